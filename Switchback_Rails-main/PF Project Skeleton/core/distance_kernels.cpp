@@ -0,0 +1,264 @@
+#include "distance_kernels.h"
+#include "grid.h"
+#include "trains.h"
+#include <climits>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DISTANCE_KERNELS_X86
+#endif
+
+using namespace std;
+
+// ============================================================================
+// DISTANCE_KERNELS.CPP - Scalar, SSE4.1 and AVX2 distance kernels
+// ============================================================================
+// The SIMD versions are compiled with target attributes, so the rest of the
+// build needs no -m flags, and are only called after the CPU check. Each
+// handles whole vectors and leaves the tail to the scalar version.
+// ============================================================================
+
+static int detectDistanceKernelLevel() {
+#ifdef DISTANCE_KERNELS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return KERNEL_AVX2;
+    if(__builtin_cpu_supports("sse4.1")) return KERNEL_SSE4;
+#endif
+    return KERNEL_SCALAR;
+}
+
+// Set before main(), so parallel sweep workers only ever read it
+static int g_bestKernelLevel = detectDistanceKernelLevel();
+static int g_kernelLevel = g_bestKernelLevel;
+
+// ----------------------------------------------------------------------------
+// Dispatch
+// ----------------------------------------------------------------------------
+int getDistanceKernelLevel() {
+    return g_kernelLevel;
+}
+
+int getBestDistanceKernelLevel() {
+    return g_bestKernelLevel;
+}
+
+bool setDistanceKernelLevel(int level) {
+    if(level < 0 || level > g_bestKernelLevel) {
+        return false;
+    }
+    g_kernelLevel = level;
+    return true;
+}
+
+const char* getDistanceKernelName(int level) {
+    const char* names[KERNEL_LEVEL_COUNT] = {"scalar", "sse4", "avx2"};
+    return (level >= 0 && level < KERNEL_LEVEL_COUNT) ? names[level] : "unknown";
+}
+
+int findDistanceKernelLevel(const char* name) {
+    for(int level = 0; level < KERNEL_LEVEL_COUNT; level++) {
+        if(strcmp(name, getDistanceKernelName(level)) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+// ----------------------------------------------------------------------------
+// Scalar kernels (from index begin on)
+// ----------------------------------------------------------------------------
+static void priorityScalar(const World& world, const int ids[], int begin, int count, int out[]) {
+    for(int k = begin; k < count; k++) {
+        out[ids[k]] = getPriorityDistance(world, ids[k]);
+    }
+}
+
+// The flat trackDist index must fit the 32-bit lanes
+static bool fitsVectorIndex(const World& world) {
+    long long entries = (long long)world.gridRows * world.gridCols * 4 * world.destCount;
+    return entries < INT_MAX;
+}
+
+#ifdef DISTANCE_KERNELS_X86
+
+// ----------------------------------------------------------------------------
+// SSE4.1 kernels (4 lanes; no gathers, so the loads stay scalar)
+// ----------------------------------------------------------------------------
+__attribute__((target("sse4.1")))
+static void prioritySse4(const World& world, const int ids[], int count, int out[]) {
+    int stateCount = world.gridRows * world.gridCols * 4;
+    const __m128i cols = _mm_set1_epi32(world.gridCols);
+    const __m128i states = _mm_set1_epi32(stateCount);
+    const __m128i fieldLimit = _mm_set1_epi32(world.destCount);
+    const __m128i minusOne = _mm_set1_epi32(-1);
+    int vectorEnd = count & ~3;
+    
+    for(int k = 0; k < vectorEnd; k += 4) {
+        int lane[6][4];
+        for(int j = 0; j < 4; j++) {
+            int t = ids[k + j];
+            lane[0][j] = world.trainX[t];
+            lane[1][j] = world.trainY[t];
+            lane[2][j] = world.trainDir[t];
+            lane[3][j] = world.trainDestField[t];
+            lane[4][j] = world.trainDestX[t];
+            lane[5][j] = world.trainDestY[t];
+        }
+        __m128i x = _mm_loadu_si128((const __m128i*)lane[0]);
+        __m128i y = _mm_loadu_si128((const __m128i*)lane[1]);
+        __m128i dir = _mm_loadu_si128((const __m128i*)lane[2]);
+        __m128i field = _mm_loadu_si128((const __m128i*)lane[3]);
+        __m128i destX = _mm_loadu_si128((const __m128i*)lane[4]);
+        __m128i destY = _mm_loadu_si128((const __m128i*)lane[5]);
+        
+        __m128i cell = _mm_add_epi32(_mm_mullo_epi32(y, cols), x);
+        __m128i index = _mm_add_epi32(_mm_mullo_epi32(field, states),
+                                      _mm_add_epi32(_mm_slli_epi32(cell, 2), dir));
+        __m128i hasField = _mm_and_si128(_mm_cmpgt_epi32(field, minusOne),
+                                         _mm_cmpgt_epi32(fieldLimit, field));
+        
+        int indices[4];
+        int tracked[4];
+        _mm_storeu_si128((__m128i*)indices, index);
+        int fieldMask = _mm_movemask_ps(_mm_castsi128_ps(hasField));
+        for(int j = 0; j < 4; j++) {
+            tracked[j] = (fieldMask & (1 << j)) ? world.trackDist[indices[j]] : 0;
+        }
+        
+        __m128i manhattan = _mm_add_epi32(_mm_abs_epi32(_mm_sub_epi32(destX, x)),
+                                          _mm_abs_epi32(_mm_sub_epi32(destY, y)));
+        __m128i dist = _mm_blendv_epi8(manhattan, _mm_loadu_si128((const __m128i*)tracked), hasField);
+        
+        int result[4];
+        _mm_storeu_si128((__m128i*)result, dist);
+        for(int j = 0; j < 4; j++) {
+            out[ids[k + j]] = result[j];
+        }
+    }
+    priorityScalar(world, ids, vectorEnd, count, out);
+}
+
+// ----------------------------------------------------------------------------
+// AVX2 kernels (8 lanes, gathered loads)
+// ----------------------------------------------------------------------------
+// The distance fields are 16-bit, so each lane gathers the 32 bits at its
+// entry and keeps the low half. The 2 bytes past the last entry still lie
+// inside world.memory (more arrays follow trackDist).
+__attribute__((target("avx2")))
+static void priorityAvx2(const World& world, const int ids[], int count, int out[]) {
+    int stateCount = world.gridRows * world.gridCols * 4;
+    const __m256i cols = _mm256_set1_epi32(world.gridCols);
+    const __m256i states = _mm256_set1_epi32(stateCount);
+    const __m256i fieldLimit = _mm256_set1_epi32(world.destCount);
+    const __m256i minusOne = _mm256_set1_epi32(-1);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    const int* distBase = (const int*)world.trackDist;
+    int vectorEnd = count & ~7;
+    
+    for(int k = 0; k < vectorEnd; k += 8) {
+        __m256i id = _mm256_loadu_si256((const __m256i*)&ids[k]);
+        __m256i x = _mm256_i32gather_epi32(world.trainX, id, 4);
+        __m256i y = _mm256_i32gather_epi32(world.trainY, id, 4);
+        __m256i dir = _mm256_i32gather_epi32(world.trainDir, id, 4);
+        __m256i field = _mm256_i32gather_epi32(world.trainDestField, id, 4);
+        __m256i destX = _mm256_i32gather_epi32(world.trainDestX, id, 4);
+        __m256i destY = _mm256_i32gather_epi32(world.trainDestY, id, 4);
+        
+        __m256i cell = _mm256_add_epi32(_mm256_mullo_epi32(y, cols), x);
+        __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(field, states),
+                                          _mm256_add_epi32(_mm256_slli_epi32(cell, 2), dir));
+        __m256i hasField = _mm256_and_si256(_mm256_cmpgt_epi32(field, minusOne),
+                                            _mm256_cmpgt_epi32(fieldLimit, field));
+        
+        __m256i tracked = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), distBase, index,
+                                                      hasField, 2);
+        tracked = _mm256_and_si256(tracked, low16);
+        
+        __m256i manhattan = _mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(destX, x)),
+                                             _mm256_abs_epi32(_mm256_sub_epi32(destY, y)));
+        __m256i dist = _mm256_blendv_epi8(manhattan, tracked, hasField);
+        
+        int result[8];
+        _mm256_storeu_si256((__m256i*)result, dist);
+        for(int j = 0; j < 8; j++) {
+            out[ids[k + j]] = result[j];
+        }
+    }
+    priorityScalar(world, ids, vectorEnd, count, out);
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+// Kernels at a given level
+// ----------------------------------------------------------------------------
+static void computePriorityDistancesAt(int level, const World& world, const int ids[], int count,
+                                       int out[]) {
+#ifdef DISTANCE_KERNELS_X86
+    if(level == KERNEL_AVX2 && fitsVectorIndex(world)) {
+        priorityAvx2(world, ids, count, out);
+        return;
+    }
+    if(level >= KERNEL_SSE4 && fitsVectorIndex(world)) {
+        prioritySse4(world, ids, count, out);
+        return;
+    }
+#endif
+    priorityScalar(world, ids, 0, count, out);
+}
+
+void computePriorityDistances(const World& world, const int ids[], int count, int out[]) {
+    computePriorityDistancesAt(g_kernelLevel, world, ids, count, out);
+}
+
+// ----------------------------------------------------------------------------
+// Verification
+// ----------------------------------------------------------------------------
+// Priority distances of every train on the grid, in a shuffled order so the
+// gathers are not sequential
+int verifyDistanceKernels(const World& world, int level) {
+    if(level < 0 || level > g_bestKernelLevel) {
+        return 0;
+    }
+    int mismatches = 0;
+    
+    int trainCount = world.trainCount;
+    int* ids = new int[trainCount + 1];
+    int* dist = new int[trainCount + 1];
+    int idCount = 0;
+    for(int t = 0; t < trainCount; t++) {
+        if(isInBounds(world.trainX[t], world.trainY[t], world.gridCols, world.gridRows) &&
+           world.trainDir[t] >= 0 && world.trainDir[t] < 4) {
+            ids[idCount++] = t;
+        }
+    }
+    unsigned int random = 12345;
+    for(int i = idCount - 1; i > 0; i--) {
+        random = random * 1103515245u + 12345u;
+        int j = (int)((random >> 8) % (unsigned int)(i + 1));
+        int swap = ids[i];
+        ids[i] = ids[j];
+        ids[j] = swap;
+    }
+    computePriorityDistancesAt(level, world, ids, idCount, dist);
+    for(int k = 0; k < idCount; k++) {
+        if(dist[ids[k]] != getPriorityDistance(world, ids[k])) {
+            mismatches++;
+        }
+    }
+    
+    // Short batches as well, so every tail length is covered
+    for(int count = 1; count <= 16 && count <= idCount; count++) {
+        computePriorityDistancesAt(level, world, ids, count, dist);
+        for(int k = 0; k < count; k++) {
+            if(dist[ids[k]] != getPriorityDistance(world, ids[k])) {
+                mismatches++;
+            }
+        }
+    }
+    
+    delete[] ids;
+    delete[] dist;
+    return mismatches;
+}
@@ -0,0 +1,54 @@
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+// ============================================================================
+// DISTANCE_KERNELS.H - Batched distance computations
+// ============================================================================
+// The collision priority distances over the World's int32 arrays, built
+// three times: scalar, SSE4.1 and AVX2. The best level the CPU supports is
+// picked at startup; setDistanceKernelLevel() forces another one. All
+// levels give bit-identical results (integer arithmetic only), which
+// verifyDistanceKernels() checks.
+// ============================================================================
+
+#include "world.h"
+
+const int KERNEL_SCALAR = 0;
+const int KERNEL_SSE4 = 1;
+const int KERNEL_AVX2 = 2;
+const int KERNEL_LEVEL_COUNT = 3;
+
+// ----------------------------------------------------------------------------
+// DISPATCH
+// ----------------------------------------------------------------------------
+int getDistanceKernelLevel();
+
+// Best level this CPU supports
+int getBestDistanceKernelLevel();
+
+// False (and no change) when the CPU does not support the level
+bool setDistanceKernelLevel(int level);
+
+// "scalar", "sse4", "avx2"
+const char* getDistanceKernelName(int level);
+
+// KERNEL_* for a name, -1 if unknown
+int findDistanceKernelLevel(const char* name);
+
+// ----------------------------------------------------------------------------
+// KERNELS
+// ----------------------------------------------------------------------------
+// getPriorityDistance() of every train in ids[0..count), written to
+// out[ids[k]]: the track distance to its destination, or the Manhattan
+// distance when it has no distance field
+void computePriorityDistances(const World& world, const int ids[], int count, int out[]);
+
+// ----------------------------------------------------------------------------
+// VERIFICATION
+// ----------------------------------------------------------------------------
+// Runs the kernel at the given level on the world's trains, in one batch and
+// in short ones, and compares with the scalar code; returns the number of
+// mismatching results
+int verifyDistanceKernels(const World& world, int level);
+
+#endif
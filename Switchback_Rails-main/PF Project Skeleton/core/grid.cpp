@@ -1,10 +1,15 @@
 #include "grid.h"
 #include "simulation_state.h"
+#include "trains.h"
+#include "state_hash.h"
 
 // ============================================================================
 // GRID.CPP - Grid utilities
 // ============================================================================
 
+const int STEP_X[] = {0, 1, 0, -1};
+const int STEP_Y[] = {-1, 0, 1, 0};
+
 // ----------------------------------------------------------------------------
 // Check if position is inside grid
 // ----------------------------------------------------------------------------
@@ -18,14 +23,15 @@ bool isInBounds(int x, int y, int gr_cols, int gr_rows) {
 bool isTrackTile(char tile) {
     return ((tile == '-') || (tile == '|') || (tile == '/') || (tile == '\\') ||
             (tile == '+') || (tile == 'S') || (tile == 'D') || (tile == '=') ||
-            (tile >= 'A') && (tile <= 'Z'));
+            (tile == '*') || ((tile >= 'A') && (tile <= 'Z')));
 }
 
 // ----------------------------------------------------------------------------
-// Check if tile is a switch
+// Check if tile is a switch (a letter, or '*' for a switch the SWITCHES
+// section names by its cell)
 // ----------------------------------------------------------------------------
 bool isSwitchTile(char tile) {
-    return ((tile >= 'A') && (tile <= 'Z'));
+    return ((tile == '*') || ((tile >= 'A') && (tile <= 'Z')));
 }
 
 // ----------------------------------------------------------------------------
@@ -65,23 +71,283 @@ bool isDestinationPoint(int x, int y, int destX[], int destY[], int destCount) {
 // ----------------------------------------------------------------------------
 // Toggle safety tile at position
 // ----------------------------------------------------------------------------
-bool toggleSafetyTile(int x, int y, char grid[][100], int gr_cols, int gr_rows) {
-    if(!isInBounds(x, y, gr_cols, gr_rows)) {
+bool toggleSafetyTile(World& world, int x, int y) {
+    if(!isInBounds(x, y, world.gridCols, world.gridRows)) {
         return false;
     }
     
-    char tile = grid[y][x];
+    char tile = getTile(world, x, y);
+    int cell = y * world.gridCols + x;
     
+    char toggled;
     if(tile == '-' || tile == '|') {
-        grid[y][x] = '=';
-        return true;
+        toggled = '=';
+    }
+    else if(tile == '=') {
+        toggled = '-';
+    }
+    else {
+        return false;
+    }
+    
+    updateStateHash(world, HASH_SAFETY_TILE, cell, getSafetyTileValue(tile),
+                    getSafetyTileValue(toggled));
+    setTile(world, x, y, toggled);
+    refreshTransitionCell(world, x, y);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Compute the table entries of one cell from the tile rules
+// ----------------------------------------------------------------------------
+void computeTransitionCell(World& world, int x, int y) {
+    long long base = ((long long)y * world.gridCols + x) * 4;
+    char tile = getTile(world, x, y);
+    unsigned char crossing = (tile == '+') ? TRANSITION_CROSSING : 0;
+    
+    for(int dir = 0; dir < 4; dir++) {
+        int nextDir = getNextDirection(x, y, dir, tile, nullptr, nullptr);
+        int nextX = x + STEP_X[nextDir];
+        int nextY = y + STEP_Y[nextDir];
+        
+        unsigned char entry = (unsigned char)nextDir | crossing;
+        if(!isInBounds(nextX, nextY, world.gridCols, world.gridRows) ||
+           !isTrackTile(getTile(world, nextX, nextY))) {
+            entry |= TRANSITION_CRASH;
+        }
+        world.transitions[base + dir] = entry;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Build the transition table for the whole grid (called at load time)
+// ----------------------------------------------------------------------------
+void buildTransitionTable(World& world) {
+    for(int y = 0; y < world.gridRows; y++) {
+        for(int x = 0; x < world.gridCols; x++) {
+            computeTransitionCell(world, x, y);
+        }
     }
+}
+
+// ----------------------------------------------------------------------------
+// Reverse BFS from one destination over (cell, heading) states
+// ----------------------------------------------------------------------------
+// A state's predecessors all sit on the cell behind it. A crossing can send a
+// train out in any direction, every other tile follows the transition table.
+void computeDistanceField(World& world, int field) {
+    long long stateCount = (long long)world.gridRows * world.gridCols * 4;
+    unsigned short* dist = &world.trackDist[field * stateCount];
+    const unsigned char* table = world.transitions;
+    int* queue = world.bfsQueue;
     
-    if(tile == '=') {
-        grid[y][x] = '-';
-        return true;
+    for(long long s = 0; s < stateCount; s++) {
+        dist[s] = TRACK_DISTANCE_UNREACHABLE;
     }
     
-    return false;
+    long long head = 0;
+    long long tail = 0;
+    int destBase = (world.destY[field] * world.gridCols + world.destX[field]) * 4;
+    for(int dir = 0; dir < 4; dir++) {
+        dist[destBase + dir] = 0;
+        queue[tail++] = destBase + dir;
+    }
+    
+    while(head < tail) {
+        int state = queue[head++];
+        
+        // Its predecessors would need a distance the field cannot hold (and
+        // 0xFFFF would leave them looking unvisited, to be queued again)
+        if(dist[state] >= TRACK_DISTANCE_MAX) {
+            continue;
+        }
+        
+        int cell = state / 4;
+        int heading = state % 4;
+        int px = cell % world.gridCols - STEP_X[heading];
+        int py = cell / world.gridCols - STEP_Y[heading];
+        
+        if(!isInBounds(px, py, world.gridCols, world.gridRows) ||
+           !isTrackTile(getTile(world, px, py))) {
+            continue;
+        }
+        
+        int prevBase = (py * world.gridCols + px) * 4;
+        bool crossing = (table[prevBase] & TRANSITION_CROSSING) != 0;
+        unsigned short nextDist = dist[state] + 1;
+        
+        for(int dir = 0; dir < 4; dir++) {
+            int entry = prevBase + dir;
+            if(dist[entry] != TRACK_DISTANCE_UNREACHABLE) {
+                continue;
+            }
+            
+            bool reaches;
+            if(crossing) {
+                reaches = (table[prevBase + heading] & TRANSITION_CRASH) == 0;
+            } else {
+                reaches = (table[entry] & TRANSITION_CRASH) == 0 &&
+                          (table[entry] & TRANSITION_DIR_MASK) == heading;
+            }
+            
+            if(reaches) {
+                dist[entry] = nextDist;
+                queue[tail++] = entry;
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// A table entry changed: flag the fields in which it can matter. The entry is
+// irrelevant to a field if no state on its cell reaches the destination and
+// the new successor does not reach it either.
+// ----------------------------------------------------------------------------
+void markDistanceFieldsForEntry(World& world, int entry) {
+    long long stateCount = (long long)world.gridRows * world.gridCols * 4;
+    int cellBase = entry - entry % 4;
+    int cell = entry / 4;
+    unsigned char transition = world.transitions[entry];
+    int nextDir = transition & TRANSITION_DIR_MASK;
+    int nextEntry = -1;
+    if((transition & TRANSITION_CRASH) == 0) {
+        int nextX = cell % world.gridCols + STEP_X[nextDir];
+        int nextY = cell / world.gridCols + STEP_Y[nextDir];
+        nextEntry = (nextY * world.gridCols + nextX) * 4 + nextDir;
+    }
+    
+    for(int f = 0; f < world.destCount; f++) {
+        if(world.fieldDirty[f]) continue;
+        
+        const unsigned short* dist = &world.trackDist[f * stateCount];
+        bool matters = false;
+        
+        for(int dir = 0; dir < 4; dir++) {
+            if(dist[cellBase + dir] != TRACK_DISTANCE_UNREACHABLE) {
+                matters = true;
+            }
+        }
+        
+        if(nextEntry >= 0 && dist[nextEntry] != TRACK_DISTANCE_UNREACHABLE) {
+            matters = true;
+        }
+        
+        world.fieldDirty[f] = matters;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Recompute a changed cell and the neighbours that can step onto it, then
+// repair any distance field the change can affect
+// ----------------------------------------------------------------------------
+void refreshTransitionCell(World& world, int x, int y) {
+    const int dx[] = {0, 0, 1, 0, -1};
+    const int dy[] = {0, -1, 0, 1, 0};
+    
+    for(int i = 0; i < 5; i++) {
+        int cx = x + dx[i];
+        int cy = y + dy[i];
+        if(!isInBounds(cx, cy, world.gridCols, world.gridRows)) {
+            continue;
+        }
+        
+        int base = (cy * world.gridCols + cx) * 4;
+        unsigned char old[4];
+        for(int dir = 0; dir < 4; dir++) {
+            old[dir] = world.transitions[base + dir];
+        }
+        
+        computeTransitionCell(world, cx, cy);
+        
+        for(int dir = 0; dir < 4; dir++) {
+            if(old[dir] != world.transitions[base + dir]) {
+                markDistanceFieldsForEntry(world, base + dir);
+            }
+        }
+    }
+    
+    for(int f = 0; f < world.destCount; f++) {
+        if(world.fieldDirty[f]) {
+            computeDistanceField(world, f);
+            world.fieldDirty[f] = false;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Look up next cell/direction; false if the step crashes
+// ----------------------------------------------------------------------------
+bool lookupTransition(const World& world, int x, int y, int dir,
+                      int& nextX, int& nextY, int& nextDir) {
+    unsigned char entry = world.transitions[(y * world.gridCols + x) * 4 + dir];
+    nextDir = entry & TRANSITION_DIR_MASK;
+    nextX = x + STEP_X[nextDir];
+    nextY = y + STEP_Y[nextDir];
+    return (entry & TRANSITION_CRASH) == 0;
 }
 
+// ----------------------------------------------------------------------------
+// Compare every table entry with getNextDirection()/isTrackTile(); returns
+// the number of mismatching entries
+// ----------------------------------------------------------------------------
+int validateTransitionTable(const World& world) {
+    int mismatches = 0;
+    
+    for(int y = 0; y < world.gridRows; y++) {
+        for(int x = 0; x < world.gridCols; x++) {
+            char tile = getTile(world, x, y);
+            
+            for(int dir = 0; dir < 4; dir++) {
+                int expectedDir = getNextDirection(x, y, dir, tile, nullptr, nullptr);
+                int expectedX = x;
+                int expectedY = y;
+                
+                if(expectedDir == 0) expectedY--;
+                else if(expectedDir == 1) expectedX++;
+                else if(expectedDir == 2) expectedY++;
+                else if(expectedDir == 3) expectedX--;
+                
+                bool expectedCrash = !isInBounds(expectedX, expectedY, world.gridCols, world.gridRows) ||
+                                     !isTrackTile(getTile(world, expectedX, expectedY));
+                
+                int nextX, nextY, nextDir;
+                bool ok = lookupTransition(world, x, y, dir, nextX, nextY, nextDir);
+                bool crossing = (world.transitions[(y * world.gridCols + x) * 4] &
+                                 TRANSITION_CROSSING) != 0;
+                
+                if(ok == expectedCrash || nextDir != expectedDir ||
+                   (ok && (nextX != expectedX || nextY != expectedY)) ||
+                   crossing != (tile == '+')) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    
+    return mismatches;
+}
+
+// ----------------------------------------------------------------------------
+// Build one distance field per destination (called at load time, after the
+// transition table)
+// ----------------------------------------------------------------------------
+void buildTrackDistanceFields(World& world) {
+    for(int f = 0; f < world.destCount; f++) {
+        world.fieldDirty[f] = false;
+        computeDistanceField(world, f);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Track distance from (x, y) with a heading to the destination of a field.
+// Returns TRACK_DISTANCE_UNREACHABLE if the train cannot get there, or -1 if
+// there is no such field
+// ----------------------------------------------------------------------------
+int getTrackDistance(const World& world, int field, int x, int y, int dir) {
+    if(field < 0 || field >= world.destCount) {
+        return -1;
+    }
+    
+    long long stateCount = (long long)world.gridRows * world.gridCols * 4;
+    return world.trackDist[field * stateCount + (y * world.gridCols + x) * 4 + dir];
+}
@@ -5,6 +5,8 @@
 // GRID.H - Grid manipulation functions
 // ============================================================================
 
+#include "world.h"
+
 bool isInBounds(int x, int y, int gr_cols, int gr_rows);
 
 bool isTrackTile(char tile);
@@ -17,7 +19,45 @@ bool isSpawnPoint(int x, int y, int spawnX[], int spawnY[], int spawnCount);
 
 bool isDestinationPoint(int x, int y, int destX[], int destY[], int destCount);
 
-bool toggleSafetyTile(int x, int y, char grid[][100], int gr_cols, int gr_rows);
+bool toggleSafetyTile(World& world, int x, int y);
 
-#endif
+// ----------------------------------------------------------------------------
+// TRANSITION TABLE
+// ----------------------------------------------------------------------------
+// For every (cell, incoming direction) the table holds one byte: the
+// outgoing direction, TRANSITION_CRASH when that step leaves the grid or
+// lands on a non-track tile, and TRANSITION_CROSSING on '+' cells. Crossings
+// are stored as straight-through; the caller picks the direction first and
+// then looks up (cell, newDir).
+const unsigned char TRANSITION_DIR_MASK = 3;
+const unsigned char TRANSITION_CRASH = 4;
+const unsigned char TRANSITION_CROSSING = 8;
+
+void buildTransitionTable(World& world);
+
+void refreshTransitionCell(World& world, int x, int y);
+
+bool lookupTransition(const World& world, int x, int y, int dir,
+                      int& nextX, int& nextY, int& nextDir);
 
+int validateTransitionTable(const World& world);
+
+// ----------------------------------------------------------------------------
+// TRACK DISTANCE FIELDS
+// ----------------------------------------------------------------------------
+// One uint16 field per destination: the number of moves a train needs to
+// reach it from (cell, current heading), following the transition table and
+// taking the best exit at crossings. Built after the transition table and
+// repaired by refreshTransitionCell() whenever a table entry changes.
+//
+// Distances go up to TRACK_DISTANCE_MAX moves. States further away than
+// that are left TRACK_DISTANCE_UNREACHABLE, so on very long tracks a train
+// far from its destination routes and ranks as if it could not reach it.
+const unsigned short TRACK_DISTANCE_UNREACHABLE = 0xFFFF;
+const unsigned short TRACK_DISTANCE_MAX = 0xFFFE;
+
+void buildTrackDistanceFields(World& world);
+
+int getTrackDistance(const World& world, int field, int x, int y, int dir);
+
+#endif
@@ -0,0 +1,346 @@
+#include "history.h"
+#include "snapshot.h"
+#include <cstring>
+
+using namespace std;
+
+// ============================================================================
+// HISTORY.CPP - Keyframes and per-tick deltas
+// ============================================================================
+//
+// A segment is one keyframe followed by the deltas of the ticks after it:
+//
+//   keyframe   snapshot bytes of firstTick
+//   delta      u32 recordBytes, then runs of
+//              u32 wordOffset, u32 wordCount, wordCount x 8 bytes
+//
+// Segments are kept oldest first.
+// ============================================================================
+
+struct HistorySegment {
+    int firstTick;
+    int lastTick;
+    unsigned char* data;
+    long long used;
+    long long capacity;
+};
+
+struct History {
+    int keyframeInterval;
+    long long budgetBytes;
+    long long snapshotBytes;
+    
+    unsigned char* current;     // snapshot of the tick being recorded
+    unsigned char* previous;    // snapshot of the last recorded tick
+    unsigned char* delta;       // delta being encoded (worst-case size)
+    
+    HistorySegment* segments;
+    int segmentCount;
+    int segmentCapacity;
+    long long storedBytes;
+};
+
+// ----------------------------------------------------------------------------
+// Raw helpers
+// ----------------------------------------------------------------------------
+static void putU32(unsigned char* p, unsigned value) {
+    memcpy(p, &value, 4);
+}
+
+static unsigned getU32(const unsigned char* p) {
+    unsigned value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+// ----------------------------------------------------------------------------
+// Make room for need more bytes in a segment
+// ----------------------------------------------------------------------------
+static void reserveSegment(History* history, HistorySegment& segment, long long need) {
+    if(segment.used + need <= segment.capacity) {
+        return;
+    }
+    
+    long long newCapacity = (segment.capacity == 0) ? history->snapshotBytes : segment.capacity;
+    while(newCapacity < segment.used + need) {
+        newCapacity += newCapacity / 2;
+    }
+    
+    unsigned char* bigger = new unsigned char[newCapacity];
+    if(segment.data != nullptr) {
+        memcpy(bigger, segment.data, segment.used);
+        delete[] segment.data;
+    }
+    
+    history->storedBytes += newCapacity - segment.capacity;
+    segment.data = bigger;
+    segment.capacity = newCapacity;
+}
+
+// ----------------------------------------------------------------------------
+// Drop the oldest segment / the newest segment
+// ----------------------------------------------------------------------------
+static void dropSegment(History* history, int index) {
+    history->storedBytes -= history->segments[index].capacity;
+    delete[] history->segments[index].data;
+    
+    for(int s = index + 1; s < history->segmentCount; s++) {
+        history->segments[s - 1] = history->segments[s];
+    }
+    history->segmentCount--;
+}
+
+// ----------------------------------------------------------------------------
+// Start a segment with the current snapshot as its keyframe
+// ----------------------------------------------------------------------------
+static void beginSegment(History* history, int tick) {
+    if(history->segmentCount == history->segmentCapacity) {
+        int newCapacity = (history->segmentCapacity == 0) ? 16 : history->segmentCapacity * 2;
+        HistorySegment* bigger = new HistorySegment[newCapacity];
+        for(int s = 0; s < history->segmentCount; s++) {
+            bigger[s] = history->segments[s];
+        }
+        delete[] history->segments;
+        history->segments = bigger;
+        history->segmentCapacity = newCapacity;
+    }
+    
+    HistorySegment& segment = history->segments[history->segmentCount++];
+    segment.firstTick = tick;
+    segment.lastTick = tick;
+    segment.data = nullptr;
+    segment.used = 0;
+    segment.capacity = 0;
+    
+    reserveSegment(history, segment, history->snapshotBytes);
+    memcpy(segment.data, history->current, history->snapshotBytes);
+    segment.used = history->snapshotBytes;
+}
+
+// ----------------------------------------------------------------------------
+// Append the delta from previous to current
+// ----------------------------------------------------------------------------
+// Runs of changed words; an unchanged word between two changes costs the
+// same as a new run header, so such gaps are folded into the run.
+static void appendDelta(History* history, HistorySegment& segment) {
+    long long words = history->snapshotBytes / 8;
+    const unsigned char* now = history->current;
+    const unsigned char* before = history->previous;
+    unsigned char* start = history->delta;
+    unsigned char* p = start + 4;
+    
+    long long w = 0;
+    while(w < words) {
+        if(memcmp(now + w * 8, before + w * 8, 8) == 0) {
+            w++;
+            continue;
+        }
+        
+        long long runStart = w;
+        long long runEnd = w + 1;
+        while(runEnd < words) {
+            if(memcmp(now + runEnd * 8, before + runEnd * 8, 8) != 0) {
+                runEnd++;
+            } else if(runEnd + 1 < words &&
+                      memcmp(now + (runEnd + 1) * 8, before + (runEnd + 1) * 8, 8) != 0) {
+                runEnd += 2;
+            } else {
+                break;
+            }
+        }
+        
+        putU32(p, (unsigned)runStart);
+        putU32(p + 4, (unsigned)(runEnd - runStart));
+        memcpy(p + 8, now + runStart * 8, (runEnd - runStart) * 8);
+        p += 8 + (runEnd - runStart) * 8;
+        w = runEnd;
+    }
+    
+    long long recordBytes = p - start;
+    putU32(start, (unsigned)recordBytes);
+    
+    reserveSegment(history, segment, recordBytes);
+    memcpy(segment.data + segment.used, start, recordBytes);
+    segment.used += recordBytes;
+}
+
+// ----------------------------------------------------------------------------
+// Apply one delta record to a snapshot; returns the record size
+// ----------------------------------------------------------------------------
+static long long applyDelta(const unsigned char* record, unsigned char snapshot[]) {
+    unsigned recordBytes = getU32(record);
+    const unsigned char* p = record + 4;
+    const unsigned char* end = record + recordBytes;
+    
+    while(p < end) {
+        unsigned wordOffset = getU32(p);
+        unsigned wordCount = getU32(p + 4);
+        memcpy(snapshot + (long long)wordOffset * 8, p + 8, (long long)wordCount * 8);
+        p += 8 + (long long)wordCount * 8;
+    }
+    
+    return recordBytes;
+}
+
+// ----------------------------------------------------------------------------
+// Segment holding a tick, or -1
+// ----------------------------------------------------------------------------
+static int findSegment(const History* history, int tick) {
+    int low = 0;
+    int high = history->segmentCount - 1;
+    while(low <= high) {
+        int mid = (low + high) / 2;
+        const HistorySegment& segment = history->segments[mid];
+        if(tick < segment.firstTick) {
+            high = mid - 1;
+        } else if(tick > segment.lastTick) {
+            low = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+// ----------------------------------------------------------------------------
+// Rebuild the snapshot of a stored tick; returns the end of its delta
+// ----------------------------------------------------------------------------
+static long long rebuildTick(const History* history, int index, int tick,
+                             unsigned char snapshot[]) {
+    const HistorySegment& segment = history->segments[index];
+    memcpy(snapshot, segment.data, history->snapshotBytes);
+    
+    long long offset = history->snapshotBytes;
+    for(int t = segment.firstTick; t < tick; t++) {
+        offset += applyDelta(segment.data + offset, snapshot);
+    }
+    return offset;
+}
+
+// ----------------------------------------------------------------------------
+// Create / destroy
+// ----------------------------------------------------------------------------
+History* createHistory(const World& world, int keyframeInterval, long long budgetBytes) {
+    History* history = new History;
+    history->keyframeInterval = (keyframeInterval > 0) ? keyframeInterval : 1;
+    history->budgetBytes = budgetBytes;
+    history->snapshotBytes = getSnapshotSize(world);
+    history->current = new unsigned char[history->snapshotBytes];
+    history->previous = new unsigned char[history->snapshotBytes];
+    // Changed runs are at least one word apart, so at most words / 2 + 1 of them
+    history->delta = new unsigned char[4 + history->snapshotBytes + 8 * (history->snapshotBytes / 16 + 1)];
+    history->segments = nullptr;
+    history->segmentCount = 0;
+    history->segmentCapacity = 0;
+    history->storedBytes = 0;
+    return history;
+}
+
+void destroyHistory(History* history) {
+    if(history == nullptr) {
+        return;
+    }
+    while(history->segmentCount > 0) {
+        dropSegment(history, history->segmentCount - 1);
+    }
+    delete[] history->segments;
+    delete[] history->current;
+    delete[] history->previous;
+    delete[] history->delta;
+    delete history;
+}
+
+// ----------------------------------------------------------------------------
+// Drop every tick after lastKeptTick
+// ----------------------------------------------------------------------------
+void truncateHistory(History* history, int lastKeptTick) {
+    while(history->segmentCount > 0 &&
+          history->segments[history->segmentCount - 1].firstTick > lastKeptTick) {
+        dropSegment(history, history->segmentCount - 1);
+    }
+    
+    if(history->segmentCount == 0) {
+        return;
+    }
+    
+    HistorySegment& segment = history->segments[history->segmentCount - 1];
+    if(segment.lastTick <= lastKeptTick) {
+        return;
+    }
+    
+    // previous must hold the new last tick for the next delta
+    segment.used = rebuildTick(history, history->segmentCount - 1, lastKeptTick,
+                               history->previous);
+    segment.lastTick = lastKeptTick;
+}
+
+// ----------------------------------------------------------------------------
+// Record one tick
+// ----------------------------------------------------------------------------
+void recordHistoryTick(History* history, const World& world) {
+    int tick = world.currentTick;
+    
+    if(history->segmentCount > 0 && tick <= getHistoryLastTick(history)) {
+        truncateHistory(history, tick - 1);
+    }
+    
+    snapshotWorld(world, history->current);
+    
+    bool keyframe = true;
+    if(history->segmentCount > 0) {
+        HistorySegment& last = history->segments[history->segmentCount - 1];
+        keyframe = (tick != last.lastTick + 1) ||
+                   (tick - last.firstTick >= history->keyframeInterval);
+    }
+    
+    if(keyframe) {
+        beginSegment(history, tick);
+    } else {
+        HistorySegment& last = history->segments[history->segmentCount - 1];
+        appendDelta(history, last);
+        last.lastTick = tick;
+    }
+    
+    unsigned char* swap = history->previous;
+    history->previous = history->current;
+    history->current = swap;
+    
+    // The newest segment always stays, even on its own over budget
+    while(history->storedBytes > history->budgetBytes && history->segmentCount > 1) {
+        dropSegment(history, 0);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Seek to a stored tick
+// ----------------------------------------------------------------------------
+bool seekHistory(History* history, World& world, int tick) {
+    int index = findSegment(history, tick);
+    if(index < 0) {
+        return false;
+    }
+    
+    rebuildTick(history, index, tick, history->current);
+    return restoreWorld(world, history->current);
+}
+
+// ----------------------------------------------------------------------------
+// Range and size
+// ----------------------------------------------------------------------------
+int getHistoryFirstTick(const History* history) {
+    if(history->segmentCount == 0) {
+        return -1;
+    }
+    return history->segments[0].firstTick;
+}
+
+int getHistoryLastTick(const History* history) {
+    if(history->segmentCount == 0) {
+        return -1;
+    }
+    return history->segments[history->segmentCount - 1].lastTick;
+}
+
+long long getHistoryBytes(const History* history) {
+    return history->storedBytes;
+}
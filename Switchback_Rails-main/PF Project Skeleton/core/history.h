@@ -0,0 +1,55 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+// ============================================================================
+// HISTORY.H - Tick history for rewinding and scrubbing
+// ============================================================================
+// Every keyframeInterval ticks the history stores a full snapshot (see
+// snapshot.h). Each tick in between is stored as a delta against the tick
+// before it: the runs of 8-byte words of the snapshot that changed. A tick
+// changes little (trains that moved, switches that flipped or counted,
+// signals that changed colour), so deltas stay small.
+//
+// Seeking restores the nearest keyframe at or before the tick and applies
+// at most keyframeInterval - 1 deltas. When the stored keyframes and deltas
+// grow past the memory budget, the oldest keyframe and its deltas are
+// dropped, so only recent ticks stay reachable.
+// ============================================================================
+
+#include "world.h"
+
+struct History;
+
+// ----------------------------------------------------------------------------
+// LIFECYCLE
+// ----------------------------------------------------------------------------
+// The world is only used for its sizes; nothing is recorded yet
+History* createHistory(const World& world, int keyframeInterval, long long budgetBytes);
+
+void destroyHistory(History* history);
+
+// ----------------------------------------------------------------------------
+// RECORDING
+// ----------------------------------------------------------------------------
+// Records the world at world.currentTick. Recording a tick at or before the
+// last recorded one first drops every tick from there on (a new branch).
+void recordHistoryTick(History* history, const World& world);
+
+// Drops every tick after lastKeptTick
+void truncateHistory(History* history, int lastKeptTick);
+
+// ----------------------------------------------------------------------------
+// SEEKING
+// ----------------------------------------------------------------------------
+// Restores the world to a recorded tick; false if the tick is not stored
+bool seekHistory(History* history, World& world, int tick);
+
+// -1 when nothing is recorded
+int getHistoryFirstTick(const History* history);
+
+int getHistoryLastTick(const History* history);
+
+// Bytes held by keyframes and deltas (the part the budget limits)
+long long getHistoryBytes(const History* history);
+
+#endif
@@ -1,16 +1,19 @@
 #include "io.h"
-#include "simulation_state.h"
-#include "grid.h"
+#include "logger.h"
+#include "trace_format.h"
+#include "state_hash.h"
+#include "tick_profiler.h"
 #include <fstream>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <unistd.h>
 
 using namespace std;
 
 // ============================================================================
-// IO.CPP - Level I/O and logging
+// IO.CPP - Logging (level loading is in level_loader.cpp)
 // ============================================================================
 
 int getLength(const char* str) {
@@ -21,425 +24,402 @@ int getLength(const char* str) {
     return len;
 }
 
-const char* findString(const char* text, const char* word) {
-    int textLen = getLength(text);
-    int wordLen = getLength(word);
-    
-    for(int i = 0; i <= textLen - wordLen; i++) {
-        bool match = true;
-        for(int j = 0; j < wordLen; j++) {
-            if(text[i + j] != word[j]) {
-                match = false;
-                break;
-            }
-        }
-        if(match) {
-            return &text[i];
-        }
+void copyString(char* dest, const char* src) {
+    int i = 0;
+    while(src[i] != '\0') {
+        dest[i] = src[i];
+        i++;
     }
-    return nullptr;
+    dest[i] = '\0';
 }
 
-int compareFirst(const char* str1, const char* str2, int n) {
-    for(int i = 0; i < n; i++) {
-        if(str1[i] != str2[i]) {
-            return str1[i] - str2[i];
-        }
-        if(str1[i] == '\0') {
-            return 0;
-        }
-    }
-    return 0;
+// ----------------------------------------------------------------------------
+// Reset a log context to the defaults
+// ----------------------------------------------------------------------------
+void initializeLogContext(LogContext& log) {
+    log.logLevel = LOG_FULL;
+    copyString(log.outputDir, "out");
+    log.traceFormat = TRACE_FORMAT_CSV;
+    log.traceCompress = false;
+    log.switchLogMode = SWITCH_LOG_DENSE;
+    log.keyframeInterval = 100;
+    log.firstLoggedTick = -1;
+    log.writer = nullptr;
+    log.logStateHashes = false;
+    log.hashFile = nullptr;
+    log.profile = nullptr;
+    log.parallel = nullptr;
+    log.timeSkip = false;
+    log.skippedTicks = 0;
+    log.resumeTick = -1;
 }
 
-int compareStrings(const char* str1, const char* str2) {
-    int i = 0;
-    while(str1[i] != '\0' && str2[i] != '\0') {
-        if(str1[i] != str2[i]) {
-            return str1[i] - str2[i];
-        }
-        i++;
+// ----------------------------------------------------------------------------
+// Are per-tick rows being written
+// ----------------------------------------------------------------------------
+static bool isLogging(const LogContext& log) {
+    return log.logLevel >= LOG_FULL && log.writer != nullptr && isLogWriterRunning(log.writer);
+}
+
+// ----------------------------------------------------------------------------
+// Select trace file format (compression applies to the binary format only)
+// ----------------------------------------------------------------------------
+void setTraceFormat(LogContext& log, int format, bool compress) {
+    log.traceFormat = format;
+    log.traceCompress = compress;
+}
+
+// ----------------------------------------------------------------------------
+// Select dense or delta (change-only) switch/signal logging
+// ----------------------------------------------------------------------------
+void setSwitchLogMode(LogContext& log, int mode, int keyframeInterval) {
+    log.switchLogMode = mode;
+    if(keyframeInterval > 0) {
+        log.keyframeInterval = keyframeInterval;
     }
-    return str1[i] - str2[i];
 }
 
-void copyString(char* dest, const char* src) {
-    int i = 0;
-    while(src[i] != '\0') {
-        dest[i] = src[i];
-        i++;
+// ----------------------------------------------------------------------------
+// Delta logging only applies to the CSV format
+// ----------------------------------------------------------------------------
+bool isDeltaLogging(const LogContext& log) {
+    return log.switchLogMode == SWITCH_LOG_DELTA && log.traceFormat == TRACE_FORMAT_CSV;
+}
+
+// ----------------------------------------------------------------------------
+// Keyframes: first logged tick and every keyframe interval after that
+// ----------------------------------------------------------------------------
+bool isKeyframeTick(LogContext& log, int tick) {
+    if(log.firstLoggedTick < 0) {
+        log.firstLoggedTick = tick;
     }
-    dest[i] = '\0';
+    return (tick == log.firstLoggedTick) || (tick % log.keyframeInterval == 0);
 }
 
-int toInt(const char* str) {
-    int result = 0;
-    int sign = 1;
-    int i = 0;
-    
-    while(str[i] == ' ' || str[i] == '\t' || str[i] == '\n') {
-        i++;
+// ----------------------------------------------------------------------------
+// Set logging level (LOG_NONE, LOG_METRICS or LOG_FULL)
+// ----------------------------------------------------------------------------
+void setLogLevel(LogContext& log, int level) {
+    log.logLevel = level;
+}
+
+// ----------------------------------------------------------------------------
+// Get logging level
+// ----------------------------------------------------------------------------
+int getLogLevel(const LogContext& log) {
+    return log.logLevel;
+}
+
+// ----------------------------------------------------------------------------
+// Set directory that receives the CSV traces and metrics (false when the
+// path is empty or does not fit; the old directory is kept)
+// ----------------------------------------------------------------------------
+bool setOutputDirectory(LogContext& log, const char* dir) {
+    int len = getLength(dir);
+    if(len <= 0 || len >= (int)sizeof(log.outputDir)) {
+        return false;
     }
     
-    if(str[i] == '-') {
-        sign = -1;
-        i++;
-    } else if(str[i] == '+') {
-        i++;
-    }
+    copyString(log.outputDir, dir);
     
-    while(str[i] >= '0' && str[i] <= '9') {
-        result = result * 10 + (str[i] - '0');
-        i++;
+    if(len > 1 && log.outputDir[len - 1] == '/') {
+        log.outputDir[len - 1] = '\0';
     }
-    
-    return result * sign;
+    return true;
 }
 
-void readSwitchData(const char* line, char& switchLetter, char modeStr[], int& state,
-                    int& k0, int& k1, int& k2, int& k3, char name0[], char name1[]) {
-    int pos = 0;
-    
-    switchLetter = line[pos];
-    pos++;
-    
-    while(line[pos] == ' ') pos++;
-    
-    int modeIdx = 0;
-    while(line[pos] != ' ' && line[pos] != '\0') {
-        modeStr[modeIdx++] = line[pos++];
+// ----------------------------------------------------------------------------
+// Continue the logs of a run resumed at tick instead of starting new ones
+// ----------------------------------------------------------------------------
+void setLogResumeTick(LogContext& log, int tick) {
+    log.resumeTick = tick;
+}
+
+// ----------------------------------------------------------------------------
+// Build "<outputDir>/<fileName>" into path
+// ----------------------------------------------------------------------------
+void buildOutputPath(const LogContext& log, char path[], const char* fileName) {
+    copyString(path, log.outputDir);
+    int len = getLength(path);
+    path[len] = '/';
+    copyString(&path[len + 1], fileName);
+}
+
+// ----------------------------------------------------------------------------
+// Create a CSV log holding only its header line
+// ----------------------------------------------------------------------------
+static bool writeLogHeader(const char* path, const char* header) {
+    ofstream file(path);
+    if(!file.is_open()) {
+        return false;
     }
-    modeStr[modeIdx] = '\0';
-    
-    while(line[pos] == ' ') pos++;
-    
-    state = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        state = state * 10 + (line[pos] - '0');
-        pos++;
+    file << header;
+    file.close();
+    return !file.fail();
+}
+
+// ----------------------------------------------------------------------------
+// Prepare a CSV log for a resumed run: keep the header and the rows up to
+// lastTick, and cut everything after them (rows the interrupted run wrote
+// past its checkpoint, a half-written last row, the end marker of a delta
+// log). A missing or empty log is started with its header.
+// ----------------------------------------------------------------------------
+static bool cutLogAfterTick(const char* path, const char* header, int lastTick, bool endMarkers) {
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr) {
+        return writeLogHeader(path, header);
+    }
+    
+    // Rows are much shorter than the buffer, so a line without its newline
+    // is the half-written end of the file
+    char line[1024];
+    long long keep = 0;
+    while(fgets(line, sizeof(line), file) != nullptr) {
+        int len = strlen(line);
+        if(line[len - 1] != '\n') {
+            break;
+        }
+        if(keep > 0) {
+            bool endMarker = endMarkers && len >= 3 && strcmp(&line[len - 3], ",E\n") == 0;
+            if(atoi(line) > lastTick || endMarker) {
+                break;
+            }
+        }
+        keep = ftell(file);
     }
+    fclose(file);
     
-    while(line[pos] == ' ') pos++;
-    
-    k0 = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        k0 = k0 * 10 + (line[pos] - '0');
-        pos++;
+    if(keep == 0) {
+        return writeLogHeader(path, header);
     }
-    
-    while(line[pos] == ' ') pos++;
-    
-    k1 = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        k1 = k1 * 10 + (line[pos] - '0');
-        pos++;
+    return truncate(path, keep) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// Start a CSV log, or continue it when resuming
+// ----------------------------------------------------------------------------
+static bool prepareLogFile(const LogContext& log, const char* path, const char* header,
+                           bool endMarkers) {
+    if(log.resumeTick >= 0) {
+        return cutLogAfterTick(path, header, log.resumeTick, endMarkers);
     }
-    
-    while(line[pos] == ' ') pos++;
-    
-    k2 = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        k2 = k2 * 10 + (line[pos] - '0');
-        pos++;
+    return writeLogHeader(path, header);
+}
+
+// ----------------------------------------------------------------------------
+// Initialize log files (false when one of them cannot be created)
+// ----------------------------------------------------------------------------
+bool initializeLogFiles(LogContext& log, const World& world) {
+    char path[512];
+    
+    if(log.logStateHashes && log.hashFile == nullptr) {
+        char header[512];
+        int len = snprintf(header, sizeof(header), "Tick,Hash");
+        for(int part = 0; part < HASH_PART_COUNT; part++) {
+            len += snprintf(&header[len], sizeof(header) - len, ",%s", getStateHashPartName(part));
+        }
+        snprintf(&header[len], sizeof(header) - len, "\n");
+        
+        buildOutputPath(log, path, "hashes.csv");
+        if(!prepareLogFile(log, path, header, false)) {
+            return false;
+        }
+        log.hashFile = fopen(path, "a");
+        if(log.hashFile == nullptr) {
+            return false;
+        }
     }
-    
-    while(line[pos] == ' ') pos++;
-    
-    k3 = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        k3 = k3 * 10 + (line[pos] - '0');
-        pos++;
+
+#ifdef SWITCHBACK_PROFILE
+    if(log.profile == nullptr) {
+        log.profile = createTickProfile();
     }
+#endif
     
-    while(line[pos] == ' ') pos++;
-    
-    int name0Idx = 0;
-    while(line[pos] != ' ' && line[pos] != '\0') {
-        name0[name0Idx++] = line[pos++];
+    if(log.logLevel < LOG_FULL) {
+        return true;
     }
-    name0[name0Idx] = '\0';
-    
-    while(line[pos] == ' ') pos++;
     
-    int name1Idx = 0;
-    while(line[pos] != ' ' && line[pos] != '\0' && line[pos] != '\n' && line[pos] != '\r') {
-        name1[name1Idx++] = line[pos++];
+    if(log.writer == nullptr) {
+        log.writer = createLogWriter();
     }
-    name1[name1Idx] = '\0';
-}
-
-void readTrainData(const char* line, int& tick, int& x, int& y, int& dir, int& destIdx) {
-    int pos = 0;
-    
-    while(line[pos] == ' ') pos++;
     
-    tick = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        tick = tick * 10 + (line[pos] - '0');
-        pos++;
+    if(log.traceFormat == TRACE_FORMAT_BINARY) {
+        buildOutputPath(log, path, "trace.bin");
+        setLogWriterLevelInfo(log.writer, world.levelName, world.gridRows, world.gridCols,
+                              world.seed, world.weatherMode);
+        return startBinaryLogWriter(log.writer, path, log.traceCompress);
     }
     
-    while(line[pos] == ' ') pos++;
-    
-    x = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        x = x * 10 + (line[pos] - '0');
-        pos++;
+    buildOutputPath(log, path, "trace.csv");
+    if(!prepareLogFile(log, path, "Tick,TrainID,X,Y,Direction,State\n", false)) {
+        return false;
     }
     
-    while(line[pos] == ' ') pos++;
+    // A resumed delta log starts again with a keyframe
+    bool delta = isDeltaLogging(log);
+    const char* switchName = delta ? "switches_delta.csv" : "switches.csv";
+    const char* signalName = delta ? "signals_delta.csv" : "signals.csv";
+    log.firstLoggedTick = -1;
     
-    y = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        y = y * 10 + (line[pos] - '0');
-        pos++;
+    buildOutputPath(log, path, switchName);
+    if(!prepareLogFile(log, path, delta ? "Tick,Switch,Mode,State,Kind\n" : "Tick,Switch,Mode,State\n",
+                       delta)) {
+        return false;
     }
     
-    while(line[pos] == ' ') pos++;
-    
-    dir = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        dir = dir * 10 + (line[pos] - '0');
-        pos++;
+    buildOutputPath(log, path, signalName);
+    if(!prepareLogFile(log, path, delta ? "Tick,Switch,Signal,Kind\n" : "Tick,Switch,Signal\n", delta)) {
+        return false;
     }
     
-    while(line[pos] == ' ') pos++;
-    
-    destIdx = 0;
-    while(line[pos] >= '0' && line[pos] <= '9') {
-        destIdx = destIdx * 10 + (line[pos] - '0');
-        pos++;
-    }
+    char switchPath[512];
+    char signalPath[512];
+    buildOutputPath(log, path, "trace.csv");
+    buildOutputPath(log, switchPath, switchName);
+    buildOutputPath(log, signalPath, signalName);
+    return startLogWriter(log.writer, path, switchPath, signalPath);
 }
 
 // ----------------------------------------------------------------------------
-// Load level file
+// Block until every logged row has reached the CSV files
 // ----------------------------------------------------------------------------
-bool loadLevelFile(const char* filename,
-                   char levelName[],
-                   int& gridRows, int& gridCols,
-                   char grid[][100],
-                   int& seed, int& weatherMode,
-                   bool switchExists[], int switchState[], bool switchMode[],
-                   int switchKValues[][4], char switchStateNames[][2][32],
-                   int& trainCount, int trainX[], int trainY[], int trainDir[],
-                   int trainDestX[], int trainDestY[], int trainSpawnTick[], int trainColor[],
-                   int& spawnCount, int spawnX[], int spawnY[],
-                   int& destCount, int destX[], int destY[]) {
-    
-    ifstream file(filename);
-    if(!file.is_open()) {
-        return false;
+void flushLogFiles(LogContext& log) {
+    if(log.writer != nullptr) {
+        flushLogWriter(log.writer);
     }
-    
-    char line[256];
-    
-    file.getline(line, 256);
-    file.getline(levelName, 256);
-    
-    file.getline(line, 256);
-    
-    file.getline(line, 256);
-    file.getline(line, 256);
-    gridRows = toInt(line);
-    
-    file.getline(line, 256);
-    
-    file.getline(line, 256);
-    file.getline(line, 256);
-    gridCols = toInt(line);
-    
-    file.getline(line, 256);
-    
-    file.getline(line, 256);
-    file.getline(line, 256);
-    seed = toInt(line);
-    
-    file.getline(line, 256);
-    
-    file.getline(line, 256);
-    file.getline(line, 256);
-    if(findString(line, "NORMAL")) weatherMode = 0;
-    else if(findString(line, "RAIN")) weatherMode = 1;
-    else if(findString(line, "FOG")) weatherMode = 2;
-    
-    file.getline(line, 256);
-    
-    file.getline(line, 256);
-    
-    int actualRows = 0;
-    for(int row = 0; row < gridRows; row++) {
-        if(!file.getline(line, 256)) {
-            break;
-        }
-        
-        if(compareFirst(line, "SWITCHES:", 9) == 0) {
-            break;
-        }
-        
-        int len = getLength(line);
-        for(int x = 0; x < gridCols && x < len; x++) {
-            grid[actualRows][x] = line[x];
-            
-            if(line[x] == 'S') {
-                spawnX[spawnCount] = x;
-                spawnY[spawnCount] = actualRows;
-                spawnCount++;
-            }
-            
-            if(line[x] == 'D') {
-                destX[destCount] = x;
-                destY[destCount] = actualRows;
-                destCount++;
-            }
-        }
-        
-        for(int x = len; x < gridCols; x++) {
-            grid[actualRows][x] = ' ';
-        }
-        
-        actualRows++;
-    }
-    
-    for(int y = actualRows; y < gridRows; y++) {
-        for(int x = 0; x < gridCols; x++) {
-            grid[y][x] = ' ';
-        }
+    if(log.hashFile != nullptr) {
+        fflush(log.hashFile);
     }
+}
+
+// ----------------------------------------------------------------------------
+// Flush and close log files (stops the writer thread)
+// ----------------------------------------------------------------------------
+void closeLogFiles(LogContext& log) {
+    destroyLogWriter(log.writer);
+    log.writer = nullptr;
     
-    if(compareFirst(line, "SWITCHES:", 9) != 0) {
-        file.getline(line, 256);
+    if(log.hashFile != nullptr) {
+        fclose(log.hashFile);
+        log.hashFile = nullptr;
     }
-    
-    file.getline(line, 256);
-    while(getLength(line) > 0 && line[0] >= 'A' && line[0] <= 'Z') {
-        char switchLetter;
-        char modeStr[32];
-        int state, k0, k1, k2, k3;
-        char name0[32], name1[32];
-        
-        readSwitchData(line, switchLetter, modeStr, state, k0, k1, k2, k3, name0, name1);
-        
-        int idx = switchLetter - 'A';
-        switchExists[idx] = true;
-        switchState[idx] = state;
-        switchMode[idx] = (compareStrings(modeStr, "PER_DIR") == 0);
-        switchKValues[idx][0] = k0;
-        switchKValues[idx][1] = k1;
-        switchKValues[idx][2] = k2;
-        switchKValues[idx][3] = k3;
-        copyString(switchStateNames[idx][0], name0);
-        copyString(switchStateNames[idx][1], name1);
-        
-        file.getline(line, 256);
+
+#ifdef SWITCHBACK_PROFILE
+    destroyTickProfile(log.profile);
+    log.profile = nullptr;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Log the state hash of a tick
+// ----------------------------------------------------------------------------
+void logStateHash(LogContext& log, int tick, const unsigned long long parts[]) {
+    if(log.hashFile == nullptr) {
+        return;
     }
     
-    if(compareFirst(line, "TRAINS:", 7) != 0) {
-        file.getline(line, 256);
+    unsigned long long hash = 0;
+    for(int part = 0; part < HASH_PART_COUNT; part++) {
+        hash ^= parts[part];
     }
     
-    trainCount = 0;
-    while(file.getline(line, 256)) {
-        if(getLength(line) == 0) continue;
-        
-        int tick, x, y, dir, destIdx;
-        readTrainData(line, tick, x, y, dir, destIdx);
-        
-        trainSpawnTick[trainCount] = tick;
-        trainDir[trainCount] = dir;
-        trainColor[trainCount] = destIdx;
-        
-        int nearestSpawn = 0;
-        int minDist = 9999;
-        for(int s = 0; s < spawnCount; s++) {
-            int dx = spawnX[s] - x;
-            int dy = spawnY[s] - y;
-            int dist = (dx >= 0 ? dx : -dx) + (dy >= 0 ? dy : -dy);
-            if(dist < minDist) {
-                minDist = dist;
-                nearestSpawn = s;
-            }
-        }
-        
-        trainX[trainCount] = spawnX[nearestSpawn];
-        trainY[trainCount] = spawnY[nearestSpawn];
-        
-        if(destIdx < destCount) {
-            trainDestX[trainCount] = destX[destIdx];
-            trainDestY[trainCount] = destY[destIdx];
-        }
-        
-        trainCount++;
+    fprintf(log.hashFile, "%d,%016llx", tick, hash);
+    for(int part = 0; part < HASH_PART_COUNT; part++) {
+        fprintf(log.hashFile, ",%016llx", parts[part]);
     }
-    
-    file.close();
-    return true;
+    fprintf(log.hashFile, "\n");
+}
+
+// ----------------------------------------------------------------------------
+// Enable hashes.csv
+// ----------------------------------------------------------------------------
+void setStateHashLog(LogContext& log, bool enabled) {
+    log.logStateHashes = enabled;
+}
+
+bool hasPerTickLogs(const LogContext& log) {
+    return log.logLevel >= LOG_FULL || log.logStateHashes;
 }
 
 // ----------------------------------------------------------------------------
-// Initialize log files
+// Log train trace
 // ----------------------------------------------------------------------------
-void initializeLogFiles() {
-    ofstream traceFile("out/trace.csv");
-    if(traceFile.is_open()) {
-        traceFile << "Tick,TrainID,X,Y,Direction,State\n";
-        traceFile.close();
+void logTrainTrace(LogContext& log, int tick, int trainId, int x, int y, int dir,
+                   const char* state) {
+    if(!isLogging(log)) {
+        return;
     }
     
-    ofstream switchFile("out/switches.csv");
-    if(switchFile.is_open()) {
-        switchFile << "Tick,Switch,Mode,State\n";
-        switchFile.close();
+    pushTraceRecord(log.writer, tick, trainId, x, y, dir, state);
+}
+
+// ----------------------------------------------------------------------------
+// Log switch state
+// ----------------------------------------------------------------------------
+void logSwitchState(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* mode, const char* state) {
+    if(!isLogging(log)) {
+        return;
     }
     
-    ofstream signalFile("out/signals.csv");
-    if(signalFile.is_open()) {
-        signalFile << "Tick,Switch,Signal\n";
-        signalFile.close();
-    }
+    pushSwitchRecord(log.writer, tick, switchId, switchName, mode, state, 0);
 }
 
 // ----------------------------------------------------------------------------
-// Log train trace
+// Log signal state
 // ----------------------------------------------------------------------------
-void logTrainTrace(int tick, int trainId, int x, int y, int dir, const char* state) {
-    ofstream traceFile("out/trace.csv", ios::app);
-    if(traceFile.is_open()) {
-        const char* dirStr[] = {"UP", "RIGHT", "DOWN", "LEFT"};
-        traceFile << tick << "," << trainId << "," << x << "," << y << "," 
-                  << dirStr[dir] << "," << state << "\n";
-        traceFile.close();
+void logSignalState(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* signal) {
+    if(!isLogging(log)) {
+        return;
     }
+    
+    pushSignalRecord(log.writer, tick, switchId, switchName, signal, 0);
 }
 
 // ----------------------------------------------------------------------------
-// Log switch state
+// Log switch state change (or keyframe row) in delta mode
 // ----------------------------------------------------------------------------
-void logSwitchState(int tick, char switchLetter, const char* mode, const char* state) {
-    ofstream switchFile("out/switches.csv", ios::app);
-    if(switchFile.is_open()) {
-        switchFile << tick << "," << switchLetter << "," << mode << "," << state << "\n";
-        switchFile.close();
+void logSwitchDelta(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* mode, const char* state, bool keyframe) {
+    if(!isLogging(log)) {
+        return;
     }
+    
+    pushSwitchRecord(log.writer, tick, switchId, switchName, mode, state, keyframe ? 'K' : 'C');
 }
 
 // ----------------------------------------------------------------------------
-// Log signal state
+// Log signal change (or keyframe row) in delta mode
 // ----------------------------------------------------------------------------
-void logSignalState(int tick, char switchLetter, const char* signal) {
-    ofstream signalFile("out/signals.csv", ios::app);
-    if(signalFile.is_open()) {
-        signalFile << tick << "," << switchLetter << "," << signal << "\n";
-        signalFile.close();
+void logSignalDelta(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* signal, bool keyframe) {
+    if(!isLogging(log)) {
+        return;
     }
+    
+    pushSignalRecord(log.writer, tick, switchId, switchName, signal, keyframe ? 'K' : 'C');
 }
 
 // ----------------------------------------------------------------------------
 // Write metrics
 // ----------------------------------------------------------------------------
-void writeMetrics(int totalTicks, int trainsDelivered, int trainsCrashed,
+void writeMetrics(LogContext& log, int totalTicks, int trainsDelivered, int trainsCrashed,
                  int totalWaitTicks, int totalSwitchFlips) {
-    ofstream metricsFile("out/metrics.txt");
+    if(isDeltaLogging(log) && isLogging(log)) {
+        pushDeltaEndRecord(log.writer, totalTicks);
+    }
+    
+    flushLogFiles(log);
+    
+    if(log.logLevel < LOG_METRICS) {
+        return;
+    }
+    
+    char path[512];
+    buildOutputPath(log, path, "metrics.txt");
+    ofstream metricsFile(path);
     if(metricsFile.is_open()) {
         metricsFile << "=== SWITCHBACK RAILS - SIMULATION METRICS ===\n\n";
         metricsFile << "Total Ticks: " << totalTicks << "\n";
@@ -460,5 +440,14 @@ void writeMetrics(int totalTicks, int trainsDelivered, int trainsCrashed,
         metricsFile << "\nThroughput: " << throughput << " trains per 100 ticks\n";
         metricsFile.close();
     }
+
+#ifdef SWITCHBACK_PROFILE
+    if(log.profile != nullptr) {
+        char histogramPath[512];
+        buildOutputPath(log, path, "profile.csv");
+        buildOutputPath(log, histogramPath, "profile_histogram.csv");
+        writeTickProfile(log.profile, path, histogramPath);
+    }
+#endif
 }
 
@@ -5,33 +5,110 @@
 // IO.H - Level I/O and logging
 // ============================================================================
 
+#include "world.h"
+#include <cstdio>
+
+struct LogWriter;
+struct TickProfile;
+struct ParallelTick;
+
 // ----------------------------------------------------------------------------
 // LEVEL LOADING
 // ----------------------------------------------------------------------------
-bool loadLevelFile(const char* filename,
-                   char levelName[],
-                   int& gridRows, int& gridCols,
-                   char grid[][100],
-                   int& seed, int& weatherMode,
-                   bool switchExists[], int switchState[], bool switchMode[],
-                   int switchKValues[][4], char switchStateNames[][2][32],
-                   int& trainCount, int trainX[], int trainY[], int trainDir[],
-                   int trainDestX[], int trainDestY[], int trainSpawnTick[], int trainColor[],
-                   int& spawnCount, int spawnX[], int spawnY[],
-                   int& destCount, int destX[], int destY[]);
+// Maps the file and parses it (level_loader.h), or loads the compiled
+// "<level>.lvlb" next to it when that is current (level_cache.h).
+bool loadLevelFile(const char* filename, World& world);
 
 // ----------------------------------------------------------------------------
 // LOGGING
 // ----------------------------------------------------------------------------
-void initializeLogFiles();
+const int LOG_NONE = 0;      // No files written
+const int LOG_METRICS = 1;   // Only out/metrics.txt
+const int LOG_FULL = 2;      // Metrics plus per-tick CSV traces (default)
+
+const int TRACE_FORMAT_CSV = 0;      // trace.csv, switches.csv, signals.csv
+const int TRACE_FORMAT_BINARY = 1;   // trace.bin (see trace_format.h)
+
+const int SWITCH_LOG_DENSE = 0;   // Every switch and signal on every tick
+const int SWITCH_LOG_DELTA = 1;   // Changes only, plus periodic keyframes
+
+// Logging settings and the writer of one run. Every run has its own, so
+// several runs can write to different output directories at the same time.
+struct LogContext {
+    int logLevel;
+    char outputDir[256];
+    int traceFormat;
+    bool traceCompress;
+    int switchLogMode;
+    int keyframeInterval;
+    int firstLoggedTick;
+    LogWriter* writer;          // created by initializeLogFiles
+    bool logStateHashes;        // hashes.csv, independent of logLevel
+    FILE* hashFile;
+    TickProfile* profile;       // PROFILE=1 builds only (tick_profiler.h)
+    ParallelTick* parallel;     // setTickThreads() (parallel_tick.h)
+    bool timeSkip;              // setTimeSkipEnabled() (time_skip.h)
+    int skippedTicks;           // advanced by skipQuietTicks() (time_skip.h)
+    int resumeTick;             // -1, or the checkpoint tick the logs continue from
+};
+
+// Defaults: LOG_FULL, CSV, dense switch logs, output directory "out"
+void initializeLogContext(LogContext& log);
+
+void setLogLevel(LogContext& log, int level);
+
+int getLogLevel(const LogContext& log);
+
+void setTraceFormat(LogContext& log, int format, bool compress);
+
+void setSwitchLogMode(LogContext& log, int mode, int keyframeInterval);
+
+bool isDeltaLogging(const LogContext& log);
+
+bool isKeyframeTick(LogContext& log, int tick);
+
+// False when dir is empty or longer than outputDir holds
+bool setOutputDirectory(LogContext& log, const char* dir);
+
+// One row per tick with the state hash and its parts (state_hash.h)
+void setStateHashLog(LogContext& log, bool enabled);
+
+// True when something is written every tick (full traces or hashes.csv)
+bool hasPerTickLogs(const LogContext& log);
+
+// For --resume: initializeLogFiles() keeps the CSV rows up to tick and
+// appends to them instead of starting new files (binary traces cannot be
+// continued)
+void setLogResumeTick(LogContext& log, int tick);
+
+void buildOutputPath(const LogContext& log, char path[], const char* fileName);
+
+// Level metadata for binary traces is taken from the world. False when a
+// log file cannot be opened.
+bool initializeLogFiles(LogContext& log, const World& world);
+
+void flushLogFiles(LogContext& log);
+
+void closeLogFiles(LogContext& log);
+
+void logStateHash(LogContext& log, int tick, const unsigned long long parts[]);
+
+void logTrainTrace(LogContext& log, int tick, int trainId, int x, int y, int dir,
+                   const char* state);
+
+void logSwitchState(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* mode, const char* state);
 
-void logTrainTrace(int tick, int trainId, int x, int y, int dir, const char* state);
+void logSignalState(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* signal);
 
-void logSwitchState(int tick, char switchLetter, const char* mode, const char* state);
+void logSwitchDelta(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* mode, const char* state, bool keyframe);
 
-void logSignalState(int tick, char switchLetter, const char* signal);
+void logSignalDelta(LogContext& log, int tick, int switchId, const char* switchName,
+                    const char* signal, bool keyframe);
 
-void writeMetrics(int totalTicks, int trainsDelivered, int trainsCrashed,
+void writeMetrics(LogContext& log, int totalTicks, int trainsDelivered, int trainsCrashed,
                   int totalWaitTicks, int totalSwitchFlips);
 
 #endif
@@ -0,0 +1,277 @@
+#include "job_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// ============================================================================
+// JOB_POOL.CPP - Work-stealing thread pool
+// ============================================================================
+
+// One deque of job ids per worker; jobs[head .. tail - 1] are still queued
+struct JobDeque {
+    mutex lock;
+    int* jobs;
+    int head;
+    int tail;
+};
+
+struct JobPool {
+    JobDeque* deques;
+    int workerCount;
+    JobFunction runJob;
+    void* user;
+};
+
+// ----------------------------------------------------------------------------
+// Take a job from the back of a worker's own deque, -1 if empty
+// ----------------------------------------------------------------------------
+static int popOwnJob(JobDeque& deque) {
+    lock_guard<mutex> guard(deque.lock);
+    if(deque.head == deque.tail) {
+        return -1;
+    }
+    deque.tail--;
+    return deque.jobs[deque.tail];
+}
+
+// ----------------------------------------------------------------------------
+// Take a job from the front of another worker's deque, -1 if empty
+// ----------------------------------------------------------------------------
+static int stealJob(JobDeque& deque) {
+    lock_guard<mutex> guard(deque.lock);
+    if(deque.head == deque.tail) {
+        return -1;
+    }
+    int job = deque.jobs[deque.head];
+    deque.head++;
+    return job;
+}
+
+// ----------------------------------------------------------------------------
+// Worker loop: own deque first, then the others starting with the next one
+// ----------------------------------------------------------------------------
+static void workerLoop(JobPool* pool, int worker) {
+    while(true) {
+        int job = popOwnJob(pool->deques[worker]);
+        
+        for(int v = 1; job < 0 && v < pool->workerCount; v++) {
+            job = stealJob(pool->deques[(worker + v) % pool->workerCount]);
+        }
+        
+        if(job < 0) {
+            return;
+        }
+        
+        pool->runJob(job, worker, pool->user);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Run every job on workerCount threads
+// ----------------------------------------------------------------------------
+void runJobsWorkStealing(int jobCount, int workerCount, JobFunction runJob, void* user) {
+    if(jobCount <= 0) {
+        return;
+    }
+    
+    if(workerCount > jobCount) {
+        workerCount = jobCount;
+    }
+    
+    if(workerCount <= 1) {
+        for(int job = 0; job < jobCount; job++) {
+            runJob(job, 0, user);
+        }
+        return;
+    }
+    
+    JobPool pool;
+    pool.deques = new JobDeque[workerCount];
+    pool.workerCount = workerCount;
+    pool.runJob = runJob;
+    pool.user = user;
+    
+    // Deal jobs round robin; each worker pops from the back, so reverse the
+    // order within a deque to start the lowest job ids first
+    int perWorker = (jobCount + workerCount - 1) / workerCount;
+    for(int w = 0; w < workerCount; w++) {
+        JobDeque& deque = pool.deques[w];
+        deque.jobs = new int[perWorker];
+        deque.head = 0;
+        deque.tail = 0;
+        
+        int last = w + ((jobCount - 1 - w) / workerCount) * workerCount;
+        for(int job = last; job >= w; job -= workerCount) {
+            deque.jobs[deque.tail++] = job;
+        }
+    }
+    
+    thread* threads = new thread[workerCount - 1];
+    for(int w = 1; w < workerCount; w++) {
+        threads[w - 1] = thread(workerLoop, &pool, w);
+    }
+    
+    workerLoop(&pool, 0);
+    
+    for(int w = 1; w < workerCount; w++) {
+        threads[w - 1].join();
+    }
+    
+    delete[] threads;
+    for(int w = 0; w < workerCount; w++) {
+        delete[] pool.deques[w].jobs;
+    }
+    delete[] pool.deques;
+}
+
+// ----------------------------------------------------------------------------
+// Number of hardware threads
+// ----------------------------------------------------------------------------
+int getHardwareWorkerCount() {
+    int count = (int)thread::hardware_concurrency();
+    return (count > 0) ? count : 1;
+}
+
+// ============================================================================
+// Persistent pool
+// ============================================================================
+
+struct PersistentPool {
+    thread* threads;            // workers 1 .. workerCount - 1
+    int workerCount;
+    mutex lock;
+    condition_variable wake;    // a batch started, or the pool is stopping
+    condition_variable done;    // the last worker finished its part
+    int batch;                  // bumped for every batch
+    int busyWorkers;            // threads still working on the current batch
+    bool stopping;
+    JobFunction runJob;
+    void* user;
+    int jobCount;
+    atomic<int> nextJob;
+};
+
+// ----------------------------------------------------------------------------
+// Take jobs from the shared counter until the batch runs out
+// ----------------------------------------------------------------------------
+static void runBatchJobs(PersistentPool* pool, int worker) {
+    while(true) {
+        int job = pool->nextJob.fetch_add(1);
+        if(job >= pool->jobCount) {
+            return;
+        }
+        pool->runJob(job, worker, pool->user);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Worker thread: sleep until the next batch, work on it, report back
+// ----------------------------------------------------------------------------
+static void persistentWorkerLoop(PersistentPool* pool, int worker) {
+    int seenBatch = 0;
+    while(true) {
+        {
+            unique_lock<mutex> guard(pool->lock);
+            while(!pool->stopping && pool->batch == seenBatch) {
+                pool->wake.wait(guard);
+            }
+            if(pool->stopping) {
+                return;
+            }
+            seenBatch = pool->batch;
+        }
+        
+        runBatchJobs(pool, worker);
+        
+        lock_guard<mutex> guard(pool->lock);
+        pool->busyWorkers--;
+        if(pool->busyWorkers == 0) {
+            pool->done.notify_one();
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Start workerCount - 1 threads as workers 1 .. workerCount - 1 (the caller
+// is worker 0)
+// ----------------------------------------------------------------------------
+PersistentPool* createPersistentPool(int workerCount) {
+    if(workerCount < 1) {
+        workerCount = 1;
+    }
+    
+    PersistentPool* pool = new PersistentPool;
+    pool->workerCount = workerCount;
+    pool->batch = 0;
+    pool->busyWorkers = 0;
+    pool->stopping = false;
+    pool->runJob = nullptr;
+    pool->user = nullptr;
+    pool->jobCount = 0;
+    pool->nextJob = 0;
+    
+    pool->threads = new thread[workerCount - 1];
+    for(int w = 1; w < workerCount; w++) {
+        pool->threads[w - 1] = thread(persistentWorkerLoop, pool, w);
+    }
+    return pool;
+}
+
+void destroyPersistentPool(PersistentPool* pool) {
+    if(pool == nullptr) {
+        return;
+    }
+    
+    {
+        lock_guard<mutex> guard(pool->lock);
+        pool->stopping = true;
+    }
+    pool->wake.notify_all();
+    
+    for(int w = 1; w < pool->workerCount; w++) {
+        pool->threads[w - 1].join();
+    }
+    delete[] pool->threads;
+    delete pool;
+}
+
+int getPersistentPoolWorkerCount(const PersistentPool* pool) {
+    return pool->workerCount;
+}
+
+// ----------------------------------------------------------------------------
+// Run one batch on every worker
+// ----------------------------------------------------------------------------
+void runPersistentPoolJobs(PersistentPool* pool, int jobCount, JobFunction runJob, void* user) {
+    if(jobCount <= 0) {
+        return;
+    }
+    
+    if(pool->workerCount <= 1 || jobCount == 1) {
+        for(int job = 0; job < jobCount; job++) {
+            runJob(job, 0, user);
+        }
+        return;
+    }
+    
+    {
+        lock_guard<mutex> guard(pool->lock);
+        pool->runJob = runJob;
+        pool->user = user;
+        pool->jobCount = jobCount;
+        pool->nextJob = 0;
+        pool->busyWorkers = pool->workerCount - 1;
+        pool->batch++;
+    }
+    pool->wake.notify_all();
+    
+    runBatchJobs(pool, 0);
+    
+    unique_lock<mutex> guard(pool->lock);
+    while(pool->busyWorkers > 0) {
+        pool->done.wait(guard);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+// ============================================================================
+// JOB_POOL.H - Thread pools for independent jobs
+// ============================================================================
+// runJobsWorkStealing() deals jobs 0 .. jobCount - 1 round robin into one
+// deque per worker. A worker takes jobs from the back of its own deque and,
+// once that is empty, steals from the front of the others. Jobs never
+// create new jobs, so a worker stops when every deque is empty.
+//
+// A PersistentPool keeps its threads between batches of jobs instead.
+// ============================================================================
+
+// Called once per job on one of the worker threads. worker is the index of
+// that thread (0 .. workerCount - 1), so per-worker scratch can be indexed.
+typedef void (*JobFunction)(int job, int worker, void* user);
+
+// Runs every job and returns when all are done. workerCount <= 1 runs the
+// jobs in order on the calling thread.
+void runJobsWorkStealing(int jobCount, int workerCount, JobFunction runJob, void* user);
+
+// Number of hardware threads, at least 1
+int getHardwareWorkerCount();
+
+// ----------------------------------------------------------------------------
+// PERSISTENT POOL
+// ----------------------------------------------------------------------------
+// For short batches run over and over (the parallel tick phases): the
+// threads are started once and sleep between batches. Jobs are handed out
+// in increasing order from a shared counter, and the calling thread works
+// on the batch as worker 0.
+struct PersistentPool;
+
+PersistentPool* createPersistentPool(int workerCount);
+
+// Stops and joins the threads
+void destroyPersistentPool(PersistentPool* pool);
+
+int getPersistentPoolWorkerCount(const PersistentPool* pool);
+
+// Runs every job and returns when all are done. One batch at a time: call
+// from a single thread.
+void runPersistentPoolJobs(PersistentPool* pool, int jobCount, JobFunction runJob, void* user);
+
+#endif
@@ -0,0 +1,292 @@
+#include "journal.h"
+#include "grid.h"
+#include "switches.h"
+#include "trains.h"
+#include "simulation.h"
+#include "snapshot.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+// ============================================================================
+// JOURNAL.CPP - Recording, saving and replaying inputs
+// ============================================================================
+
+const int JOURNAL_LINE_LEN = 512;
+
+// ----------------------------------------------------------------------------
+// Lifecycle
+// ----------------------------------------------------------------------------
+void initializeJournal(Journal& journal) {
+    journal.entries = nullptr;
+    journal.entryCount = 0;
+    journal.entryCapacity = 0;
+    journal.tickHashes = nullptr;
+    journal.hashCount = 0;
+    journal.hashCapacity = 0;
+    journal.cursor = 0;
+}
+
+void freeJournal(Journal& journal) {
+    delete[] journal.entries;
+    delete[] journal.tickHashes;
+    initializeJournal(journal);
+}
+
+// ----------------------------------------------------------------------------
+// Append an entry / a hash
+// ----------------------------------------------------------------------------
+static void addJournalEntry(Journal& journal, const JournalEntry& entry) {
+    if(journal.entryCount == journal.entryCapacity) {
+        int newCapacity = (journal.entryCapacity == 0) ? 64 : journal.entryCapacity * 2;
+        JournalEntry* bigger = new JournalEntry[newCapacity];
+        for(int i = 0; i < journal.entryCount; i++) {
+            bigger[i] = journal.entries[i];
+        }
+        delete[] journal.entries;
+        journal.entries = bigger;
+        journal.entryCapacity = newCapacity;
+    }
+    journal.entries[journal.entryCount++] = entry;
+}
+
+static void setJournalHash(Journal& journal, int tick, unsigned long long hash) {
+    if(tick >= journal.hashCapacity) {
+        int newCapacity = (journal.hashCapacity == 0) ? 1024 : journal.hashCapacity;
+        while(newCapacity <= tick) {
+            newCapacity *= 2;
+        }
+        unsigned long long* bigger = new unsigned long long[newCapacity];
+        for(int t = 0; t < journal.hashCount; t++) {
+            bigger[t] = journal.tickHashes[t];
+        }
+        delete[] journal.tickHashes;
+        journal.tickHashes = bigger;
+        journal.hashCapacity = newCapacity;
+    }
+    
+    // Ticks without a hash (gaps) never match
+    for(int t = journal.hashCount; t < tick; t++) {
+        journal.tickHashes[t] = 0;
+    }
+    journal.tickHashes[tick] = hash;
+    if(tick >= journal.hashCount) {
+        journal.hashCount = tick + 1;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Record inputs
+// ----------------------------------------------------------------------------
+bool journalSafetyTile(Journal& journal, World& world, int x, int y) {
+    if(!toggleSafetyTile(world, x, y)) {
+        return false;
+    }
+    
+    JournalEntry entry;
+    entry.tick = world.currentTick;
+    entry.kind = JOURNAL_SAFETY_TILE;
+    entry.x = x;
+    entry.y = y;
+    entry.switchId = -1;
+    addJournalEntry(journal, entry);
+    return true;
+}
+
+bool journalSwitchToggle(Journal& journal, World& world, int switchId) {
+    if(switchId < 0 || switchId >= world.switchCount) {
+        return false;
+    }
+    toggleSwitchState(world, switchId);
+    
+    JournalEntry entry;
+    entry.tick = world.currentTick;
+    entry.kind = JOURNAL_SWITCH;
+    entry.x = -1;
+    entry.y = -1;
+    entry.switchId = switchId;
+    addJournalEntry(journal, entry);
+    return true;
+}
+
+void recordJournalHash(Journal& journal, const World& world) {
+    setJournalHash(journal, world.currentTick, hashWorldState(world));
+}
+
+// ----------------------------------------------------------------------------
+// Save
+// ----------------------------------------------------------------------------
+bool saveJournal(const Journal& journal, const World& world, const char* path) {
+    FILE* file = fopen(path, "w");
+    if(file == nullptr) {
+        return false;
+    }
+    
+    fprintf(file, "LEVEL,%s\n", world.levelName);
+    
+    for(int i = 0; i < journal.entryCount; i++) {
+        const JournalEntry& entry = journal.entries[i];
+        if(entry.kind == JOURNAL_SAFETY_TILE) {
+            fprintf(file, "INPUT,%d,TILE,%d,%d\n", entry.tick, entry.x, entry.y);
+        } else {
+            fprintf(file, "INPUT,%d,SWITCH,%s\n", entry.tick, getSwitchName(world, entry.switchId));
+        }
+    }
+    
+    for(int t = 0; t < journal.hashCount; t++) {
+        fprintf(file, "HASH,%d,%016llx\n", t, journal.tickHashes[t]);
+    }
+    
+    return fclose(file) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// Load
+// ----------------------------------------------------------------------------
+// Parses one INPUT line (after "INPUT,")
+static bool parseJournalInput(const World& world, char* text, JournalEntry& entry) {
+    char* fields[4];
+    int fieldCount = 0;
+    char* p = text;
+    while(fieldCount < 4) {
+        fields[fieldCount++] = p;
+        p = strchr(p, ',');
+        if(p == nullptr) break;
+        *p++ = '\0';
+    }
+    
+    if(fieldCount < 3) {
+        return false;
+    }
+    
+    entry.tick = atoi(fields[0]);
+    entry.x = -1;
+    entry.y = -1;
+    entry.switchId = -1;
+    
+    if(strcmp(fields[1], "TILE") == 0 && fieldCount == 4) {
+        entry.kind = JOURNAL_SAFETY_TILE;
+        entry.x = atoi(fields[2]);
+        entry.y = atoi(fields[3]);
+        return true;
+    }
+    
+    if(strcmp(fields[1], "SWITCH") == 0 && fieldCount == 3) {
+        entry.kind = JOURNAL_SWITCH;
+        entry.switchId = findSwitchByName(world, fields[2]);
+        return entry.switchId >= 0;
+    }
+    
+    return false;
+}
+
+bool loadJournal(Journal& journal, const World& world, const char* path) {
+    ifstream file(path);
+    if(!file.is_open()) {
+        return false;
+    }
+    
+    freeJournal(journal);
+    
+    char line[JOURNAL_LINE_LEN];
+    while(file.getline(line, JOURNAL_LINE_LEN)) {
+        int len = strlen(line);
+        while(len > 0 && line[len - 1] == '\r') {
+            line[--len] = '\0';
+        }
+        
+        if(len == 0 || strncmp(line, "LEVEL,", 6) == 0) {
+            continue;
+        }
+        
+        if(strncmp(line, "INPUT,", 6) == 0) {
+            JournalEntry entry;
+            if(!parseJournalInput(world, line + 6, entry)) {
+                return false;
+            }
+            if(journal.entryCount > 0 && entry.tick < journal.entries[journal.entryCount - 1].tick) {
+                return false;
+            }
+            addJournalEntry(journal, entry);
+        }
+        else if(strncmp(line, "HASH,", 5) == 0) {
+            char* comma = strchr(line + 5, ',');
+            if(comma == nullptr) {
+                return false;
+            }
+            int tick = atoi(line + 5);
+            if(tick < 0) {
+                return false;
+            }
+            setJournalHash(journal, tick, strtoull(comma + 1, nullptr, 16));
+        }
+        else {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Replay
+// ----------------------------------------------------------------------------
+int getJournalLastTick(const Journal& journal) {
+    return journal.hashCount - 1;
+}
+
+// Applies the inputs recorded at world.currentTick
+static void applyJournalInputs(Journal& journal, World& world) {
+    while(journal.cursor < journal.entryCount &&
+          journal.entries[journal.cursor].tick <= world.currentTick) {
+        const JournalEntry& entry = journal.entries[journal.cursor++];
+        if(entry.tick < world.currentTick) {
+            continue;
+        }
+        
+        if(entry.kind == JOURNAL_SAFETY_TILE) {
+            toggleSafetyTile(world, entry.x, entry.y);
+        } else {
+            toggleSwitchState(world, entry.switchId);
+        }
+    }
+}
+
+// Records the first tick whose hash differs from the journal
+static void checkJournalHash(const Journal& journal, const World& world, int& firstMismatch) {
+    int tick = world.currentTick;
+    if(firstMismatch >= 0 || tick >= journal.hashCount) {
+        return;
+    }
+    if(journal.tickHashes[tick] != hashWorldState(world)) {
+        firstMismatch = tick;
+    }
+}
+
+int replayJournal(World& world, LogContext& log, Journal& journal, int maxTicks) {
+    int firstMismatch = -1;
+    journal.cursor = 0;
+    
+    spawnTrainsForTick(world, 0);
+    checkJournalHash(journal, world, firstMismatch);
+    applyJournalInputs(journal, world);
+    
+    while(world.currentTick < maxTicks) {
+        simulateOneTick(world, log);
+        checkJournalHash(journal, world, firstMismatch);
+        applyJournalInputs(journal, world);
+        
+        if(isSimulationComplete(world)) {
+            break;
+        }
+    }
+    
+    // A run that stops short of the journal diverged at its first missing tick
+    if(firstMismatch < 0 && world.currentTick < getJournalLastTick(journal)) {
+        firstMismatch = world.currentTick + 1;
+    }
+    return firstMismatch;
+}
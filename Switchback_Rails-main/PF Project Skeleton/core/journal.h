@@ -0,0 +1,89 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+// ============================================================================
+// JOURNAL.H - Input journal for replaying interactive sessions
+// ============================================================================
+// Every change a player makes to a running simulation (toggling a safety
+// tile, flipping a switch by hand) is recorded as (tick, kind, target),
+// together with the state hash of every tick (hashWorldState). An input
+// recorded at tick T was made while tick T was on screen, so it applies
+// after tick T and before tick T + 1 is simulated.
+//
+// The file is plain text, one record per line:
+//
+//   LEVEL,<level name>
+//   INPUT,<tick>,TILE,<x>,<y>
+//   INPUT,<tick>,SWITCH,<switch name>
+//   HASH,<tick>,<16 hex digits>
+//
+// Replaying a journal against the same level applies the inputs at the same
+// points of the tick loop, so the run (and its traces) is bit-identical to
+// the original, and every tick can be checked against the recorded hash.
+// ============================================================================
+
+#include "world.h"
+#include "io.h"
+
+const int JOURNAL_SAFETY_TILE = 0;
+const int JOURNAL_SWITCH = 1;
+
+struct JournalEntry {
+    int tick;
+    int kind;
+    int x;                      // JOURNAL_SAFETY_TILE: cell
+    int y;
+    int switchId;               // JOURNAL_SWITCH
+};
+
+struct Journal {
+    JournalEntry* entries;
+    int entryCount;
+    int entryCapacity;
+    unsigned long long* tickHashes;     // hash of tick t at index t
+    int hashCount;
+    int hashCapacity;
+    int cursor;                 // next entry to apply while replaying
+};
+
+// ----------------------------------------------------------------------------
+// LIFECYCLE
+// ----------------------------------------------------------------------------
+void initializeJournal(Journal& journal);
+
+void freeJournal(Journal& journal);
+
+// ----------------------------------------------------------------------------
+// RECORDING
+// ----------------------------------------------------------------------------
+// Apply the change to the world and record it at world.currentTick. Nothing
+// is recorded when the change does not apply (not a plain track tile, not
+// a switch).
+bool journalSafetyTile(Journal& journal, World& world, int x, int y);
+
+bool journalSwitchToggle(Journal& journal, World& world, int switchId);
+
+// Records the hash of world.currentTick (call once per tick, before inputs)
+void recordJournalHash(Journal& journal, const World& world);
+
+// ----------------------------------------------------------------------------
+// FILES
+// ----------------------------------------------------------------------------
+bool saveJournal(const Journal& journal, const World& world, const char* path);
+
+// Switch names are resolved against the world; false for unknown names,
+// malformed lines or inputs out of tick order
+bool loadJournal(Journal& journal, const World& world, const char* path);
+
+// ----------------------------------------------------------------------------
+// REPLAY
+// ----------------------------------------------------------------------------
+// Last tick with a recorded hash, or -1
+int getJournalLastTick(const Journal& journal);
+
+// Runs a fresh world like runSimulation(), applying the journal's inputs.
+// Returns the first tick whose state hash differs from the journal, or -1
+// when every recorded tick matched.
+int replayJournal(World& world, LogContext& log, Journal& journal, int maxTicks);
+
+#endif
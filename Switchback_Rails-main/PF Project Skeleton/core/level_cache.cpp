@@ -0,0 +1,231 @@
+#include "level_cache.h"
+#include "simulation_state.h"
+#include "snapshot.h"
+#include "grid.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// ============================================================================
+// LEVEL_CACHE.CPP - Compiled level files
+// ============================================================================
+
+const char LEVEL_CACHE_MAGIC[8] = {'S', 'B', 'L', 'V', 'L', 'B', '0', '1'};
+const int LEVEL_CACHE_HEADER_SIZE = 4096;       // the block starts on a page
+
+struct LevelCacheHeader {
+    char magic[8];
+    int version;
+    int worldSize;                  // sizeof(World): catches layout changes
+    unsigned long long sourceHash;
+    long long sourceSize;
+    long long memoryBytes;
+    long long stateBytes;
+    long long levelBytes;
+    long long skippedBytes;         // distance fields left out of the file
+    int gridRows;
+    int gridCols;
+    int trainCapacity;
+    int switchCapacity;
+    int spawnCapacity;
+    int destCapacity;
+    
+    int trainCount;
+    int switchCount;
+    int spawnCount;
+    int destCount;
+    int seed;
+    int weatherMode;
+    int switchByLetter[26];
+    char levelName[256];
+};
+
+static bool g_levelCacheEnabled = true;
+
+// ----------------------------------------------------------------------------
+// Settings and keys
+// ----------------------------------------------------------------------------
+void setLevelCacheEnabled(bool enabled) {
+    g_levelCacheEnabled = enabled;
+}
+
+bool isLevelCacheEnabled() {
+    return g_levelCacheEnabled;
+}
+
+void getLevelCachePath(const char* levelPath, char cachePath[], int capacity) {
+    int len = strlen(levelPath);
+    if(len >= 4 && strcmp(&levelPath[len - 4], ".lvl") == 0) {
+        snprintf(cachePath, capacity, "%sb", levelPath);
+    } else {
+        snprintf(cachePath, capacity, "%s.lvlb", levelPath);
+    }
+}
+
+unsigned long long hashLevelText(const char* text, long long size) {
+    return hashBytes(FNV_OFFSET_BASIS, text, size);
+}
+
+// ----------------------------------------------------------------------------
+// Where the distance fields sit in the level block, and whether they are
+// left out of the file
+// ----------------------------------------------------------------------------
+static long long getFieldOffset(const World& world) {
+    return (long long)((const unsigned char*)world.trackDist - world.memory);
+}
+
+static long long getSkippedFieldBytes(const World& world) {
+    long long fieldBytes = (long long)world.gridRows * world.gridCols * 4 * world.destCapacity *
+                           (long long)sizeof(unsigned short);
+    return (fieldBytes > LEVEL_CACHE_MAX_FIELD_BYTES) ? fieldBytes : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Load a cache
+// ----------------------------------------------------------------------------
+bool loadLevelCache(const char* cachePath, unsigned long long sourceHash, long long sourceSize,
+                    World& world) {
+    int fd = open(cachePath, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < LEVEL_CACHE_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    
+    void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) {
+        return false;
+    }
+    const unsigned char* file = (const unsigned char*)mapped;
+    
+    LevelCacheHeader header;
+    memcpy(&header, file, sizeof(header));
+    
+    bool valid = memcmp(header.magic, LEVEL_CACHE_MAGIC, 8) == 0 &&
+                 header.version == LEVEL_CACHE_VERSION &&
+                 header.worldSize == (int)sizeof(World) &&
+                 header.sourceHash == sourceHash && header.sourceSize == sourceSize &&
+                 header.levelBytes >= 0 && header.skippedBytes >= 0 &&
+                 info.st_size == LEVEL_CACHE_HEADER_SIZE + header.levelBytes - header.skippedBytes;
+    
+    if(valid) {
+        // Same sizes, same layout; anything else means the cache came from
+        // another build
+        valid = allocateWorld(world, header.gridRows, header.gridCols, header.trainCapacity,
+                              header.switchCapacity, header.spawnCapacity, header.destCapacity) &&
+                world.memoryBytes == header.memoryBytes &&
+                world.stateBytes == header.stateBytes &&
+                world.levelBytes == header.levelBytes &&
+                getSkippedFieldBytes(world) == header.skippedBytes;
+    }
+    
+    if(valid) {
+        initializeSimulationState(world);
+        
+        // Everything before and after the distance fields, which follow
+        // from the rest once the counts below are set
+        const unsigned char* block = file + LEVEL_CACHE_HEADER_SIZE;
+        long long before = header.skippedBytes > 0 ? getFieldOffset(world) : header.levelBytes;
+        long long after = header.levelBytes - before - header.skippedBytes;
+        if(before > 0) {
+            memcpy(world.memory, block, before);
+        }
+        if(after > 0) {
+            memcpy(world.memory + before + header.skippedBytes, block + before, after);
+        }
+        
+        header.levelName[sizeof(header.levelName) - 1] = '\0';
+        memcpy(world.levelName, header.levelName, sizeof(world.levelName));
+        world.trainCount = header.trainCount;
+        world.switchCount = header.switchCount;
+        world.spawnCount = header.spawnCount;
+        world.destCount = header.destCount;
+        world.seed = header.seed;
+        world.weatherMode = header.weatherMode;
+        for(int i = 0; i < 26; i++) {
+            world.switchByLetter[i] = header.switchByLetter[i];
+        }
+        
+        if(header.skippedBytes > 0) {
+            buildTrackDistanceFields(world);
+        }
+    }
+    
+    munmap(mapped, (size_t)info.st_size);
+    return valid;
+}
+
+// ----------------------------------------------------------------------------
+// Write a cache
+// ----------------------------------------------------------------------------
+bool saveLevelCache(const char* cachePath, unsigned long long sourceHash, long long sourceSize,
+                    const World& world) {
+    LevelCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEVEL_CACHE_MAGIC, 8);
+    header.version = LEVEL_CACHE_VERSION;
+    header.worldSize = (int)sizeof(World);
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.memoryBytes = world.memoryBytes;
+    header.stateBytes = world.stateBytes;
+    header.levelBytes = world.levelBytes;
+    header.skippedBytes = getSkippedFieldBytes(world);
+    header.gridRows = world.gridRows;
+    header.gridCols = world.gridCols;
+    header.trainCapacity = world.trainCapacity;
+    header.switchCapacity = world.switchCapacity;
+    header.spawnCapacity = world.spawnCapacity;
+    header.destCapacity = world.destCapacity;
+    
+    header.trainCount = world.trainCount;
+    header.switchCount = world.switchCount;
+    header.spawnCount = world.spawnCount;
+    header.destCount = world.destCount;
+    header.seed = world.seed;
+    header.weatherMode = world.weatherMode;
+    for(int i = 0; i < 26; i++) {
+        header.switchByLetter[i] = world.switchByLetter[i];
+    }
+    memcpy(header.levelName, world.levelName, sizeof(header.levelName));
+    
+    unsigned char page[LEVEL_CACHE_HEADER_SIZE];
+    memset(page, 0, sizeof(page));
+    memcpy(page, &header, sizeof(header));
+    
+    // Unique per process, so runs loading the same level at once do not
+    // write into each other's temporary file
+    char tempPath[512];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp%d", cachePath, (int)getpid());
+    
+    FILE* file = fopen(tempPath, "wb");
+    if(file == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(page, 1, sizeof(page), file) == sizeof(page);
+    long long before = header.skippedBytes > 0 ? getFieldOffset(world) : world.levelBytes;
+    long long after = world.levelBytes - before - header.skippedBytes;
+    if(before > 0) {
+        ok = ok && fwrite(world.memory, 1, before, file) == (size_t)before;
+    }
+    if(after > 0) {
+        ok = ok && fwrite(world.memory + before + header.skippedBytes, 1, after, file) == (size_t)after;
+    }
+    ok = (fclose(file) == 0) && ok;
+    
+    if(!ok || rename(tempPath, cachePath) != 0) {
+        remove(tempPath);
+        return false;
+    }
+    return true;
+}
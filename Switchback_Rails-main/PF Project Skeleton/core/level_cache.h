@@ -0,0 +1,58 @@
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+// ============================================================================
+// LEVEL_CACHE.H - Compiled levels (.lvlb)
+// ============================================================================
+// A .lvlb file holds a level exactly as loadLevelFile() leaves it after
+// parsing: the level scalars (name, sizes, seed, weather, counts, switch
+// letters) in a fixed header, followed by the first levelBytes of the
+// World's allocation. That block already holds everything derived at load
+// time: the grid, trains snapped to their spawns, the spawn schedule,
+// switch tables, spawn points and destinations, the transition table, the
+// distance fields, the track graph and the quiet runs. The array layout
+// follows from the sizes alone (world.cpp), so the block has no pointers
+// and loads with one memcpy. It starts on a page boundary, so the file can
+// also be mapped directly.
+//
+// The distance fields are the exception on large grids: they take 8 bytes
+// per cell for every destination (about 128 MB each on a 4000 x 4000 grid).
+// When they add up to more than LEVEL_CACHE_MAX_FIELD_BYTES the file leaves
+// them out and loadLevelCache() rebuilds them from the transition table, so
+// the cache stays about the size of the rest of the level.
+//
+// The header records a hash and the size of the .lvl text it was compiled
+// from, the cache version and the World layout. loadLevelFile() uses
+// "<level>.lvlb" next to the .lvl when all of them match, and otherwise
+// parses the text and (re)writes the cache.
+// ============================================================================
+
+#include "world.h"
+
+// Bump when the World layout or anything built at load time changes
+const int LEVEL_CACHE_VERSION = 12;
+
+// Distance fields larger than this are rebuilt after loading instead of saved
+const long long LEVEL_CACHE_MAX_FIELD_BYTES = 32LL * 1024 * 1024;
+
+// On by default; when off, loadLevelFile() neither reads nor writes caches
+void setLevelCacheEnabled(bool enabled);
+
+bool isLevelCacheEnabled();
+
+// "<level>.lvlb" for "<level>.lvl", else the path with ".lvlb" appended
+void getLevelCachePath(const char* levelPath, char cachePath[], int capacity);
+
+// Content hash of the .lvl text the cache is keyed by
+unsigned long long hashLevelText(const char* text, long long size);
+
+// False when the file is missing, stale or not a cache; the world may have
+// been resized and must be loaded again
+bool loadLevelCache(const char* cachePath, unsigned long long sourceHash, long long sourceSize,
+                    World& world);
+
+// Written to a temporary file and renamed, so readers never see half a file
+bool saveLevelCache(const char* cachePath, unsigned long long sourceHash, long long sourceSize,
+                    const World& world);
+
+#endif
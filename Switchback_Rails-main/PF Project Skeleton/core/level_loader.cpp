@@ -0,0 +1,566 @@
+#include "level_loader.h"
+#include "level_cache.h"
+#include "io.h"
+#include "simulation_state.h"
+#include "grid.h"
+#include "switches.h"
+#include "trains.h"
+#include "track_graph.h"
+#include "time_skip.h"
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// ============================================================================
+// LEVEL_LOADER.CPP - Memory-mapped .lvl parser
+// ============================================================================
+
+const int SECTION_NAME = 0;
+const int SECTION_ROWS = 1;
+const int SECTION_COLS = 2;
+const int SECTION_SEED = 3;
+const int SECTION_WEATHER = 4;
+const int SECTION_MAP = 5;
+const int SECTION_SWITCHES = 6;
+const int SECTION_TRAINS = 7;
+const int SECTION_COUNT = 8;
+
+static const char* g_sectionKeywords[SECTION_COUNT] = {
+    "NAME:", "ROWS:", "COLS:", "SEED:", "WEATHER:", "MAP:", "SWITCHES:", "TRAINS:"
+};
+
+// Lines of each section: from the line after its keyword up to the next
+// keyword line (or the end of the text)
+struct LevelSections {
+    const char* begin[SECTION_COUNT];       // nullptr if the section is missing
+    const char* end[SECTION_COUNT];
+};
+
+// ----------------------------------------------------------------------------
+// Lines
+// ----------------------------------------------------------------------------
+// Sets length to the line starting at p, without its "\n" or "\r\n", and
+// returns the start of the next line
+static const char* nextLine(const char* p, const char* end, long long& length) {
+    const char* newline = (const char*)memchr(p, '\n', end - p);
+    const char* lineEnd = (newline != nullptr) ? newline : end;
+    if(lineEnd > p && lineEnd[-1] == '\r') {
+        lineEnd--;
+    }
+    length = lineEnd - p;
+    return (newline != nullptr) ? newline + 1 : end;
+}
+
+static bool isBlankLine(const char* line, long long length) {
+    for(long long i = 0; i < length; i++) {
+        if(line[i] != ' ' && line[i] != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Section id of a keyword line, or -1
+static int findSectionKeyword(const char* line, long long length) {
+    while(length > 0 && (line[length - 1] == ' ' || line[length - 1] == '\t')) {
+        length--;
+    }
+    if(length < 4 || length > 9 || line[length - 1] != ':') {
+        return -1;
+    }
+    for(int section = 0; section < SECTION_COUNT; section++) {
+        const char* keyword = g_sectionKeywords[section];
+        if((long long)strlen(keyword) == length && memcmp(line, keyword, length) == 0) {
+            return section;
+        }
+    }
+    return -1;
+}
+
+// One scan over the text; false if a section appears twice
+static bool findLevelSections(const char* text, const char* end, LevelSections& sections) {
+    for(int section = 0; section < SECTION_COUNT; section++) {
+        sections.begin[section] = nullptr;
+        sections.end[section] = nullptr;
+    }
+    
+    int current = -1;
+    const char* p = text;
+    while(p < end) {
+        long long length;
+        const char* next = nextLine(p, end, length);
+        int section = findSectionKeyword(p, length);
+        if(section >= 0) {
+            if(sections.begin[section] != nullptr) {
+                return false;
+            }
+            if(current >= 0) {
+                sections.end[current] = p;
+            }
+            sections.begin[section] = next;
+            current = section;
+        }
+        p = next;
+    }
+    if(current >= 0) {
+        sections.end[current] = end;
+    }
+    return true;
+}
+
+// First non-blank line of a section
+static bool getSectionValue(const LevelSections& sections, int section,
+                            const char*& value, long long& length) {
+    const char* p = sections.begin[section];
+    const char* end = sections.end[section];
+    if(p == nullptr) {
+        return false;
+    }
+    while(p < end) {
+        const char* next = nextLine(p, end, length);
+        if(!isBlankLine(p, length)) {
+            value = p;
+            return true;
+        }
+        p = next;
+    }
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Fields
+// ----------------------------------------------------------------------------
+static void skipSpaces(const char*& p, const char* end) {
+    while(p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+}
+
+static int readNumber(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    int sign = 1;
+    if(p < end && (*p == '-' || *p == '+')) {
+        sign = (*p == '-') ? -1 : 1;
+        p++;
+    }
+    int value = 0;
+    while(p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return value * sign;
+}
+
+// Copies one word, truncated to fit the buffer
+static void readWord(const char*& p, const char* end, char word[], int capacity) {
+    skipSpaces(p, end);
+    int length = 0;
+    while(p < end && *p != ' ' && *p != '\t') {
+        if(length < capacity - 1) {
+            word[length++] = *p;
+        }
+        p++;
+    }
+    word[length] = '\0';
+}
+
+static bool containsWord(const char* text, long long length, const char* word) {
+    long long wordLen = strlen(word);
+    for(long long i = 0; i + wordLen <= length; i++) {
+        if(memcmp(&text[i], word, wordLen) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Header
+// ----------------------------------------------------------------------------
+// Grid size from the map when ROWS or COLS is missing: the lines up to the
+// last non-blank one, and the longest of them
+static void measureMap(const LevelSections& sections, int& mapRows, int& mapCols) {
+    mapRows = 0;
+    mapCols = 0;
+    int row = 0;
+    const char* p = sections.begin[SECTION_MAP];
+    const char* end = sections.end[SECTION_MAP];
+    while(p < end) {
+        long long length;
+        const char* line = p;
+        p = nextLine(p, end, length);
+        row++;
+        if(!isBlankLine(line, length)) {
+            mapRows = row;
+        }
+        if(length > mapCols) {
+            mapCols = (int)length;
+        }
+    }
+}
+
+static bool readGridSize(const LevelSections& sections, int& gridRows, int& gridCols) {
+    const char* value;
+    long long length;
+    gridRows = getSectionValue(sections, SECTION_ROWS, value, length) ? readNumber(value, value + length) : 0;
+    gridCols = getSectionValue(sections, SECTION_COLS, value, length) ? readNumber(value, value + length) : 0;
+    
+    if(sections.begin[SECTION_ROWS] == nullptr || sections.begin[SECTION_COLS] == nullptr) {
+        int mapRows, mapCols;
+        measureMap(sections, mapRows, mapCols);
+        if(sections.begin[SECTION_ROWS] == nullptr) gridRows = mapRows;
+        if(sections.begin[SECTION_COLS] == nullptr) gridCols = mapCols;
+    }
+    return gridRows > 0 && gridCols > 0;
+}
+
+static void readLevelHeader(const LevelSections& sections, World& world) {
+    const char* value;
+    long long length;
+    
+    world.levelName[0] = '\0';
+    if(getSectionValue(sections, SECTION_NAME, value, length)) {
+        long long nameLen = (length < (long long)sizeof(world.levelName)) ? length : sizeof(world.levelName) - 1;
+        memcpy(world.levelName, value, nameLen);
+        world.levelName[nameLen] = '\0';
+    }
+    
+    world.seed = 0;
+    if(getSectionValue(sections, SECTION_SEED, value, length)) {
+        world.seed = readNumber(value, value + length);
+    }
+    
+    world.weatherMode = 0;
+    if(getSectionValue(sections, SECTION_WEATHER, value, length)) {
+        if(containsWord(value, length, "NORMAL")) world.weatherMode = 0;
+        else if(containsWord(value, length, "RAIN")) world.weatherMode = 1;
+        else if(containsWord(value, length, "FOG")) world.weatherMode = 2;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Map
+// ----------------------------------------------------------------------------
+static void countMapPoints(const LevelSections& sections, int gridRows, int gridCols,
+                           int& spawnCount, int& destCount) {
+    spawnCount = 0;
+    destCount = 0;
+    const char* p = sections.begin[SECTION_MAP];
+    const char* end = sections.end[SECTION_MAP];
+    for(int row = 0; row < gridRows && p < end; row++) {
+        long long length;
+        const char* line = p;
+        p = nextLine(p, end, length);
+        int width = (length < gridCols) ? (int)length : gridCols;
+        for(int x = 0; x < width; x++) {
+            if(line[x] == 'S') spawnCount++;
+            if(line[x] == 'D') destCount++;
+        }
+    }
+}
+
+static int getSpawnSlot(long long cell, int slotMask) {
+    unsigned long long h = (unsigned long long)cell * 0x9E3779B97F4A7C15ull;
+    return (int)(h >> 32) & slotMask;
+}
+
+// Copies the rows into the grid and lists spawn points and destinations in
+// row-major order; spawnSlots maps a spawn cell to its index (open
+// addressing, -1 = empty)
+static void readMapRows(const LevelSections& sections, World& world, int spawnSlots[], int slotMask) {
+    const char* p = sections.begin[SECTION_MAP];
+    const char* end = sections.end[SECTION_MAP];
+    for(int y = 0; y < world.gridRows && p < end; y++) {
+        long long length;
+        const char* line = p;
+        p = nextLine(p, end, length);
+        int width = (length < world.gridCols) ? (int)length : world.gridCols;
+        memcpy(&world.grid[y * world.gridCols], line, width);
+        
+        for(int x = 0; x < width; x++) {
+            if(line[x] == 'S') {
+                long long cell = (long long)y * world.gridCols + x;
+                int slot = getSpawnSlot(cell, slotMask);
+                while(spawnSlots[slot] >= 0) {
+                    slot = (slot + 1) & slotMask;
+                }
+                spawnSlots[slot] = world.spawnCount;
+                
+                world.spawnX[world.spawnCount] = x;
+                world.spawnY[world.spawnCount] = y;
+                world.spawnCount++;
+            }
+            else if(line[x] == 'D') {
+                world.destX[world.destCount] = x;
+                world.destY[world.destCount] = y;
+                world.destCount++;
+            }
+        }
+    }
+}
+
+// Spawn point a train starts from: the one on its cell, else the nearest
+// (first in row-major order on ties)
+static int findTrainSpawn(const World& world, const int spawnSlots[], int slotMask, int x, int y) {
+    if(x >= 0 && x < world.gridCols && y >= 0 && y < world.gridRows) {
+        long long cell = (long long)y * world.gridCols + x;
+        int slot = getSpawnSlot(cell, slotMask);
+        while(spawnSlots[slot] >= 0) {
+            int s = spawnSlots[slot];
+            if(world.spawnX[s] == x && world.spawnY[s] == y) {
+                return s;
+            }
+            slot = (slot + 1) & slotMask;
+        }
+    }
+    
+    int nearestSpawn = 0;
+    long long minDist = -1;
+    for(int s = 0; s < world.spawnCount; s++) {
+        long long dx = world.spawnX[s] - x;
+        long long dy = world.spawnY[s] - y;
+        long long dist = (dx >= 0 ? dx : -dx) + (dy >= 0 ? dy : -dy);
+        if(minDist < 0 || dist < minDist) {
+            minDist = dist;
+            nearestSpawn = s;
+        }
+    }
+    return nearestSpawn;
+}
+
+// ----------------------------------------------------------------------------
+// Switches and trains
+// ----------------------------------------------------------------------------
+// A SWITCHES line starts with the switch letter, or with '*' and a name and
+// cell for a switch that has no letter:
+//   A PER_DIR 0 2 2 2 2 STRAIGHT TURN
+//   * J1042 120 45 PER_DIR 0 2 2 2 2 STRAIGHT TURN
+// For SWITCHES this marks the letters used and counts the named switches.
+static int countSectionEntries(const LevelSections& sections, int section, bool letterUsed[]) {
+    int count = 0;
+    const char* p = sections.begin[section];
+    const char* end = sections.end[section];
+    while(p != nullptr && p < end) {
+        long long length;
+        const char* line = p;
+        p = nextLine(p, end, length);
+        if(section == SECTION_SWITCHES) {
+            if(length > 0 && line[0] >= 'A' && line[0] <= 'Z') {
+                letterUsed[line[0] - 'A'] = true;
+            }
+            else if(length > 0 && line[0] == '*') {
+                count++;
+            }
+        }
+        else if(!isBlankLine(line, length)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void readSwitches(const LevelSections& sections, World& world) {
+    const char* p = sections.begin[SECTION_SWITCHES];
+    const char* end = sections.end[SECTION_SWITCHES];
+    while(p != nullptr && p < end) {
+        long long length;
+        const char* line = p;
+        p = nextLine(p, end, length);
+        if(length == 0 || (line[0] != '*' && (line[0] < 'A' || line[0] > 'Z'))) {
+            continue;
+        }
+        
+        const char* field = line + 1;
+        const char* lineEnd = line + length;
+        
+        // Named switches are added in file order, after the letters;
+        // buildSwitchIndex() checks their cells
+        int id;
+        if(line[0] == '*') {
+            char name[SWITCH_NAME_LEN];
+            readWord(field, lineEnd, name, sizeof(name));
+            id = addSwitch(world, name);
+            if(id < 0) continue;
+            world.switchX[id] = readNumber(field, lineEnd);
+            world.switchY[id] = readNumber(field, lineEnd);
+        } else {
+            id = findSwitchByLetter(world, line[0]);
+        }
+        
+        char modeStr[32];
+        readWord(field, lineEnd, modeStr, sizeof(modeStr));
+        world.switchState[id] = readNumber(field, lineEnd);
+        world.switchMode[id] = (strcmp(modeStr, "PER_DIR") == 0);
+        for(int dir = 0; dir < 4; dir++) {
+            world.switchKValues[id * 4 + dir] = readNumber(field, lineEnd);
+        }
+        readWord(field, lineEnd, getSwitchStateName(world, id, 0), SWITCH_STATE_NAME_LEN);
+        readWord(field, lineEnd, getSwitchStateName(world, id, 1), SWITCH_STATE_NAME_LEN);
+    }
+}
+
+static void readTrains(const LevelSections& sections, World& world, const int spawnSlots[], int slotMask) {
+    const char* p = sections.begin[SECTION_TRAINS];
+    const char* end = sections.end[SECTION_TRAINS];
+    while(p != nullptr && p < end && world.trainCount < world.trainCapacity) {
+        long long length;
+        const char* line = p;
+        p = nextLine(p, end, length);
+        if(isBlankLine(line, length)) {
+            continue;
+        }
+        
+        const char* field = line;
+        const char* lineEnd = line + length;
+        int tick = readNumber(field, lineEnd);
+        int x = readNumber(field, lineEnd);
+        int y = readNumber(field, lineEnd);
+        int dir = readNumber(field, lineEnd);
+        int destIdx = readNumber(field, lineEnd);
+        
+        int t = world.trainCount;
+        world.trainSpawnTick[t] = tick;
+        world.trainDir[t] = dir;
+        world.trainColor[t] = destIdx;
+        
+        if(world.spawnCount > 0) {
+            int s = findTrainSpawn(world, spawnSlots, slotMask, x, y);
+            world.trainX[t] = world.spawnX[s];
+            world.trainY[t] = world.spawnY[s];
+        }
+        
+        if(destIdx >= 0 && destIdx < world.destCount) {
+            world.trainDestX[t] = world.destX[destIdx];
+            world.trainDestY[t] = world.destY[destIdx];
+            world.trainDestField[t] = destIdx;
+        }
+        
+        world.trainCount++;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Parse a level
+// ----------------------------------------------------------------------------
+bool parseLevelText(const char* text, long long size, World& world) {
+    const char* end = text + size;
+    
+    LevelSections sections;
+    if(!findLevelSections(text, end, sections) || sections.begin[SECTION_MAP] == nullptr) {
+        return false;
+    }
+    
+    // Sizes
+    int gridRows, gridCols;
+    if(!readGridSize(sections, gridRows, gridCols)) {
+        return false;
+    }
+    
+    int spawnCount, destCount;
+    countMapPoints(sections, gridRows, gridCols, spawnCount, destCount);
+    
+    bool letterUsed[26];
+    for(int i = 0; i < 26; i++) {
+        letterUsed[i] = false;
+    }
+    int namedSwitches = countSectionEntries(sections, SECTION_SWITCHES, letterUsed);
+    int trainCount = countSectionEntries(sections, SECTION_TRAINS, letterUsed);
+    
+    int switchCount = namedSwitches;
+    for(int i = 0; i < 26; i++) {
+        if(letterUsed[i]) switchCount++;
+    }
+    
+    if(!allocateWorld(world, gridRows, gridCols, trainCount, switchCount, spawnCount, destCount)) {
+        cout << "ERROR: Not enough memory for a " << gridRows << " x " << gridCols << " level with "
+             << trainCount << " trains" << endl;
+        return false;
+    }
+    initializeSimulationState(world);
+    readLevelHeader(sections, world);
+    
+    // Letter switches get their ids in alphabetical order
+    for(int i = 0; i < 26; i++) {
+        if(letterUsed[i]) {
+            char name[2] = {(char)('A' + i), '\0'};
+            addSwitch(world, name);
+        }
+    }
+    
+    // Contents
+    int slotCount = 16;
+    while(slotCount < spawnCount * 2) {
+        slotCount *= 2;
+    }
+    int* spawnSlots = new int[slotCount];
+    for(int slot = 0; slot < slotCount; slot++) {
+        spawnSlots[slot] = -1;
+    }
+    
+    readMapRows(sections, world, spawnSlots, slotCount - 1);
+    readSwitches(sections, world);
+    readTrains(sections, world, spawnSlots, slotCount - 1);
+    
+    delete[] spawnSlots;
+    
+    buildSpawnSchedule(world);
+    buildTransitionTable(world);
+    buildTrackDistanceFields(world);
+    buildTrackGraph(world);
+    buildSwitchIndex(world);
+    buildQuietRuns(world);
+    
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Load level file
+// ----------------------------------------------------------------------------
+bool loadLevelFile(const char* filename, World& world) {
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    
+    void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) {
+        return false;
+    }
+    
+    const char* text = (const char*)mapped;
+    long long size = (long long)info.st_size;
+    
+    // A current .lvlb skips parsing and every table built after it
+    bool useCache = isLevelCacheEnabled();
+    unsigned long long sourceHash = 0;
+    char cachePath[512];
+    if(useCache) {
+        sourceHash = hashLevelText(text, size);
+        getLevelCachePath(filename, cachePath, sizeof(cachePath));
+        if(loadLevelCache(cachePath, sourceHash, size, world)) {
+            munmap(mapped, (size_t)info.st_size);
+            return true;
+        }
+    }
+    
+    bool loaded = parseLevelText(text, size, world);
+    munmap(mapped, (size_t)info.st_size);
+    
+    // Best effort: a read-only level directory just means no cache
+    if(loaded && useCache) {
+        saveLevelCache(cachePath, sourceHash, size, world);
+    }
+    return loaded;
+}
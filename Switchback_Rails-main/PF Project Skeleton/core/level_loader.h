@@ -0,0 +1,32 @@
+#ifndef LEVEL_LOADER_H
+#define LEVEL_LOADER_H
+
+// ============================================================================
+// LEVEL_LOADER.H - .lvl parser
+// ============================================================================
+// loadLevelFile() (io.h) maps the file into memory and hands the bytes to
+// parseLevelText(), unless a current compiled copy exists (level_cache.h).
+// A level is a list of sections, each starting with its
+// keyword on a line of its own:
+//
+//   NAME:      level name (next non-blank line)
+//   ROWS:      grid size; when missing, taken from the MAP section
+//   COLS:
+//   SEED:
+//   WEATHER:   NORMAL, RAIN or FOG
+//   MAP:       one line per grid row, any width
+//   SWITCHES:  <letter> <GLOBAL|PER_DIR> <state> <k up> <k right> <k down>
+//              <k left> <state 0 name> <state 1 name>
+//   TRAINS:    <spawn tick> <x> <y> <dir> <destination index>
+//
+// Sections may come in any order and lines have no length limit. Lines may
+// end in "\r\n". Map rows beyond COLS and rows beyond ROWS are ignored.
+// ============================================================================
+
+#include "world.h"
+
+// Fills the world from the text of a .lvl file; false if the text is not a
+// level (no MAP section, no grid size, repeated section)
+bool parseLevelText(const char* text, long long size, World& world);
+
+#endif
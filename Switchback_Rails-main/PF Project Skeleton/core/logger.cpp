@@ -0,0 +1,503 @@
+#include "logger.h"
+#include "trace_format.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// ============================================================================
+// LOGGER.CPP - Background CSV log writer
+// ============================================================================
+
+const int LOG_RING_SIZE = 1 << 16;          // Records, power of two
+const int LOG_BLOCK_SIZE = 256 * 1024;      // Bytes buffered per file
+const int LOG_MAX_LINE = 256;
+
+const int RECORD_TRACE = 0;
+const int RECORD_SWITCH = 1;
+const int RECORD_SIGNAL = 2;
+const int RECORD_DELTA_END = 3;
+
+// One writer per run. Everything the simulation thread and the writer thread
+// share lives here, so several runs can log side by side.
+struct LogWriter {
+    
+    // Ring buffer (parallel arrays, one slot per record)
+    int recKind[LOG_RING_SIZE];
+    int recTick[LOG_RING_SIZE];
+    int recId[LOG_RING_SIZE];
+    int recX[LOG_RING_SIZE];
+    int recY[LOG_RING_SIZE];
+    int recDir[LOG_RING_SIZE];
+    const char* recName[LOG_RING_SIZE];     // switch name
+    const char* recText1[LOG_RING_SIZE];
+    const char* recText2[LOG_RING_SIZE];
+    
+    // head is written only by the simulation thread, tail only by the writer
+    atomic<unsigned> head;
+    atomic<unsigned> tail;
+    
+    // Flush fence: the producer publishes a target head and a request number,
+    // the writer answers with the same number once everything up to it is out
+    unsigned fenceTarget;
+    atomic<unsigned> fenceRequest;
+    atomic<unsigned> fenceDone;
+    
+    atomic<bool> writerRunning;
+    atomic<bool> stopRequested;
+    thread writerThread;
+    bool binaryOutput;
+    BinaryTraceWriter* binary;
+    
+    // Output files and their pending blocks (touched only by the writer thread)
+    ofstream files[3];
+    char blocks[3][LOG_BLOCK_SIZE];
+    int blockLen[3];
+    
+    LogWriter* nextLive;
+};
+
+// Writers still running are stopped at exit so their files are complete
+static mutex g_liveMutex;
+static LogWriter* g_liveWriters = nullptr;
+static bool g_atExitRegistered = false;
+
+// ----------------------------------------------------------------------------
+// Append text to a block
+// ----------------------------------------------------------------------------
+static void appendText(char block[], int& len, const char* text) {
+    for(int i = 0; text[i] != '\0'; i++) {
+        block[len++] = text[i];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Append integer to a block
+// ----------------------------------------------------------------------------
+static void appendInt(char block[], int& len, int value) {
+    char digits[12];
+    int count = 0;
+    unsigned magnitude = (value < 0) ? 0u - (unsigned)value : (unsigned)value;
+    
+    if(value < 0) {
+        block[len++] = '-';
+    }
+    
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude > 0);
+    
+    while(count > 0) {
+        block[len++] = digits[--count];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Write a file's pending block
+// ----------------------------------------------------------------------------
+static void writeBlock(LogWriter* writer, int file) {
+    if(writer->blockLen[file] > 0 && writer->files[file].is_open()) {
+        writer->files[file].write(writer->blocks[file], writer->blockLen[file]);
+    }
+    writer->blockLen[file] = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Format one record into its file's block
+// ----------------------------------------------------------------------------
+static void formatRecord(LogWriter* writer, unsigned slot) {
+    static const char* dirStr[] = {"UP", "RIGHT", "DOWN", "LEFT"};
+    
+    int file = writer->recKind[slot];
+    
+    if(file == RECORD_DELTA_END) {
+        if(writer->binaryOutput) {
+            return;
+        }
+        writer->recKind[slot] = RECORD_SWITCH;
+        writer->recText1[slot] = "-";
+        writer->recText2[slot] = "-";
+        formatRecord(writer, slot);
+        writer->recKind[slot] = RECORD_SIGNAL;
+        formatRecord(writer, slot);
+        return;
+    }
+    
+    if(writer->binaryOutput) {
+        if(file == RECORD_TRACE) {
+            appendBinaryTrainRow(writer->binary, writer->recTick[slot], writer->recId[slot],
+                                 writer->recX[slot], writer->recY[slot],
+                                 writer->recDir[slot], writer->recText1[slot]);
+        }
+        else if(file == RECORD_SWITCH) {
+            appendBinarySwitchRow(writer->binary, writer->recTick[slot], writer->recId[slot],
+                                  writer->recName[slot],
+                                  writer->recText1[slot], writer->recText2[slot]);
+        }
+        else {
+            appendBinarySignalRow(writer->binary, writer->recTick[slot], writer->recId[slot],
+                                  writer->recName[slot], writer->recText1[slot]);
+        }
+        return;
+    }
+    
+    if(writer->blockLen[file] > LOG_BLOCK_SIZE - LOG_MAX_LINE) {
+        writeBlock(writer, file);
+    }
+    
+    char* block = writer->blocks[file];
+    int& len = writer->blockLen[file];
+    
+    appendInt(block, len, writer->recTick[slot]);
+    block[len++] = ',';
+    
+    if(file == RECORD_TRACE) {
+        appendInt(block, len, writer->recId[slot]);
+        block[len++] = ',';
+        appendInt(block, len, writer->recX[slot]);
+        block[len++] = ',';
+        appendInt(block, len, writer->recY[slot]);
+        block[len++] = ',';
+        appendText(block, len, dirStr[writer->recDir[slot]]);
+        block[len++] = ',';
+        appendText(block, len, writer->recText1[slot]);
+    }
+    else if(file == RECORD_SWITCH) {
+        appendText(block, len, writer->recName[slot]);
+        block[len++] = ',';
+        appendText(block, len, writer->recText1[slot]);
+        block[len++] = ',';
+        appendText(block, len, writer->recText2[slot]);
+    }
+    else {
+        appendText(block, len, writer->recName[slot]);
+        block[len++] = ',';
+        appendText(block, len, writer->recText1[slot]);
+    }
+    
+    if(file != RECORD_TRACE && writer->recX[slot] != 0) {
+        block[len++] = ',';
+        block[len++] = (char)writer->recX[slot];
+    }
+    
+    block[len++] = '\n';
+}
+
+// ----------------------------------------------------------------------------
+// Writer thread loop
+// ----------------------------------------------------------------------------
+static void writerLoop(LogWriter* writer) {
+    while(true) {
+        unsigned head = writer->head.load(memory_order_acquire);
+        unsigned tail = writer->tail.load(memory_order_relaxed);
+        
+        while(tail != head) {
+            formatRecord(writer, tail & (LOG_RING_SIZE - 1));
+            tail++;
+        }
+        writer->tail.store(tail, memory_order_release);
+        
+        unsigned request = writer->fenceRequest.load(memory_order_acquire);
+        if(request != writer->fenceDone.load(memory_order_relaxed) &&
+           (int)(tail - writer->fenceTarget) >= 0) {
+            for(int f = 0; f < 3; f++) {
+                writeBlock(writer, f);
+                writer->files[f].flush();
+            }
+            if(writer->binaryOutput) {
+                flushBinaryTrace(writer->binary);
+            }
+            writer->fenceDone.store(request, memory_order_release);
+        }
+        
+        if(writer->stopRequested.load(memory_order_acquire) &&
+           tail == writer->head.load(memory_order_acquire)) {
+            break;
+        }
+        
+        if(tail == writer->head.load(memory_order_acquire)) {
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+    }
+    
+    for(int f = 0; f < 3; f++) {
+        writeBlock(writer, f);
+        writer->files[f].close();
+    }
+    if(writer->binaryOutput) {
+        closeBinaryTrace(writer->binary);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Reserve the next ring slot, waiting while the writer catches up
+// ----------------------------------------------------------------------------
+static unsigned reserveSlot(LogWriter* writer) {
+    unsigned head = writer->head.load(memory_order_relaxed);
+    while(head - writer->tail.load(memory_order_acquire) >= (unsigned)LOG_RING_SIZE) {
+        this_thread::yield();
+    }
+    return head;
+}
+
+// ----------------------------------------------------------------------------
+// Publish a filled slot to the writer
+// ----------------------------------------------------------------------------
+static void publishSlot(LogWriter* writer, unsigned head) {
+    writer->head.store(head + 1, memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+// Stop every writer that is still running (registered with atexit)
+// ----------------------------------------------------------------------------
+static void stopLiveWriters() {
+    while(true) {
+        LogWriter* writer;
+        {
+            lock_guard<mutex> lock(g_liveMutex);
+            writer = g_liveWriters;
+        }
+        if(writer == nullptr) {
+            return;
+        }
+        stopLogWriter(writer);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Reset ring and launch the writer thread
+// ----------------------------------------------------------------------------
+static void launchWriter(LogWriter* writer) {
+    for(int f = 0; f < 3; f++) {
+        writer->blockLen[f] = 0;
+    }
+    
+    writer->head.store(0);
+    writer->tail.store(0);
+    writer->fenceTarget = 0;
+    writer->fenceRequest.store(0);
+    writer->fenceDone.store(0);
+    writer->stopRequested.store(false);
+    
+    {
+        lock_guard<mutex> lock(g_liveMutex);
+        if(!g_atExitRegistered) {
+            atexit(stopLiveWriters);
+            g_atExitRegistered = true;
+        }
+        writer->nextLive = g_liveWriters;
+        g_liveWriters = writer;
+    }
+    
+    writer->writerThread = thread(writerLoop, writer);
+    writer->writerRunning.store(true);
+}
+
+// ----------------------------------------------------------------------------
+// Create an idle writer
+// ----------------------------------------------------------------------------
+LogWriter* createLogWriter() {
+    LogWriter* writer = new LogWriter;
+    writer->head.store(0);
+    writer->tail.store(0);
+    writer->fenceTarget = 0;
+    writer->fenceRequest.store(0);
+    writer->fenceDone.store(0);
+    writer->writerRunning.store(false);
+    writer->stopRequested.store(false);
+    writer->binaryOutput = false;
+    writer->binary = createBinaryTraceWriter();
+    for(int f = 0; f < 3; f++) {
+        writer->blockLen[f] = 0;
+    }
+    writer->nextLive = nullptr;
+    return writer;
+}
+
+// ----------------------------------------------------------------------------
+// Stop (if running) and free a writer
+// ----------------------------------------------------------------------------
+void destroyLogWriter(LogWriter* writer) {
+    if(writer == nullptr) {
+        return;
+    }
+    stopLogWriter(writer);
+    destroyBinaryTraceWriter(writer->binary);
+    delete writer;
+}
+
+// ----------------------------------------------------------------------------
+// Start writer thread (files are opened for append; false, with no thread
+// started, when one of them cannot be opened)
+// ----------------------------------------------------------------------------
+bool startLogWriter(LogWriter* writer, const char* tracePath, const char* switchPath,
+                    const char* signalPath) {
+    stopLogWriter(writer);
+    
+    writer->binaryOutput = false;
+    writer->files[RECORD_TRACE].open(tracePath, ios::app | ios::binary);
+    writer->files[RECORD_SWITCH].open(switchPath, ios::app | ios::binary);
+    writer->files[RECORD_SIGNAL].open(signalPath, ios::app | ios::binary);
+    
+    bool opened = true;
+    for(int f = 0; f < 3; f++) {
+        if(!writer->files[f].is_open()) {
+            opened = false;
+        }
+    }
+    if(!opened) {
+        for(int f = 0; f < 3; f++) {
+            writer->files[f].close();
+        }
+        return false;
+    }
+    
+    launchWriter(writer);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Level metadata for the binary trace directory (set before starting)
+// ----------------------------------------------------------------------------
+void setLogWriterLevelInfo(LogWriter* writer, const char* levelName, int rows, int cols,
+                           int seed, int weatherMode) {
+    setBinaryTraceLevelInfo(writer->binary, levelName, rows, cols, seed, weatherMode);
+}
+
+// ----------------------------------------------------------------------------
+// Start writer thread producing a binary trace
+// ----------------------------------------------------------------------------
+bool startBinaryLogWriter(LogWriter* writer, const char* binaryPath, bool compress) {
+    stopLogWriter(writer);
+    
+    if(!openBinaryTrace(writer->binary, binaryPath, compress)) {
+        return false;
+    }
+    
+    writer->binaryOutput = true;
+    launchWriter(writer);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Drain remaining records, stop writer thread and close files
+// ----------------------------------------------------------------------------
+void stopLogWriter(LogWriter* writer) {
+    if(!writer->writerRunning.load()) {
+        return;
+    }
+    
+    writer->stopRequested.store(true, memory_order_release);
+    writer->writerThread.join();
+    writer->writerRunning.store(false);
+    
+    lock_guard<mutex> lock(g_liveMutex);
+    LogWriter** link = &g_liveWriters;
+    while(*link != nullptr && *link != writer) {
+        link = &(*link)->nextLive;
+    }
+    if(*link == writer) {
+        *link = writer->nextLive;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Is writer thread running
+// ----------------------------------------------------------------------------
+bool isLogWriterRunning(LogWriter* writer) {
+    return writer->writerRunning.load(memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+// Push train trace record
+// ----------------------------------------------------------------------------
+void pushTraceRecord(LogWriter* writer, int tick, int trainId, int x, int y, int dir,
+                     const char* state) {
+    unsigned head = reserveSlot(writer);
+    unsigned slot = head & (LOG_RING_SIZE - 1);
+    
+    writer->recKind[slot] = RECORD_TRACE;
+    writer->recTick[slot] = tick;
+    writer->recId[slot] = trainId;
+    writer->recX[slot] = x;
+    writer->recY[slot] = y;
+    writer->recDir[slot] = dir;
+    writer->recText1[slot] = state;
+    
+    publishSlot(writer, head);
+}
+
+// ----------------------------------------------------------------------------
+// Push switch state record
+// ----------------------------------------------------------------------------
+void pushSwitchRecord(LogWriter* writer, int tick, int switchId, const char* switchName,
+                      const char* mode, const char* state, char rowKind) {
+    unsigned head = reserveSlot(writer);
+    unsigned slot = head & (LOG_RING_SIZE - 1);
+    
+    writer->recKind[slot] = RECORD_SWITCH;
+    writer->recTick[slot] = tick;
+    writer->recId[slot] = switchId;
+    writer->recName[slot] = switchName;
+    writer->recX[slot] = rowKind;
+    writer->recText1[slot] = mode;
+    writer->recText2[slot] = state;
+    
+    publishSlot(writer, head);
+}
+
+// ----------------------------------------------------------------------------
+// Push signal state record
+// ----------------------------------------------------------------------------
+void pushSignalRecord(LogWriter* writer, int tick, int switchId, const char* switchName,
+                      const char* signal, char rowKind) {
+    unsigned head = reserveSlot(writer);
+    unsigned slot = head & (LOG_RING_SIZE - 1);
+    
+    writer->recKind[slot] = RECORD_SIGNAL;
+    writer->recTick[slot] = tick;
+    writer->recId[slot] = switchId;
+    writer->recName[slot] = switchName;
+    writer->recX[slot] = rowKind;
+    writer->recText1[slot] = signal;
+    
+    publishSlot(writer, head);
+}
+
+// ----------------------------------------------------------------------------
+// Push delta log end marker
+// ----------------------------------------------------------------------------
+void pushDeltaEndRecord(LogWriter* writer, int tick) {
+    unsigned head = reserveSlot(writer);
+    unsigned slot = head & (LOG_RING_SIZE - 1);
+    
+    writer->recKind[slot] = RECORD_DELTA_END;
+    writer->recTick[slot] = tick;
+    writer->recId[slot] = -1;
+    writer->recName[slot] = "-";
+    writer->recX[slot] = 'E';
+    
+    publishSlot(writer, head);
+}
+
+// ----------------------------------------------------------------------------
+// Wait until all pushed records are written and flushed
+// ----------------------------------------------------------------------------
+void flushLogWriter(LogWriter* writer) {
+    if(!writer->writerRunning.load()) {
+        return;
+    }
+    
+    writer->fenceTarget = writer->head.load(memory_order_relaxed);
+    unsigned request = writer->fenceRequest.load(memory_order_relaxed) + 1;
+    writer->fenceRequest.store(request, memory_order_release);
+    
+    while(writer->fenceDone.load(memory_order_acquire) != request) {
+        this_thread::sleep_for(chrono::microseconds(50));
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+// ============================================================================
+// LOGGER.H - Background CSV log writer
+// ============================================================================
+// The simulation thread pushes fixed-size records into a single-producer
+// ring buffer. A writer thread formats them and appends to the CSV files in
+// large blocks. Text arguments must stay valid until the record is written
+// (string literals and the switch and state names held by the World all
+// qualify).
+// Each run owns its own LogWriter, so runs on different threads never share
+// a ring buffer or an output file.
+// ============================================================================
+
+struct LogWriter;
+
+// ----------------------------------------------------------------------------
+// LIFECYCLE
+// ----------------------------------------------------------------------------
+LogWriter* createLogWriter();
+
+void destroyLogWriter(LogWriter* writer);
+
+// False (no thread started) when one of the files cannot be opened
+bool startLogWriter(LogWriter* writer, const char* tracePath, const char* switchPath,
+                    const char* signalPath);
+
+// Level metadata stored in binary traces; call before startBinaryLogWriter
+void setLogWriterLevelInfo(LogWriter* writer, const char* levelName, int rows, int cols,
+                           int seed, int weatherMode);
+
+// Same ring buffer, but the writer packs rows into the binary trace format
+bool startBinaryLogWriter(LogWriter* writer, const char* binaryPath, bool compress);
+
+void stopLogWriter(LogWriter* writer);
+
+bool isLogWriterRunning(LogWriter* writer);
+
+// ----------------------------------------------------------------------------
+// RECORDS
+// ----------------------------------------------------------------------------
+void pushTraceRecord(LogWriter* writer, int tick, int trainId, int x, int y, int dir,
+                     const char* state);
+
+// rowKind 0 writes a dense row; 'K' (keyframe) or 'C' (change) adds a Kind column.
+// CSV rows show the switch name, binary rows store the numeric switch id.
+void pushSwitchRecord(LogWriter* writer, int tick, int switchId, const char* switchName,
+                      const char* mode, const char* state, char rowKind);
+
+void pushSignalRecord(LogWriter* writer, int tick, int switchId, const char* switchName,
+                      const char* signal, char rowKind);
+
+// Delta logs only: closing 'E' row in the switch and signal files
+void pushDeltaEndRecord(LogWriter* writer, int tick);
+
+// ----------------------------------------------------------------------------
+// FENCE
+// ----------------------------------------------------------------------------
+// Blocks until every record pushed so far has been written to its file.
+void flushLogWriter(LogWriter* writer);
+
+#endif
@@ -0,0 +1,175 @@
+#include "parallel_tick.h"
+#include "simulation.h"
+#include "trains.h"
+#include "switches.h"
+#include "state_hash.h"
+#include "job_pool.h"
+#include <cstring>
+
+using namespace std;
+
+// ============================================================================
+// PARALLEL_TICK.CPP - Chunked route, counter and move phases
+// ============================================================================
+
+const int HASH_STRIDE = 8;          // hash parts per thread, padded to a cache line
+const int COUNT_ALIGN = 16;         // ints per cache line
+
+struct ParallelTick {
+    PersistentPool* pool;
+    int threadCount;
+    unsigned long long* hashParts;  // HASH_STRIDE per thread
+    int* counts;                    // countStride per thread
+    int countStride;
+    World* world;                   // the phase being run
+    int phase;
+    int trainCount;                 // activeCount when the phase started
+};
+
+// ----------------------------------------------------------------------------
+// Thread count
+// ----------------------------------------------------------------------------
+void setTickThreads(LogContext& log, int threadCount) {
+    stopTickThreads(log);
+    
+    if(threadCount < 1) {
+        threadCount = getHardwareWorkerCount();
+    }
+    if(threadCount == 1) {
+        return;
+    }
+    
+    ParallelTick* parallel = new ParallelTick;
+    parallel->pool = createPersistentPool(threadCount);
+    parallel->threadCount = threadCount;
+    parallel->hashParts = new unsigned long long[threadCount * HASH_STRIDE];
+    parallel->counts = nullptr;
+    parallel->countStride = 0;
+    parallel->world = nullptr;
+    parallel->phase = -1;
+    parallel->trainCount = 0;
+    log.parallel = parallel;
+}
+
+int getTickThreads(const LogContext& log) {
+    return (log.parallel != nullptr) ? log.parallel->threadCount : 1;
+}
+
+void stopTickThreads(LogContext& log) {
+    ParallelTick* parallel = log.parallel;
+    if(parallel == nullptr) {
+        return;
+    }
+    
+    destroyPersistentPool(parallel->pool);
+    delete[] parallel->hashParts;
+    delete[] parallel->counts;
+    delete parallel;
+    log.parallel = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// One chunk of the active list, on whichever thread took it
+// ----------------------------------------------------------------------------
+static void runTrainChunk(int chunk, int worker, void* user) {
+    ParallelTick* parallel = (ParallelTick*)user;
+    World& world = *parallel->world;
+    
+    int begin = chunk * PARALLEL_CHUNK_TRAINS;
+    int end = begin + PARALLEL_CHUNK_TRAINS;
+    if(end > parallel->trainCount) {
+        end = parallel->trainCount;
+    }
+    
+    unsigned long long* parts = &parallel->hashParts[worker * HASH_STRIDE];
+    
+    switch(parallel->phase) {
+        case PHASE_ROUTES:
+            determineRoutesInRange(world, begin, end, parts);
+            break;
+        case PHASE_SWITCH_COUNTERS:
+            countSwitchEntriesInRange(world, begin, end,
+                                      &parallel->counts[worker * parallel->countStride]);
+            break;
+        case PHASE_MOVE:
+            for(int a = begin; a < end; a++) {
+                int i = world.activeList[a];
+                world.trainPrevX[i] = world.trainX[i];
+                world.trainPrevY[i] = world.trainY[i];
+            }
+            moveTrainsInRange(world, begin, end, parts);
+            break;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Per-thread counters big enough for the world's switches
+// ----------------------------------------------------------------------------
+static void reserveCounts(ParallelTick* parallel, const World& world) {
+    int needed = (world.switchCount * 4 + COUNT_ALIGN - 1) / COUNT_ALIGN * COUNT_ALIGN;
+    if(needed <= parallel->countStride) {
+        return;
+    }
+    
+    delete[] parallel->counts;
+    parallel->counts = new int[parallel->threadCount * needed];
+    parallel->countStride = needed;
+}
+
+// ----------------------------------------------------------------------------
+// Run a phase on the pool and merge the partials
+// ----------------------------------------------------------------------------
+bool runParallelTickPhase(World& world, LogContext& log, int phase) {
+    ParallelTick* parallel = log.parallel;
+    if(parallel == nullptr || world.activeCount < PARALLEL_MIN_TRAINS) {
+        return false;
+    }
+    if(phase != PHASE_ROUTES && phase != PHASE_SWITCH_COUNTERS && phase != PHASE_MOVE) {
+        return false;
+    }
+    
+    // The first move also records the trains still waiting to spawn; the
+    // serial phase does that once
+    if(phase == PHASE_MOVE && !world.prevPrimed) {
+        return false;
+    }
+    
+    int threads = parallel->threadCount;
+    int counterCount = world.switchCount * 4;
+    
+    memset(parallel->hashParts, 0, sizeof(unsigned long long) * threads * HASH_STRIDE);
+    if(phase == PHASE_SWITCH_COUNTERS) {
+        reserveCounts(parallel, world);
+        for(int t = 0; t < threads; t++) {
+            memset(&parallel->counts[t * parallel->countStride], 0, sizeof(int) * counterCount);
+        }
+    }
+    
+    parallel->world = &world;
+    parallel->phase = phase;
+    parallel->trainCount = world.activeCount;
+    
+    int chunkCount = (world.activeCount + PARALLEL_CHUNK_TRAINS - 1) / PARALLEL_CHUNK_TRAINS;
+    runPersistentPoolJobs(parallel->pool, chunkCount, runTrainChunk, parallel);
+    
+    // Merge in thread order
+    for(int t = 0; t < threads; t++) {
+        for(int part = 0; part < HASH_PART_COUNT; part++) {
+            world.stateHash[part] ^= parallel->hashParts[t * HASH_STRIDE + part];
+        }
+    }
+    
+    if(phase == PHASE_SWITCH_COUNTERS) {
+        int* total = parallel->counts;
+        for(int t = 1; t < threads; t++) {
+            const int* counts = &parallel->counts[t * parallel->countStride];
+            for(int c = 0; c < counterCount; c++) {
+                total[c] += counts[c];
+            }
+        }
+        addSwitchCounts(world, total);
+    }
+    
+    parallel->world = nullptr;
+    return true;
+}
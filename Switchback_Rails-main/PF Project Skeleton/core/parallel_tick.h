@@ -0,0 +1,39 @@
+#ifndef PARALLEL_TICK_H
+#define PARALLEL_TICK_H
+
+// ============================================================================
+// PARALLEL_TICK.H - Multithreaded per-train tick phases
+// ============================================================================
+// After setTickThreads(log, n) with n > 1, runTickPhase() runs the routes,
+// switch counter and move phases on a persistent pool of n threads whenever
+// at least PARALLEL_MIN_TRAINS trains are active. The active list is cut
+// into chunks of PARALLEL_CHUNK_TRAINS that the threads take in order.
+//
+// Within these phases a train only writes its own slots, so the shared
+// results are the state hash and the switch counters. Every thread XORs its
+// hash changes into its own copy of the hash parts and counts switch
+// entries into its own counters; after the phase the partials are merged
+// into the World in thread order. XOR and addition give the same result in
+// any order, so the state, the hash and every log stay bit-identical to the
+// serial engine at any thread count.
+// ============================================================================
+
+#include "world.h"
+#include "io.h"
+
+const int PARALLEL_MIN_TRAINS = 2048;
+const int PARALLEL_CHUNK_TRAINS = 512;
+
+// threadCount < 1 uses every hardware thread; 1 goes back to the serial
+// engine. Call between ticks; shutdownSimulation() stops the threads.
+void setTickThreads(LogContext& log, int threadCount);
+
+int getTickThreads(const LogContext& log);
+
+void stopTickThreads(LogContext& log);
+
+// Runs the phase on the pool and returns true, or returns false (nothing
+// done) when it is not a per-train phase or too few trains are active
+bool runParallelTickPhase(World& world, LogContext& log, int phase);
+
+#endif
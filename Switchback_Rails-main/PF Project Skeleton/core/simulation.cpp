@@ -3,6 +3,10 @@
 #include "trains.h"
 #include "switches.h"
 #include "io.h"
+#include "state_hash.h"
+#include "tick_profiler.h"
+#include "parallel_tick.h"
+#include "time_skip.h"
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
@@ -14,146 +18,253 @@ using namespace std;
 // ============================================================================
 
 // ----------------------------------------------------------------------------
-// Initialize simulation
+// Initialize simulation (false when the log files cannot be created)
 // ----------------------------------------------------------------------------
-void initializeSimulation() {
-    initializeLogFiles();
+bool initializeSimulation(World& world, LogContext& log) {
+    for(int i = 0; i < world.switchCount; i++) {
+        world.loggedSwitchState[i] = -1;
+        world.loggedSignal[i] = -1;
+    }
+    
+    // Covers anything set since loading (sweep overrides, restored snapshots)
+    resetStateHash(world);
+    
+    return initializeLogFiles(log, world);
 }
 
 // ----------------------------------------------------------------------------
-// Simulate one tick
+// Shutdown simulation (stops the tick threads, flushes and closes log files)
 // ----------------------------------------------------------------------------
-void simulateOneTick(int& currentTick,
-                    int trainCount, int trainX[], int trainY[], int trainDir[],
-                    int trainNextX[], int trainNextY[], int trainNextDir[],
-                    int trainPrevX[], int trainPrevY[],
-                    int trainDestX[], int trainDestY[],
-                    int trainSpawnTick[], int trainColor[],
-                    bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-                    int trainWaitTicks[], int trainTotalWaitTicks[],
-                    char grid[][100], int gridRows, int gridCols,
-                    bool switchExists[], int switchState[], bool switchMode[],
-                    int switchCounters[][4], int switchKValues[][4],
-                    bool switchFlipQueued[], int switchSignal[],
-                    char switchStateNames[][2][32],
-                    int& trainsDelivered, int& trainsCrashed, int& totalSwitchFlips) {
-    
-    currentTick++;
-    
-    spawnTrainsForTick(currentTick, trainCount, trainSpawnTick, trainX, trainY,
-                      trainActive, grid);
-    
-    determineAllRoutes(trainCount, trainX, trainY, trainDir,
-                      trainNextX, trainNextY, trainNextDir,
-                      trainActive, trainCrashed,
-                      trainDestX, trainDestY,
-                      grid, gridCols, gridRows,
-                      switchExists, switchState);
-    
-    updateSwitchCounters(trainCount, trainX, trainY, trainPrevX, trainPrevY,
-                        trainActive, trainCrashed, trainDir, grid,
-                        switchExists, switchMode, switchCounters);
-    
-    queueSwitchFlips(switchExists, switchMode, switchCounters,
-                    switchKValues, switchFlipQueued);
-    
-    detectCollisions(trainCount, trainX, trainY, trainNextX, trainNextY, trainNextDir,
-                    trainDir, trainDestX, trainDestY,
-                    trainActive, trainCrashed, trainDelivered);
-    
-    for(int i = 0; i < trainCount; i++) {
-        if(trainCrashed[i] && trainActive[i]) {
-            trainsCrashed++;
-            trainActive[i] = false;
-        }
+void shutdownSimulation(LogContext& log) {
+    stopTickThreads(log);
+    closeLogFiles(log);
+}
+
+// ----------------------------------------------------------------------------
+// Delta logging: only switches that flipped and signals that changed colour,
+// plus every switch and signal on keyframe ticks
+// ----------------------------------------------------------------------------
+void logSwitchAndSignalChanges(World& world, LogContext& log) {
+    
+    bool keyframe = isKeyframeTick(log, world.currentTick);
+    const char* signalStr[] = {"GREEN", "YELLOW", "RED"};
+    
+    for(int i = 0; i < world.switchCount; i++) {
+        int state = world.switchState[i];
+        if(!keyframe && world.loggedSwitchState[i] == state) continue;
+        
+        const char* mode = world.switchMode[i] ? "PER_DIR" : "GLOBAL";
+        logSwitchDelta(log, world.currentTick, i, getSwitchName(world, i), mode,
+                       getSwitchStateName(world, i, state), keyframe);
+        world.loggedSwitchState[i] = state;
     }
     
-    for(int i = 0; i < trainCount; i++) {
-        trainPrevX[i] = trainX[i];
-        trainPrevY[i] = trainY[i];
+    for(int i = 0; i < world.switchCount; i++) {
+        if(!keyframe && world.loggedSignal[i] == world.switchSignal[i]) continue;
+        
+        logSignalDelta(log, world.currentTick, i, getSwitchName(world, i),
+                       signalStr[world.switchSignal[i]], keyframe);
+        world.loggedSignal[i] = world.switchSignal[i];
     }
+}
+
+// ----------------------------------------------------------------------------
+// Log one tick (hashes.csv and the per-tick traces)
+// ----------------------------------------------------------------------------
+static void logTick(World& world, LogContext& log) {
     
-    moveAllTrains(trainCount, trainX, trainY, trainDir,
-                 trainNextX, trainNextY, trainNextDir,
-                 trainActive, trainCrashed, trainDelivered,
-                 trainWaitTicks, grid);
+    logStateHash(log, world.currentTick, world.stateHash);
     
-    applyDeferredFlips(switchExists, switchState, switchFlipQueued,
-                      switchCounters, totalSwitchFlips);
+    if(getLogLevel(log) < LOG_FULL) {
+        return;
+    }
     
-    checkArrivals(trainCount, trainX, trainY, trainDestX, trainDestY,
-                 trainActive, trainDelivered, trainsDelivered);
+    // Trace rows stay in train id order
+    int logCount = getActiveTrainsInIdOrder(world);
+    for(int a = 0; a < logCount; a++) {
+        int i = world.trainOrder[a];
+        const char* state = "MOVING";
+        if(world.trainDelivered[i]) state = "DELIVERED";
+        if(world.trainCrashed[i]) state = "CRASHED";
+        
+        logTrainTrace(log, world.currentTick, i, world.trainX[i], world.trainY[i],
+                      world.trainDir[i], state);
+    }
     
-    updateSignalLights(switchExists, switchState, switchSignal,
-                      grid, gridRows, gridCols,
-                      trainCount, trainX, trainY, trainActive);
+    if(isDeltaLogging(log)) {
+        logSwitchAndSignalChanges(world, log);
+        return;
+    }
     
-    for(int i = 0; i < trainCount; i++) {
-        if(trainActive[i]) {
-            const char* state = "MOVING";
-            if(trainDelivered[i]) state = "DELIVERED";
-            if(trainCrashed[i]) state = "CRASHED";
-            
-            logTrainTrace(currentTick, i, trainX[i], trainY[i], trainDir[i], state);
-        }
+    for(int i = 0; i < world.switchCount; i++) {
+        const char* mode = world.switchMode[i] ? "PER_DIR" : "GLOBAL";
+        const char* stateName = getSwitchStateName(world, i, world.switchState[i]);
+        
+        logSwitchState(log, world.currentTick, i, getSwitchName(world, i), mode, stateName);
     }
     
-    for(int i = 0; i < 26; i++) {
-        if(switchExists[i]) {
-            char letter = 'A' + i;
-            const char* mode = switchMode[i] ? "PER_DIR" : "GLOBAL";
-            const char* stateName = switchStateNames[i][switchState[i]];
-            
-            logSwitchState(currentTick, letter, mode, stateName);
+    for(int i = 0; i < world.switchCount; i++) {
+        const char* signalStr[] = {"GREEN", "YELLOW", "RED"};
+        
+        logSignalState(log, world.currentTick, i, getSwitchName(world, i),
+                       signalStr[world.switchSignal[i]]);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Record where every train is before it moves
+// ----------------------------------------------------------------------------
+// The first tick records every train, waiting ones included, so a train
+// that spawns later starts with its spawn cell as previous position.
+// Waiting trains never move, so after that only active trains need it.
+static void updatePreviousPositions(World& world) {
+    if(!world.prevPrimed) {
+        for(int i = 0; i < world.trainCount; i++) {
+            world.trainPrevX[i] = world.trainX[i];
+            world.trainPrevY[i] = world.trainY[i];
         }
+        world.prevPrimed = true;
     }
-    
-    for(int i = 0; i < 26; i++) {
-        if(switchExists[i]) {
-            char letter = 'A' + i;
-            const char* signalStr[] = {"GREEN", "YELLOW", "RED"};
-            
-            logSignalState(currentTick, letter, signalStr[switchSignal[i]]);
+    else {
+        for(int a = 0; a < world.activeCount; a++) {
+            int i = world.activeList[a];
+            world.trainPrevX[i] = world.trainX[i];
+            world.trainPrevY[i] = world.trainY[i];
         }
     }
+}
+
+// ----------------------------------------------------------------------------
+// Run one phase of a tick
+// ----------------------------------------------------------------------------
+void runTickPhase(World& world, LogContext& log, int phase) {
+    if(runParallelTickPhase(world, log, phase)) {
+        return;
+    }
     
-    printGridToTerminal(grid, gridRows, gridCols, trainCount,
-                       trainX, trainY, trainDir, trainActive, trainCrashed, currentTick);
+    switch(phase) {
+        case PHASE_SPAWN:
+            updateStateHash(world, HASH_CLOCK, 0, world.currentTick, world.currentTick + 1);
+            world.currentTick++;
+            spawnTrainsForTick(world, world.currentTick);
+            if(isRegionGroupingEnabled() && world.currentTick % REGION_REGROUP_TICKS == 0) {
+                groupActiveTrainsByRegion(world);
+            }
+            break;
+        case PHASE_ROUTES:
+            determineAllRoutes(world);
+            break;
+        case PHASE_SWITCH_COUNTERS:
+            updateSwitchCounters(world);
+            break;
+        case PHASE_QUEUE_FLIPS:
+            queueSwitchFlips(world);
+            break;
+        case PHASE_COLLISIONS:
+            detectCollisions(world);
+            world.trainsCrashed += removeCrashedTrains(world);
+            break;
+        case PHASE_MOVE:
+            updatePreviousPositions(world);
+            moveAllTrains(world);
+            break;
+        case PHASE_DEFERRED_FLIPS:
+            applyDeferredFlips(world);
+            break;
+        case PHASE_ARRIVALS:
+            checkArrivals(world);
+            break;
+        case PHASE_SIGNALS:
+            updateSignalLights(world);
+            break;
+        case PHASE_LOGGING:
+            logTick(world, log);
+            break;
+    }
+}
+
+const char* getTickPhaseName(int phase) {
+    const char* names[TICK_PHASE_COUNT] = {
+        "spawn", "routes", "switch_counters", "queue_flips", "collisions",
+        "move", "deferred_flips", "arrivals", "signals", "logging"
+    };
+    if(phase < 0 || phase >= TICK_PHASE_COUNT) {
+        return "?";
+    }
+    return names[phase];
 }
 
 // ----------------------------------------------------------------------------
-// Check if simulation complete
+// Simulate one tick
+// ----------------------------------------------------------------------------
+void simulateOneTick(World& world, LogContext& log) {
+    TICK_PROFILE_START(log);
+    for(int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+        runTickPhase(world, log, phase);
+        TICK_PROFILE_PHASE(log, phase);
+    }
+    TICK_PROFILE_END(log);
+}
+
+// ----------------------------------------------------------------------------
+// Run until every train is done or maxTicks is reached
 // ----------------------------------------------------------------------------
-bool isSimulationComplete(int trainCount, bool trainActive[],
-                         bool trainDelivered[], bool trainCrashed[]) {
+// A world restored from a snapshot continues from its tick; tick 0 spawns
+// only happen on a fresh run. With time skipping on, quiet stretches are
+// advanced in one step (time_skip.h).
+void runSimulation(World& world, LogContext& log, int maxTicks) {
     
-    for(int i = 0; i < trainCount; i++) {
-        if(trainActive[i] && !trainDelivered[i] && !trainCrashed[i]) {
-            return false;
-        }
+    if(world.currentTick == 0) {
+        spawnTrainsForTick(world, 0);
     }
     
-    return true;
+    while(world.currentTick < maxTicks) {
+        if(isTimeSkipEnabled(log) && skipQuietTicks(world, log, maxTicks) > 0) {
+            continue;
+        }
+        simulateOneTick(world, log);
+        
+        if(isSimulationComplete(world)) {
+            break;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Sum of wait ticks over every train
+// ----------------------------------------------------------------------------
+int getTotalWaitTicks(const World& world) {
+    int totalWait = 0;
+    for(int i = 0; i < world.trainCount; i++) {
+        totalWait += world.trainTotalWaitTicks[i];
+    }
+    return totalWait;
+}
+
+// ----------------------------------------------------------------------------
+// Check if simulation complete
+// ----------------------------------------------------------------------------
+// Every train has spawned and none is left on the track. Crashed and
+// delivered trains leave the active list within the tick, so this is O(1).
+bool isSimulationComplete(const World& world) {
+    return areAllTrainsSpawned(world) && world.activeCount == 0;
 }
 
 // ----------------------------------------------------------------------------
 // Print grid to terminal
 // ----------------------------------------------------------------------------
-void printGridToTerminal(char grid[][100], int gridRows, int gridCols,
-                        int trainCount, int trainX[], int trainY[], int trainDir[],
-                        bool trainActive[], bool trainCrashed[],
-                        int currentTick) {
+void printGridToTerminal(const World& world) {
     
-    cout << "\n========== TICK " << currentTick << " ==========\n";
+    cout << "\n========== TICK " << world.currentTick << " ==========\n";
     
-    for(int y = 0; y < gridRows; y++) {
-        for(int x = 0; x < gridCols; x++) {
+    for(int y = 0; y < world.gridRows; y++) {
+        for(int x = 0; x < world.gridCols; x++) {
             bool trainHere = false;
             int trainId = -1;
             
-            for(int i = 0; i < trainCount; i++) {
-                if(trainActive[i] && !trainCrashed[i] && 
-                   trainX[i] == x && trainY[i] == y) {
+            for(int i = 0; i < world.trainCount; i++) {
+                if(world.trainActive[i] && !world.trainCrashed[i] && 
+                   world.trainX[i] == x && world.trainY[i] == y) {
                     trainHere = true;
                     trainId = i;
                     break;
@@ -164,23 +275,22 @@ void printGridToTerminal(char grid[][100], int gridRows, int gridCols,
                 cout << (trainId % 10);
             } 
             else {
-                cout << grid[y][x];
+                cout << getTile(world, x, y);
             }
         }
         cout << "\n";
     }
     
     cout << "\nTrain Status:\n";
-    for(int i = 0; i < trainCount; i++) {
-        if(trainActive[i]) {
+    for(int i = 0; i < world.trainCount; i++) {
+        if(world.trainActive[i]) {
             const char* dirStr[] = {"UP", "RIGHT", "DOWN", "LEFT"};
-            cout << "Train " << i << " at (" << trainX[i] << "," << trainY[i] 
-                 << ") moving " << dirStr[trainDir[i]];
+            cout << "Train " << i << " at (" << world.trainX[i] << "," << world.trainY[i] 
+                 << ") moving " << dirStr[world.trainDir[i]];
             
-            if(trainCrashed[i]) cout << " [CRASHED]";
+            if(world.trainCrashed[i]) cout << " [CRASHED]";
             cout << "\n";
         }
     }
     cout << endl;
 }
-
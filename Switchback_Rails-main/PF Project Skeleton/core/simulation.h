@@ -5,42 +5,65 @@
 // SIMULATION.H - Simulation tick logic
 // ============================================================================
 
+#include "world.h"
+#include "io.h"
+
 // ----------------------------------------------------------------------------
 // MAIN SIMULATION FUNCTION
 // ----------------------------------------------------------------------------
-void simulateOneTick(int& currentTick,
-                    int trainCount, int trainX[], int trainY[], int trainDir[],
-                    int trainNextX[], int trainNextY[], int trainNextDir[],
-                    int trainPrevX[], int trainPrevY[],
-                    int trainDestX[], int trainDestY[],
-                    int trainSpawnTick[], int trainColor[],
-                    bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-                    int trainWaitTicks[], int trainTotalWaitTicks[],
-                    char grid[][100], int gridRows, int gridCols,
-                    bool switchExists[], int switchState[], bool switchMode[],
-                    int switchCounters[][4], int switchKValues[][4],
-                    bool switchFlipQueued[], int switchSignal[],
-                    char switchStateNames[][2][32],
-                    int& trainsDelivered, int& trainsCrashed, int& totalSwitchFlips);
+// Runs every tick phase below in order
+void simulateOneTick(World& world, LogContext& log);
+
+// ----------------------------------------------------------------------------
+// TICK PHASES
+// ----------------------------------------------------------------------------
+const int PHASE_SPAWN = 0;              // advance the clock, spawn due trains
+const int PHASE_ROUTES = 1;
+const int PHASE_SWITCH_COUNTERS = 2;
+const int PHASE_QUEUE_FLIPS = 3;
+const int PHASE_COLLISIONS = 4;         // detect, then remove crashed trains
+const int PHASE_MOVE = 5;               // record previous positions, then move
+const int PHASE_DEFERRED_FLIPS = 6;
+const int PHASE_ARRIVALS = 7;
+const int PHASE_SIGNALS = 8;
+const int PHASE_LOGGING = 9;            // hashes.csv and the traces
+const int TICK_PHASE_COUNT = 10;
+
+// One phase on its own; running all of them in order is one tick
+void runTickPhase(World& world, LogContext& log, int phase);
+
+// Short name ("routes", "move", ...)
+const char* getTickPhaseName(int phase);
+
+// Spawns tick 0 (fresh runs only) and ticks until the simulation completes
+// or maxTicks is hit
+void runSimulation(World& world, LogContext& log, int maxTicks);
+
+// ----------------------------------------------------------------------------
+// DELTA LOGGING
+// ----------------------------------------------------------------------------
+void logSwitchAndSignalChanges(World& world, LogContext& log);
 
 // ----------------------------------------------------------------------------
 // INITIALIZATION
 // ----------------------------------------------------------------------------
-void initializeSimulation();
+// False when the log files cannot be created; the run should not start
+bool initializeSimulation(World& world, LogContext& log);
+
+void shutdownSimulation(LogContext& log);
 
 // ----------------------------------------------------------------------------
 // UTILITY
 // ----------------------------------------------------------------------------
-bool isSimulationComplete(int trainCount, bool trainActive[],
-                         bool trainDelivered[], bool trainCrashed[]);
+// True once every train has spawned and left the track
+bool isSimulationComplete(const World& world);
+
+int getTotalWaitTicks(const World& world);
 
 // ----------------------------------------------------------------------------
 // TERMINAL OUTPUT
 // ----------------------------------------------------------------------------
-void printGridToTerminal(char grid[][100], int gridRows, int gridCols,
-                        int trainCount, int trainX[], int trainY[], int trainDir[],
-                        bool trainActive[], bool trainCrashed[],
-                        int currentTick);
+void printGridToTerminal(const World& world);
 
 #endif
 
@@ -5,83 +5,71 @@
 // SIMULATION_STATE.CPP 
 // ============================================================================
 
-void initializeSimulationState(
-    int& gridRows, int& gridCols, char grid[][100], char levelName[],
-    int& trainCount, int trainX[], int trainY[], int trainDir[],
-    int trainNextX[], int trainNextY[], int trainNextDir[],
-    int trainPrevX[], int trainPrevY[],
-    int trainDestX[], int trainDestY[], int trainSpawnTick[], int trainColor[],
-    bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-    int trainWaitTicks[], int trainTotalWaitTicks[],
-    bool switchExists[], int switchState[], bool switchMode[],
-    int switchCounters[][4], int switchKValues[][4], bool switchFlipQueued[],
-    int switchSignal[], char switchStateNames[][2][32],
-    int& spawnCount, int spawnX[], int spawnY[],
-    int& destCount, int destX[], int destY[],
-    int& currentTick, int& seed, int& weatherMode,
-    int& trainsDelivered, int& trainsCrashed, int& totalSwitchFlips, int& signalViolations
-) {
-    gridRows = 0;
-    gridCols = 0;
-    for(int i = 0; i < 50; i++) {
-        for(int j = 0; j < 100; j++) {
-            grid[i][j] = ' ';
-        }
+void initializeSimulationState(World& world) {
+    long long cells = (long long)world.gridRows * world.gridCols;
+    if(world.grid != nullptr) {
+        memset(world.grid, ' ', cells);
     }
-    levelName[0] = '\0';
+    world.levelName[0] = '\0';
     
-    trainCount = 0;
-    for(int i = 0; i < 100; i++) {
-        trainX[i] = 0;
-        trainY[i] = 0;
-        trainDir[i] = 0;
-        trainNextX[i] = 0;
-        trainNextY[i] = 0;
-        trainNextDir[i] = 0;
-        trainDestX[i] = 0;
-        trainDestY[i] = 0;
-        trainSpawnTick[i] = 0;
-        trainColor[i] = 0;
-        trainActive[i] = false;
-        trainCrashed[i] = false;
-        trainDelivered[i] = false;
-        trainWaitTicks[i] = 0;
-        trainTotalWaitTicks[i] = 0;
-        trainPrevX[i] = -1;
-        trainPrevY[i] = -1;
+    world.trainCount = 0;
+    for(int i = 0; i < world.trainCapacity; i++) {
+        world.trainX[i] = 0;
+        world.trainY[i] = 0;
+        world.trainDir[i] = 0;
+        world.trainNextX[i] = 0;
+        world.trainNextY[i] = 0;
+        world.trainNextDir[i] = 0;
+        world.trainDestX[i] = 0;
+        world.trainDestY[i] = 0;
+        world.trainDestField[i] = -1;
+        world.trainSpawnTick[i] = 0;
+        world.trainColor[i] = 0;
+        world.trainActive[i] = false;
+        world.trainCrashed[i] = false;
+        world.trainDelivered[i] = false;
+        world.trainWaitTicks[i] = 0;
+        world.trainTotalWaitTicks[i] = 0;
+        world.trainPrevX[i] = -1;
+        world.trainPrevY[i] = -1;
+        world.spawnOrder[i] = i;
+        world.activeSlot[i] = -1;
     }
+    world.spawnCursor = 0;
+    world.activeCount = 0;
+    world.retiredCount = 0;
+    world.prevPrimed = false;
     
+    world.switchCount = 0;
     for(int i = 0; i < 26; i++) {
-        switchExists[i] = false;
-        switchState[i] = 0;
-        switchMode[i] = true;
-        switchFlipQueued[i] = false;
-        switchSignal[i] = 0;
+        world.switchByLetter[i] = -1;
+    }
+    for(int i = 0; i < world.switchCapacity; i++) {
+        world.switchNames[i * SWITCH_NAME_LEN] = '\0';
+        world.switchState[i] = 0;
+        world.switchMode[i] = true;
+        world.switchFlipQueued[i] = false;
+        world.switchSignal[i] = 0;
         for(int j = 0; j < 4; j++) {
-            switchCounters[i][j] = 0;
-            switchKValues[i][j] = 0;
+            world.switchCounters[i * 4 + j] = 0;
+            world.switchKValues[i * 4 + j] = 0;
         }
         for(int j = 0; j < 2; j++) {
-            switchStateNames[i][j][0] = '\0';
+            getSwitchStateName(world, i, j)[0] = '\0';
         }
+        world.loggedSwitchState[i] = -1;
+        world.loggedSignal[i] = -1;
     }
     
-    spawnCount = 0;
-    destCount = 0;
-    for(int i = 0; i < 50; i++) {
-        spawnX[i] = 0;
-        spawnY[i] = 0;
-        destX[i] = 0;
-        destY[i] = 0;
-    }
+    world.spawnCount = 0;
+    world.destCount = 0;
     
-    currentTick = 0;
-    seed = 0;
-    weatherMode = 0;
+    world.currentTick = 0;
+    world.seed = 0;
+    world.weatherMode = 0;
     
-    trainsDelivered = 0;
-    trainsCrashed = 0;
-    totalSwitchFlips = 0;
-    signalViolations = 0;
+    world.trainsDelivered = 0;
+    world.trainsCrashed = 0;
+    world.totalSwitchFlips = 0;
+    world.signalViolations = 0;
 }
-
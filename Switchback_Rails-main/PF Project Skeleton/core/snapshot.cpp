@@ -0,0 +1,210 @@
+#include "snapshot.h"
+#include "state_hash.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// ============================================================================
+// SNAPSHOT.CPP - Full-state snapshots
+// ============================================================================
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'B', 'S', 'N', 'A', 'P', '0', '1'};
+const int SNAPSHOT_HEADER_SIZE = 128;
+
+// Sizes identify the layout of the state block; the rest are the scalars
+// that change while ticking
+struct SnapshotHeader {
+    char magic[8];
+    long long stateBytes;
+    int gridRows;
+    int gridCols;
+    int trainCapacity;
+    int switchCapacity;
+    int spawnCapacity;
+    int destCapacity;
+    int trainCount;
+    int switchCount;
+    
+    int currentTick;
+    int trainsDelivered;
+    int trainsCrashed;
+    int totalSwitchFlips;
+    int signalViolations;
+    int spawnCursor;
+    int activeCount;
+    int retiredCount;
+    int signalDirtyCount;
+    int prevPrimed;
+    int signalsPrimed;
+};
+
+// ----------------------------------------------------------------------------
+// Size of a snapshot
+// ----------------------------------------------------------------------------
+long long getSnapshotSize(const World& world) {
+    return SNAPSHOT_HEADER_SIZE + world.stateBytes;
+}
+
+// ----------------------------------------------------------------------------
+// Take a snapshot
+// ----------------------------------------------------------------------------
+void snapshotWorld(const World& world, unsigned char snapshot[]) {
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.stateBytes = world.stateBytes;
+    header.gridRows = world.gridRows;
+    header.gridCols = world.gridCols;
+    header.trainCapacity = world.trainCapacity;
+    header.switchCapacity = world.switchCapacity;
+    header.spawnCapacity = world.spawnCapacity;
+    header.destCapacity = world.destCapacity;
+    header.trainCount = world.trainCount;
+    header.switchCount = world.switchCount;
+    
+    header.currentTick = world.currentTick;
+    header.trainsDelivered = world.trainsDelivered;
+    header.trainsCrashed = world.trainsCrashed;
+    header.totalSwitchFlips = world.totalSwitchFlips;
+    header.signalViolations = world.signalViolations;
+    header.spawnCursor = world.spawnCursor;
+    header.activeCount = world.activeCount;
+    header.retiredCount = world.retiredCount;
+    header.signalDirtyCount = world.signalDirtyCount;
+    header.prevPrimed = world.prevPrimed ? 1 : 0;
+    header.signalsPrimed = world.signalsPrimed ? 1 : 0;
+    
+    memset(snapshot, 0, SNAPSHOT_HEADER_SIZE);
+    memcpy(snapshot, &header, sizeof(header));
+    memcpy(snapshot + SNAPSHOT_HEADER_SIZE, world.memory, world.stateBytes);
+}
+
+// ----------------------------------------------------------------------------
+// Restore a snapshot
+// ----------------------------------------------------------------------------
+// The collision hash tables are scratch and keep their stamps, so
+// collisionStamp is left running forward rather than restored.
+bool restoreWorld(World& world, const unsigned char snapshot[]) {
+    SnapshotHeader header;
+    memcpy(&header, snapshot, sizeof(header));
+    
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, 8) != 0 ||
+       header.stateBytes != world.stateBytes ||
+       header.gridRows != world.gridRows || header.gridCols != world.gridCols ||
+       header.trainCapacity != world.trainCapacity ||
+       header.switchCapacity != world.switchCapacity ||
+       header.spawnCapacity != world.spawnCapacity ||
+       header.destCapacity != world.destCapacity ||
+       header.trainCount != world.trainCount || header.switchCount != world.switchCount) {
+        return false;
+    }
+    
+    memcpy(world.memory, snapshot + SNAPSHOT_HEADER_SIZE, world.stateBytes);
+    
+    world.currentTick = header.currentTick;
+    world.trainsDelivered = header.trainsDelivered;
+    world.trainsCrashed = header.trainsCrashed;
+    world.totalSwitchFlips = header.totalSwitchFlips;
+    world.signalViolations = header.signalViolations;
+    world.spawnCursor = header.spawnCursor;
+    world.activeCount = header.activeCount;
+    world.retiredCount = header.retiredCount;
+    world.signalDirtyCount = header.signalDirtyCount;
+    world.prevPrimed = (header.prevPrimed != 0);
+    world.signalsPrimed = (header.signalsPrimed != 0);
+    resetStateHash(world);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write a snapshot file
+// ----------------------------------------------------------------------------
+bool saveSnapshotFile(const World& world, const char* path) {
+    long long size = getSnapshotSize(world);
+    unsigned char* snapshot = new unsigned char[size];
+    snapshotWorld(world, snapshot);
+    
+    char tempPath[512];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    
+    FILE* file = fopen(tempPath, "wb");
+    bool ok = (file != nullptr);
+    if(ok) {
+        ok = (fwrite(snapshot, 1, size, file) == (size_t)size);
+        ok = (fclose(file) == 0) && ok;
+    }
+    delete[] snapshot;
+    
+    return ok && rename(tempPath, path) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// Read a snapshot file into a world loaded from the same level
+// ----------------------------------------------------------------------------
+bool loadSnapshotFile(World& world, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if(file == nullptr) {
+        return false;
+    }
+    
+    long long size = getSnapshotSize(world);
+    unsigned char* snapshot = new unsigned char[size];
+    bool ok = (fread(snapshot, 1, size, file) == (size_t)size) && fgetc(file) == EOF;
+    fclose(file);
+    
+    ok = ok && restoreWorld(world, snapshot);
+    delete[] snapshot;
+    return ok;
+}
+
+// ----------------------------------------------------------------------------
+// State hash
+// ----------------------------------------------------------------------------
+// FNV-1a over 8-byte words (the tail is zero-padded)
+unsigned long long hashBytes(unsigned long long hash, const void* data, long long size) {
+    const unsigned long long FNV_PRIME = 1099511628211ULL;
+    const unsigned char* bytes = (const unsigned char*)data;
+    
+    long long offset = 0;
+    for(; offset + 8 <= size; offset += 8) {
+        unsigned long long word;
+        memcpy(&word, bytes + offset, 8);
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    if(offset < size) {
+        unsigned long long word = 0;
+        memcpy(&word, bytes + offset, size - offset);
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    return hash;
+}
+
+unsigned long long hashWorldState(const World& world) {
+    int counters[7] = {
+        world.currentTick, world.trainsDelivered, world.trainsCrashed,
+        world.totalSwitchFlips, world.signalViolations, world.spawnCursor,
+        world.activeCount
+    };
+    int trains = world.trainCount;
+    int switches = world.switchCount;
+    
+    unsigned long long hash = FNV_OFFSET_BASIS;
+    hash = hashBytes(hash, counters, sizeof(counters));
+    hash = hashBytes(hash, world.grid, (long long)world.gridRows * world.gridCols);
+    
+    hash = hashBytes(hash, world.trainX, trains * sizeof(int));
+    hash = hashBytes(hash, world.trainY, trains * sizeof(int));
+    hash = hashBytes(hash, world.trainDir, trains * sizeof(int));
+    hash = hashBytes(hash, world.trainActive, trains * sizeof(bool));
+    hash = hashBytes(hash, world.trainCrashed, trains * sizeof(bool));
+    hash = hashBytes(hash, world.trainDelivered, trains * sizeof(bool));
+    hash = hashBytes(hash, world.trainWaitTicks, trains * sizeof(int));
+    hash = hashBytes(hash, world.trainTotalWaitTicks, trains * sizeof(int));
+    
+    hash = hashBytes(hash, world.switchState, switches * sizeof(int));
+    hash = hashBytes(hash, world.switchCounters, switches * 4 * sizeof(int));
+    hash = hashBytes(hash, world.switchFlipQueued, switches * sizeof(bool));
+    hash = hashBytes(hash, world.switchSignal, switches * sizeof(int));
+    return hash;
+}
@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// ============================================================================
+// SNAPSHOT.H - Full-state snapshots (checkpoints)
+// ============================================================================
+// Every array that changes while ticking sits at the front of the World's
+// single allocation (the state block): train positions and flags, the
+// active list, switch states, counters and the flip queue, signals, the
+// grid (safety tiles) and the delta log bookkeeping. A snapshot is a small header with the tick counters
+// followed by a byte copy of that block, so taking or restoring one is a
+// single memcpy. It holds no pointers and can be written to disk.
+//
+// A snapshot restores into any World loaded from the same level (same
+// sizes). Level data (names, K-values, spawn ticks) is not part of it, and
+// neither are the transition table and distance fields: loading the level
+// builds them, and no change a snapshot can undo (safety toggles only turn
+// one straight tile into another) ever alters them.
+// ============================================================================
+
+#include "world.h"
+
+// Size in bytes of a snapshot of this world
+long long getSnapshotSize(const World& world);
+
+// snapshot must hold getSnapshotSize(world) bytes
+void snapshotWorld(const World& world, unsigned char snapshot[]);
+
+// False (world unchanged) when the snapshot was taken from a different layout
+bool restoreWorld(World& world, const unsigned char snapshot[]);
+
+// ----------------------------------------------------------------------------
+// FILES
+// ----------------------------------------------------------------------------
+// Written to "<path>.tmp" and renamed, so a crash never leaves half a file
+bool saveSnapshotFile(const World& world, const char* path);
+
+bool loadSnapshotFile(World& world, const char* path);
+
+// ----------------------------------------------------------------------------
+// STATE HASH
+// ----------------------------------------------------------------------------
+// 64-bit hash of what a run can observe: the tick counters, the grid, every
+// train's position, direction, flags and waits, and every switch's state,
+// counters, queued flip and signal. Routing tables and log bookkeeping are
+// left out, so runs with different log settings hash the same.
+unsigned long long hashWorldState(const World& world);
+
+// FNV-1a over 8-byte words, continuing from hash (start from FNV_OFFSET_BASIS)
+const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+unsigned long long hashBytes(unsigned long long hash, const void* data, long long size);
+
+#endif
@@ -0,0 +1,82 @@
+#include "state_hash.h"
+
+using namespace std;
+
+// ============================================================================
+// STATE_HASH.CPP - Zobrist keys and the full hash
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Keys
+// ----------------------------------------------------------------------------
+// Keys come from a mixing function instead of a table, so values of any
+// range (counters, cells of any grid size) have a key without any memory.
+static unsigned long long mixBits(unsigned long long x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+unsigned long long getZobristKey(int part, int index, int value) {
+    unsigned long long slot = ((unsigned long long)part << 32) | (unsigned)index;
+    return mixBits(mixBits(slot) ^ (unsigned)value);
+}
+
+// ----------------------------------------------------------------------------
+// Full hash
+// ----------------------------------------------------------------------------
+void computeStateHash(const World& world, unsigned long long parts[]) {
+    for(int part = 0; part < HASH_PART_COUNT; part++) {
+        parts[part] = 0;
+    }
+    
+    parts[HASH_CLOCK] ^= getZobristKey(HASH_CLOCK, 0, world.currentTick);
+    
+    for(int i = 0; i < world.trainCount; i++) {
+        int cell = world.trainY[i] * world.gridCols + world.trainX[i];
+        parts[HASH_TRAIN_POSITION] ^= getZobristKey(HASH_TRAIN_POSITION, i, cell);
+        parts[HASH_TRAIN_DIRECTION] ^= getZobristKey(HASH_TRAIN_DIRECTION, i, world.trainDir[i]);
+        parts[HASH_TRAIN_FLAGS] ^= getZobristKey(HASH_TRAIN_FLAGS, i, getTrainFlags(world, i));
+    }
+    
+    for(int id = 0; id < world.switchCount; id++) {
+        parts[HASH_SWITCH_STATE] ^= getZobristKey(HASH_SWITCH_STATE, id, world.switchState[id]);
+        for(int dir = 0; dir < 4; dir++) {
+            parts[HASH_SWITCH_COUNTER] ^= getZobristKey(HASH_SWITCH_COUNTER, id * 4 + dir,
+                                                        world.switchCounters[id * 4 + dir]);
+        }
+    }
+    
+    int cells = world.gridRows * world.gridCols;
+    for(int cell = 0; cell < cells; cell++) {
+        parts[HASH_SAFETY_TILE] ^= getZobristKey(HASH_SAFETY_TILE, cell,
+                                                 getSafetyTileValue(world.grid[cell]));
+    }
+}
+
+void resetStateHash(World& world) {
+    computeStateHash(world, world.stateHash);
+}
+
+unsigned long long getStateHash(const World& world) {
+    unsigned long long hash = 0;
+    for(int part = 0; part < HASH_PART_COUNT; part++) {
+        hash ^= world.stateHash[part];
+    }
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+// Part names
+// ----------------------------------------------------------------------------
+const char* getStateHashPartName(int part) {
+    const char* names[HASH_PART_COUNT] = {
+        "Clock", "TrainPosition", "TrainDirection", "TrainFlags",
+        "SwitchState", "SwitchCounter", "SafetyTile"
+    };
+    if(part < 0 || part >= HASH_PART_COUNT) {
+        return "?";
+    }
+    return names[part];
+}
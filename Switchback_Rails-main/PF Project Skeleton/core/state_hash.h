@@ -0,0 +1,77 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+// ============================================================================
+// STATE_HASH.H - Incremental Zobrist hash of the simulation state
+// ============================================================================
+// Every (field, index, value) triple has a fixed pseudo-random 64-bit key,
+// and the hash of a state is the XOR of the keys of all its values. When a
+// value changes, the old key is XORed out and the new one in, so the tick
+// phases keep world.stateHash current at the cost of their own writes.
+//
+// The hash is split into parts, one per kind of field, so a mismatch can be
+// narrowed down to (say) train positions without looking at the state.
+// The full hash is the XOR of the parts.
+// ============================================================================
+
+#include "world.h"
+
+const int HASH_CLOCK = 0;               // currentTick
+const int HASH_TRAIN_POSITION = 1;      // cell of each train
+const int HASH_TRAIN_DIRECTION = 2;
+const int HASH_TRAIN_FLAGS = 3;         // active, crashed, delivered
+const int HASH_SWITCH_STATE = 4;
+const int HASH_SWITCH_COUNTER = 5;      // 4 per switch
+const int HASH_SAFETY_TILE = 6;         // '-', '|' and '=' cells
+
+// ----------------------------------------------------------------------------
+// KEYS AND UPDATES
+// ----------------------------------------------------------------------------
+unsigned long long getZobristKey(int part, int index, int value);
+
+// Into a set of HASH_PART_COUNT parts other than world.stateHash (the
+// partial hash of one thread of the parallel tick, XORed in afterwards)
+inline void updateStateHashParts(unsigned long long parts[], int part, int index,
+                                 int oldValue, int newValue) {
+    if(oldValue != newValue) {
+        parts[part] ^= getZobristKey(part, index, oldValue) ^ getZobristKey(part, index, newValue);
+    }
+}
+
+inline void updateStateHash(World& world, int part, int index, int oldValue, int newValue) {
+    updateStateHashParts(world.stateHash, part, index, oldValue, newValue);
+}
+
+inline int getTrainFlags(const World& world, int trainId) {
+    return (world.trainActive[trainId] ? 1 : 0) | (world.trainCrashed[trainId] ? 2 : 0) |
+           (world.trainDelivered[trainId] ? 4 : 0);
+}
+
+// Call after changing any of the train's flags
+inline void rehashTrainFlags(World& world, int trainId, int oldFlags) {
+    updateStateHash(world, HASH_TRAIN_FLAGS, trainId, oldFlags, getTrainFlags(world, trainId));
+}
+
+// Value a cell adds to HASH_SAFETY_TILE. Safety toggles cycle a cell
+// through '|', '=' and '-', so each of the three has its own value.
+inline int getSafetyTileValue(char tile) {
+    if(tile == '=') return 1;
+    if(tile == '|') return 2;
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// FULL HASH
+// ----------------------------------------------------------------------------
+// From scratch, O(state); parts must hold HASH_PART_COUNT values
+void computeStateHash(const World& world, unsigned long long parts[]);
+
+// Sets world.stateHash from scratch (after loading or restoring a state)
+void resetStateHash(World& world);
+
+unsigned long long getStateHash(const World& world);
+
+// Column name of a part in hashes.csv
+const char* getStateHashPartName(int part);
+
+#endif
@@ -0,0 +1,478 @@
+#include "sweep.h"
+#include "world.h"
+#include "io.h"
+#include "trains.h"
+#include "simulation.h"
+#include "job_pool.h"
+#include "time_skip.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+// ============================================================================
+// SWEEP.CPP - Parallel scenario sweeps
+// ============================================================================
+
+const int SWEEP_LINE_LEN = 1024;
+
+// Shared by the jobs of one sweep. Templates are only read while the pool
+// runs; each worker writes to its own World and each job to its own result.
+struct SweepRun {
+    const SweepSettings* settings;
+    const SweepJob* jobs;
+    SweepResult* results;
+    World** templates;          // one per distinct level, nullptr if it failed to load
+    int* jobTemplate;           // template index of each job
+    World** workerWorlds;
+};
+
+// ----------------------------------------------------------------------------
+// Skip spaces and tabs
+// ----------------------------------------------------------------------------
+static const char* skipBlanks(const char* text) {
+    while(*text == ' ' || *text == '\t') {
+        text++;
+    }
+    return text;
+}
+
+// ----------------------------------------------------------------------------
+// Copy the next blank-separated word into word; returns the text after it.
+// A word that does not fit is cut, and fits is set to false.
+// ----------------------------------------------------------------------------
+static const char* readWord(const char* text, char word[], int size, bool& fits) {
+    text = skipBlanks(text);
+    int len = 0;
+    fits = true;
+    while(*text != '\0' && *text != ' ' && *text != '\t') {
+        if(len < size - 1) {
+            word[len++] = *text;
+        } else {
+            fits = false;
+        }
+        text++;
+    }
+    word[len] = '\0';
+    return text;
+}
+
+// ----------------------------------------------------------------------------
+// Parse a whole decimal integer; false if anything else is in the text
+// ----------------------------------------------------------------------------
+static bool parseInt(const char* text, int& value) {
+    char* end;
+    long parsed = strtol(text, &end, 10);
+    if(end == text || *end != '\0') {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Read the job file
+// ----------------------------------------------------------------------------
+int readSweepJobs(const char* path, SweepJob*& jobs) {
+    jobs = nullptr;
+    
+    ifstream file(path);
+    if(!file.is_open()) {
+        return -1;
+    }
+    
+    // First pass counts the jobs, second pass fills them
+    char line[SWEEP_LINE_LEN];
+    int count = 0;
+    int lineNumber = 0;
+    while(file.getline(line, SWEEP_LINE_LEN)) {
+        lineNumber++;
+        const char* text = skipBlanks(line);
+        if(*text != '\0' && *text != '#' && *text != '\r') {
+            count++;
+        }
+    }
+    
+    // getline() stops without reaching the end on a line that does not fit
+    if(!file.eof()) {
+        cout << "ERROR: " << path << ":" << lineNumber + 1 << " (job " << count
+             << "): line longer than " << SWEEP_LINE_LEN - 1 << " characters" << endl;
+        return -1;
+    }
+    
+    file.clear();
+    file.seekg(0);
+    jobs = new SweepJob[count > 0 ? count : 1];
+    
+    int filled = 0;
+    lineNumber = 0;
+    while(filled < count && file.getline(line, SWEEP_LINE_LEN)) {
+        lineNumber++;
+        int len = strlen(line);
+        if(len > 0 && line[len - 1] == '\r') {
+            line[len - 1] = '\0';
+        }
+        
+        const char* text = skipBlanks(line);
+        if(*text == '\0' || *text == '#') {
+            continue;
+        }
+        
+        SweepJob& job = jobs[filled];
+        char seedText[32];
+        bool levelFits;
+        bool seedFits;
+        text = readWord(text, job.levelFile, SWEEP_TEXT_LEN, levelFits);
+        text = readWord(text, seedText, sizeof(seedText), seedFits);
+        text = skipBlanks(text);
+        
+        const char* problem = nullptr;
+        if(!seedFits || !parseInt(seedText, job.seed)) {
+            problem = "expected <level.lvl> <seed> [overrides]";
+        } else if(!levelFits) {
+            problem = "level path too long";
+        } else if((int)strlen(text) >= SWEEP_TEXT_LEN) {
+            problem = "overrides too long";
+        }
+        if(problem != nullptr) {
+            cout << "ERROR: " << path << ":" << lineNumber << " (job " << filled << "): "
+                 << problem << " (at most " << SWEEP_TEXT_LEN - 1 << " characters each)" << endl;
+            delete[] jobs;
+            jobs = nullptr;
+            return -1;
+        }
+        
+        strcpy(job.overrides, text);
+        filled++;
+    }
+    
+    return filled;
+}
+
+// ----------------------------------------------------------------------------
+// Apply one "target.field=value", "ticks=N" or "skip=0|1" override
+// ----------------------------------------------------------------------------
+static bool applyOverride(World& world, char token[], int& maxTicks, bool& timeSkip,
+                          bool& respawn) {
+    char* equals = strchr(token, '=');
+    if(equals == nullptr) {
+        return false;
+    }
+    *equals = '\0';
+    const char* value = equals + 1;
+    
+    if(strcmp(token, "ticks") == 0) {
+        return parseInt(value, maxTicks) && maxTicks >= 0;
+    }
+    
+    if(strcmp(token, "skip") == 0) {
+        int skip;
+        if(!parseInt(value, skip) || (skip != 0 && skip != 1)) {
+            return false;
+        }
+        timeSkip = (skip == 1);
+        return true;
+    }
+    
+    char* dot = strrchr(token, '.');
+    if(dot == nullptr) {
+        return false;
+    }
+    *dot = '\0';
+    const char* field = dot + 1;
+    
+    if(strcmp(field, "spawn") == 0) {
+        int trainId;
+        int tick;
+        if(strncmp(token, "train", 5) != 0 || !parseInt(token + 5, trainId) ||
+           trainId < 0 || trainId >= world.trainCount || !parseInt(value, tick) || tick < 0) {
+            return false;
+        }
+        world.trainSpawnTick[trainId] = tick;
+        respawn = true;
+        return true;
+    }
+    
+    int id = findSwitchByName(world, token);
+    if(id < 0) {
+        return false;
+    }
+    
+    if(strcmp(field, "k") == 0) {
+        int k[4];
+        int count = 0;
+        char list[SWEEP_TEXT_LEN];
+        strncpy(list, value, SWEEP_TEXT_LEN - 1);
+        list[SWEEP_TEXT_LEN - 1] = '\0';
+        
+        char* part = list;
+        while(count < 4) {
+            char* comma = strchr(part, ',');
+            if(comma != nullptr) {
+                *comma = '\0';
+            }
+            if(!parseInt(part, k[count])) {
+                return false;
+            }
+            count++;
+            if(comma == nullptr) {
+                break;
+            }
+            part = comma + 1;
+        }
+        if(count != 1 && count != 4) {
+            return false;
+        }
+        
+        for(int dir = 0; dir < 4; dir++) {
+            world.switchKValues[id * 4 + dir] = (count == 1) ? k[0] : k[dir];
+        }
+        return true;
+    }
+    
+    if(strcmp(field, "mode") == 0) {
+        if(strcmp(value, "PER_DIR") == 0) {
+            world.switchMode[id] = true;
+        } else if(strcmp(value, "GLOBAL") == 0) {
+            world.switchMode[id] = false;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    
+    if(strcmp(field, "state") == 0) {
+        int state;
+        if(!parseInt(value, state) || (state != 0 && state != 1)) {
+            return false;
+        }
+        world.switchState[id] = state;
+        return true;
+    }
+    
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Apply every override of a job to a freshly copied world
+// ----------------------------------------------------------------------------
+static bool applyOverrides(World& world, const char* overrides, int& maxTicks,
+                           bool& timeSkip, char error[]) {
+    bool respawn = false;
+    const char* text = overrides;
+    
+    while(*skipBlanks(text) != '\0') {
+        char token[SWEEP_TEXT_LEN];
+        bool fits;
+        text = readWord(text, token, SWEEP_TEXT_LEN, fits);
+        
+        char original[SWEEP_TEXT_LEN];
+        strcpy(original, token);
+        if(!applyOverride(world, token, maxTicks, timeSkip, respawn)) {
+            snprintf(error, SWEEP_TEXT_LEN, "bad override: %.200s", original);
+            return false;
+        }
+    }
+    
+    if(respawn) {
+        buildSpawnSchedule(world);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Run one job on a worker (called by the job pool)
+// ----------------------------------------------------------------------------
+static void runSweepJob(int jobIndex, int worker, void* user) {
+    SweepRun* run = (SweepRun*)user;
+    const SweepSettings& settings = *run->settings;
+    const SweepJob& job = run->jobs[jobIndex];
+    SweepResult& result = run->results[jobIndex];
+    
+    result.ok = false;
+    result.error[0] = '\0';
+    
+    const World* level = run->templates[run->jobTemplate[jobIndex]];
+    if(level == nullptr) {
+        snprintf(result.error, SWEEP_TEXT_LEN, "cannot load %.200s", job.levelFile);
+        return;
+    }
+    
+    World& world = *run->workerWorlds[worker];
+    if(!copyWorld(world, *level)) {
+        snprintf(result.error, SWEEP_TEXT_LEN, "out of memory for %.200s", job.levelFile);
+        return;
+    }
+    world.seed = job.seed;
+    
+    int maxTicks = settings.maxTicks;
+    bool timeSkip = settings.timeSkip;
+    if(!applyOverrides(world, job.overrides, maxTicks, timeSkip, result.error)) {
+        return;
+    }
+    
+    LogContext log;
+    initializeLogContext(log);
+    setLogLevel(log, settings.logLevel);
+    setTraceFormat(log, settings.traceFormat, false);
+    setTimeSkipEnabled(log, timeSkip);
+    
+    char jobDir[SWEEP_TEXT_LEN + 16];
+    snprintf(jobDir, sizeof(jobDir), "%s/job_%04d", settings.outputDir, jobIndex);
+    if(!setOutputDirectory(log, jobDir)) {
+        snprintf(result.error, SWEEP_TEXT_LEN, "output path too long: %.200s", jobDir);
+        return;
+    }
+    if(settings.logLevel > LOG_NONE) {
+        mkdir(jobDir, 0755);
+    }
+    
+    if(!initializeSimulation(world, log)) {
+        shutdownSimulation(log);
+        snprintf(result.error, SWEEP_TEXT_LEN, "cannot create logs in %.200s", jobDir);
+        return;
+    }
+    
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    runSimulation(world, log, maxTicks);
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+    
+    result.ticks = world.currentTick;
+    result.delivered = world.trainsDelivered;
+    result.crashed = world.trainsCrashed;
+    result.switchFlips = world.totalSwitchFlips;
+    result.totalWait = getTotalWaitTicks(world);
+    result.wallMs = chrono::duration<double>(endTime - startTime).count() * 1000.0;
+    
+    writeMetrics(log, result.ticks, result.delivered, result.crashed,
+                 result.totalWait, result.switchFlips);
+    shutdownSimulation(log);
+    
+    result.ok = true;
+}
+
+// ----------------------------------------------------------------------------
+// Load each distinct level once, then run the jobs on the pool
+// ----------------------------------------------------------------------------
+bool runSweep(const SweepSettings& settings, const SweepJob jobs[], int jobCount,
+              SweepResult results[]) {
+    if(jobCount <= 0) {
+        return false;
+    }
+    
+    if(settings.logLevel > LOG_NONE) {
+        mkdir(settings.outputDir, 0755);
+    }
+    
+    SweepRun run;
+    run.settings = &settings;
+    run.jobs = jobs;
+    run.results = results;
+    run.templates = new World*[jobCount];
+    run.jobTemplate = new int[jobCount];
+    
+    int templateCount = 0;
+    const char** templateFiles = new const char*[jobCount];
+    for(int j = 0; j < jobCount; j++) {
+        int t = 0;
+        while(t < templateCount && strcmp(templateFiles[t], jobs[j].levelFile) != 0) {
+            t++;
+        }
+        
+        if(t == templateCount) {
+            templateFiles[t] = jobs[j].levelFile;
+            run.templates[t] = createWorld();
+            if(!loadLevelFile(jobs[j].levelFile, *run.templates[t])) {
+                destroyWorld(run.templates[t]);
+                run.templates[t] = nullptr;
+            }
+            templateCount++;
+        }
+        run.jobTemplate[j] = t;
+    }
+    
+    int workerCount = settings.workerCount;
+    if(workerCount <= 0) {
+        workerCount = getHardwareWorkerCount();
+    }
+    if(workerCount > jobCount) {
+        workerCount = jobCount;
+    }
+    
+    run.workerWorlds = new World*[workerCount];
+    for(int w = 0; w < workerCount; w++) {
+        run.workerWorlds[w] = createWorld();
+    }
+    
+    runJobsWorkStealing(jobCount, workerCount, runSweepJob, &run);
+    
+    for(int w = 0; w < workerCount; w++) {
+        destroyWorld(run.workerWorlds[w]);
+    }
+    for(int t = 0; t < templateCount; t++) {
+        destroyWorld(run.templates[t]);
+    }
+    delete[] run.workerWorlds;
+    delete[] templateFiles;
+    delete[] run.jobTemplate;
+    delete[] run.templates;
+    
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write text as one quoted CSV field (embedded quotes doubled)
+// ----------------------------------------------------------------------------
+static void writeCsvText(ostream& out, const char* text) {
+    out << '"';
+    for(int i = 0; text[i] != '\0'; i++) {
+        if(text[i] == '"') {
+            out << '"';
+        }
+        out << text[i];
+    }
+    out << '"';
+}
+
+// ----------------------------------------------------------------------------
+// Write the aggregated metrics table
+// ----------------------------------------------------------------------------
+void writeSweepTable(ostream& out, const SweepJob jobs[], const SweepResult results[],
+                     int jobCount) {
+    out << "Job,Level,Seed,Overrides,Ticks,Delivered,Crashed,SwitchFlips,"
+        << "AvgWait,Throughput,WallMs,Status\n";
+    
+    for(int j = 0; j < jobCount; j++) {
+        const SweepResult& result = results[j];
+        out << j << ",";
+        writeCsvText(out, jobs[j].levelFile);
+        out << "," << jobs[j].seed << ",";
+        writeCsvText(out, jobs[j].overrides);
+        out << ",";
+        
+        if(!result.ok) {
+            out << ",,,,,,,";
+            writeCsvText(out, result.error);
+            out << "\n";
+            continue;
+        }
+        
+        float avgWait = 0.0f;
+        if(result.delivered > 0) {
+            avgWait = (float)result.totalWait / result.delivered;
+        }
+        float throughput = 0.0f;
+        if(result.ticks > 0) {
+            throughput = (float)result.delivered * 100.0f / result.ticks;
+        }
+        
+        out << result.ticks << "," << result.delivered << "," << result.crashed << ","
+            << result.switchFlips << "," << avgWait << "," << throughput << ","
+            << result.wallMs << ",OK\n";
+    }
+}
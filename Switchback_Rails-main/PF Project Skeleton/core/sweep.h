@@ -0,0 +1,77 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+// ============================================================================
+// SWEEP.H - Parallel scenario sweeps
+// ============================================================================
+// A sweep is a list of jobs, one per line of a job file:
+//
+//   <level.lvl> <seed> [override ...]
+//
+// Overrides (separated by spaces, applied in order):
+//   ticks=N            stop that run after N ticks
+//   skip=0|1           time skipping off or on for that run (time_skip.h)
+//   A.k=K              all four K-values of switch A
+//   A.k=K0,K1,K2,K3    K-values per direction (UP, RIGHT, DOWN, LEFT)
+//   A.mode=PER_DIR     or GLOBAL
+//   A.state=0          or 1
+//   train3.spawn=T     spawn tick of train 3
+//
+// Blank lines and lines starting with '#' are skipped. Each distinct level
+// is loaded once; every job starts from a copy of it in its worker's own
+// World and LogContext, and writes to <out>/job_NNNN/.
+// ============================================================================
+
+#include <ostream>
+
+const int SWEEP_TEXT_LEN = 256;
+
+struct SweepJob {
+    char levelFile[SWEEP_TEXT_LEN];
+    int seed;
+    char overrides[SWEEP_TEXT_LEN];
+};
+
+struct SweepResult {
+    bool ok;
+    char error[SWEEP_TEXT_LEN];
+    int ticks;
+    int delivered;
+    int crashed;
+    int switchFlips;
+    int totalWait;
+    double wallMs;
+};
+
+struct SweepSettings {
+    int workerCount;
+    int maxTicks;               // default for jobs without ticks=N
+    bool timeSkip;              // default for jobs without skip=0|1
+    int logLevel;               // LOG_NONE, LOG_METRICS or LOG_FULL
+    int traceFormat;
+    char outputDir[SWEEP_TEXT_LEN];
+};
+
+// ----------------------------------------------------------------------------
+// JOBS
+// ----------------------------------------------------------------------------
+// Returns the number of jobs read (jobs is allocated with new[]), or -1
+// when the file cannot be opened or a line is malformed.
+int readSweepJobs(const char* path, SweepJob*& jobs);
+
+// ----------------------------------------------------------------------------
+// RUNNING
+// ----------------------------------------------------------------------------
+// Runs every job; results[i] belongs to jobs[i]. Returns false only when
+// nothing could be run (a failed job is reported in its result).
+bool runSweep(const SweepSettings& settings, const SweepJob jobs[], int jobCount,
+              SweepResult results[]);
+
+// ----------------------------------------------------------------------------
+// RESULTS
+// ----------------------------------------------------------------------------
+// One CSV row per job, in job order
+void writeSweepTable(std::ostream& out, const SweepJob jobs[], const SweepResult results[],
+                     int jobCount);
+
+#endif
@@ -2,6 +2,9 @@
 #include "simulation_state.h"
 #include "grid.h"
 #include "io.h"
+#include "state_hash.h"
+#include "trains.h"
+#include "track_graph.h"
 
 using namespace std;
 
@@ -9,69 +12,95 @@ using namespace std;
 // SWITCHES.CPP - Switch management
 // ============================================================================
 
+// ----------------------------------------------------------------------------
+// Counter a train bumps this tick: the one of the switch it just moved onto
+// (per direction in PER_DIR mode), -1 if none
+// ----------------------------------------------------------------------------
+static int getEnteredSwitchCounter(const World& world, int trainId) {
+    if(world.trainCrashed[trainId]) {
+        return -1;
+    }
+    
+    // Straight cells hold no switch letters
+    if(world.trainRunLeft[trainId] >= 0 && isSegmentAdvanceEnabled()) {
+        return -1;
+    }
+    
+    int x = world.trainX[trainId];
+    int y = world.trainY[trainId];
+    if(world.trainPrevX[trainId] == x && world.trainPrevY[trainId] == y) {
+        return -1;
+    }
+    
+    int id = world.switchAtCell[y * world.gridCols + x];
+    if(id < 0) {
+        return -1;
+    }
+    return world.switchMode[id] ? id * 4 + world.trainDir[trainId] : id * 4;
+}
+
 // ----------------------------------------------------------------------------
 // Update switch counters
 // ----------------------------------------------------------------------------
-void updateSwitchCounters(int trainCount, int trainX[], int trainY[],
-                         int trainPrevX[], int trainPrevY[],
-                         bool trainActive[], bool trainCrashed[],
-                         int trainDir[], char grid[][100],
-                         bool switchExists[], bool switchMode[],
-                         int switchCounters[][4]) {
+void updateSwitchCounters(World& world) {
     
-    for(int i = 0; i < trainCount; i++) {
-        if(!trainActive[i] || trainCrashed[i]) continue;
-        
-        int x = trainX[i];
-        int y = trainY[i];
-        int px = trainPrevX[i];
-        int py = trainPrevY[i];
+    for(int a = 0; a < world.activeCount; a++) {
+        int counter = getEnteredSwitchCounter(world, world.activeList[a]);
+        if(counter < 0) continue;
         
-        if((px != x || py != y) && isSwitchTile(grid[y][x])) {
-            int idx = getSwitchIndex(grid[y][x]);
-            
-            if(switchExists[idx]) {
-                int dir = trainDir[i];
-                
-                if(switchMode[idx]) {
-                    switchCounters[idx][dir]++;
-                } else {
-                    switchCounters[idx][0]++;
-                }
-            }
+        updateStateHash(world, HASH_SWITCH_COUNTER, counter,
+                        world.switchCounters[counter], world.switchCounters[counter] + 1);
+        world.switchCounters[counter]++;
+    }
+}
+
+void countSwitchEntriesInRange(const World& world, int begin, int end, int counts[]) {
+    for(int a = begin; a < end; a++) {
+        int counter = getEnteredSwitchCounter(world, world.activeList[a]);
+        if(counter >= 0) {
+            counts[counter]++;
         }
     }
 }
 
+// Going from v straight to v + n XORs the same keys as n single steps (the
+// ones in between cancel out)
+void addSwitchCounts(World& world, const int counts[]) {
+    for(int counter = 0; counter < world.switchCount * 4; counter++) {
+        if(counts[counter] == 0) continue;
+        
+        updateStateHash(world, HASH_SWITCH_COUNTER, counter, world.switchCounters[counter],
+                        world.switchCounters[counter] + counts[counter]);
+        world.switchCounters[counter] += counts[counter];
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Queue switch flips
 // ----------------------------------------------------------------------------
-void queueSwitchFlips(bool switchExists[], bool switchMode[],
-                     int switchCounters[][4], int switchKValues[][4],
-                     bool switchFlipQueued[]) {
+void queueSwitchFlips(World& world) {
     
-    for(int i = 0; i < 26; i++) {
-        if(!switchExists[i]) continue;
+    for(int i = 0; i < world.switchCount; i++) {
+        int* counters = &world.switchCounters[i * 4];
+        int* kValues = &world.switchKValues[i * 4];
         
         bool shouldFlip = false;
         
-        if(switchMode[i]) {
+        if(world.switchMode[i]) {
             for(int dir = 0; dir < 4; dir++) {
-                if(switchCounters[i][dir] >= switchKValues[i][dir] && 
-                   switchKValues[i][dir] > 0) {
+                if(counters[dir] >= kValues[dir] && kValues[dir] > 0) {
                     shouldFlip = true;
                     break;
                 }
             }
         } else {
-            if(switchCounters[i][0] >= switchKValues[i][0] && 
-               switchKValues[i][0] > 0) {
+            if(counters[0] >= kValues[0] && kValues[0] > 0) {
                 shouldFlip = true;
             }
         }
         
         if(shouldFlip) {
-            switchFlipQueued[i] = true;
+            world.switchFlipQueued[i] = true;
         }
     }
 }
@@ -79,103 +108,238 @@ void queueSwitchFlips(bool switchExists[], bool switchMode[],
 // ----------------------------------------------------------------------------
 // Apply deferred flips
 // ----------------------------------------------------------------------------
-void applyDeferredFlips(bool switchExists[], int switchState[],
-                       bool switchFlipQueued[], int switchCounters[][4],
-                       int& totalSwitchFlips) {
+void applyDeferredFlips(World& world) {
     
-    for(int i = 0; i < 26; i++) {
-        if(!switchExists[i]) {
-            continue;
-        }
-        
-        if(switchFlipQueued[i]) {
-        
-            switchState[i] = 1 - switchState[i]; 
+    for(int i = 0; i < world.switchCount; i++) {
+        if(world.switchFlipQueued[i]) {
+            
+            updateStateHash(world, HASH_SWITCH_STATE, i, world.switchState[i],
+                            1 - world.switchState[i]);
+            world.switchState[i] = 1 - world.switchState[i];
             
             for(int dir = 0; dir < 4; dir++) {
-                switchCounters[i][dir] = 0;
+                updateStateHash(world, HASH_SWITCH_COUNTER, i * 4 + dir,
+                                world.switchCounters[i * 4 + dir], 0);
+                world.switchCounters[i * 4 + dir] = 0;
             }
             
-            switchFlipQueued[i] = false;
+            world.switchFlipQueued[i] = false;
             
-            totalSwitchFlips++;
+            world.totalSwitchFlips++;
         }
     }
 }
 
 // ----------------------------------------------------------------------------
-// Update signal lights
+// Record switch locations (called at load time)
+// ----------------------------------------------------------------------------
+// A letter switch sits on every cell holding its letter and shows its signal
+// on the first of them. A named switch comes with its cell from the level
+// (readSwitches() leaves it in switchX/switchY), which must hold a '*'.
+static bool isNamedSwitch(const World& world, int switchId) {
+    return findSwitchByLetter(world, getSwitchName(world, switchId)[0]) != switchId;
+}
+
+void buildSwitchIndex(World& world) {
+    
+    for(int i = 0; i < world.switchCount; i++) {
+        int x = world.switchX[i];
+        int y = world.switchY[i];
+        if(!isNamedSwitch(world, i) || !isInBounds(x, y, world.gridCols, world.gridRows) ||
+           getTile(world, x, y) != '*') {
+            world.switchX[i] = -1;
+            world.switchY[i] = -1;
+        }
+        world.signalDirty[i] = false;
+    }
+    world.signalDirtyCount = 0;
+    
+    for(int y = 0; y < world.gridRows; y++) {
+        for(int x = 0; x < world.gridCols; x++) {
+            int cell = y * world.gridCols + x;
+            int id = findSwitchByLetter(world, getTile(world, x, y));
+            
+            world.switchAtCell[cell] = id;
+            world.cellTrainCount[cell] = 0;
+            
+            if(id >= 0 && world.switchX[id] < 0) {
+                world.switchX[id] = x;
+                world.switchY[id] = y;
+            }
+        }
+    }
+    
+    for(int i = 0; i < world.switchCount; i++) {
+        if(isNamedSwitch(world, i) && world.switchX[i] >= 0) {
+            world.switchAtCell[world.switchY[i] * world.gridCols + world.switchX[i]] = i;
+        }
+    }
+    
+    for(int t = 0; t < world.trainCapacity; t++) {
+        world.seenActive[t] = false;
+    }
+    world.signalsPrimed = false;
+}
+
 // ----------------------------------------------------------------------------
-void updateSignalLights(bool switchExists[], int switchState[],
-                       int switchSignal[], char grid[][100],
-                       int gridRows, int gridCols,
-                       int trainCount, int trainX[], int trainY[],
-                       bool trainActive[]) {
+// Get the recorded location of a switch; false if its letter is not on the grid
+// ----------------------------------------------------------------------------
+bool getSwitchLocation(const World& world, int switchId, int& x, int& y) {
+    if(switchId < 0 || switchId >= world.switchCount || world.switchX[switchId] < 0) {
+        return false;
+    }
+    x = world.switchX[switchId];
+    y = world.switchY[switchId];
+    return true;
+}
 
-    for(int i = 0; i < 26; i++) {
-        if(!switchExists[i]) continue;
+// ----------------------------------------------------------------------------
+// Mark every switch within signal range of a cell for recomputation
+// ----------------------------------------------------------------------------
+// Looks up the switch of every cell in the diamond of radius SIGNAL_RANGE
+// around (x, y), so the cost does not grow with the number of switches
+void markSignalsNear(World& world, int x, int y) {
+    for(int dy = -SIGNAL_RANGE; dy <= SIGNAL_RANGE; dy++) {
+        int reach = SIGNAL_RANGE - (dy >= 0 ? dy : -dy);
+        int cy = y + dy;
+        if(cy < 0 || cy >= world.gridRows) continue;
+        
+        for(int dx = -reach; dx <= reach; dx++) {
+            int cx = x + dx;
+            if(cx < 0 || cx >= world.gridCols) continue;
+            
+            // Only the first cell of a switch carries its signal
+            int id = world.switchAtCell[cy * world.gridCols + cx];
+            if(id >= 0 && world.switchX[id] == cx && world.switchY[id] == cy &&
+               !world.signalDirty[id]) {
+                world.signalDirty[id] = true;
+                world.signalDirtyList[world.signalDirtyCount++] = id;
+            }
+        }
+    }
+}
 
-        bool found = false;
-        int sx = -1, sy = -1;
+// ----------------------------------------------------------------------------
+// Signal colour of one switch from the trains around it
+// ----------------------------------------------------------------------------
+int computeSignalAt(const World& world, int sx, int sy) {
+    if(world.cellTrainCount[sy * world.gridCols + sx] > 0) {
+        return 2;
+    }
+    
+    for(int dy = -SIGNAL_RANGE; dy <= SIGNAL_RANGE; dy++) {
+        int reach = SIGNAL_RANGE - (dy >= 0 ? dy : -dy);
+        int cy = sy + dy;
+        if(cy < 0 || cy >= world.gridRows) continue;
         
-        for(int y = 0; y < gridRows && !found; y++) {
-            for(int x = 0; x < gridCols && !found; x++) {
-                if(grid[y][x] == ('A' + i)) {
-                    sx = x;
-                    sy = y;
-                    found = true;
-                }
+        for(int dx = -reach; dx <= reach; dx++) {
+            int cx = sx + dx;
+            if(cx < 0 || cx >= world.gridCols) continue;
+            
+            if(world.cellTrainCount[cy * world.gridCols + cx] > 0) {
+                return 1;
             }
         }
+    }
+    
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Update signal lights
+// ----------------------------------------------------------------------------
+// RED when an active train is on the switch, YELLOW within distance 2, GREEN
+// otherwise. Only switches near a train that moved, spawned or left the
+// track since the last call are recomputed. Trains that left the track are
+// taken from world.retiredList, so inactive trains are never visited.
+void updateSignalLights(World& world) {
+    
+    int visitCount = world.activeCount + world.retiredCount;
+    for(int v = 0; v < visitCount; v++) {
+        int t = (v < world.activeCount) ? world.activeList[v]
+                                        : world.retiredList[v - world.activeCount];
+        bool active = world.trainActive[t];
+        if(active == world.seenActive[t] &&
+           (!active || (world.trainX[t] == world.seenX[t] && world.trainY[t] == world.seenY[t]))) {
+            continue;
+        }
         
-        if(!found) continue;
+        if(world.seenActive[t]) {
+            world.cellTrainCount[world.seenY[t] * world.gridCols + world.seenX[t]]--;
+            markSignalsNear(world, world.seenX[t], world.seenY[t]);
+        }
+        if(active) {
+            world.cellTrainCount[world.trainY[t] * world.gridCols + world.trainX[t]]++;
+            markSignalsNear(world, world.trainX[t], world.trainY[t]);
+        }
         
-        int minDist = 999;
-        for(int t = 0; t < trainCount; t++) {
-            if(!trainActive[t]) {
-                continue;
-            }
-            
-            int dx = trainX[t] - sx;
-            int dy = trainY[t] - sy;
-            int dist = (dx >= 0 ? dx : -dx) + (dy >= 0 ? dy : -dy);
-            
-            if(dist < minDist) {
-                minDist = dist;
+        world.seenX[t] = world.trainX[t];
+        world.seenY[t] = world.trainY[t];
+        world.seenActive[t] = active;
+    }
+    
+    if(!world.signalsPrimed) {
+        for(int i = 0; i < world.switchCount; i++) {
+            if(world.switchX[i] >= 0 && !world.signalDirty[i]) {
+                world.signalDirty[i] = true;
+                world.signalDirtyList[world.signalDirtyCount++] = i;
             }
         }
+        world.signalsPrimed = true;
+    }
+    world.retiredCount = 0;
+    
+    for(int d = 0; d < world.signalDirtyCount; d++) {
+        int i = world.signalDirtyList[d];
+        world.signalDirty[i] = false;
+        world.switchSignal[i] = computeSignalAt(world, world.switchX[i], world.switchY[i]);
+    }
+    world.signalDirtyCount = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Recompute every signal from the active trains' positions
+// ----------------------------------------------------------------------------
+// The nearest active train decides: on the switch RED, within SIGNAL_RANGE
+// YELLOW, else GREEN. Returns the number of switches whose signal differs.
+int verifySignalLights(const World& world) {
+    int mismatches = 0;
+    for(int i = 0; i < world.switchCount; i++) {
+        if(world.switchX[i] < 0) continue;
         
-        if(minDist == 0) {
-            switchSignal[i] = 2;
-        } else if(minDist <= 2) {
-            switchSignal[i] = 1;
-        } else {
-            switchSignal[i] = 0;
+        int nearest = SIGNAL_RANGE + 1;
+        for(int a = 0; a < world.activeCount && nearest > 0; a++) {
+            int t = world.activeList[a];
+            int dist = calculateManhattanDistance(world.switchX[i], world.switchY[i],
+                                                  world.trainX[t], world.trainY[t]);
+            if(dist < nearest) nearest = dist;
+        }
+        int signal = (nearest == 0) ? 2 : (nearest <= SIGNAL_RANGE ? 1 : 0);
+        if(signal != world.switchSignal[i]) {
+            mismatches++;
         }
     }
+    return mismatches;
 }
 
 // ----------------------------------------------------------------------------
 // Toggle switch state
 // ----------------------------------------------------------------------------
-void toggleSwitchState(char switchLetter, bool switchExists[], int switchState[]) {
-    if(switchLetter >= 'A' && switchLetter <= 'Z') {
-        int idx = switchLetter - 'A';
-        if(switchExists[idx]) {
-            switchState[idx] = 1 - switchState[idx];
-        }
+void toggleSwitchState(World& world, int switchId) {
+    if(switchId >= 0 && switchId < world.switchCount) {
+        updateStateHash(world, HASH_SWITCH_STATE, switchId, world.switchState[switchId],
+                        1 - world.switchState[switchId]);
+        world.switchState[switchId] = 1 - world.switchState[switchId];
     }
 }
 
 // ----------------------------------------------------------------------------
 // Get switch state for direction
 // ----------------------------------------------------------------------------
-int getSwitchStateForDirection(int switchIndex, int direction,
-                               int switchState[], bool switchMode[]) {
-                               
-    if((switchIndex >= 0) && (switchIndex < 26)) {
-        return switchState[switchIndex];
+int getSwitchStateForDirection(const World& world, int switchId, int direction) {
+    
+    if((switchId >= 0) && (switchId < world.switchCount)) {
+        return world.switchState[switchId];
     }
     return 0;
 }
-
@@ -5,49 +5,60 @@
 // SWITCHES.H - Switch logic
 // ============================================================================
 
+#include "world.h"
+
+const int SIGNAL_RANGE = 2;     // YELLOW within this Manhattan distance
+
 // ----------------------------------------------------------------------------
 // SWITCH COUNTER UPDATE
 // ----------------------------------------------------------------------------
-void updateSwitchCounters(int trainCount, int trainX[], int trainY[],
-                         int trainPrevX[], int trainPrevY[],
-                         bool trainActive[], bool trainCrashed[],
-                         int trainDir[], char grid[][100],
-                         bool switchExists[], bool switchMode[],
-                         int switchCounters[][4]);
+void updateSwitchCounters(World& world);
+
+// The same in two steps, for the parallel tick: count the switch entries of
+// activeList[begin .. end) into counts (switchCount * 4, laid out like
+// switchCounters), then add the summed counts to the counters
+void countSwitchEntriesInRange(const World& world, int begin, int end, int counts[]);
+
+void addSwitchCounts(World& world, const int counts[]);
 
 // ----------------------------------------------------------------------------
 // FLIP QUEUE
 // ----------------------------------------------------------------------------
-void queueSwitchFlips(bool switchExists[], bool switchMode[],
-                     int switchCounters[][4], int switchKValues[][4],
-                     bool switchFlipQueued[]);
+void queueSwitchFlips(World& world);
 
 // ----------------------------------------------------------------------------
 // DEFERRED FLIP
 // ----------------------------------------------------------------------------
-void applyDeferredFlips(bool switchExists[], int switchState[],
-                       bool switchFlipQueued[], int switchCounters[][4],
-                       int& totalSwitchFlips);
+void applyDeferredFlips(World& world);
+
+// ----------------------------------------------------------------------------
+// SWITCH INDEX
+// ----------------------------------------------------------------------------
+// Maps every grid cell holding a switch letter to its switch id and records
+// the first such cell of every switch; named switches ('*' in the map) map
+// the one cell the level gives them. Built by loadLevelFile().
+void buildSwitchIndex(World& world);
+
+bool getSwitchLocation(const World& world, int switchId, int& x, int& y);
 
 // ----------------------------------------------------------------------------
 // SIGNAL CALCULATION
 // ----------------------------------------------------------------------------
-void updateSignalLights(bool switchExists[], int switchState[],
-                       int switchSignal[], char grid[][100],
-                       int gridRows, int gridCols,
-                       int trainCount, int trainX[], int trainY[],
-                       bool trainActive[]);
+void updateSignalLights(World& world);
+
+// Checks the incrementally kept signals against a full recompute after a
+// tick; returns the number of switches that differ
+int verifySignalLights(const World& world);
 
 // ----------------------------------------------------------------------------
 // SWITCH TOGGLE
 // ----------------------------------------------------------------------------
-void toggleSwitchState(char switchLetter, bool switchExists[], int switchState[]);
+void toggleSwitchState(World& world, int switchId);
 
 // ----------------------------------------------------------------------------
 // HELPER FUNCTIONS
 // ----------------------------------------------------------------------------
-int getSwitchStateForDirection(int switchIndex, int direction,
-                               int switchState[], bool switchMode[]);
+int getSwitchStateForDirection(const World& world, int switchId, int direction);
 
 #endif
 
@@ -0,0 +1,145 @@
+#include "tick_profiler.h"
+
+#ifdef SWITCHBACK_PROFILE
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+// ============================================================================
+// TICK_PROFILER.CPP - Per-phase counters and histograms
+// ============================================================================
+
+static long long readSteadyNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ----------------------------------------------------------------------------
+// Lifecycle
+// ----------------------------------------------------------------------------
+TickProfile* createTickProfile() {
+    TickProfile* profile = new TickProfile;
+    resetTickProfile(profile);
+    return profile;
+}
+
+void destroyTickProfile(TickProfile* profile) {
+    delete profile;
+}
+
+void resetTickProfile(TickProfile* profile) {
+    memset(profile, 0, sizeof(TickProfile));
+    for(int series = 0; series < PROFILE_SERIES_COUNT; series++) {
+        profile->minimum[series] = ~0ULL;
+    }
+    profile->startClock = readProfileClock();
+    profile->startNs = readSteadyNs();
+}
+
+// ----------------------------------------------------------------------------
+// Queries
+// ----------------------------------------------------------------------------
+const TickProfile* getTickProfile(const LogContext& log) {
+    return log.profile;
+}
+
+// steady_clock nanoseconds per clock tick since the last reset (1 when the
+// profile clock is steady_clock itself)
+double getProfileNsPerClock(const TickProfile* profile) {
+    unsigned long long clocks = readProfileClock() - profile->startClock;
+    long long ns = readSteadyNs() - profile->startNs;
+    if(clocks == 0 || ns <= 0) {
+        return 1.0;
+    }
+    return (double)ns / clocks;
+}
+
+// Upper bound (ns) of the bucket holding the given fraction of the samples
+static double getBucketPercentile(const TickProfile* profile, int series, double fraction,
+                                  double nsPerClock) {
+    long long rank = (long long)(fraction * profile->count[series] + 0.999999);
+    if(rank < 1) rank = 1;
+    long long seen = 0;
+    for(int bucket = 0; bucket < PROFILE_BUCKET_COUNT; bucket++) {
+        seen += profile->buckets[series][bucket];
+        if(seen >= rank) {
+            return (double)(2ULL << bucket) * nsPerClock;
+        }
+    }
+    return (double)profile->maximum[series] * nsPerClock;
+}
+
+bool getTickPhaseStats(const TickProfile* profile, int series, TickPhaseStats& stats) {
+    memset(&stats, 0, sizeof(stats));
+    if(profile == nullptr || series < 0 || series >= PROFILE_SERIES_COUNT) {
+        return false;
+    }
+    
+    stats.count = profile->count[series];
+    if(stats.count == 0) {
+        return true;
+    }
+    
+    double nsPerClock = getProfileNsPerClock(profile);
+    stats.totalNs = profile->total[series] * nsPerClock;
+    stats.meanNs = stats.totalNs / stats.count;
+    stats.minNs = profile->minimum[series] * nsPerClock;
+    stats.maxNs = profile->maximum[series] * nsPerClock;
+    stats.p50Ns = getBucketPercentile(profile, series, 0.50, nsPerClock);
+    stats.p99Ns = getBucketPercentile(profile, series, 0.99, nsPerClock);
+    return true;
+}
+
+const char* getProfileSeriesName(int series) {
+    if(series == PROFILE_TICK) {
+        return "tick";
+    }
+    return getTickPhaseName(series);
+}
+
+// ----------------------------------------------------------------------------
+// Export
+// ----------------------------------------------------------------------------
+bool writeTickProfile(const TickProfile* profile, const char* summaryPath,
+                      const char* histogramPath) {
+    FILE* summary = fopen(summaryPath, "w");
+    if(summary == nullptr) {
+        return false;
+    }
+    
+    double nsPerClock = getProfileNsPerClock(profile);
+    fprintf(summary, "Phase,Count,TotalNs,MeanNs,MinNs,MaxNs,P50Ns,P99Ns,ShareOfTick\n");
+    for(int series = 0; series < PROFILE_SERIES_COUNT; series++) {
+        TickPhaseStats stats;
+        getTickPhaseStats(profile, series, stats);
+        double tickNs = profile->total[PROFILE_TICK] * nsPerClock;
+        double share = (tickNs > 0) ? stats.totalNs / tickNs : 0.0;
+        fprintf(summary, "%s,%lld,%.0f,%.1f,%.0f,%.0f,%.0f,%.0f,%.4f\n",
+                getProfileSeriesName(series), stats.count, stats.totalNs, stats.meanNs,
+                stats.minNs, stats.maxNs, stats.p50Ns, stats.p99Ns, share);
+    }
+    bool ok = (fclose(summary) == 0);
+    
+    FILE* histogram = fopen(histogramPath, "w");
+    if(histogram == nullptr) {
+        return false;
+    }
+    
+    fprintf(histogram, "Phase,BucketLowNs,BucketHighNs,Count\n");
+    for(int series = 0; series < PROFILE_SERIES_COUNT; series++) {
+        for(int bucket = 0; bucket < PROFILE_BUCKET_COUNT; bucket++) {
+            long long count = profile->buckets[series][bucket];
+            if(count == 0) continue;
+            
+            double low = (bucket == 0) ? 0.0 : (double)(1ULL << bucket) * nsPerClock;
+            double high = (double)(2ULL << bucket) * nsPerClock;
+            fprintf(histogram, "%s,%.1f,%.1f,%lld\n", getProfileSeriesName(series), low, high, count);
+        }
+    }
+    return (fclose(histogram) == 0) && ok;
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef TICK_PROFILER_H
+#define TICK_PROFILER_H
+
+// ============================================================================
+// TICK_PROFILER.H - Optional per-phase tick profiler
+// ============================================================================
+// Built with PROFILE=1 (-DSWITCHBACK_PROFILE), simulateOneTick() reads the
+// clock after every phase and adds the time to that phase's counters and a
+// histogram with power-of-two buckets. The clock is the TSC on x86 and
+// steady_clock elsewhere; clock ticks are converted to nanoseconds when the
+// profile is read, from how far both clocks advanced since it was reset.
+//
+// Every LogContext has its own profile, created by initializeLogFiles().
+// writeMetrics() saves it next to metrics.txt as profile.csv (one row per
+// phase) and profile_histogram.csv (one row per non-empty bucket).
+//
+// Without SWITCHBACK_PROFILE the hooks are empty macros and none of this is
+// compiled in.
+// ============================================================================
+
+#include "io.h"
+#include "simulation.h"
+
+#ifdef SWITCHBACK_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+const int PROFILE_BUCKET_COUNT = 48;                    // bucket b: [2^b, 2^(b+1)) clock ticks
+const int PROFILE_SERIES_COUNT = TICK_PHASE_COUNT + 1;  // the phases, then the whole tick
+const int PROFILE_TICK = TICK_PHASE_COUNT;
+
+struct TickProfile {
+    long long count[PROFILE_SERIES_COUNT];
+    unsigned long long total[PROFILE_SERIES_COUNT];     // clock ticks
+    unsigned long long minimum[PROFILE_SERIES_COUNT];
+    unsigned long long maximum[PROFILE_SERIES_COUNT];
+    long long buckets[PROFILE_SERIES_COUNT][PROFILE_BUCKET_COUNT];
+    unsigned long long startClock;                      // at the last reset
+    long long startNs;
+};
+
+// Summary of one series, in nanoseconds. The percentiles are the upper
+// bounds of the buckets they fall in.
+struct TickPhaseStats {
+    long long count;
+    double totalNs;
+    double meanNs;
+    double minNs;
+    double maxNs;
+    double p50Ns;
+    double p99Ns;
+};
+
+inline unsigned long long readProfileClock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Adds the time since lastClock to a series and moves lastClock to now
+inline void recordTickPhase(TickProfile* profile, int series, unsigned long long& lastClock) {
+    unsigned long long now = readProfileClock();
+    if(profile != nullptr) {
+        unsigned long long elapsed = now - lastClock;
+        int bucket = 63 - __builtin_clzll(elapsed | 1);
+        if(bucket >= PROFILE_BUCKET_COUNT) bucket = PROFILE_BUCKET_COUNT - 1;
+        
+        profile->count[series]++;
+        profile->total[series] += elapsed;
+        if(elapsed < profile->minimum[series]) profile->minimum[series] = elapsed;
+        if(elapsed > profile->maximum[series]) profile->maximum[series] = elapsed;
+        profile->buckets[series][bucket]++;
+    }
+    lastClock = now;
+}
+
+// Hooks used by simulateOneTick()
+#define TICK_PROFILE_START(log) \
+    unsigned long long tickStartClock = readProfileClock(); \
+    unsigned long long tickPhaseClock = tickStartClock
+#define TICK_PROFILE_PHASE(log, phase) \
+    recordTickPhase((log).profile, (phase), tickPhaseClock)
+#define TICK_PROFILE_END(log) \
+    recordTickPhase((log).profile, PROFILE_TICK, tickStartClock)
+
+// ----------------------------------------------------------------------------
+// LIFECYCLE
+// ----------------------------------------------------------------------------
+TickProfile* createTickProfile();
+
+void destroyTickProfile(TickProfile* profile);
+
+// Clears every counter and restarts the clock calibration
+void resetTickProfile(TickProfile* profile);
+
+// ----------------------------------------------------------------------------
+// LIVE QUERIES
+// ----------------------------------------------------------------------------
+// Call from the thread running the simulation (between ticks). series is a
+// phase, or PROFILE_TICK for whole ticks.
+const TickProfile* getTickProfile(const LogContext& log);
+
+double getProfileNsPerClock(const TickProfile* profile);
+
+bool getTickPhaseStats(const TickProfile* profile, int series, TickPhaseStats& stats);
+
+// "spawn", ..., "logging", "tick"
+const char* getProfileSeriesName(int series);
+
+// ----------------------------------------------------------------------------
+// EXPORT
+// ----------------------------------------------------------------------------
+bool writeTickProfile(const TickProfile* profile, const char* summaryPath,
+                      const char* histogramPath);
+
+#else
+
+#define TICK_PROFILE_START(log)
+#define TICK_PROFILE_PHASE(log, phase)
+#define TICK_PROFILE_END(log)
+
+#endif
+
+#endif
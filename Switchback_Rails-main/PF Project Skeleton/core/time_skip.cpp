@@ -0,0 +1,237 @@
+#include "time_skip.h"
+#include "simulation.h"
+#include "trains.h"
+#include "grid.h"
+#include "switches.h"
+#include "state_hash.h"
+#include "track_graph.h"
+#include <cstdlib>
+
+using namespace std;
+
+// ============================================================================
+// TIME_SKIP.CPP - Quiet windows and straight-line jumps
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Settings
+// ----------------------------------------------------------------------------
+void setTimeSkipEnabled(LogContext& log, bool enabled) {
+    log.timeSkip = enabled;
+}
+
+bool isTimeSkipEnabled(const LogContext& log) {
+    return log.timeSkip;
+}
+
+// ----------------------------------------------------------------------------
+// Fill the quiet run table (called at load time, after the switch index)
+// ----------------------------------------------------------------------------
+// Every straight cell is marked first, then the cells within SIGNAL_RANGE of
+// a switch signal are cleared again. Only switches whose letter is on the
+// grid have a signal (switchX -1 otherwise). Each heading is then filled
+// walking against it, so the cell ahead is always done first.
+void buildQuietRuns(World& world) {
+    const int stepX[] = {0, 1, 0, -1};
+    const int stepY[] = {-1, 0, 1, 0};
+    long long cells = (long long)world.gridRows * world.gridCols;
+    
+    for(long long cell = 0; cell < cells; cell++) {
+        unsigned char mark = isStraightTile(world.grid[cell]) ? 1 : 0;
+        for(int dir = 0; dir < 4; dir++) {
+            world.quietRun[cell * 4 + dir] = mark;
+        }
+    }
+    
+    for(int i = 0; i < world.switchCount; i++) {
+        if(world.switchX[i] < 0) {
+            continue;
+        }
+        for(int dy = -SIGNAL_RANGE; dy <= SIGNAL_RANGE; dy++) {
+            int reach = SIGNAL_RANGE - abs(dy);
+            for(int dx = -reach; dx <= reach; dx++) {
+                int x = world.switchX[i] + dx;
+                int y = world.switchY[i] + dy;
+                if(!isInBounds(x, y, world.gridCols, world.gridRows)) {
+                    continue;
+                }
+                long long cell = (long long)y * world.gridCols + x;
+                for(int dir = 0; dir < 4; dir++) {
+                    world.quietRun[cell * 4 + dir] = 0;
+                }
+            }
+        }
+    }
+    
+    for(int dir = 0; dir < 4; dir++) {
+        long long step = stepX[dir] + stepY[dir] * (long long)world.gridCols;
+        for(int row = 0; row < world.gridRows; row++) {
+            int y = (dir == 2) ? world.gridRows - 1 - row : row;
+            for(int col = 0; col < world.gridCols; col++) {
+                int x = (dir == 1) ? world.gridCols - 1 - col : col;
+                long long cell = (long long)y * world.gridCols + x;
+                
+                // A transition entry equal to dir means the train leaves
+                // straight on and stays on the grid
+                if(world.quietRun[cell * 4 + dir] == 0 ||
+                   world.transitions[cell * 4 + dir] != dir) {
+                    continue;
+                }
+                int ahead = world.quietRun[(cell + step) * 4 + dir];
+                world.quietRun[cell * 4 + dir] = (ahead >= QUIET_RUN_MAX) ? QUIET_RUN_MAX : ahead + 1;
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Moves a train can make from (x, y) heading dir and still stand on straight
+// track, where it keeps its heading and touches no switch, with no signal
+// within SIGNAL_RANGE; at most limit
+// ----------------------------------------------------------------------------
+static int countClearMoves(const World& world, int x, int y, int dir, int limit) {
+    int run = world.quietRun[((long long)y * world.gridCols + x) * 4 + dir];
+    int moves = (run > 0) ? run - 1 : 0;
+    return (moves < limit) ? moves : limit;
+}
+
+// ----------------------------------------------------------------------------
+// Length of the quiet window ahead
+// ----------------------------------------------------------------------------
+// The window only shrinks, and every test below stops as soon as it is
+// shorter than MIN_QUIET_TICKS. In order:
+// - the next spawn and the tick limit;
+// - each train's destination, when it lies straight ahead;
+// - each train's straight run: one move past it the train is on a switch,
+//   crossing, curve, spawn or destination, where routing has real work.
+//   The run also ends where a switch signal comes within SIGNAL_RANGE of
+//   the train, so no signal changes. Both come from one table lookup;
+// - the other trains: two trains close in by at most two cells a tick and
+//   must not get within two cells (the collision range) before a move, so
+//   any two must start more than 2 * window apart. The search compares
+//   trains in squares sized by the window, so it comes last, when the
+//   window is smallest.
+// Trains that are not on straight track end the search straight away.
+int findQuietTicks(World& world, int limit) {
+    
+    // The first full tick primes the previous positions and the signals;
+    // trains that left the track have to reach the signals first
+    if(!world.prevPrimed || !world.signalsPrimed || world.retiredCount > 0) {
+        return 0;
+    }
+    
+    int window = limit;
+    if(window > MAX_QUIET_TICKS) window = MAX_QUIET_TICKS;
+    if(world.spawnCursor < world.trainCount) {
+        int nextSpawn = world.trainSpawnTick[world.spawnOrder[world.spawnCursor]];
+        if(nextSpawn - world.currentTick - 1 < window) {
+            window = nextSpawn - world.currentTick - 1;
+        }
+    }
+    if(window < MIN_QUIET_TICKS) {
+        return 0;
+    }
+    
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        int x = world.trainX[i];
+        int y = world.trainY[i];
+        int dir = world.trainDir[i];
+        if(!isStraightTile(getTile(world, x, y))) {
+            return 0;
+        }
+        
+        int stepX = (dir == 1) - (dir == 3);
+        int stepY = (dir == 2) - (dir == 0);
+        
+        // Cells to the destination when it is straight ahead (arrival on
+        // that move, so the window ends one tick before)
+        int ahead = 0;
+        if(stepY == 0 && world.trainDestY[i] == y) ahead = (world.trainDestX[i] - x) * stepX;
+        if(stepX == 0 && world.trainDestX[i] == x) ahead = (world.trainDestY[i] - y) * stepY;
+        if(ahead > 0 && ahead - 1 < window) {
+            window = ahead - 1;
+            if(window < MIN_QUIET_TICKS) return 0;
+        }
+    }
+    
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        window = countClearMoves(world, world.trainX[i], world.trainY[i], world.trainDir[i],
+                                 window);
+        if(window < MIN_QUIET_TICKS) return 0;
+    }
+    
+    if(world.activeCount > 1) {
+        int closest = findClosestTrainDistance(world, 2 * window);
+        if((closest - 1) / 2 < window) {
+            window = (closest - 1) / 2;
+            if(window < MIN_QUIET_TICKS) return 0;
+        }
+    }
+    
+    return (window >= MIN_QUIET_TICKS) ? window : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Advance the clock and every train through quiet ticks
+// ----------------------------------------------------------------------------
+// What the full ticks would leave: the clock, positions and next positions
+// (the same cell after a move), previous positions one cell back, the
+// track graph offsets and the cell counts the signals keep. Signals,
+// switches and flags do not change in a quiet window.
+void advanceQuietTicks(World& world, int ticks) {
+    
+    updateStateHash(world, HASH_CLOCK, 0, world.currentTick, world.currentTick + ticks);
+    world.currentTick += ticks;
+    
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        int dir = world.trainDir[i];
+        int stepX = (dir == 1) - (dir == 3);
+        int stepY = (dir == 2) - (dir == 0);
+        
+        int oldCell = world.trainY[i] * world.gridCols + world.trainX[i];
+        int x = world.trainX[i] + stepX * ticks;
+        int y = world.trainY[i] + stepY * ticks;
+        int newCell = y * world.gridCols + x;
+        updateStateHash(world, HASH_TRAIN_POSITION, i, oldCell, newCell);
+        
+        world.trainPrevX[i] = x - stepX;
+        world.trainPrevY[i] = y - stepY;
+        world.trainX[i] = x;
+        world.trainY[i] = y;
+        world.trainNextX[i] = x;
+        world.trainNextY[i] = y;
+        world.trainRunLeft[i] = lookupTrainRun(world, i);
+        
+        world.cellTrainCount[oldCell]--;
+        world.cellTrainCount[newCell]++;
+        world.seenX[i] = x;
+        world.seenY[i] = y;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Skip the quiet ticks ahead
+// ----------------------------------------------------------------------------
+int skipQuietTicks(World& world, LogContext& log, int maxTicks) {
+    
+    int ticks = findQuietTicks(world, maxTicks - world.currentTick);
+    if(ticks == 0) {
+        return 0;
+    }
+    
+    if(hasPerTickLogs(log)) {
+        for(int t = 0; t < ticks; t++) {
+            advanceQuietTicks(world, 1);
+            runTickPhase(world, log, PHASE_LOGGING);
+        }
+    }
+    else {
+        advanceQuietTicks(world, ticks);
+    }
+    
+    log.skippedTicks += ticks;
+    return ticks;
+}
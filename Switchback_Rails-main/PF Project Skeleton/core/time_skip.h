@@ -0,0 +1,62 @@
+#ifndef TIME_SKIP_H
+#define TIME_SKIP_H
+
+// ============================================================================
+// TIME_SKIP.H - Skipping ticks where nothing can interact
+// ============================================================================
+// On most ticks of a sparse network every train is somewhere on a long run
+// of straight track ('-', '|', '='), far from the other trains and from any
+// switch, and no spawn is due. Such a tick only moves every train
+// one cell straight on and advances the clock.
+//
+// findQuietTicks() works out how many ticks from now are certainly like
+// that: no train leaves straight track or reaches its destination, comes within signal
+// range of a switch, or gets close enough to another train to claim the
+// same cell, and no train spawns. advanceQuietTicks() then moves every
+// train that many cells in one step and leaves the world exactly as the
+// full ticks would have, state hash included.
+//
+// runSimulation() does this between full ticks when time skipping is on
+// for the run's LogContext (off by default). When per-tick rows are written (full traces or
+// hashes.csv) the skipped ticks are advanced and logged one at a time, so
+// the files do not change; otherwise the whole window is one step.
+// ============================================================================
+
+#include "world.h"
+#include "io.h"
+
+const int MIN_QUIET_TICKS = 2;      // shorter windows run as full ticks
+const int MAX_QUIET_TICKS = 256;    // keeps the train proximity squares small
+const int QUIET_RUN_MAX = 255;      // quietRun entries are cut to this
+
+// ----------------------------------------------------------------------------
+// SETTINGS
+// ----------------------------------------------------------------------------
+void setTimeSkipEnabled(LogContext& log, bool enabled);
+
+bool isTimeSkipEnabled(const LogContext& log);
+
+// ----------------------------------------------------------------------------
+// QUIET RUNS
+// ----------------------------------------------------------------------------
+// quietRun holds, for every cell and heading, how many cells in a row from
+// that one are straight track with no switch signal within SIGNAL_RANGE,
+// 0 when the cell itself is not. It is built at load time with the other
+// tables (level_loader.cpp); the switches and straight tiles never move.
+void buildQuietRuns(World& world);
+
+// ----------------------------------------------------------------------------
+// SKIPPING
+// ----------------------------------------------------------------------------
+// Ticks after the current one (at most limit) that only move trains along
+// straight track; 0 when fewer than MIN_QUIET_TICKS
+int findQuietTicks(World& world, int limit);
+
+// The next ticks ticks, all of them quiet
+void advanceQuietTicks(World& world, int ticks);
+
+// Skips the quiet ticks ahead, if any, without passing maxTicks; writes
+// their rows when per-tick rows are logged. Returns the ticks skipped.
+int skipQuietTicks(World& world, LogContext& log, int maxTicks);
+
+#endif
@@ -0,0 +1,784 @@
+#include "trace_format.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef SWITCHBACK_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+// ============================================================================
+// TRACE_FORMAT.CPP - Binary columnar trace writer and mmap reader
+// ============================================================================
+
+const char TRACE_MAGIC[8] = {'S', 'B', 'T', 'R', 'A', 'C', 'E', '1'};
+const unsigned TRACE_VERSION = 2;
+const int TRACE_PREAMBLE_SIZE = 32;
+const int TRACE_MAX_STRINGS = 255;
+const int TRACE_MAX_STRING_LEN = 64;
+
+// ----------------------------------------------------------------------------
+// Writer state (one per open trace)
+// ----------------------------------------------------------------------------
+struct BinaryTraceWriter {
+    FILE* out;
+    unsigned long long offset;
+    unsigned flags;
+    
+    char levelName[256];
+    int levelRows;
+    int levelCols;
+    int levelSeed;
+    int levelWeather;
+    
+    char strings[TRACE_MAX_STRINGS][TRACE_MAX_STRING_LEN];
+    const char* stringPtr[TRACE_MAX_STRINGS];
+    int stringCount;
+    
+    // Switch names by switch id (TRACE_MAX_STRING_LEN each)
+    char* switchNames;
+    int switchNameCount, switchNameCap;
+    
+    // Staged rows of the tick currently being collected
+    bool hasBlock;
+    int blockTick;
+    int trainRows, trainCap;
+    int* colTrainId;
+    int* colTrainX;
+    int* colTrainY;
+    int* colTrainDir;
+    int* colTrainState;
+    int switchRows, switchCap;
+    int* colSwitchId;
+    int* colSwitchMode;
+    int* colSwitchState;
+    int signalRows, signalCap;
+    int* colSignalId;
+    int* colSignalValue;
+    
+    unsigned char* payload;
+    unsigned long payloadCap;
+    unsigned char* packed;
+    unsigned long packedCap;
+    
+    int indexCount, indexCap;
+    int* indexTick;
+    unsigned long long* indexOffset;
+};
+
+// ----------------------------------------------------------------------------
+// Reader state
+// ----------------------------------------------------------------------------
+static unsigned char* g_map = nullptr;
+static unsigned long g_mapSize = 0;
+static unsigned g_mapFlags = 0;
+static const char* g_mapLevelName = "";
+static int g_mapRows = 0, g_mapCols = 0, g_mapSeed = 0, g_mapWeather = 0;
+static const char* g_mapStrings[TRACE_MAX_STRINGS];
+static char g_mapStringData[TRACE_MAX_STRINGS][TRACE_MAX_STRING_LEN];
+static int g_mapStringCount = 0;
+static char* g_mapSwitchNames = nullptr;
+static int g_mapSwitchCount = 0;
+static int g_mapBlockCount = 0;
+static const unsigned char* g_mapIndex = nullptr;
+#ifdef SWITCHBACK_ZLIB
+static unsigned char* g_unpacked = nullptr;
+static unsigned long g_unpackedCap = 0;
+#endif
+
+// ----------------------------------------------------------------------------
+// Grow an int array to hold at least need entries
+// ----------------------------------------------------------------------------
+static void growIntArray(int*& arr, int count, int newCap) {
+    int* bigger = new int[newCap];
+    if(arr != nullptr) {
+        memcpy(bigger, arr, sizeof(int) * count);
+        delete[] arr;
+    }
+    arr = bigger;
+}
+
+// ----------------------------------------------------------------------------
+// Grow a byte buffer to hold at least need bytes (contents not kept)
+// ----------------------------------------------------------------------------
+static void reserveBytes(unsigned char*& buf, unsigned long& cap, unsigned long need) {
+    if(need <= cap) {
+        return;
+    }
+    unsigned long newCap = (cap == 0) ? 4096 : cap;
+    while(newCap < need) {
+        newCap *= 2;
+    }
+    delete[] buf;
+    buf = new unsigned char[newCap];
+    cap = newCap;
+}
+
+// ----------------------------------------------------------------------------
+// Round up to multiple of four / eight
+// ----------------------------------------------------------------------------
+static unsigned long pad4(unsigned long n) {
+    return (n + 3) & ~3ul;
+}
+
+static unsigned long long pad8(unsigned long long n) {
+    return (n + 7) & ~7ull;
+}
+
+// ----------------------------------------------------------------------------
+// Raw little-endian helpers
+// ----------------------------------------------------------------------------
+static void putU32(unsigned char* p, unsigned value) {
+    memcpy(p, &value, 4);
+}
+
+static unsigned getU32(const unsigned char* p) {
+    unsigned value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static unsigned long long getU64(const unsigned char* p) {
+    unsigned long long value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+static void writeBytes(BinaryTraceWriter* trace, const void* data, unsigned long size) {
+    fwrite(data, 1, size, trace->out);
+    trace->offset += size;
+}
+
+static void writeU32(BinaryTraceWriter* trace, unsigned value) {
+    writeBytes(trace, &value, 4);
+}
+
+static void writeU64(BinaryTraceWriter* trace, unsigned long long value) {
+    writeBytes(trace, &value, 8);
+}
+
+static void writePadding8(BinaryTraceWriter* trace) {
+    static const unsigned char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    unsigned long long padded = pad8(trace->offset);
+    if(padded > trace->offset) {
+        writeBytes(trace, zeros, (unsigned long)(padded - trace->offset));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Intern a string, returning its table index
+// ----------------------------------------------------------------------------
+static int internString(BinaryTraceWriter* trace, const char* text) {
+    for(int i = 0; i < trace->stringCount; i++) {
+        if(trace->stringPtr[i] == text) {
+            return i;
+        }
+    }
+    
+    for(int i = 0; i < trace->stringCount; i++) {
+        if(strcmp(trace->strings[i], text) == 0) {
+            trace->stringPtr[i] = text;
+            return i;
+        }
+    }
+    
+    if(trace->stringCount >= TRACE_MAX_STRINGS) {
+        return TRACE_MAX_STRINGS - 1;
+    }
+    
+    strncpy(trace->strings[trace->stringCount], text, TRACE_MAX_STRING_LEN - 1);
+    trace->strings[trace->stringCount][TRACE_MAX_STRING_LEN - 1] = '\0';
+    trace->stringPtr[trace->stringCount] = text;
+    return trace->stringCount++;
+}
+
+// ----------------------------------------------------------------------------
+// Remember the name of a switch id for the directory
+// ----------------------------------------------------------------------------
+static void registerSwitchName(BinaryTraceWriter* trace, int switchId, const char* name) {
+    if(switchId < 0) {
+        return;
+    }
+    
+    if(switchId >= trace->switchNameCap) {
+        int newCap = (trace->switchNameCap == 0) ? 32 : trace->switchNameCap;
+        while(newCap <= switchId) {
+            newCap *= 2;
+        }
+        char* bigger = new char[(unsigned long)newCap * TRACE_MAX_STRING_LEN];
+        if(trace->switchNames != nullptr) {
+            memcpy(bigger, trace->switchNames, (unsigned long)trace->switchNameCount * TRACE_MAX_STRING_LEN);
+            delete[] trace->switchNames;
+        }
+        trace->switchNames = bigger;
+        trace->switchNameCap = newCap;
+    }
+    
+    while(trace->switchNameCount <= switchId) {
+        trace->switchNames[trace->switchNameCount * TRACE_MAX_STRING_LEN] = '\0';
+        trace->switchNameCount++;
+    }
+    
+    char* slot = &trace->switchNames[switchId * TRACE_MAX_STRING_LEN];
+    if(slot[0] == '\0') {
+        strncpy(slot, name, TRACE_MAX_STRING_LEN - 1);
+        slot[TRACE_MAX_STRING_LEN - 1] = '\0';
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Start a new block when the tick changes
+// ----------------------------------------------------------------------------
+static void writeStagedBlock(BinaryTraceWriter* trace);
+
+static void beginRow(BinaryTraceWriter* trace, int tick) {
+    if(trace->hasBlock && tick != trace->blockTick) {
+        writeStagedBlock(trace);
+    }
+    trace->hasBlock = true;
+    trace->blockTick = tick;
+}
+
+// ----------------------------------------------------------------------------
+// Pack staged columns into a payload and append it as one block
+// ----------------------------------------------------------------------------
+static void writeStagedBlock(BinaryTraceWriter* trace) {
+    if(!trace->hasBlock || trace->out == nullptr) {
+        return;
+    }
+    
+    unsigned long size = 16;
+    size += pad4(4ul * trace->trainRows) + 2 * pad4(2ul * trace->trainRows) + 2 * pad4(trace->trainRows);
+    size += pad4(2ul * trace->switchRows) + 2 * pad4(trace->switchRows);
+    size += pad4(2ul * trace->signalRows) + pad4(trace->signalRows);
+    
+    reserveBytes(trace->payload, trace->payloadCap, size);
+    memset(trace->payload, 0, size);
+    
+    unsigned char* p = trace->payload;
+    putU32(p, (unsigned)trace->blockTick);
+    putU32(p + 4, (unsigned)trace->trainRows);
+    putU32(p + 8, (unsigned)trace->switchRows);
+    putU32(p + 12, (unsigned)trace->signalRows);
+    p += 16;
+    
+    for(int i = 0; i < trace->trainRows; i++) {
+        memcpy(p + 4 * i, &trace->colTrainId[i], 4);
+    }
+    p += pad4(4ul * trace->trainRows);
+    for(int i = 0; i < trace->trainRows; i++) {
+        unsigned short v = (unsigned short)trace->colTrainX[i];
+        memcpy(p + 2 * i, &v, 2);
+    }
+    p += pad4(2ul * trace->trainRows);
+    for(int i = 0; i < trace->trainRows; i++) {
+        unsigned short v = (unsigned short)trace->colTrainY[i];
+        memcpy(p + 2 * i, &v, 2);
+    }
+    p += pad4(2ul * trace->trainRows);
+    for(int i = 0; i < trace->trainRows; i++) {
+        p[i] = (unsigned char)trace->colTrainDir[i];
+    }
+    p += pad4(trace->trainRows);
+    for(int i = 0; i < trace->trainRows; i++) {
+        p[i] = (unsigned char)trace->colTrainState[i];
+    }
+    p += pad4(trace->trainRows);
+    
+    for(int i = 0; i < trace->switchRows; i++) {
+        unsigned short v = (unsigned short)trace->colSwitchId[i];
+        memcpy(p + 2 * i, &v, 2);
+    }
+    p += pad4(2ul * trace->switchRows);
+    for(int i = 0; i < trace->switchRows; i++) {
+        p[i] = (unsigned char)trace->colSwitchMode[i];
+    }
+    p += pad4(trace->switchRows);
+    for(int i = 0; i < trace->switchRows; i++) {
+        p[i] = (unsigned char)trace->colSwitchState[i];
+    }
+    p += pad4(trace->switchRows);
+    
+    for(int i = 0; i < trace->signalRows; i++) {
+        unsigned short v = (unsigned short)trace->colSignalId[i];
+        memcpy(p + 2 * i, &v, 2);
+    }
+    p += pad4(2ul * trace->signalRows);
+    for(int i = 0; i < trace->signalRows; i++) {
+        p[i] = (unsigned char)trace->colSignalValue[i];
+    }
+    
+    const unsigned char* stored = trace->payload;
+    unsigned long storedSize = size;
+
+#ifdef SWITCHBACK_ZLIB
+    if(trace->flags & TRACE_FLAG_ZLIB) {
+        uLongf bound = compressBound(size);
+        reserveBytes(trace->packed, trace->packedCap, bound);
+        if(compress2(trace->packed, &bound, trace->payload, size, Z_BEST_SPEED) == Z_OK) {
+            stored = trace->packed;
+            storedSize = bound;
+        }
+    }
+#endif
+    
+    if(trace->indexCount == trace->indexCap) {
+        int newCap = (trace->indexCap == 0) ? 1024 : trace->indexCap * 2;
+        growIntArray(trace->indexTick, trace->indexCount, newCap);
+        unsigned long long* biggerOffsets = new unsigned long long[newCap];
+        if(trace->indexOffset != nullptr) {
+            memcpy(biggerOffsets, trace->indexOffset, sizeof(unsigned long long) * trace->indexCount);
+            delete[] trace->indexOffset;
+        }
+        trace->indexOffset = biggerOffsets;
+        trace->indexCap = newCap;
+    }
+    trace->indexTick[trace->indexCount] = trace->blockTick;
+    trace->indexOffset[trace->indexCount] = trace->offset;
+    trace->indexCount++;
+    
+    writeU32(trace, (unsigned)storedSize);
+    writeU32(trace, (unsigned)size);
+    writeBytes(trace, stored, storedSize);
+    writePadding8(trace);
+    
+    trace->hasBlock = false;
+    trace->trainRows = 0;
+    trace->switchRows = 0;
+    trace->signalRows = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Create / destroy a writer
+// ----------------------------------------------------------------------------
+BinaryTraceWriter* createBinaryTraceWriter() {
+    BinaryTraceWriter* trace = new BinaryTraceWriter;
+    memset(trace, 0, sizeof(BinaryTraceWriter));
+    return trace;
+}
+
+void destroyBinaryTraceWriter(BinaryTraceWriter* trace) {
+    if(trace == nullptr) {
+        return;
+    }
+    closeBinaryTrace(trace);
+    delete[] trace->switchNames;
+    delete[] trace->colTrainId;
+    delete[] trace->colTrainX;
+    delete[] trace->colTrainY;
+    delete[] trace->colTrainDir;
+    delete[] trace->colTrainState;
+    delete[] trace->colSwitchId;
+    delete[] trace->colSwitchMode;
+    delete[] trace->colSwitchState;
+    delete[] trace->colSignalId;
+    delete[] trace->colSignalValue;
+    delete[] trace->payload;
+    delete[] trace->packed;
+    delete[] trace->indexTick;
+    delete[] trace->indexOffset;
+    delete trace;
+}
+
+// ----------------------------------------------------------------------------
+// Open binary trace for writing
+// ----------------------------------------------------------------------------
+bool openBinaryTrace(BinaryTraceWriter* trace, const char* path, bool compress) {
+    closeBinaryTrace(trace);
+    
+    trace->out = fopen(path, "wb");
+    if(trace->out == nullptr) {
+        return false;
+    }
+    
+    trace->offset = 0;
+    trace->flags = (compress && isBinaryCompressionAvailable()) ? TRACE_FLAG_ZLIB : 0;
+    trace->stringCount = 0;
+    trace->switchNameCount = 0;
+    trace->indexCount = 0;
+    trace->hasBlock = false;
+    trace->trainRows = 0;
+    trace->switchRows = 0;
+    trace->signalRows = 0;
+    
+    // Preamble, offsets are patched in closeBinaryTrace()
+    writeBytes(trace, TRACE_MAGIC, 8);
+    writeU32(trace, TRACE_VERSION);
+    writeU32(trace, trace->flags);
+    writeU64(trace, 0);
+    writeU64(trace, 0);
+    
+    // Fixed vocabulary first so the common strings get stable indices
+    const char* fixed[] = {"MOVING", "DELIVERED", "CRASHED",
+                           "PER_DIR", "GLOBAL",
+                           "GREEN", "YELLOW", "RED"};
+    for(int i = 0; i < 8; i++) {
+        internString(trace, fixed[i]);
+    }
+    
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Set level metadata stored in the directory
+// ----------------------------------------------------------------------------
+void setBinaryTraceLevelInfo(BinaryTraceWriter* trace, const char* levelName, int rows, int cols,
+                             int seed, int weatherMode) {
+    strncpy(trace->levelName, levelName, 255);
+    trace->levelName[255] = '\0';
+    trace->levelRows = rows;
+    trace->levelCols = cols;
+    trace->levelSeed = seed;
+    trace->levelWeather = weatherMode;
+}
+
+// ----------------------------------------------------------------------------
+// Append one row to the staged block
+// ----------------------------------------------------------------------------
+void appendBinaryTrainRow(BinaryTraceWriter* trace, int tick, int trainId, int x, int y, int dir,
+                          const char* state) {
+    beginRow(trace, tick);
+    if(trace->trainRows == trace->trainCap) {
+        int newCap = (trace->trainCap == 0) ? 256 : trace->trainCap * 2;
+        growIntArray(trace->colTrainId, trace->trainRows, newCap);
+        growIntArray(trace->colTrainX, trace->trainRows, newCap);
+        growIntArray(trace->colTrainY, trace->trainRows, newCap);
+        growIntArray(trace->colTrainDir, trace->trainRows, newCap);
+        growIntArray(trace->colTrainState, trace->trainRows, newCap);
+        trace->trainCap = newCap;
+    }
+    trace->colTrainId[trace->trainRows] = trainId;
+    trace->colTrainX[trace->trainRows] = x;
+    trace->colTrainY[trace->trainRows] = y;
+    trace->colTrainDir[trace->trainRows] = dir;
+    trace->colTrainState[trace->trainRows] = internString(trace, state);
+    trace->trainRows++;
+}
+
+void appendBinarySwitchRow(BinaryTraceWriter* trace, int tick, int switchId,
+                           const char* switchName, const char* mode, const char* state) {
+    beginRow(trace, tick);
+    registerSwitchName(trace, switchId, switchName);
+    if(trace->switchRows == trace->switchCap) {
+        int newCap = (trace->switchCap == 0) ? 64 : trace->switchCap * 2;
+        growIntArray(trace->colSwitchId, trace->switchRows, newCap);
+        growIntArray(trace->colSwitchMode, trace->switchRows, newCap);
+        growIntArray(trace->colSwitchState, trace->switchRows, newCap);
+        trace->switchCap = newCap;
+    }
+    trace->colSwitchId[trace->switchRows] = switchId;
+    trace->colSwitchMode[trace->switchRows] = internString(trace, mode);
+    trace->colSwitchState[trace->switchRows] = internString(trace, state);
+    trace->switchRows++;
+}
+
+void appendBinarySignalRow(BinaryTraceWriter* trace, int tick, int switchId,
+                           const char* switchName, const char* signal) {
+    beginRow(trace, tick);
+    registerSwitchName(trace, switchId, switchName);
+    if(trace->signalRows == trace->signalCap) {
+        int newCap = (trace->signalCap == 0) ? 64 : trace->signalCap * 2;
+        growIntArray(trace->colSignalId, trace->signalRows, newCap);
+        growIntArray(trace->colSignalValue, trace->signalRows, newCap);
+        trace->signalCap = newCap;
+    }
+    trace->colSignalId[trace->signalRows] = switchId;
+    trace->colSignalValue[trace->signalRows] = internString(trace, signal);
+    trace->signalRows++;
+}
+
+// ----------------------------------------------------------------------------
+// Write staged rows and flush to disk
+// ----------------------------------------------------------------------------
+void flushBinaryTrace(BinaryTraceWriter* trace) {
+    if(trace->out == nullptr) {
+        return;
+    }
+    writeStagedBlock(trace);
+    fflush(trace->out);
+}
+
+// ----------------------------------------------------------------------------
+// Write directory and index, patch preamble, close file
+// ----------------------------------------------------------------------------
+void closeBinaryTrace(BinaryTraceWriter* trace) {
+    if(trace->out == nullptr) {
+        return;
+    }
+    
+    writeStagedBlock(trace);
+    
+    unsigned long long directoryOffset = trace->offset;
+    unsigned nameLen = (unsigned)strlen(trace->levelName);
+    writeU32(trace, nameLen);
+    writeBytes(trace, trace->levelName, nameLen);
+    writePadding8(trace);
+    writeU32(trace, (unsigned)trace->levelRows);
+    writeU32(trace, (unsigned)trace->levelCols);
+    writeU32(trace, (unsigned)trace->levelSeed);
+    writeU32(trace, (unsigned)trace->levelWeather);
+    writeU32(trace, (unsigned)trace->stringCount);
+    for(int i = 0; i < trace->stringCount; i++) {
+        unsigned char len = (unsigned char)strlen(trace->strings[i]);
+        writeBytes(trace, &len, 1);
+        writeBytes(trace, trace->strings[i], len);
+    }
+    writeU32(trace, (unsigned)trace->switchNameCount);
+    for(int i = 0; i < trace->switchNameCount; i++) {
+        const char* name = &trace->switchNames[i * TRACE_MAX_STRING_LEN];
+        unsigned char len = (unsigned char)strlen(name);
+        writeBytes(trace, &len, 1);
+        writeBytes(trace, name, len);
+    }
+    writePadding8(trace);
+    
+    unsigned long long indexOffset = trace->offset;
+    writeU64(trace, (unsigned long long)trace->indexCount);
+    for(int i = 0; i < trace->indexCount; i++) {
+        writeU64(trace, (unsigned long long)(unsigned)trace->indexTick[i]);
+        writeU64(trace, trace->indexOffset[i]);
+    }
+    
+    fseek(trace->out, 16, SEEK_SET);
+    fwrite(&directoryOffset, 8, 1, trace->out);
+    fwrite(&indexOffset, 8, 1, trace->out);
+    fclose(trace->out);
+    trace->out = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// Was the build linked against zlib
+// ----------------------------------------------------------------------------
+bool isBinaryCompressionAvailable() {
+#ifdef SWITCHBACK_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Map a trace file and parse its directory
+// ----------------------------------------------------------------------------
+bool mapBinaryTrace(const char* path) {
+    unmapBinaryTrace();
+    
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < TRACE_PREAMBLE_SIZE) {
+        close(fd);
+        return false;
+    }
+    
+    void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) {
+        return false;
+    }
+    
+    g_map = (unsigned char*)mapped;
+    g_mapSize = (unsigned long)info.st_size;
+    
+    unsigned long long directoryOffset = getU64(g_map + 16);
+    unsigned long long indexOffset = getU64(g_map + 24);
+    if(memcmp(g_map, TRACE_MAGIC, 8) != 0 || getU32(g_map + 8) != TRACE_VERSION ||
+       directoryOffset == 0 || indexOffset + 8 > g_mapSize) {
+        unmapBinaryTrace();
+        return false;
+    }
+    g_mapFlags = getU32(g_map + 12);
+    
+    const unsigned char* p = g_map + directoryOffset;
+    unsigned nameLen = getU32(p);
+    g_mapLevelName = (const char*)(p + 4);
+    p = g_map + pad8(directoryOffset + 4 + nameLen);
+    g_mapRows = (int)getU32(p);
+    g_mapCols = (int)getU32(p + 4);
+    g_mapSeed = (int)getU32(p + 8);
+    g_mapWeather = (int)getU32(p + 12);
+    g_mapStringCount = (int)getU32(p + 16);
+    p += 20;
+    for(int i = 0; i < g_mapStringCount && i < TRACE_MAX_STRINGS; i++) {
+        int len = *p++;
+        memcpy(g_mapStringData[i], p, len);
+        g_mapStringData[i][len] = '\0';
+        g_mapStrings[i] = g_mapStringData[i];
+        p += len;
+    }
+    
+    unsigned switchCount;
+    memcpy(&switchCount, p, 4);
+    p += 4;
+    g_mapSwitchCount = (int)switchCount;
+    g_mapSwitchNames = new char[(unsigned long)switchCount * TRACE_MAX_STRING_LEN + 1];
+    for(int i = 0; i < g_mapSwitchCount; i++) {
+        int len = *p++;
+        char* name = &g_mapSwitchNames[i * TRACE_MAX_STRING_LEN];
+        memcpy(name, p, len);
+        name[len] = '\0';
+        p += len;
+    }
+    
+    // Level name is not NUL-terminated in the file; keep a copy
+    static char levelNameCopy[256];
+    unsigned copyLen = (nameLen < 255) ? nameLen : 255;
+    memcpy(levelNameCopy, g_mapLevelName, copyLen);
+    levelNameCopy[copyLen] = '\0';
+    g_mapLevelName = levelNameCopy;
+    
+    g_mapBlockCount = (int)getU64(g_map + indexOffset);
+    g_mapIndex = g_map + indexOffset + 8;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Release mapped trace
+// ----------------------------------------------------------------------------
+void unmapBinaryTrace() {
+    if(g_map != nullptr) {
+        munmap(g_map, g_mapSize);
+    }
+    g_map = nullptr;
+    g_mapSize = 0;
+    g_mapBlockCount = 0;
+    g_mapStringCount = 0;
+    delete[] g_mapSwitchNames;
+    g_mapSwitchNames = nullptr;
+    g_mapSwitchCount = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Directory accessors
+// ----------------------------------------------------------------------------
+void getBinaryTraceLevelInfo(const char*& levelName, int& rows, int& cols,
+                             int& seed, int& weatherMode) {
+    levelName = g_mapLevelName;
+    rows = g_mapRows;
+    cols = g_mapCols;
+    seed = g_mapSeed;
+    weatherMode = g_mapWeather;
+}
+
+int getBinaryTraceStringCount() {
+    return g_mapStringCount;
+}
+
+const char* getBinaryTraceString(int index) {
+    if(index < 0 || index >= g_mapStringCount) {
+        return "";
+    }
+    return g_mapStrings[index];
+}
+
+int getBinaryTraceSwitchCount() {
+    return g_mapSwitchCount;
+}
+
+const char* getBinaryTraceSwitchName(int switchId) {
+    if(switchId < 0 || switchId >= g_mapSwitchCount) {
+        return "";
+    }
+    return &g_mapSwitchNames[switchId * TRACE_MAX_STRING_LEN];
+}
+
+int getBinaryTraceBlockCount() {
+    return g_mapBlockCount;
+}
+
+int getBinaryTraceBlockTick(int blockIndex) {
+    return (int)getU64(g_mapIndex + 16 * blockIndex);
+}
+
+// ----------------------------------------------------------------------------
+// First block holding rows for tick (binary search), -1 if none
+// ----------------------------------------------------------------------------
+int findBinaryTraceBlock(int tick) {
+    int lo = 0;
+    int hi = g_mapBlockCount;
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(getBinaryTraceBlockTick(mid) < tick) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if(lo < g_mapBlockCount && getBinaryTraceBlockTick(lo) == tick) {
+        return lo;
+    }
+    return -1;
+}
+
+// ----------------------------------------------------------------------------
+// Decode one block; column pointers stay valid until the next call
+// ----------------------------------------------------------------------------
+bool loadBinaryTraceBlock(int blockIndex, int& tick,
+                          int& trainRows, const int*& trainIds,
+                          const unsigned short*& trainX, const unsigned short*& trainY,
+                          const unsigned char*& trainDir, const unsigned char*& trainState,
+                          int& switchRows, const unsigned short*& switchIds,
+                          const unsigned char*& switchMode, const unsigned char*& switchState,
+                          int& signalRows, const unsigned short*& signalIds,
+                          const unsigned char*& signalValue) {
+    if(blockIndex < 0 || blockIndex >= g_mapBlockCount) {
+        return false;
+    }
+    
+    unsigned long long offset = getU64(g_mapIndex + 16 * blockIndex + 8);
+    unsigned storedSize = getU32(g_map + offset);
+    unsigned rawSize = getU32(g_map + offset + 4);
+    const unsigned char* p = g_map + offset + 8;
+    
+    if(g_mapFlags & TRACE_FLAG_ZLIB) {
+#ifdef SWITCHBACK_ZLIB
+        reserveBytes(g_unpacked, g_unpackedCap, rawSize);
+        uLongf outSize = rawSize;
+        if(uncompress(g_unpacked, &outSize, p, storedSize) != Z_OK || outSize != rawSize) {
+            return false;
+        }
+        p = g_unpacked;
+#else
+        (void)storedSize;
+        (void)rawSize;
+        return false;
+#endif
+    }
+    
+    tick = (int)getU32(p);
+    trainRows = (int)getU32(p + 4);
+    switchRows = (int)getU32(p + 8);
+    signalRows = (int)getU32(p + 12);
+    p += 16;
+    
+    trainIds = (const int*)p;
+    p += pad4(4ul * trainRows);
+    trainX = (const unsigned short*)p;
+    p += pad4(2ul * trainRows);
+    trainY = (const unsigned short*)p;
+    p += pad4(2ul * trainRows);
+    trainDir = p;
+    p += pad4(trainRows);
+    trainState = p;
+    p += pad4(trainRows);
+    
+    switchIds = (const unsigned short*)p;
+    p += pad4(2ul * switchRows);
+    switchMode = p;
+    p += pad4(switchRows);
+    switchState = p;
+    p += pad4(switchRows);
+    
+    signalIds = (const unsigned short*)p;
+    p += pad4(2ul * signalRows);
+    signalValue = p;
+    
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+// ============================================================================
+// TRACE_FORMAT.H - Binary columnar trace (out/trace.bin)
+// ============================================================================
+// Layout (little-endian, every section 8-byte aligned so it can be mmapped):
+//
+//   preamble   "SBTRACE1", version, flags, directory offset, index offset
+//   blocks     u32 storedSize, u32 rawSize, payload (zlib if FLAG set)
+//              payload = u32 tick, u32 trainRows, u32 switchRows,
+//                        u32 signalRows, then one column per field:
+//                        trainId i32, x u16, y u16, dir u8, state u8,
+//                        switchId u16, mode u8, state u8,
+//                        signalId u16, signal u8   (each padded to 4 bytes)
+//   directory  level name, rows, cols, seed, weather, interned strings,
+//              switch names by switch id
+//   index      block count, then (tick, offset) per block
+//
+// Text columns hold indices into the interned string table; switchId and
+// signalId are numeric switch ids, named in the directory. The directory
+// is written on close so that every string seen during the run is in it.
+// ============================================================================
+
+const int TRACE_FLAG_ZLIB = 1;
+
+struct BinaryTraceWriter;
+
+// ----------------------------------------------------------------------------
+// WRITER (called from the log writer thread, one writer per open trace)
+// ----------------------------------------------------------------------------
+BinaryTraceWriter* createBinaryTraceWriter();
+
+void destroyBinaryTraceWriter(BinaryTraceWriter* trace);
+
+bool openBinaryTrace(BinaryTraceWriter* trace, const char* path, bool compress);
+
+void setBinaryTraceLevelInfo(BinaryTraceWriter* trace, const char* levelName, int rows,
+                             int cols, int seed, int weatherMode);
+
+void appendBinaryTrainRow(BinaryTraceWriter* trace, int tick, int trainId, int x, int y,
+                          int dir, const char* state);
+
+void appendBinarySwitchRow(BinaryTraceWriter* trace, int tick, int switchId,
+                           const char* switchName, const char* mode, const char* state);
+
+void appendBinarySignalRow(BinaryTraceWriter* trace, int tick, int switchId,
+                           const char* switchName, const char* signal);
+
+void flushBinaryTrace(BinaryTraceWriter* trace);
+
+void closeBinaryTrace(BinaryTraceWriter* trace);
+
+bool isBinaryCompressionAvailable();
+
+// ----------------------------------------------------------------------------
+// READER (mmap based, one trace open at a time)
+// ----------------------------------------------------------------------------
+bool mapBinaryTrace(const char* path);
+
+void unmapBinaryTrace();
+
+void getBinaryTraceLevelInfo(const char*& levelName, int& rows, int& cols,
+                             int& seed, int& weatherMode);
+
+int getBinaryTraceStringCount();
+
+const char* getBinaryTraceString(int index);
+
+int getBinaryTraceSwitchCount();
+
+const char* getBinaryTraceSwitchName(int switchId);
+
+int getBinaryTraceBlockCount();
+
+int getBinaryTraceBlockTick(int blockIndex);
+
+int findBinaryTraceBlock(int tick);
+
+bool loadBinaryTraceBlock(int blockIndex, int& tick,
+                          int& trainRows, const int*& trainIds,
+                          const unsigned short*& trainX, const unsigned short*& trainY,
+                          const unsigned char*& trainDir, const unsigned char*& trainState,
+                          int& switchRows, const unsigned short*& switchIds,
+                          const unsigned char*& switchMode, const unsigned char*& switchState,
+                          int& signalRows, const unsigned short*& signalIds,
+                          const unsigned char*& signalValue);
+
+#endif
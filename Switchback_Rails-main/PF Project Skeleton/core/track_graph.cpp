@@ -0,0 +1,163 @@
+#include "track_graph.h"
+#include "grid.h"
+
+using namespace std;
+
+// ============================================================================
+// TRACK_GRAPH.CPP - Straight-run table
+// ============================================================================
+
+static bool g_segmentAdvance = true;
+
+// ----------------------------------------------------------------------------
+// Settings
+// ----------------------------------------------------------------------------
+void setSegmentAdvanceEnabled(bool enabled) {
+    g_segmentAdvance = enabled;
+}
+
+bool isSegmentAdvanceEnabled() {
+    return g_segmentAdvance;
+}
+
+// ----------------------------------------------------------------------------
+// Straight cell with all four neighbours on the grid and none of them a spawn
+// ----------------------------------------------------------------------------
+static bool isOpenCell(const World& world, int x, int y) {
+    const int stepX[] = {0, 1, 0, -1};
+    const int stepY[] = {-1, 0, 1, 0};
+    
+    if(!isStraightTile(getTile(world, x, y))) {
+        return false;
+    }
+    for(int dir = 0; dir < 4; dir++) {
+        int nx = x + stepX[dir];
+        int ny = y + stepY[dir];
+        if(!isInBounds(nx, ny, world.gridCols, world.gridRows) || getTile(world, nx, ny) == 'S') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Expected runAhead of (x, y) heading dir, from the entry of the cell ahead
+// ----------------------------------------------------------------------------
+static unsigned short getExpectedRun(const World& world, int x, int y, int dir) {
+    const int stepX[] = {0, 1, 0, -1};
+    const int stepY[] = {-1, 0, 1, 0};
+    
+    if(!isStraightTile(getTile(world, x, y))) {
+        return RUN_NODE;
+    }
+    
+    long long cell = (long long)y * world.gridCols + x;
+    int nextX = x + stepX[dir];
+    int nextY = y + stepY[dir];
+    if(world.transitions[cell * 4 + dir] != dir ||
+       !isInBounds(nextX, nextY, world.gridCols, world.gridRows) || !isOpenCell(world, nextX, nextY)) {
+        return 0;
+    }
+    
+    long long next = (long long)nextY * world.gridCols + nextX;
+    unsigned short ahead = world.runAhead[next * 4 + dir];
+    return (ahead >= RUN_MAX) ? RUN_MAX : ahead + 1;
+}
+
+// ----------------------------------------------------------------------------
+// Fill runAhead for one heading, walking against it so the cell ahead is
+// always done first
+// ----------------------------------------------------------------------------
+static void buildRunsForDirection(World& world, int dir) {
+    bool backwardY = (dir == 2);
+    bool backwardX = (dir == 1);
+    
+    for(int row = 0; row < world.gridRows; row++) {
+        int y = backwardY ? world.gridRows - 1 - row : row;
+        for(int col = 0; col < world.gridCols; col++) {
+            int x = backwardX ? world.gridCols - 1 - col : col;
+            long long cell = (long long)y * world.gridCols + x;
+            world.runAhead[cell * 4 + dir] = getExpectedRun(world, x, y, dir);
+        }
+    }
+}
+
+void buildTrackGraph(World& world) {
+    for(int dir = 0; dir < 4; dir++) {
+        buildRunsForDirection(world, dir);
+    }
+}
+
+int validateTrackGraph(const World& world) {
+    int mismatches = 0;
+    for(int y = 0; y < world.gridRows; y++) {
+        for(int x = 0; x < world.gridCols; x++) {
+            long long cell = (long long)y * world.gridCols + x;
+            for(int dir = 0; dir < 4; dir++) {
+                if(world.runAhead[cell * 4 + dir] != getExpectedRun(world, x, y, dir)) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+// ----------------------------------------------------------------------------
+// Node and edge counts
+// ----------------------------------------------------------------------------
+// A run starts where the cell behind it is not straight; it is an edge when
+// the cell behind it or the one past its end is track
+void getTrackGraphStats(const World& world, TrackGraphStats& stats) {
+    const int stepX[] = {0, 1, 0, -1};
+    const int stepY[] = {-1, 0, 1, 0};
+    
+    stats.nodes = 0;
+    stats.straightCells = 0;
+    stats.edges = 0;
+    long long edgeCells = 0;
+    
+    for(int y = 0; y < world.gridRows; y++) {
+        for(int x = 0; x < world.gridCols; x++) {
+            char tile = getTile(world, x, y);
+            if(!isTrackTile(tile)) {
+                continue;
+            }
+            if(!isStraightTile(tile)) {
+                stats.nodes++;
+                continue;
+            }
+            stats.straightCells++;
+            
+            // Runs heading right and down, counted from their first cell
+            for(int dir = 1; dir <= 2; dir++) {
+                int backX = x - stepX[dir];
+                int backY = y - stepY[dir];
+                bool backIn = isInBounds(backX, backY, world.gridCols, world.gridRows);
+                if(backIn && isStraightTile(getTile(world, backX, backY))) {
+                    continue;
+                }
+                
+                int length = 1;
+                int endX = x + stepX[dir];
+                int endY = y + stepY[dir];
+                while(isInBounds(endX, endY, world.gridCols, world.gridRows) &&
+                      isStraightTile(getTile(world, endX, endY))) {
+                    length++;
+                    endX += stepX[dir];
+                    endY += stepY[dir];
+                }
+                
+                bool backTrack = backIn && isTrackTile(getTile(world, backX, backY));
+                bool endTrack = isInBounds(endX, endY, world.gridCols, world.gridRows) &&
+                                isTrackTile(getTile(world, endX, endY));
+                if(backTrack || endTrack) {
+                    stats.edges++;
+                    edgeCells += length;
+                }
+            }
+        }
+    }
+    
+    stats.meanEdgeLength = (stats.edges > 0) ? (double)edgeCells / stats.edges : 0.0;
+}
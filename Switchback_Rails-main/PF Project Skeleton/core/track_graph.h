@@ -0,0 +1,103 @@
+#ifndef TRACK_GRAPH_H
+#define TRACK_GRAPH_H
+
+// ============================================================================
+// TRACK_GRAPH.H - Straight runs compiled out of the grid
+// ============================================================================
+// The track is a graph. Its nodes are the cells where something can happen
+// to a train: switches, crossings, curves, spawns and destinations. The
+// other track cells ('-', '|', '=') are straight cells, where a train keeps
+// its heading and steps to the next cell. The straight cells between two
+// nodes in a row or column form an edge.
+//
+// buildTrackGraph() compiles the graph at load time into runAhead: for
+// every straight cell and heading, the number of open cells directly
+// ahead. An open cell is a straight cell whose four neighbours are on the
+// grid and are not spawns, so a train entering it can only meet trains that
+// were already on the track at the end of the last tick. A train that moves
+// looks up its new cell once and carries the result as trainRunLeft, its
+// offset from the end of the open part of the edge.
+//
+// While that offset is positive the train is cruising when no other train
+// is on its cell, on the cell ahead or on any neighbour of that cell
+// (cellTrainCount, kept by the signals). Nothing can then claim the cell
+// it enters or swap with it, so the routes phase steps it straight on
+// without reading the grid, and the collision engine leaves it out of the
+// claims and the priority distances. Positions are still written every
+// tick, so every output matches the cell-by-cell engine, which
+// setSegmentAdvanceEnabled(false) brings back for comparison.
+//
+// Safety toggles only swap '-', '|' and '=', so the graph never changes
+// after loading.
+// ============================================================================
+
+#include "world.h"
+
+const unsigned short RUN_NODE = 0xFFFF;     // runAhead of a node or off-track cell
+const unsigned short RUN_MAX = 0xFFFE;      // longer runs are cut to this
+
+inline bool isStraightTile(char tile) {
+    return tile == '-' || tile == '|' || tile == '=';
+}
+
+// ----------------------------------------------------------------------------
+// BUILD AND CHECK
+// ----------------------------------------------------------------------------
+// After the grid and the transition table (level_loader.cpp)
+void buildTrackGraph(World& world);
+
+// Checks every runAhead entry against the cell ahead; returns the number of
+// mismatching entries
+int validateTrackGraph(const World& world);
+
+struct TrackGraphStats {
+    long long nodes;
+    long long straightCells;
+    long long edges;            // runs with a node at one end at least
+    double meanEdgeLength;
+};
+
+void getTrackGraphStats(const World& world, TrackGraphStats& stats);
+
+// ----------------------------------------------------------------------------
+// TRAINS
+// ----------------------------------------------------------------------------
+// On by default
+void setSegmentAdvanceEnabled(bool enabled);
+
+bool isSegmentAdvanceEnabled();
+
+// Fresh offset of a train from its cell and heading, -1 on a node
+inline int lookupTrainRun(const World& world, int trainId) {
+    long long cell = (long long)world.trainY[trainId] * world.gridCols + world.trainX[trainId];
+    unsigned short ahead = world.runAhead[cell * 4 + world.trainDir[trainId]];
+    return (ahead == RUN_NODE) ? -1 : ahead;
+}
+
+// After a train moved: one cell further along its edge, or a fresh lookup
+// when it left a node or the open part of the edge
+inline void advanceTrainRun(World& world, int trainId) {
+    int left = world.trainRunLeft[trainId];
+    world.trainRunLeft[trainId] = (left > 0) ? left - 1 : lookupTrainRun(world, trainId);
+}
+
+// A train whose next move cannot interact with any other train this tick
+// (see above); called by the routes phase
+inline bool canTrainCruise(const World& world, int trainId) {
+    if(world.trainRunLeft[trainId] <= 0) {
+        return false;
+    }
+    
+    int dir = world.trainDir[trainId];
+    long long cols = world.gridCols;
+    long long step = ((dir == 1) - (dir == 3)) + ((dir == 2) - (dir == 0)) * cols;
+    long long side = ((dir == 0) - (dir == 2)) + ((dir == 1) - (dir == 3)) * cols;
+    long long cell = world.trainY[trainId] * cols + world.trainX[trainId];
+    long long next = cell + step;
+    
+    const int* count = world.cellTrainCount;
+    return count[cell] == 1 && count[next] == 0 && count[next + step] == 0 &&
+           count[next + side] == 0 && count[next - side] == 0;
+}
+
+#endif
@@ -2,6 +2,9 @@
 #include "simulation_state.h"
 #include "grid.h"
 #include "switches.h"
+#include "state_hash.h"
+#include "distance_kernels.h"
+#include "track_graph.h"
 #include <cstdlib>
 #include <iostream>
 
@@ -11,85 +14,229 @@ using namespace std;
 // TRAINS.CPP - Train logic
 // ============================================================================
 
+static bool g_regionGrouping = true;
+
 // ----------------------------------------------------------------------------
-// Spawn trains for current tick
+// Stable sort of train ids by key[id] (by id when key is nullptr)
 // ----------------------------------------------------------------------------
-void spawnTrainsForTick(int currentTick, int trainCount,
-                        int trainSpawnTick[], int trainX[], int trainY[],
-                        bool trainActive[], char grid[][100]) {
+void sortTrainIds(int ids[], int count, const int key[], int scratch[]) {
     
-    for(int i = 0; i < trainCount; i++) {
-        if(trainSpawnTick[i] == currentTick) {
-            trainActive[i] = true;
+    for(int width = 1; width < count; width *= 2) {
+        for(int lo = 0; lo < count; lo += 2 * width) {
+            int mid = (lo + width < count) ? lo + width : count;
+            int hi = (lo + 2 * width < count) ? lo + 2 * width : count;
+            
+            int a = lo;
+            int b = mid;
+            for(int k = lo; k < hi; k++) {
+                bool takeLeft = a < mid;
+                if(takeLeft && b < hi) {
+                    int keyA = (key != nullptr) ? key[ids[a]] : ids[a];
+                    int keyB = (key != nullptr) ? key[ids[b]] : ids[b];
+                    takeLeft = keyA <= keyB;
+                }
+                scratch[k] = takeLeft ? ids[a++] : ids[b++];
+            }
+        }
+        
+        for(int k = 0; k < count; k++) {
+            ids[k] = scratch[k];
         }
     }
 }
 
 // ----------------------------------------------------------------------------
-// Determine next position for a train
+// Sort the spawn schedule (called at load time)
 // ----------------------------------------------------------------------------
-bool determineNextPosition(int trainId, int trainCount, int trainX[], int trainY[], int trainDir[],
-                          int trainNextX[], int trainNextY[], int trainNextDir[],
-                          bool trainActive[], bool trainCrashed[],
-                          int trainDestX[], int trainDestY[],
-                          char grid[][100], int gridCols, int gridRows,
-                          bool switchExists[], int switchState[]) {
+void buildSpawnSchedule(World& world) {
     
-    if(!trainActive[trainId] || trainCrashed[trainId]) {
-        return false;
+    for(int i = 0; i < world.trainCount; i++) {
+        world.spawnOrder[i] = i;
+    }
+    sortTrainIds(world.spawnOrder, world.trainCount, world.trainSpawnTick, world.sortScratch);
+    world.spawnCursor = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Add a train to the active list
+// ----------------------------------------------------------------------------
+void activateTrain(World& world, int trainId) {
+    
+    int flags = getTrainFlags(world, trainId);
+    world.trainActive[trainId] = true;
+    rehashTrainFlags(world, trainId, flags);
+    world.trainRunLeft[trainId] = -1;
+    if(world.activeSlot[trainId] < 0) {
+        world.activeSlot[trainId] = world.activeCount;
+        world.activeList[world.activeCount++] = trainId;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Remove a train from the active list (swap with the last entry)
+// ----------------------------------------------------------------------------
+void deactivateTrain(World& world, int trainId) {
+    
+    int flags = getTrainFlags(world, trainId);
+    world.trainActive[trainId] = false;
+    rehashTrainFlags(world, trainId, flags);
+    
+    int slot = world.activeSlot[trainId];
+    if(slot < 0) {
+        return;
     }
     
-    int x = trainX[trainId];
-    int y = trainY[trainId];
-    int dir = trainDir[trainId];
+    int last = world.activeList[--world.activeCount];
+    world.activeList[slot] = last;
+    world.activeSlot[last] = slot;
+    world.activeSlot[trainId] = -1;
     
-    char currentTile = grid[y][x];
+    world.retiredList[world.retiredCount++] = trainId;
+}
+
+// ----------------------------------------------------------------------------
+// Active train ids in id order (into world.trainOrder); returns the count
+// ----------------------------------------------------------------------------
+int getActiveTrainsInIdOrder(World& world) {
     
-    int nextDir = dir;
+    for(int a = 0; a < world.activeCount; a++) {
+        world.trainOrder[a] = world.activeList[a];
+    }
+    sortTrainIds(world.trainOrder, world.activeCount, nullptr, world.sortScratch);
+    return world.activeCount;
+}
+
+// ----------------------------------------------------------------------------
+// Group the active list by region (counting sort on the region index)
+// ----------------------------------------------------------------------------
+// Rebuilt from the positions, so a train that crossed a region edge is
+// handed to its new region here. Within a region trains keep their list
+// order. No phase depends on the list order, so only the memory access
+// pattern changes.
+void setRegionGroupingEnabled(bool enabled) {
+    g_regionGrouping = enabled;
+}
+
+bool isRegionGroupingEnabled() {
+    return g_regionGrouping;
+}
+
+void groupActiveTrainsByRegion(World& world) {
+    int regions = getRegionCount(world);
+    int* start = world.regionStart;
     
-    if(currentTile == '+') {
-        nextDir = getSmartDirectionAtCrossing(x, y, dir, trainDestX[trainId], trainDestY[trainId]);
-    } else {
-        nextDir = getNextDirection(x, y, dir, currentTile, switchExists, switchState);
+    for(int r = 0; r <= regions; r++) {
+        start[r] = 0;
+    }
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        start[getRegionOfCell(world, world.trainX[i], world.trainY[i]) + 1]++;
+    }
+    for(int r = 0; r < regions; r++) {
+        start[r + 1] += start[r];
     }
     
-    int nextX = x;
-    int nextY = y;
+    // Fill through the region starts, which then point one region further
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        world.sortScratch[start[getRegionOfCell(world, world.trainX[i], world.trainY[i])]++] = i;
+    }
+    for(int r = regions; r > 0; r--) {
+        start[r] = start[r - 1];
+    }
+    start[0] = 0;
     
-    if(nextDir == 0) 
-    nextY--;
-    else if(nextDir == 1) 
-    nextX++;
-    else if(nextDir == 2) 
-    nextY++;
-    else if(nextDir == 3) 
-    nextX--;
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.sortScratch[a];
+        world.activeList[a] = i;
+        world.activeSlot[i] = a;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Spawn trains for current tick
+// ----------------------------------------------------------------------------
+// Walks the sorted schedule from where the previous call stopped. Trains
+// whose tick has already passed are skipped, as before.
+void spawnTrainsForTick(World& world, int currentTick) {
     
-    if(x == trainDestX[trainId] && y == trainDestY[trainId]) {
-        trainNextX[trainId] = x;
-        trainNextY[trainId] = y;
-        trainNextDir[trainId] = dir;
-        return true;
+    while(world.spawnCursor < world.trainCount) {
+        int i = world.spawnOrder[world.spawnCursor];
+        if(world.trainSpawnTick[i] > currentTick) {
+            break;
+        }
+        
+        if(world.trainSpawnTick[i] == currentTick) {
+            activateTrain(world, i);
+        }
+        world.spawnCursor++;
     }
+}
+
+// ----------------------------------------------------------------------------
+// Every train has reached its spawn tick
+// ----------------------------------------------------------------------------
+bool areAllTrainsSpawned(const World& world) {
+    return world.spawnCursor >= world.trainCount;
+}
+
+// ----------------------------------------------------------------------------
+// Determine next position for a train
+// ----------------------------------------------------------------------------
+static bool determineNextPosition(World& world, int trainId, unsigned long long parts[]) {
     
-    if(nextX < 0 || nextX >= gridCols || nextY < 0 || nextY >= gridRows) {
-        trainCrashed[trainId] = true;
+    world.trainCruising[trainId] = false;
+    if(!world.trainActive[trainId] || world.trainCrashed[trainId]) {
         return false;
     }
     
-    char nextTile = grid[nextY][nextX];
-    if(!isTrackTile(nextTile)) {
-        trainCrashed[trainId] = true;
+    int x = world.trainX[trainId];
+    int y = world.trainY[trainId];
+    int dir = world.trainDir[trainId];
+    
+    // Inside an edge of the track graph with nobody around: straight on,
+    // and the collision engine can skip the train (track_graph.h)
+    if(isSegmentAdvanceEnabled() && canTrainCruise(world, trainId)) {
+        world.trainNextX[trainId] = x + (dir == 1) - (dir == 3);
+        world.trainNextY[trainId] = y + (dir == 2) - (dir == 0);
+        world.trainNextDir[trainId] = dir;
+        world.trainCruising[trainId] = true;
+        return true;
+    }
+    
+    if(x == world.trainDestX[trainId] && y == world.trainDestY[trainId]) {
+        world.trainNextX[trainId] = x;
+        world.trainNextY[trainId] = y;
+        world.trainNextDir[trainId] = dir;
+        return true;
+    }
+    
+    if(getTile(world, x, y) == '+') {
+        dir = getSmartDirectionAtCrossing(world, x, y, dir, world.trainDestField[trainId],
+                                          world.trainDestX[trainId], world.trainDestY[trainId]);
+    }
+    
+    int nextX, nextY, nextDir;
+    bool onTrack = lookupTransition(world, x, y, dir, nextX, nextY, nextDir);
+    
+    if(!onTrack) {
+        int flags = getTrainFlags(world, trainId);
+        world.trainCrashed[trainId] = true;
+        updateStateHashParts(parts, HASH_TRAIN_FLAGS, trainId, flags, getTrainFlags(world, trainId));
         return false;
     }
     
-    trainNextX[trainId] = nextX;
-    trainNextY[trainId] = nextY;
-    trainNextDir[trainId] = nextDir;
+    world.trainNextX[trainId] = nextX;
+    world.trainNextY[trainId] = nextY;
+    world.trainNextDir[trainId] = nextDir;
     
     return true;
 }
 
+bool determineNextPosition(World& world, int trainId) {
+    return determineNextPosition(world, trainId, world.stateHash);
+}
+
 // ----------------------------------------------------------------------------
 // Get next direction based on tile
 // ----------------------------------------------------------------------------
@@ -104,7 +251,7 @@ int getNextDirection(int x, int y, int currentDir, char tile,
         return currentDir;
     }
     
-    if(tile >= 'A' && tile <= 'Z') {
+    if(isSwitchTile(tile)) {
         return currentDir;
     }
     
@@ -118,7 +265,7 @@ int getNextDirection(int x, int y, int currentDir, char tile,
         if(currentDir == 3)
          return 2;
     }
-
+    
     
     if(tile == '\\') {
         if(currentDir == 0) 
@@ -137,8 +284,32 @@ int getNextDirection(int x, int y, int currentDir, char tile,
 // ----------------------------------------------------------------------------
 // Smart routing at crossing toward destination
 // ----------------------------------------------------------------------------
-int getSmartDirectionAtCrossing(int x, int y, int currentDir,
-                               int destX, int destY) {
+// Takes the exit with the shortest track distance, keeping the current
+// direction on a tie. Falls back to the Manhattan deltas when no exit can
+// reach the destination.
+int getSmartDirectionAtCrossing(const World& world, int x, int y, int currentDir,
+                               int destField, int destX, int destY) {
+    
+    int bestDir = -1;
+    int bestDist = TRACK_DISTANCE_UNREACHABLE;
+    
+    for(int i = 0; i < 4; i++) {
+        int dir = (currentDir + i) % 4;
+        int nextX, nextY, nextDir;
+        if(!lookupTransition(world, x, y, dir, nextX, nextY, nextDir)) {
+            continue;
+        }
+        
+        int dist = getTrackDistance(world, destField, nextX, nextY, nextDir);
+        if(dist >= 0 && dist < bestDist) {
+            bestDist = dist;
+            bestDir = dir;
+        }
+    }
+    
+    if(bestDir >= 0) {
+        return bestDir;
+    }
     
     int dx = destX - x;
     int dy = destY - y;
@@ -164,155 +335,327 @@ int getSmartDirectionAtCrossing(int x, int y, int currentDir,
     return currentDir;
 }
 
+// ----------------------------------------------------------------------------
+// Distance used for collision priority: track distance to the destination,
+// or Manhattan distance when the destination has no distance field
+// ----------------------------------------------------------------------------
+int getPriorityDistance(const World& world, int trainId) {
+    int dist = getTrackDistance(world, world.trainDestField[trainId],
+                                world.trainX[trainId], world.trainY[trainId],
+                                world.trainDir[trainId]);
+    if(dist >= 0) {
+        return dist;
+    }
+    return calculateManhattanDistance(world.trainX[trainId], world.trainY[trainId],
+                                      world.trainDestX[trainId], world.trainDestY[trainId]);
+}
+
 // ----------------------------------------------------------------------------
 // Determine all routes
 // ----------------------------------------------------------------------------
-void determineAllRoutes(int trainCount, int trainX[], int trainY[], int trainDir[],
-                       int trainNextX[], int trainNextY[], int trainNextDir[],
-                       bool trainActive[], bool trainCrashed[],
-                       int trainDestX[], int trainDestY[],
-                       char grid[][100], int gridCols, int gridRows,
-                       bool switchExists[], int switchState[]) {
+void determineAllRoutes(World& world) {
+    determineRoutesInRange(world, 0, world.activeCount, world.stateHash);
+}
+
+void determineRoutesInRange(World& world, int begin, int end, unsigned long long parts[]) {
+    
+    for(int a = begin; a < end; a++) {
+        determineNextPosition(world, world.activeList[a], parts);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Move all trains
+// ----------------------------------------------------------------------------
+void moveAllTrains(World& world) {
+    moveTrainsInRange(world, 0, world.activeCount, world.stateHash);
+}
+
+void moveTrainsInRange(World& world, int begin, int end, unsigned long long parts[]) {
     
-    for(int i = 0; i < trainCount; i++) {
-        if(!trainActive[i] || trainCrashed[i]) {
+    for(int a = begin; a < end; a++) {
+        int i = world.activeList[a];
+        if(world.trainCrashed[i] || world.trainDelivered[i]) {
             continue;
         }
         
-        int x = trainX[i];
-        int y = trainY[i];
-        int dir = trainDir[i];
-        
-        char currentTile = grid[y][x];
-        
-        int nextDir = dir;
-        
-        if(currentTile == '+') {
-            nextDir = getSmartDirectionAtCrossing(x, y, dir, trainDestX[i], trainDestY[i]);
-        } else {
-            nextDir = getNextDirection(x, y, dir, currentTile, switchExists, switchState);
-        }
-        
-        int nextX = x;
-        int nextY = y;
+        updateStateHashParts(parts, HASH_TRAIN_POSITION, i,
+                             world.trainY[i] * world.gridCols + world.trainX[i],
+                             world.trainNextY[i] * world.gridCols + world.trainNextX[i]);
+        updateStateHashParts(parts, HASH_TRAIN_DIRECTION, i, world.trainDir[i],
+                             world.trainNextDir[i]);
         
-        if(nextDir == 0) 
-        nextY--;
-        else if(nextDir == 1) 
-        nextX++;
-        else if(nextDir == 2) 
-        nextY++;
-        else if(nextDir == 3) 
-        nextX--;
-        
-        if(x == trainDestX[i] && y == trainDestY[i]) {
-            trainNextX[i] = x;
-            trainNextY[i] = y;
-            trainNextDir[i] = dir;
-            continue;
+        bool moved = world.trainNextX[i] != world.trainX[i] ||
+                     world.trainNextY[i] != world.trainY[i];
+        world.trainX[i] = world.trainNextX[i];
+        world.trainY[i] = world.trainNextY[i];
+        world.trainDir[i] = world.trainNextDir[i];
+        if(moved) {
+            advanceTrainRun(world, i);
         }
+    }
+}
 
-        if(nextX < 0 || nextX >= gridCols || nextY < 0 || nextY >= gridRows) {
-            trainCrashed[i] = true;
-            continue;
-        }
-        
-        char nextTile = grid[nextY][nextX];
-        if(!isTrackTile(nextTile)) {
-            trainCrashed[i] = true;
-            continue;
+// ----------------------------------------------------------------------------
+// Collision engine
+// ----------------------------------------------------------------------------
+// Every train claims the cell it wants to enter; a train that is held back
+// re-claims its own cell. Claims live in linked lists hanging off an open
+// addressing hash keyed on the packed cell index. Slots are reset lazily
+// through a stamp, so a tick only touches the cells trains actually claim.
+
+// ----------------------------------------------------------------------------
+// Hash slot of a packed key (linear probing)
+// ----------------------------------------------------------------------------
+int hashSlot(long long key, int tableSize) {
+    unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ull;
+    return (int)(h >> 32) & (tableSize - 1);
+}
+
+// ----------------------------------------------------------------------------
+// Find or create the claim slot of a cell
+// ----------------------------------------------------------------------------
+int findClaimSlot(World& world, long long cell) {
+    int mask = world.claimTableSize - 1;
+    int slot = hashSlot(cell, world.claimTableSize);
+    
+    while(world.claimStamp[slot] == world.collisionStamp) {
+        if(world.claimKey[slot] == cell) {
+            return slot;
         }
-        
-        trainNextX[i] = nextX;
-        trainNextY[i] = nextY;
-        trainNextDir[i] = nextDir;
+        slot = (slot + 1) & mask;
     }
+    
+    world.claimStamp[slot] = world.collisionStamp;
+    world.claimKey[slot] = cell;
+    world.claimHead[slot] = -1;
+    world.claimQueued[slot] = false;
+    return slot;
 }
 
 // ----------------------------------------------------------------------------
-// Move all trains
+// Add a claim on a cell and queue the cell for resolution
 // ----------------------------------------------------------------------------
-void moveAllTrains(int trainCount, int trainX[], int trainY[], int trainDir[],
-                  int trainNextX[], int trainNextY[], int trainNextDir[],
-                  bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-                  int trainWaitTicks[], char grid[][100]) {
+void addCellClaim(World& world, int x, int y, int trainId) {
+    int slot = findClaimSlot(world, (long long)y * world.gridCols + x);
     
-    for(int i = 0; i < trainCount; i++) {
-        if(!trainActive[i] || trainCrashed[i] || trainDelivered[i]) {
-            continue;
-        }
-        
-        trainX[i] = trainNextX[i];
-        trainY[i] = trainNextY[i];
-        trainDir[i] = trainNextDir[i];
+    world.claimTrain[world.claimCount] = trainId;
+    world.claimNext[world.claimCount] = world.claimHead[slot];
+    world.claimHead[slot] = world.claimCount;
+    world.claimCount++;
+    
+    if(!world.claimQueued[slot]) {
+        world.claimQueued[slot] = true;
+        world.claimQueue[world.queueTail++] = slot;
     }
 }
 
 // ----------------------------------------------------------------------------
-// Detect collisions with distance-based priority
+// Keep a train where it is; its own cell becomes its new claim
+// ----------------------------------------------------------------------------
+void holdTrain(World& world, int trainId) {
+    
+    bool wasMoving = world.trainNextX[trainId] != world.trainX[trainId] ||
+                     world.trainNextY[trainId] != world.trainY[trainId];
+    
+    world.trainNextX[trainId] = world.trainX[trainId];
+    world.trainNextY[trainId] = world.trainY[trainId];
+    world.trainNextDir[trainId] = world.trainDir[trainId];
+    
+    if(wasMoving) {
+        addCellClaim(world, world.trainX[trainId], world.trainY[trainId], trainId);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Is this claim still live (train not crashed and still heading for the cell)
+// ----------------------------------------------------------------------------
+bool isLiveClaim(const World& world, int trainId, long long cell) {
+    return !world.trainCrashed[trainId] &&
+           (long long)world.trainNextY[trainId] * world.gridCols + world.trainNextX[trainId] == cell;
+}
+
+// ----------------------------------------------------------------------------
+// Resolve every queued cell that has more than one live claim
 // ----------------------------------------------------------------------------
-void detectCollisions(int trainCount, int trainX[], int trainY[],
-                     int trainNextX[], int trainNextY[], int trainNextDir[],
-                     int trainDir[],
-                     int trainDestX[], int trainDestY[],
-                     bool trainActive[], bool trainCrashed[], bool trainDelivered[]) {
+// The farthest train from its destination keeps the cell and everyone else
+// waits. If the farthest distance is shared, those trains crash and the rest
+// still wait. Cells are resolved in rounds and the trains told to wait only
+// re-claim their own cells once the round is over, so the outcome depends on
+// the claims alone and never on the order trains or cells are visited in.
+void resolveCellClaims(World& world) {
     
-    for(int i = 0; i < trainCount; i++) {
-        if(!trainActive[i] || trainCrashed[i] || trainDelivered[i]) 
-        continue;
+    while(world.queueHead < world.queueTail) {
+        int roundEnd = world.queueTail;
+        world.holdCount = 0;
         
-        for(int j = i + 1; j < trainCount; j++) {
-            if(!trainActive[j] || trainCrashed[j] || trainDelivered[j]) 
-            continue;
+        while(world.queueHead < roundEnd) {
+            int slot = world.claimQueue[world.queueHead++];
+            long long cell = world.claimKey[slot];
+            world.claimQueued[slot] = false;
             
-            if(trainNextX[i] == trainNextX[j] && trainNextY[i] == trainNextY[j]) {
-                
-                int dist_i = calculateManhattanDistance(trainX[i], trainY[i], 
-                                                       trainDestX[i], trainDestY[i]);
-                int dist_j = calculateManhattanDistance(trainX[j], trainY[j], 
-                                                       trainDestX[j], trainDestY[j]);
-                
-                if(dist_i == dist_j) {
-                    trainCrashed[i] = true;
-                    trainCrashed[j] = true;
-                } 
-                else if(dist_i > dist_j) {
-                    trainNextX[j] = trainX[j];
-                    trainNextY[j] = trainY[j];
-                    trainNextDir[j] = trainDir[j];
-                } 
-                else {
-                    trainNextX[i] = trainX[i];
-                    trainNextY[i] = trainY[i];
-                    trainNextDir[i] = trainDir[i];
+            int bestDist = -1;
+            int bestCount = 0;
+            int claimants = 0;
+            
+            for(int c = world.claimHead[slot]; c >= 0; c = world.claimNext[c]) {
+                int t = world.claimTrain[c];
+                if(!isLiveClaim(world, t, cell)) {
+                    continue;
+                }
+                claimants++;
+                if(world.collisionDist[t] > bestDist) {
+                    bestDist = world.collisionDist[t];
+                    bestCount = 1;
+                }
+                else if(world.collisionDist[t] == bestDist) {
+                    bestCount++;
                 }
             }
             
-            if(trainNextX[i] == trainX[j] && trainNextY[i] == trainY[j] &&
-               trainNextX[j] == trainX[i] && trainNextY[j] == trainY[i]) {
-                
-                int dist_i = calculateManhattanDistance(trainX[i], trainY[i], 
-                                                       trainDestX[i], trainDestY[i]);
-                int dist_j = calculateManhattanDistance(trainX[j], trainY[j], 
-                                                       trainDestX[j], trainDestY[j]);
-                
-                if(dist_i == dist_j) {
-                    trainCrashed[i] = true;
-                    trainCrashed[j] = true;
-                } 
-                else if(dist_i > dist_j) {
-                    trainNextX[j] = trainX[j];
-                    trainNextY[j] = trainY[j];
-                    trainNextDir[j] = trainDir[j];
-                } 
+            if(claimants < 2) {
+                continue;
+            }
+            
+            for(int c = world.claimHead[slot]; c >= 0; c = world.claimNext[c]) {
+                int t = world.claimTrain[c];
+                if(!isLiveClaim(world, t, cell)) {
+                    continue;
+                }
+                if(world.collisionDist[t] == bestDist) {
+                    if(bestCount > 1) {
+                        int flags = getTrainFlags(world, t);
+                        world.trainCrashed[t] = true;
+                        rehashTrainFlags(world, t, flags);
+                    }
+                }
                 else {
-                    trainNextX[i] = trainX[i];
-                    trainNextY[i] = trainY[i];
-                    trainNextDir[i] = trainDir[i];
+                    world.holdList[world.holdCount++] = t;
                 }
             }
         }
+        
+        for(int h = 0; h < world.holdCount; h++) {
+            holdTrain(world, world.holdList[h]);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Direction of a one-cell step (0=up, 1=right, 2=down, 3=left)
+// ----------------------------------------------------------------------------
+int stepDirection(int fromX, int fromY, int toX, int toY) {
+    if(toY < fromY) return 0;
+    if(toX > fromX) return 1;
+    if(toY > fromY) return 2;
+    return 3;
+}
+
+// ----------------------------------------------------------------------------
+// Packed key of the directed edge leaving (x, y) in direction dir
+// ----------------------------------------------------------------------------
+long long edgeKey(const World& world, int x, int y, int dir) {
+    return ((long long)y * world.gridCols + x) * 4 + dir;
+}
+
+// ----------------------------------------------------------------------------
+// Detect collisions with distance-based priority
+// ----------------------------------------------------------------------------
+// Same-cell claims are resolved first, then head-on swaps found through the
+// directed edge hash, then any cells that trains held back by a swap now
+// share. Cruising trains have no train near their next cell, so they are
+// left out (track_graph.h). Work is proportional to the number of trains
+// that are not cruising.
+void detectCollisions(World& world) {
+    
+    world.collisionStamp++;
+    world.claimCount = 0;
+    world.queueHead = 0;
+    world.queueTail = 0;
+    
+    int moverCount = 0;
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        if(world.trainCrashed[i] || world.trainDelivered[i] || world.trainCruising[i]) {
+            continue;
+        }
+        world.moverList[moverCount++] = i;
+    }
+    
+    // Every mover's priority in one batch (distance_kernels.h)
+    computePriorityDistances(world, world.moverList, moverCount, world.collisionDist);
+    for(int m = 0; m < moverCount; m++) {
+        int i = world.moverList[m];
+        addCellClaim(world, world.trainNextX[i], world.trainNextY[i], i);
+    }
+    
+    resolveCellClaims(world);
+    
+    // Directed edges of the trains that still move
+    int edgeMask = world.edgeTableSize - 1;
+    for(int m = 0; m < moverCount; m++) {
+        int i = world.moverList[m];
+        int x = world.trainX[i];
+        int y = world.trainY[i];
+        int nextX = world.trainNextX[i];
+        int nextY = world.trainNextY[i];
+        if(world.trainCrashed[i] || (nextX == x && nextY == y)) {
+            continue;
+        }
+        
+        long long key = edgeKey(world, x, y, stepDirection(x, y, nextX, nextY));
+        int slot = hashSlot(key, world.edgeTableSize);
+        while(world.edgeStamp[slot] == world.collisionStamp && world.edgeKey[slot] != key) {
+            slot = (slot + 1) & edgeMask;
+        }
+        world.edgeStamp[slot] = world.collisionStamp;
+        world.edgeKey[slot] = key;
+        world.edgeOwner[slot] = i;
+    }
+    
+    // A swap is an edge whose reverse edge is also taken. Each train owns one
+    // edge, so every swap pair is seen from both ends; handle it once.
+    for(int m = 0; m < moverCount; m++) {
+        int i = world.moverList[m];
+        int x = world.trainX[i];
+        int y = world.trainY[i];
+        int nextX = world.trainNextX[i];
+        int nextY = world.trainNextY[i];
+        if(world.trainCrashed[i] || (nextX == x && nextY == y)) {
+            continue;
+        }
+        
+        long long reverse = edgeKey(world, nextX, nextY, stepDirection(nextX, nextY, x, y));
+        int slot = hashSlot(reverse, world.edgeTableSize);
+        while(world.edgeStamp[slot] == world.collisionStamp && world.edgeKey[slot] != reverse) {
+            slot = (slot + 1) & edgeMask;
+        }
+        if(world.edgeStamp[slot] != world.collisionStamp) {
+            continue;
+        }
+        
+        int j = world.edgeOwner[slot];
+        if(j <= i || world.trainCrashed[j]) {
+            continue;
+        }
+        
+        if(world.collisionDist[i] == world.collisionDist[j]) {
+            int flagsI = getTrainFlags(world, i);
+            int flagsJ = getTrainFlags(world, j);
+            world.trainCrashed[i] = true;
+            world.trainCrashed[j] = true;
+            rehashTrainFlags(world, i, flagsI);
+            rehashTrainFlags(world, j, flagsJ);
+        }
+        else if(world.collisionDist[i] > world.collisionDist[j]) {
+            holdTrain(world, j);
+        }
+        else {
+            holdTrain(world, i);
+        }
     }
+    
+    resolveCellClaims(world);
 }
 
 // ----------------------------------------------------------------------------
@@ -324,31 +667,109 @@ int calculateManhattanDistance(int x1, int y1, int x2, int y2) {
     return (dx >= 0 ? dx : -dx) + (dy >= 0 ? dy : -dy);
 }
 
+// ----------------------------------------------------------------------------
+// Closest pair of active trains
+// ----------------------------------------------------------------------------
+// Trains go into squares of range + 1 cells, kept in the claim hash (keyed
+// on the square instead of the cell), so two trains within range are in
+// the same or neighbouring squares and only those are compared. Returns
+// range + 1 when no two trains are that close.
+int findClosestTrainDistance(World& world, int range) {
+    
+    int size = range + 1;
+    world.collisionStamp++;
+    world.claimCount = 0;
+    
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        long long square = ((long long)(world.trainY[i] / size + 1) << 32) |
+                           (world.trainX[i] / size + 1);
+        int slot = findClaimSlot(world, square);
+        
+        int node = world.claimCount++;
+        world.claimTrain[node] = i;
+        world.claimNext[node] = world.claimHead[slot];
+        world.claimHead[slot] = node;
+    }
+    
+    int mask = world.claimTableSize - 1;
+    int closest = range + 1;
+    for(int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        int squareX = world.trainX[i] / size + 1;
+        int squareY = world.trainY[i] / size + 1;
+        
+        for(int oy = -1; oy <= 1; oy++) {
+            for(int ox = -1; ox <= 1; ox++) {
+                long long square = ((long long)(squareY + oy) << 32) | (squareX + ox);
+                
+                // Lookup only: empty squares get no slot
+                int slot = hashSlot(square, world.claimTableSize);
+                while(world.claimStamp[slot] == world.collisionStamp &&
+                      world.claimKey[slot] != square) {
+                    slot = (slot + 1) & mask;
+                }
+                if(world.claimStamp[slot] != world.collisionStamp) continue;
+                
+                for(int node = world.claimHead[slot]; node >= 0; node = world.claimNext[node]) {
+                    int j = world.claimTrain[node];
+                    if(j <= i) continue;
+                    
+                    int distance = calculateManhattanDistance(world.trainX[i], world.trainY[i],
+                                                              world.trainX[j], world.trainY[j]);
+                    if(distance < closest) {
+                        closest = distance;
+                    }
+                }
+            }
+        }
+    }
+    
+    return closest;
+}
+
 // ----------------------------------------------------------------------------
 // Check arrivals
 // ----------------------------------------------------------------------------
-void checkArrivals(int trainCount, int trainX[], int trainY[],
-                  int trainDestX[], int trainDestY[],
-                  bool trainActive[], bool trainDelivered[], int& trainsDelivered) {
+void checkArrivals(World& world) {
     
-    for(int i = 0; i < trainCount; i++) {
-        if(!trainActive[i] || trainDelivered[i]) {
+    // Backwards, so the entry swapped into a removed slot was already checked
+    for(int a = world.activeCount - 1; a >= 0; a--) {
+        int i = world.activeList[a];
+        if(world.trainDelivered[i]) {
             continue;
         }
         
-        if(trainX[i] == trainDestX[i] && trainY[i] == trainDestY[i]) {
-            trainDelivered[i] = true;
-            trainActive[i] = false;
-            trainsDelivered++;
+        if(world.trainX[i] == world.trainDestX[i] && world.trainY[i] == world.trainDestY[i]) {
+            int flags = getTrainFlags(world, i);
+            world.trainDelivered[i] = true;
+            rehashTrainFlags(world, i, flags);
+            deactivateTrain(world, i);
+            world.trainsDelivered++;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Take crashed trains off the track; returns how many were removed
+// ----------------------------------------------------------------------------
+int removeCrashedTrains(World& world) {
+    
+    int removed = 0;
+    for(int a = world.activeCount - 1; a >= 0; a--) {
+        int i = world.activeList[a];
+        if(world.trainCrashed[i]) {
+            deactivateTrain(world, i);
+            removed++;
         }
     }
+    return removed;
 }
 
 // ----------------------------------------------------------------------------
 // Apply emergency halt
 // ----------------------------------------------------------------------------
-void applyEmergencyHalt(int trainCount, int trainX[], int trainY[],
-                       bool trainActive[], bool trainCrashed[]) {
+void applyEmergencyHalt() {
     // Stub function for emergency halt
 }
 
@@ -358,4 +779,3 @@ void applyEmergencyHalt(int trainCount, int trainX[], int trainY[],
 void updateEmergencyHalt() {
     // Stub function for emergency halt timer
 }
-
@@ -5,70 +5,95 @@
 // TRAINS.H - Train logic
 // ============================================================================
 
+#include "world.h"
+
 // ----------------------------------------------------------------------------
 // TRAIN SPAWNING
 // ----------------------------------------------------------------------------
-void spawnTrainsForTick(int currentTick, int trainCount,
-                        int trainSpawnTick[], int trainX[], int trainY[],
-                        bool trainActive[], char grid[][100]);
+void buildSpawnSchedule(World& world);
+
+void spawnTrainsForTick(World& world, int currentTick);
+
+bool areAllTrainsSpawned(const World& world);
+
+// ----------------------------------------------------------------------------
+// ACTIVE TRAIN LIST
+// ----------------------------------------------------------------------------
+// Every phase walks world.activeList instead of the whole roster. Removal
+// swaps the last entry into the freed slot, and no phase depends on the
+// order of the list.
+void activateTrain(World& world, int trainId);
+
+void deactivateTrain(World& world, int trainId);
+
+int getActiveTrainsInIdOrder(World& world);
+
+// Every REGION_REGROUP_TICKS ticks, after the spawns, the list is sorted by
+// region (world.h), so the phases touch one patch of the grid at a time. The
+// trains of region r are then activeList[regionStart[r] .. regionStart[r + 1]).
+// Trains move one cell per tick, so in between only the new trains and the
+// few that crossed a region edge are out of place. On by default;
+// setRegionGroupingEnabled(false) keeps the list in activation order.
+const int REGION_REGROUP_TICKS = 8;
+
+void setRegionGroupingEnabled(bool enabled);
+
+bool isRegionGroupingEnabled();
+
+void groupActiveTrainsByRegion(World& world);
+
+void sortTrainIds(int ids[], int count, const int key[], int scratch[]);
 
 // ----------------------------------------------------------------------------
 // TRAIN ROUTING
 // ----------------------------------------------------------------------------
-void determineAllRoutes(int trainCount, int trainX[], int trainY[], int trainDir[],
-                       int trainNextX[], int trainNextY[], int trainNextDir[],
-                       bool trainActive[], bool trainCrashed[],
-                       int trainDestX[], int trainDestY[],
-                       char grid[][100], int gridCols, int gridRows,
-                       bool switchExists[], int switchState[]);
-
-bool determineNextPosition(int trainId, int trainCount, int trainX[], int trainY[], int trainDir[],
-                          int trainNextX[], int trainNextY[], int trainNextDir[],
-                          bool trainActive[], bool trainCrashed[],
-                          int trainDestX[], int trainDestY[],
-                          char grid[][100], int gridCols, int gridRows,
-                          bool switchExists[], int switchState[]);
+void determineAllRoutes(World& world);
+
+bool determineNextPosition(World& world, int trainId);
+
+// Routes of activeList[begin .. end), with hash changes XORed into parts
+// (HASH_PART_COUNT values) instead of world.stateHash
+void determineRoutesInRange(World& world, int begin, int end, unsigned long long parts[]);
 
 int getNextDirection(int x, int y, int currentDir, char tile,
                     bool switchExists[], int switchState[]);
 
-int getSmartDirectionAtCrossing(int x, int y, int currentDir,
-                               int destX, int destY);
+int getSmartDirectionAtCrossing(const World& world, int x, int y, int currentDir,
+                               int destField, int destX, int destY);
 
 // ----------------------------------------------------------------------------
 // TRAIN MOVEMENT
 // ----------------------------------------------------------------------------
-void moveAllTrains(int trainCount, int trainX[], int trainY[], int trainDir[],
-                  int trainNextX[], int trainNextY[], int trainNextDir[],
-                  bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-                  int trainWaitTicks[], char grid[][100]);
+void moveAllTrains(World& world);
+
+// Same as determineRoutesInRange(), for moves
+void moveTrainsInRange(World& world, int begin, int end, unsigned long long parts[]);
 
 // ----------------------------------------------------------------------------
 // COLLISION DETECTION
 // ----------------------------------------------------------------------------
-void detectCollisions(int trainCount, int trainX[], int trainY[],
-                     int trainNextX[], int trainNextY[], int trainNextDir[],
-                     int trainDir[],
-                     int trainDestX[], int trainDestY[],
-                     bool trainActive[], bool trainCrashed[], bool trainDelivered[]);
+void detectCollisions(World& world);
 
 int calculateManhattanDistance(int x1, int y1, int x2, int y2);
 
+int getPriorityDistance(const World& world, int trainId);
+
+// Smallest Manhattan distance between two active trains if it is at most
+// range, else range + 1. Uses the collision scratch tables.
+int findClosestTrainDistance(World& world, int range);
+
 // ----------------------------------------------------------------------------
 // ARRIVALS
 // ----------------------------------------------------------------------------
-void checkArrivals(int trainCount, int trainX[], int trainY[],
-                  int trainDestX[], int trainDestY[],
-                  bool trainActive[], bool trainDelivered[],
-                  int& trainsDelivered);
+void checkArrivals(World& world);
+
+int removeCrashedTrains(World& world);
 
 // ----------------------------------------------------------------------------
 // EMERGENCY HALT
 // ----------------------------------------------------------------------------
-void applyEmergencyHalt(int trainCount, int trainX[], int trainY[],
-                       bool trainActive[], bool trainCrashed[]);
+void applyEmergencyHalt();
 
 void updateEmergencyHalt();
 
 #endif
-
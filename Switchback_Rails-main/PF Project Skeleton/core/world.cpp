@@ -0,0 +1,358 @@
+#include "world.h"
+#include <cstdlib>
+#include <cstring>
+
+// ============================================================================
+// WORLD.CPP - World allocation
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Array table
+// ----------------------------------------------------------------------------
+// Every array of a world is listed once here with its size in bytes and its
+// kind, so allocation, copying and snapshots cannot miss one. Each entry
+// points at the pointer field; the field is read and written with memcpy.
+//
+// All arrays share one allocation: first every ARRAY_STATE array (the state
+// block, see snapshot.h), then the ARRAY_LEVEL arrays, then ARRAY_SCRATCH.
+const int MAX_WORLD_ARRAYS = 96;
+const int ARRAY_ALIGN = 64;
+
+const int ARRAY_STATE = 0;      // changes while ticking, part of snapshots
+const int ARRAY_LEVEL = 1;      // fixed once the level is loaded
+const int ARRAY_SCRATCH = 2;    // rebuilt within a tick, never saved
+
+struct WorldArray {
+    void* field;
+    long long bytes;
+    int kind;
+};
+
+template<typename T>
+static void addArray(WorldArray arrays[], int& count, T*& array, long long length, int kind) {
+    arrays[count].field = &array;
+    arrays[count].bytes = (length > 0) ? length * (long long)sizeof(T) : 0;
+    arrays[count].kind = kind;
+    count++;
+}
+
+static int listWorldArrays(World& world, WorldArray arrays[]) {
+    long long cells = (long long)world.gridRows * world.gridCols;
+    long long trains = world.trainCapacity;
+    long long switches = world.switchCapacity;
+    int count = 0;
+    
+    addArray(arrays, count, world.grid, cells, ARRAY_STATE);
+    
+    addArray(arrays, count, world.trainX, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainY, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainDir, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainNextX, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainNextY, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainNextDir, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainPrevX, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainPrevY, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainDestX, trains, ARRAY_LEVEL);
+    addArray(arrays, count, world.trainDestY, trains, ARRAY_LEVEL);
+    addArray(arrays, count, world.trainDestField, trains, ARRAY_LEVEL);
+    addArray(arrays, count, world.trainSpawnTick, trains, ARRAY_LEVEL);
+    addArray(arrays, count, world.trainColor, trains, ARRAY_LEVEL);
+    addArray(arrays, count, world.trainActive, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainCrashed, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainDelivered, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainWaitTicks, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainTotalWaitTicks, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainRunLeft, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainCruising, trains, ARRAY_SCRATCH);
+    
+    addArray(arrays, count, world.spawnOrder, trains, ARRAY_LEVEL);
+    addArray(arrays, count, world.activeList, trains, ARRAY_STATE);
+    addArray(arrays, count, world.activeSlot, trains, ARRAY_STATE);
+    addArray(arrays, count, world.retiredList, trains, ARRAY_STATE);
+    addArray(arrays, count, world.trainOrder, trains, ARRAY_SCRATCH);
+    addArray(arrays, count, world.sortScratch, trains, ARRAY_SCRATCH);
+    addArray(arrays, count, world.regionStart, getRegionCount(world) + 1, ARRAY_SCRATCH);
+    
+    addArray(arrays, count, world.switchNames, switches * SWITCH_NAME_LEN, ARRAY_LEVEL);
+    addArray(arrays, count, world.switchState, switches, ARRAY_STATE);
+    addArray(arrays, count, world.switchMode, switches, ARRAY_LEVEL);
+    addArray(arrays, count, world.switchCounters, switches * 4, ARRAY_STATE);
+    addArray(arrays, count, world.switchKValues, switches * 4, ARRAY_LEVEL);
+    addArray(arrays, count, world.switchFlipQueued, switches, ARRAY_STATE);
+    addArray(arrays, count, world.switchSignal, switches, ARRAY_STATE);
+    addArray(arrays, count, world.switchStateNames, switches * 2 * SWITCH_STATE_NAME_LEN, ARRAY_LEVEL);
+    
+    addArray(arrays, count, world.spawnX, world.spawnCapacity, ARRAY_LEVEL);
+    addArray(arrays, count, world.spawnY, world.spawnCapacity, ARRAY_LEVEL);
+    addArray(arrays, count, world.destX, world.destCapacity, ARRAY_LEVEL);
+    addArray(arrays, count, world.destY, world.destCapacity, ARRAY_LEVEL);
+    
+    // Safety toggles only cycle a straight tile through '|', '=' and '-',
+    // which all lead straight on, so none of these tables changes while ticking
+    addArray(arrays, count, world.transitions, cells * 4, ARRAY_LEVEL);
+    addArray(arrays, count, world.trackDist, cells * 4 * world.destCapacity, ARRAY_LEVEL);
+    addArray(arrays, count, world.runAhead, cells * 4, ARRAY_LEVEL);
+    addArray(arrays, count, world.quietRun, cells * 4, ARRAY_LEVEL);
+    addArray(arrays, count, world.fieldDirty, world.destCapacity, ARRAY_SCRATCH);
+    addArray(arrays, count, world.bfsQueue, cells * 4, ARRAY_SCRATCH);
+    
+    addArray(arrays, count, world.switchAtCell, cells, ARRAY_LEVEL);
+    addArray(arrays, count, world.switchX, switches, ARRAY_LEVEL);
+    addArray(arrays, count, world.switchY, switches, ARRAY_LEVEL);
+    addArray(arrays, count, world.cellTrainCount, cells, ARRAY_STATE);
+    addArray(arrays, count, world.seenX, trains, ARRAY_STATE);
+    addArray(arrays, count, world.seenY, trains, ARRAY_STATE);
+    addArray(arrays, count, world.seenActive, trains, ARRAY_STATE);
+    addArray(arrays, count, world.signalDirty, switches, ARRAY_STATE);
+    addArray(arrays, count, world.signalDirtyList, switches, ARRAY_STATE);
+    
+    addArray(arrays, count, world.claimKey, world.claimTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.claimStamp, world.claimTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.claimHead, world.claimTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.claimQueued, world.claimTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.edgeKey, world.edgeTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.edgeStamp, world.edgeTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.edgeOwner, world.edgeTableSize, ARRAY_SCRATCH);
+    addArray(arrays, count, world.claimTrain, trains * 2, ARRAY_SCRATCH);
+    addArray(arrays, count, world.claimNext, trains * 2, ARRAY_SCRATCH);
+    addArray(arrays, count, world.claimQueue, trains * 2, ARRAY_SCRATCH);
+    addArray(arrays, count, world.holdList, trains, ARRAY_SCRATCH);
+    addArray(arrays, count, world.moverList, trains, ARRAY_SCRATCH);
+    addArray(arrays, count, world.collisionDist, trains, ARRAY_SCRATCH);
+    
+    addArray(arrays, count, world.loggedSwitchState, switches, ARRAY_STATE);
+    addArray(arrays, count, world.loggedSignal, switches, ARRAY_STATE);
+    
+    return count;
+}
+
+static void setArray(const WorldArray& entry, unsigned char* array) {
+    memcpy(entry.field, &array, sizeof(array));
+}
+
+static long long alignBytes(long long bytes) {
+    return (bytes + ARRAY_ALIGN - 1) / ARRAY_ALIGN * ARRAY_ALIGN;
+}
+
+// ----------------------------------------------------------------------------
+// Point every array into world.memory (nullptr: only compute the sizes)
+// ----------------------------------------------------------------------------
+// Sets world.stateBytes and levelBytes and returns the total size. The layout depends only
+// on the sizes, so two worlds of the same sizes have identical layouts.
+static long long layoutWorldArrays(World& world, unsigned char* memory) {
+    WorldArray arrays[MAX_WORLD_ARRAYS];
+    int count = listWorldArrays(world, arrays);
+    long long offset = 0;
+    
+    for(int kind = ARRAY_STATE; kind <= ARRAY_SCRATCH; kind++) {
+        for(int i = 0; i < count; i++) {
+            if(arrays[i].kind != kind) continue;
+            
+            if(arrays[i].bytes == 0 || memory == nullptr) {
+                setArray(arrays[i], nullptr);
+            } else {
+                setArray(arrays[i], memory + offset);
+            }
+            offset += alignBytes(arrays[i].bytes);
+        }
+        
+        if(kind == ARRAY_STATE) {
+            world.stateBytes = offset;
+        }
+        if(kind == ARRAY_LEVEL) {
+            world.levelBytes = offset;
+        }
+    }
+    
+    return offset;
+}
+
+// ----------------------------------------------------------------------------
+// Smallest power of two that is at least n
+// ----------------------------------------------------------------------------
+static int powerOfTwoAtLeast(int n) {
+    int size = 16;
+    while(size < n) {
+        size *= 2;
+    }
+    return size;
+}
+
+// ----------------------------------------------------------------------------
+// Free every array of a world
+// ----------------------------------------------------------------------------
+static void freeWorldArrays(World& world) {
+    free(world.memory);
+    world.memory = nullptr;
+    world.memoryBytes = 0;
+    layoutWorldArrays(world, nullptr);
+}
+
+// ----------------------------------------------------------------------------
+// Create an empty world (no level loaded)
+// ----------------------------------------------------------------------------
+World* createWorld() {
+    World* world = new World;
+    memset(world, 0, sizeof(World));
+    for(int i = 0; i < 26; i++) {
+        world->switchByLetter[i] = -1;
+    }
+    return world;
+}
+
+// ----------------------------------------------------------------------------
+// Destroy a world and everything it owns
+// ----------------------------------------------------------------------------
+void destroyWorld(World* world) {
+    if(world == nullptr) {
+        return;
+    }
+    freeWorldArrays(*world);
+    delete world;
+}
+
+// ----------------------------------------------------------------------------
+// Set the sizes the array layout is computed from
+// ----------------------------------------------------------------------------
+static void setWorldSizes(World& world, int gridRows, int gridCols, int trainCapacity,
+                          int switchCapacity, int spawnCapacity, int destCapacity) {
+    world.gridRows = gridRows;
+    world.gridCols = gridCols;
+    world.trainCapacity = trainCapacity;
+    world.switchCapacity = switchCapacity;
+    world.spawnCapacity = spawnCapacity;
+    world.destCapacity = destCapacity;
+    
+    // Each train claims at most two cells and owns at most one edge; keep
+    // both hash tables at most half full
+    world.claimTableSize = powerOfTwoAtLeast(trainCapacity * 4);
+    world.edgeTableSize = powerOfTwoAtLeast(trainCapacity * 2);
+}
+
+// ----------------------------------------------------------------------------
+// Allocate every array for the given sizes (false, leaving an empty world,
+// when the memory is not available)
+// ----------------------------------------------------------------------------
+bool allocateWorld(World& world, int gridRows, int gridCols, int trainCapacity,
+                   int switchCapacity, int spawnCapacity, int destCapacity) {
+    freeWorldArrays(world);
+    setWorldSizes(world, gridRows, gridCols, trainCapacity, switchCapacity,
+                  spawnCapacity, destCapacity);
+    
+    world.memoryBytes = layoutWorldArrays(world, nullptr);
+    // calloc: large blocks come zeroed from the OS page by page instead of
+    // being cleared up front (the distance fields alone are destinations x
+    // cells x 4, and are overwritten when they are built)
+    if(world.memoryBytes > 0) {
+        world.memory = (unsigned char*)calloc(world.memoryBytes, 1);
+        if(world.memory == nullptr) {
+            setWorldSizes(world, 0, 0, 0, 0, 0, 0);
+            freeWorldArrays(world);
+            return false;
+        }
+    }
+    layoutWorldArrays(world, world.memory);
+    
+    if(world.grid != nullptr) {
+        memset(world.grid, ' ', (long long)gridRows * gridCols);
+    }
+    
+    world.trainCount = 0;
+    world.spawnCursor = 0;
+    world.activeCount = 0;
+    world.retiredCount = 0;
+    world.prevPrimed = false;
+    world.switchCount = 0;
+    for(int i = 0; i < 26; i++) {
+        world.switchByLetter[i] = -1;
+    }
+    world.spawnCount = 0;
+    world.destCount = 0;
+    world.signalDirtyCount = 0;
+    world.signalsPrimed = false;
+    world.collisionStamp = 0;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Size of a world without allocating it
+// ----------------------------------------------------------------------------
+long long measureWorld(int gridRows, int gridCols, int trainCapacity,
+                       int switchCapacity, int spawnCapacity, int destCapacity) {
+    World probe;
+    memset(&probe, 0, sizeof(World));
+    setWorldSizes(probe, gridRows, gridCols, trainCapacity, switchCapacity,
+                  spawnCapacity, destCapacity);
+    return layoutWorldArrays(probe, nullptr);
+}
+
+// ----------------------------------------------------------------------------
+// Make dst an exact copy of src (dst is reallocated if its sizes differ;
+// false when that allocation fails)
+// ----------------------------------------------------------------------------
+bool copyWorld(World& dst, const World& src) {
+    if(&dst == &src) {
+        return true;
+    }
+    
+    if(dst.gridRows != src.gridRows || dst.gridCols != src.gridCols ||
+       dst.trainCapacity != src.trainCapacity || dst.switchCapacity != src.switchCapacity ||
+       dst.spawnCapacity != src.spawnCapacity || dst.destCapacity != src.destCapacity) {
+        if(!allocateWorld(dst, src.gridRows, src.gridCols, src.trainCapacity,
+                          src.switchCapacity, src.spawnCapacity, src.destCapacity)) {
+            return false;
+        }
+    }
+    
+    // Scalars come across with the struct, then dst gets its own arrays back
+    unsigned char* memory = dst.memory;
+    memcpy(&dst, &src, sizeof(World));
+    dst.memory = memory;
+    if(src.memoryBytes > 0) {
+        memcpy(dst.memory, src.memory, src.memoryBytes);
+    }
+    layoutWorldArrays(dst, dst.memory);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Add a switch; single letter names are also registered as aliases
+// ----------------------------------------------------------------------------
+int addSwitch(World& world, const char* name) {
+    if(world.switchCount >= world.switchCapacity) {
+        return -1;
+    }
+    
+    int id = world.switchCount++;
+    char* slot = &world.switchNames[id * SWITCH_NAME_LEN];
+    strncpy(slot, name, SWITCH_NAME_LEN - 1);
+    slot[SWITCH_NAME_LEN - 1] = '\0';
+    
+    if(name[0] >= 'A' && name[0] <= 'Z' && name[1] == '\0') {
+        world.switchByLetter[name[0] - 'A'] = id;
+    }
+    
+    return id;
+}
+
+// ----------------------------------------------------------------------------
+// Switch id of a letter alias, or -1
+// ----------------------------------------------------------------------------
+int findSwitchByLetter(const World& world, char letter) {
+    if(letter < 'A' || letter > 'Z') {
+        return -1;
+    }
+    return world.switchByLetter[letter - 'A'];
+}
+
+// ----------------------------------------------------------------------------
+// Switch id by name, or -1
+// ----------------------------------------------------------------------------
+int findSwitchByName(const World& world, const char* name) {
+    for(int i = 0; i < world.switchCount; i++) {
+        if(strcmp(getSwitchName(world, i), name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
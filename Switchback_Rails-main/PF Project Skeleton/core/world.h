@@ -0,0 +1,251 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+// ============================================================================
+// WORLD.H - Heap-allocated simulation world
+// ============================================================================
+// Everything one simulation needs: the grid, trains, switches and the tables
+// derived from them. Arrays are sized at load time from the level (no fixed
+// grid, train or switch limits) and nothing is allocated while ticking.
+//
+// Grid cells are stored row by row: cell = y * gridCols + x. The grid is
+// also cut into square regions of REGION_SIZE cells, numbered row by row.
+// Trains are a struct of arrays indexed by train id (0 .. trainCount - 1).
+// Switches have numeric ids (0 .. switchCount - 1). Letter switches from
+// .lvl files keep their letter as a name and as an alias in switchByLetter;
+// any number of named switches can follow them, each on one '*' cell.
+// ============================================================================
+
+const int SWITCH_NAME_LEN = 16;
+const int SWITCH_STATE_NAME_LEN = 32;
+const int HASH_PART_COUNT = 7;      // see state_hash.h
+const int REGION_SHIFT = 8;
+const int REGION_SIZE = 1 << REGION_SHIFT;
+
+struct World {
+    
+    // ------------------------------------------------------------------------
+    // MEMORY (world.cpp)
+    // ------------------------------------------------------------------------
+    // Every array below points into this one allocation. The first
+    // stateBytes hold the arrays that change while ticking (snapshot.h);
+    // the first levelBytes add the fixed level data (level_cache.h) and
+    // leave out only the per-tick scratch arrays.
+    unsigned char* memory;
+    long long memoryBytes;
+    long long stateBytes;
+    long long levelBytes;
+    
+    // ------------------------------------------------------------------------
+    // LEVEL
+    // ------------------------------------------------------------------------
+    char levelName[256];
+    int gridRows;
+    int gridCols;
+    char* grid;
+    int seed;
+    int weatherMode;
+    
+    // ------------------------------------------------------------------------
+    // TRAINS
+    // ------------------------------------------------------------------------
+    int trainCount;
+    int trainCapacity;
+    int* trainX;
+    int* trainY;
+    int* trainDir;
+    int* trainNextX;
+    int* trainNextY;
+    int* trainNextDir;
+    int* trainPrevX;
+    int* trainPrevY;
+    int* trainDestX;
+    int* trainDestY;
+    int* trainDestField;        // distance field of the destination, -1 if none
+    int* trainSpawnTick;
+    int* trainColor;
+    bool* trainActive;
+    bool* trainCrashed;
+    bool* trainDelivered;
+    int* trainWaitTicks;
+    int* trainTotalWaitTicks;
+    int* trainRunLeft;          // open cells ahead, -1 on a node (track_graph.h)
+    bool* trainCruising;        // scratch: set by the routes phase (track_graph.h)
+    
+    // ------------------------------------------------------------------------
+    // SPAWN SCHEDULE AND ACTIVE TRAINS (trains.cpp)
+    // ------------------------------------------------------------------------
+    int* spawnOrder;            // train ids sorted by spawn tick
+    int spawnCursor;            // next entry of spawnOrder to spawn
+    int* activeList;            // dense list of active train ids (grouped by region, trains.h)
+    int* activeSlot;            // position in activeList, -1 if inactive
+    int activeCount;
+    int* retiredList;           // trains deactivated since the last signal update
+    int retiredCount;
+    bool prevPrimed;            // trainPrevX/Y set for every train at least once
+    int* trainOrder;            // scratch: active ids in id order
+    int* sortScratch;
+    int* regionStart;           // scratch: region r's trains start at activeList[regionStart[r]]
+    
+    // ------------------------------------------------------------------------
+    // SWITCHES
+    // ------------------------------------------------------------------------
+    int switchCount;
+    int switchCapacity;
+    int switchByLetter[26];     // switch id of letter 'A' + i, or -1
+    char* switchNames;          // SWITCH_NAME_LEN per switch
+    int* switchState;
+    bool* switchMode;           // true = PER_DIR, false = GLOBAL
+    int* switchCounters;        // 4 per switch
+    int* switchKValues;         // 4 per switch
+    bool* switchFlipQueued;
+    int* switchSignal;
+    char* switchStateNames;     // 2 x SWITCH_STATE_NAME_LEN per switch
+    
+    // ------------------------------------------------------------------------
+    // SPAWN POINTS AND DESTINATIONS
+    // ------------------------------------------------------------------------
+    int spawnCount;
+    int spawnCapacity;
+    int* spawnX;
+    int* spawnY;
+    int destCount;
+    int destCapacity;
+    int* destX;
+    int* destY;
+    
+    // ------------------------------------------------------------------------
+    // CLOCK AND METRICS
+    // ------------------------------------------------------------------------
+    int currentTick;
+    int trainsDelivered;
+    int trainsCrashed;
+    int totalSwitchFlips;
+    int signalViolations;
+    
+    // ------------------------------------------------------------------------
+    // STATE HASH (state_hash.cpp)
+    // ------------------------------------------------------------------------
+    unsigned long long stateHash[HASH_PART_COUNT];  // kept current by the tick phases
+    
+    // ------------------------------------------------------------------------
+    // TRANSITION TABLE, DISTANCE FIELDS AND STRAIGHT RUNS (built at load time)
+    // ------------------------------------------------------------------------
+    unsigned char* transitions;     // 4 per cell, see grid.h
+    unsigned short* trackDist;      // 4 per cell per destination
+    unsigned short* runAhead;       // 4 per cell, see track_graph.h
+    unsigned char* quietRun;        // 4 per cell, see time_skip.h
+    bool* fieldDirty;
+    int* bfsQueue;
+    
+    // ------------------------------------------------------------------------
+    // SWITCH INDEX AND SIGNALS (switches.cpp)
+    // ------------------------------------------------------------------------
+    int* switchAtCell;          // switch id on the cell (letter or '*'), or -1
+    int* switchX;               // first cell of the switch, -1 if none
+    int* switchY;
+    int* cellTrainCount;        // active trains per cell
+    int* seenX;                 // train positions the signals last saw
+    int* seenY;
+    bool* seenActive;
+    bool* signalDirty;
+    int* signalDirtyList;
+    int signalDirtyCount;
+    bool signalsPrimed;
+    
+    // ------------------------------------------------------------------------
+    // COLLISION SCRATCH (trains.cpp)
+    // ------------------------------------------------------------------------
+    int claimTableSize;         // power of two, cell claim hash
+    long long* claimKey;
+    int* claimStamp;
+    int* claimHead;
+    bool* claimQueued;
+    int edgeTableSize;          // power of two, directed edge hash
+    long long* edgeKey;
+    int* edgeStamp;
+    int* edgeOwner;
+    int* claimTrain;            // claim list nodes, 2 per train
+    int* claimNext;
+    int claimCount;
+    int* claimQueue;            // hash slots waiting to be resolved
+    int queueHead;
+    int queueTail;
+    int* holdList;
+    int holdCount;
+    int* moverList;
+    int* collisionDist;
+    int collisionStamp;
+    
+    // ------------------------------------------------------------------------
+    // DELTA LOGGING (simulation.cpp)
+    // ------------------------------------------------------------------------
+    int* loggedSwitchState;     // -1 = never logged
+    int* loggedSignal;
+};
+
+// ----------------------------------------------------------------------------
+// LIFECYCLE
+// ----------------------------------------------------------------------------
+World* createWorld();
+
+void destroyWorld(World* world);
+
+// Frees the old arrays and allocates new ones for the given sizes (all zero).
+// False when the memory is not available; the world is then left empty.
+bool allocateWorld(World& world, int gridRows, int gridCols, int trainCapacity,
+                   int switchCapacity, int spawnCapacity, int destCapacity);
+
+// Bytes allocateWorld() would allocate for these sizes, without allocating
+long long measureWorld(int gridRows, int gridCols, int trainCapacity,
+                       int switchCapacity, int spawnCapacity, int destCapacity);
+
+// Deep copy: dst gets its own arrays with the same contents as src. Used to
+// start several runs from one loaded level without reading the file again.
+// False when dst cannot be reallocated.
+bool copyWorld(World& dst, const World& src);
+
+// ----------------------------------------------------------------------------
+// GRID ACCESS
+// ----------------------------------------------------------------------------
+inline char getTile(const World& world, int x, int y) {
+    return world.grid[y * world.gridCols + x];
+}
+
+inline void setTile(World& world, int x, int y, char tile) {
+    world.grid[y * world.gridCols + x] = tile;
+}
+
+// The last column and row of regions may be narrower than REGION_SIZE
+inline int getRegionCols(const World& world) {
+    return (world.gridCols + REGION_SIZE - 1) >> REGION_SHIFT;
+}
+
+inline int getRegionCount(const World& world) {
+    return getRegionCols(world) * ((world.gridRows + REGION_SIZE - 1) >> REGION_SHIFT);
+}
+
+inline int getRegionOfCell(const World& world, int x, int y) {
+    return (y >> REGION_SHIFT) * getRegionCols(world) + (x >> REGION_SHIFT);
+}
+
+// ----------------------------------------------------------------------------
+// SWITCHES
+// ----------------------------------------------------------------------------
+// Adds a switch with the given name; a single letter name also becomes an
+// alias. Returns the new id, or -1 when the world is full.
+int addSwitch(World& world, const char* name);
+
+int findSwitchByLetter(const World& world, char letter);
+
+int findSwitchByName(const World& world, const char* name);
+
+inline const char* getSwitchName(const World& world, int switchId) {
+    return &world.switchNames[switchId * SWITCH_NAME_LEN];
+}
+
+inline char* getSwitchStateName(World& world, int switchId, int state) {
+    return &world.switchStateNames[(switchId * 2 + state) * SWITCH_STATE_NAME_LEN];
+}
+
+#endif
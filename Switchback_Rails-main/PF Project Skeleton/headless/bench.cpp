@@ -0,0 +1,626 @@
+#include "../core/simulation.h"
+#include "../core/io.h"
+#include "../core/trains.h"
+#include "../core/level_loader.h"
+#include "../core/distance_kernels.h"
+#include "../core/parallel_tick.h"
+#include "../core/track_graph.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/BENCH.CPP - Per-phase tick benchmarks
+// ============================================================================
+// Runs each level until enough ticks have been timed and reports, for every
+// tick phase (simulation.h) and for the whole tick, the median, p99 and
+// mean time in nanoseconds. Short levels are run again from the start until
+// --samples ticks are collected.
+//
+// Besides the given levels, synthetic levels are built by tiling a level
+// K x K times (--scale K): K^2 times the trains, cells and destinations.
+// The distance fields grow with destinations x cells, so memory grows with
+// K^4 (complex_network x 4 needs about 40 MB, x 8 about 600 MB).
+//
+// Results are written as JSON, one record per level and phase. --compare
+// checks them against a saved baseline and exits with 1 when a phase's
+// median got slower by more than --threshold percent (and --min-delta ns).
+// ============================================================================
+
+const int BENCH_MAX_LEVELS = 32;
+const int BENCH_MAX_RECORDS = 1024;
+const int BENCH_NAME_LEN = 64;
+const int BENCH_LINE_LEN = 512;
+const int BENCH_SERIES_COUNT = TICK_PHASE_COUNT + 1;      // the phases, then the whole tick
+
+struct BenchRecord {
+    char level[BENCH_NAME_LEN];
+    char phase[BENCH_NAME_LEN];
+    int trains;
+    long long cells;
+    int runs;
+    int samples;
+    long long medianNs;
+    long long p99Ns;
+    double meanNs;
+};
+
+struct BenchSettings {
+    int maxTicks;
+    int minSamples;
+    int logLevel;
+    const char* outputDir;
+    double thresholdPercent;
+    long long minDeltaNs;
+    int tickThreads;
+};
+
+// ----------------------------------------------------------------------------
+// Print usage
+// ----------------------------------------------------------------------------
+void printBenchUsage(const char* program) {
+    cout << "Usage: " << program << " [level.lvl ...] [options]" << endl;
+    cout << "Without levels: the four levels in data/levels, plus complex_network" << endl;
+    cout << "tiled 2x2 and 4x4." << endl;
+    cout << "Options:" << endl;
+    cout << "  --scale K       Also bench the last level tiled K x K (repeatable)" << endl;
+    cout << "  --ticks N       Tick limit per run (default 500)" << endl;
+    cout << "  --samples N     Ticks to time per level (default 5000)" << endl;
+    cout << "  --log LEVEL     none | metrics | full (default full)" << endl;
+    cout << "  --out DIR       Directory for the runs' logs (default bench_out)" << endl;
+    cout << "  --json FILE     Write results to FILE (default bench.json)" << endl;
+    cout << "  --compare FILE  Compare against a baseline; exit 1 on regressions" << endl;
+    cout << "  --results FILE  Compare FILE instead of running (with --compare)" << endl;
+    cout << "  --threshold P   Regression threshold in percent (default 10)" << endl;
+    cout << "  --min-delta NS  Ignore changes below NS nanoseconds (default 20)" << endl;
+    cout << "  --kernels NAME  scalar | sse4 | avx2 distance kernels (default: best available)" << endl;
+    cout << "  --threads N     Threads for the per-train phases (default 1, 0 = all cores)" << endl;
+    cout << "  --cell-by-cell  Route every train through the collision engine every tick" << endl;
+    cout << "  --no-regions    Keep the active trains in activation order" << endl;
+}
+
+// ----------------------------------------------------------------------------
+// Synthetic levels
+// ----------------------------------------------------------------------------
+// Writes the .lvl text of base tiled scale x scale times. Switch letters are
+// shared by every copy; each copy's trains go to the same destination of
+// their own copy. The caller deletes the text.
+char* buildScaledLevelText(const World& base, int scale, long long& size) {
+    int rows = base.gridRows * scale;
+    int cols = base.gridCols * scale;
+    long long cells = (long long)rows * cols;
+    
+    char* grid = new char[cells];
+    for(int y = 0; y < rows; y++) {
+        for(int x = 0; x < cols; x++) {
+            char tile = getTile(base, x % base.gridCols, y % base.gridRows);
+            grid[(long long)y * cols + x] = (tile == '\0') ? ' ' : tile;
+        }
+    }
+    
+    // Destination indexes follow row-major order over the tiled map
+    int* destIndexAt = new int[cells];
+    int destCount = 0;
+    for(long long cell = 0; cell < cells; cell++) {
+        destIndexAt[cell] = (grid[cell] == 'D') ? destCount++ : -1;
+    }
+    
+    long long capacity = cells + rows + 4096 + (long long)base.switchCount * 128 +
+                         (long long)base.trainCount * scale * scale * 64;
+    char* text = new char[capacity];
+    long long length = 0;
+    const char* weather[] = {"NORMAL", "RAIN", "FOG"};
+    
+    length += snprintf(text + length, capacity - length,
+                       "NAME:\n%s x%d\n\nROWS:\n%d\n\nCOLS:\n%d\n\nSEED:\n%d\n\nWEATHER:\n%s\n\nMAP:\n",
+                       base.levelName, scale, rows, cols, base.seed, weather[base.weatherMode % 3]);
+    for(int y = 0; y < rows; y++) {
+        memcpy(text + length, &grid[(long long)y * cols], cols);
+        length += cols;
+        text[length++] = '\n';
+    }
+    
+    length += snprintf(text + length, capacity - length, "\nSWITCHES:\n");
+    for(int id = 0; id < base.switchCount; id++) {
+        length += snprintf(text + length, capacity - length, "%c %s %d %d %d %d %d %s %s\n",
+                           getSwitchName(base, id)[0], base.switchMode[id] ? "PER_DIR" : "GLOBAL",
+                           base.switchState[id], base.switchKValues[id * 4 + 0],
+                           base.switchKValues[id * 4 + 1], base.switchKValues[id * 4 + 2],
+                           base.switchKValues[id * 4 + 3],
+                           &base.switchStateNames[(id * 2 + 0) * SWITCH_STATE_NAME_LEN],
+                           &base.switchStateNames[(id * 2 + 1) * SWITCH_STATE_NAME_LEN]);
+    }
+    
+    length += snprintf(text + length, capacity - length, "\nTRAINS:\n");
+    for(int by = 0; by < scale; by++) {
+        for(int bx = 0; bx < scale; bx++) {
+            int offsetX = bx * base.gridCols;
+            int offsetY = by * base.gridRows;
+            for(int t = 0; t < base.trainCount; t++) {
+                int destIdx = destCount;
+                int field = base.trainDestField[t];
+                if(field >= 0) {
+                    long long cell = (long long)(base.destY[field] + offsetY) * cols +
+                                     base.destX[field] + offsetX;
+                    destIdx = destIndexAt[cell];
+                }
+                length += snprintf(text + length, capacity - length, "%d %d %d %d %d\n",
+                                   base.trainSpawnTick[t], base.trainX[t] + offsetX,
+                                   base.trainY[t] + offsetY, base.trainDir[t], destIdx);
+            }
+        }
+    }
+    
+    delete[] grid;
+    delete[] destIndexAt;
+    size = length;
+    return text;
+}
+
+// Label of a level: its file name without directory and extension
+void getLevelLabel(const char* path, char label[], int capacity) {
+    const char* slash = strrchr(path, '/');
+    snprintf(label, capacity, "%s", (slash != nullptr) ? slash + 1 : path);
+    char* dot = strrchr(label, '.');
+    if(dot != nullptr) {
+        *dot = '\0';
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Timing
+// ----------------------------------------------------------------------------
+static long long elapsedNs(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to) {
+    return chrono::duration_cast<chrono::nanoseconds>(to - from).count();
+}
+
+// Median cost of reading the clock, included in every reported time
+long long measureTimerOverhead() {
+    const int trials = 1001;
+    long long samples[trials];
+    for(int i = 0; i < trials; i++) {
+        chrono::steady_clock::time_point a = chrono::steady_clock::now();
+        chrono::steady_clock::time_point b = chrono::steady_clock::now();
+        samples[i] = elapsedNs(a, b);
+    }
+    
+    // Insertion sort: small and only done once
+    for(int i = 1; i < trials; i++) {
+        long long value = samples[i];
+        int j = i - 1;
+        while(j >= 0 && samples[j] > value) {
+            samples[j + 1] = samples[j];
+            j--;
+        }
+        samples[j + 1] = value;
+    }
+    return samples[trials / 2];
+}
+
+static int compareNs(const void* a, const void* b) {
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static long long getPercentile(const long long sorted[], int count, double percent) {
+    int rank = (int)(percent / 100.0 * count + 0.999999);
+    if(rank < 1) rank = 1;
+    if(rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+// ----------------------------------------------------------------------------
+// Bench one level
+// ----------------------------------------------------------------------------
+// Appends BENCH_SERIES_COUNT records to records
+int benchLevel(const World& level, const char* label, const BenchSettings& settings,
+               BenchRecord records[], int recordCount) {
+    
+    // Each run adds at most maxTicks samples
+    int capacity = settings.minSamples + settings.maxTicks;
+    long long* samples = new long long[(long long)capacity * BENCH_SERIES_COUNT];
+    int sampleCount = 0;
+    int runs = 0;
+    
+    char runDir[512];
+    snprintf(runDir, sizeof(runDir), "%s/%s", settings.outputDir, label);
+    if(settings.logLevel != LOG_NONE) {
+        mkdir(settings.outputDir, 0755);
+        mkdir(runDir, 0755);
+    }
+    
+    World* world = createWorld();
+    chrono::steady_clock::time_point stamps[TICK_PHASE_COUNT + 1];
+    
+    while(sampleCount < settings.minSamples) {
+        if(!copyWorld(*world, level)) {
+            cout << "ERROR: Not enough memory to copy " << label << endl;
+            break;
+        }
+        
+        LogContext log;
+        initializeLogContext(log);
+        setLogLevel(log, settings.logLevel);
+        setTickThreads(log, settings.tickThreads);
+        if(!setOutputDirectory(log, runDir) || !initializeSimulation(*world, log)) {
+            cout << "ERROR: Cannot create log files in " << runDir << endl;
+            shutdownSimulation(log);
+            break;
+        }
+        spawnTrainsForTick(*world, 0);
+        
+        while(world->currentTick < settings.maxTicks && sampleCount < capacity) {
+            stamps[0] = chrono::steady_clock::now();
+            for(int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+                runTickPhase(*world, log, phase);
+                stamps[phase + 1] = chrono::steady_clock::now();
+            }
+            
+            for(int phase = 0; phase < TICK_PHASE_COUNT; phase++) {
+                samples[(long long)phase * capacity + sampleCount] = elapsedNs(stamps[phase], stamps[phase + 1]);
+            }
+            samples[(long long)TICK_PHASE_COUNT * capacity + sampleCount] =
+                elapsedNs(stamps[0], stamps[TICK_PHASE_COUNT]);
+            sampleCount++;
+            
+            if(isSimulationComplete(*world)) {
+                break;
+            }
+        }
+        
+        shutdownSimulation(log);
+        runs++;
+    }
+    
+    // Nothing was measured when the first run could not start
+    for(int series = 0; sampleCount > 0 && series < BENCH_SERIES_COUNT; series++) {
+        long long* values = &samples[(long long)series * capacity];
+        double total = 0;
+        for(int i = 0; i < sampleCount; i++) {
+            total += values[i];
+        }
+        qsort(values, sampleCount, sizeof(long long), compareNs);
+        
+        BenchRecord& record = records[recordCount++];
+        snprintf(record.level, BENCH_NAME_LEN, "%s", label);
+        snprintf(record.phase, BENCH_NAME_LEN, "%s",
+                 (series < TICK_PHASE_COUNT) ? getTickPhaseName(series) : "tick");
+        record.trains = level.trainCount;
+        record.cells = (long long)level.gridRows * level.gridCols;
+        record.runs = runs;
+        record.samples = sampleCount;
+        record.medianNs = getPercentile(values, sampleCount, 50.0);
+        record.p99Ns = getPercentile(values, sampleCount, 99.0);
+        record.meanNs = total / sampleCount;
+    }
+    
+    destroyWorld(world);
+    delete[] samples;
+    return recordCount;
+}
+
+// ----------------------------------------------------------------------------
+// Results files
+// ----------------------------------------------------------------------------
+bool writeBenchJson(const char* path, const BenchRecord records[], int recordCount,
+                    long long timerOverheadNs, const BenchSettings& settings) {
+    FILE* file = fopen(path, "w");
+    if(file == nullptr) {
+        return false;
+    }
+    
+    fprintf(file, "{\n");
+    fprintf(file, "  \"timer_overhead_ns\": %lld,\n", timerOverheadNs);
+    fprintf(file, "  \"max_ticks\": %d,\n", settings.maxTicks);
+    fprintf(file, "  \"log_level\": %d,\n", settings.logLevel);
+    fprintf(file, "  \"results\": [\n");
+    for(int i = 0; i < recordCount; i++) {
+        const BenchRecord& r = records[i];
+        fprintf(file, "    {\"level\": \"%s\", \"phase\": \"%s\", \"trains\": %d, \"cells\": %lld, "
+                      "\"runs\": %d, \"samples\": %d, \"median_ns\": %lld, \"p99_ns\": %lld, "
+                      "\"mean_ns\": %.1f}%s\n",
+                r.level, r.phase, r.trains, r.cells, r.runs, r.samples, r.medianNs, r.p99Ns,
+                r.meanNs, (i + 1 < recordCount) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    
+    return fclose(file) == 0;
+}
+
+// Value of "key": in a record line, as text
+static bool findJsonField(const char* line, const char* key, char value[], int capacity) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* p = strstr(line, pattern);
+    if(p == nullptr) {
+        return false;
+    }
+    p += strlen(pattern);
+    while(*p == ' ') p++;
+    
+    int length = 0;
+    if(*p == '"') {
+        p++;
+        while(*p != '\0' && *p != '"' && length < capacity - 1) {
+            value[length++] = *p++;
+        }
+    } else {
+        while(*p != '\0' && *p != ',' && *p != '}' && length < capacity - 1) {
+            value[length++] = *p++;
+        }
+    }
+    value[length] = '\0';
+    return true;
+}
+
+// Reads the records of a file written by writeBenchJson (one per line)
+int readBenchJson(const char* path, BenchRecord records[], int capacity) {
+    FILE* file = fopen(path, "r");
+    if(file == nullptr) {
+        return -1;
+    }
+    
+    int count = 0;
+    char line[BENCH_LINE_LEN];
+    char value[BENCH_NAME_LEN];
+    while(count < capacity && fgets(line, sizeof(line), file) != nullptr) {
+        BenchRecord& r = records[count];
+        if(!findJsonField(line, "level", r.level, BENCH_NAME_LEN) ||
+           !findJsonField(line, "phase", r.phase, BENCH_NAME_LEN)) {
+            continue;
+        }
+        r.trains = findJsonField(line, "trains", value, sizeof(value)) ? atoi(value) : 0;
+        r.cells = findJsonField(line, "cells", value, sizeof(value)) ? atoll(value) : 0;
+        r.runs = findJsonField(line, "runs", value, sizeof(value)) ? atoi(value) : 0;
+        r.samples = findJsonField(line, "samples", value, sizeof(value)) ? atoi(value) : 0;
+        r.medianNs = findJsonField(line, "median_ns", value, sizeof(value)) ? atoll(value) : 0;
+        r.p99Ns = findJsonField(line, "p99_ns", value, sizeof(value)) ? atoll(value) : 0;
+        r.meanNs = findJsonField(line, "mean_ns", value, sizeof(value)) ? atof(value) : 0;
+        count++;
+    }
+    
+    fclose(file);
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+// Print and compare
+// ----------------------------------------------------------------------------
+void printBenchRecords(const BenchRecord records[], int recordCount) {
+    printf("%-28s %-16s %10s %10s %12s\n", "level", "phase", "median_ns", "p99_ns", "mean_ns");
+    for(int i = 0; i < recordCount; i++) {
+        const BenchRecord& r = records[i];
+        printf("%-28s %-16s %10lld %10lld %12.1f\n", r.level, r.phase, r.medianNs, r.p99Ns, r.meanNs);
+    }
+}
+
+// Returns the number of regressions
+int compareBenchRecords(const BenchRecord baseline[], int baselineCount,
+                        const BenchRecord current[], int currentCount,
+                        const BenchSettings& settings) {
+    int regressions = 0;
+    printf("%-28s %-16s %10s %10s %8s\n", "level", "phase", "base_ns", "now_ns", "change");
+    
+    for(int i = 0; i < currentCount; i++) {
+        const BenchRecord& now = current[i];
+        const BenchRecord* base = nullptr;
+        for(int j = 0; j < baselineCount && base == nullptr; j++) {
+            if(strcmp(baseline[j].level, now.level) == 0 && strcmp(baseline[j].phase, now.phase) == 0) {
+                base = &baseline[j];
+            }
+        }
+        if(base == nullptr) {
+            printf("%-28s %-16s %10s %10lld %8s\n", now.level, now.phase, "-", now.medianNs, "new");
+            continue;
+        }
+        
+        double change = (base->medianNs > 0)
+                        ? 100.0 * (now.medianNs - base->medianNs) / base->medianNs : 0.0;
+        bool regressed = change > settings.thresholdPercent &&
+                         now.medianNs - base->medianNs > settings.minDeltaNs;
+        if(regressed) {
+            regressions++;
+        }
+        printf("%-28s %-16s %10lld %10lld %+7.1f%%%s\n", now.level, now.phase, base->medianNs,
+               now.medianNs, change, regressed ? "  REGRESSION" : "");
+    }
+    
+    return regressions;
+}
+
+int main(int argc, char* argv[]) {
+    
+    const char* levelFiles[BENCH_MAX_LEVELS];
+    int levelCount = 0;
+    int scales[BENCH_MAX_LEVELS];
+    int scaleCount = 0;
+    const char* jsonFile = "bench.json";
+    const char* baselineFile = nullptr;
+    const char* resultsFile = nullptr;
+    
+    BenchSettings settings;
+    settings.maxTicks = 500;
+    settings.minSamples = 5000;
+    settings.logLevel = LOG_FULL;
+    settings.outputDir = "bench_out";
+    settings.thresholdPercent = 10.0;
+    settings.minDeltaNs = 20;
+    settings.tickThreads = 1;
+    
+    for(int a = 1; a < argc; a++) {
+        if(strcmp(argv[a], "--scale") == 0 && a + 1 < argc) {
+            if(scaleCount < BENCH_MAX_LEVELS) {
+                scales[scaleCount++] = atoi(argv[++a]);
+            }
+        }
+        else if(strcmp(argv[a], "--ticks") == 0 && a + 1 < argc) {
+            settings.maxTicks = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--samples") == 0 && a + 1 < argc) {
+            settings.minSamples = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--log") == 0 && a + 1 < argc) {
+            a++;
+            if(strcmp(argv[a], "none") == 0) {
+                settings.logLevel = LOG_NONE;
+            } else if(strcmp(argv[a], "metrics") == 0) {
+                settings.logLevel = LOG_METRICS;
+            } else if(strcmp(argv[a], "full") == 0) {
+                settings.logLevel = LOG_FULL;
+            } else {
+                cout << "ERROR: Unknown log level: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            settings.outputDir = argv[++a];
+        }
+        else if(strcmp(argv[a], "--json") == 0 && a + 1 < argc) {
+            jsonFile = argv[++a];
+        }
+        else if(strcmp(argv[a], "--compare") == 0 && a + 1 < argc) {
+            baselineFile = argv[++a];
+        }
+        else if(strcmp(argv[a], "--results") == 0 && a + 1 < argc) {
+            resultsFile = argv[++a];
+        }
+        else if(strcmp(argv[a], "--threshold") == 0 && a + 1 < argc) {
+            settings.thresholdPercent = atof(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--min-delta") == 0 && a + 1 < argc) {
+            settings.minDeltaNs = atoll(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--kernels") == 0 && a + 1 < argc) {
+            a++;
+            int level = findDistanceKernelLevel(argv[a]);
+            if(level < 0 || !setDistanceKernelLevel(level)) {
+                cout << "ERROR: Kernels not available on this CPU: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            settings.tickThreads = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--cell-by-cell") == 0) {
+            setSegmentAdvanceEnabled(false);
+        }
+        else if(strcmp(argv[a], "--no-regions") == 0) {
+            setRegionGroupingEnabled(false);
+        }
+        else if(argv[a][0] != '-' && levelCount < BENCH_MAX_LEVELS) {
+            levelFiles[levelCount++] = argv[a];
+        }
+        else {
+            printBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if(settings.maxTicks <= 0 || settings.minSamples <= 0) {
+        printBenchUsage(argv[0]);
+        return 1;
+    }
+    
+    BenchRecord* records = new BenchRecord[BENCH_MAX_RECORDS];
+    int recordCount = 0;
+    
+    if(resultsFile != nullptr) {
+        recordCount = readBenchJson(resultsFile, records, BENCH_MAX_RECORDS);
+        if(recordCount < 0) {
+            cout << "ERROR: Cannot read " << resultsFile << endl;
+            delete[] records;
+            return 1;
+        }
+    }
+    else {
+        if(levelCount == 0) {
+            levelFiles[levelCount++] = "data/levels/easy_level.lvl";
+            levelFiles[levelCount++] = "data/levels/medium_level.lvl";
+            levelFiles[levelCount++] = "data/levels/hard_level.lvl";
+            levelFiles[levelCount++] = "data/levels/complex_network.lvl";
+            if(scaleCount == 0) {
+                scales[scaleCount++] = 2;
+                scales[scaleCount++] = 4;
+            }
+        }
+        
+        long long timerOverheadNs = measureTimerOverhead();
+        World* level = createWorld();
+        
+        for(int i = 0; i < levelCount && recordCount + BENCH_SERIES_COUNT <= BENCH_MAX_RECORDS; i++) {
+            if(!loadLevelFile(levelFiles[i], *level)) {
+                cout << "ERROR: Failed to load level file: " << levelFiles[i] << endl;
+                destroyWorld(level);
+                delete[] records;
+                return 1;
+            }
+            
+            char label[BENCH_NAME_LEN];
+            getLevelLabel(levelFiles[i], label, sizeof(label));
+            
+            cout << "Benchmarking " << label << "..." << endl;
+            recordCount = benchLevel(*level, label, settings, records, recordCount);
+        }
+        
+        // Scaled copies of the last level loaded (complex_network by default)
+        const char* scaleBase = levelFiles[levelCount - 1];
+        for(int s = 0; s < scaleCount && recordCount + BENCH_SERIES_COUNT <= BENCH_MAX_RECORDS; s++) {
+            if(scales[s] < 2 || !loadLevelFile(scaleBase, *level)) {
+                continue;
+            }
+            
+            long long size;
+            char* text = buildScaledLevelText(*level, scales[s], size);
+            World* scaled = createWorld();
+            if(parseLevelText(text, size, *scaled)) {
+                char label[BENCH_NAME_LEN];
+                getLevelLabel(scaleBase, label, sizeof(label));
+                snprintf(label + strlen(label), sizeof(label) - strlen(label), "_x%d", scales[s]);
+                
+                cout << "Benchmarking " << label << " (" << scaled->trainCount << " trains, "
+                     << scaled->gridRows << "x" << scaled->gridCols << ")..." << endl;
+                recordCount = benchLevel(*scaled, label, settings, records, recordCount);
+            }
+            destroyWorld(scaled);
+            delete[] text;
+        }
+        
+        destroyWorld(level);
+        
+        printBenchRecords(records, recordCount);
+        cout << "Timer overhead per reading: " << timerOverheadNs << " ns (included above)" << endl;
+        
+        if(!writeBenchJson(jsonFile, records, recordCount, timerOverheadNs, settings)) {
+            cout << "ERROR: Cannot write " << jsonFile << endl;
+            delete[] records;
+            return 1;
+        }
+        cout << "Results written to " << jsonFile << endl;
+    }
+    
+    int status = 0;
+    if(baselineFile != nullptr) {
+        BenchRecord* baseline = new BenchRecord[BENCH_MAX_RECORDS];
+        int baselineCount = readBenchJson(baselineFile, baseline, BENCH_MAX_RECORDS);
+        if(baselineCount < 0) {
+            cout << "ERROR: Cannot read " << baselineFile << endl;
+            status = 1;
+        } else {
+            int regressions = compareBenchRecords(baseline, baselineCount, records, recordCount, settings);
+            cout << regressions << " regression(s) over " << settings.thresholdPercent
+                 << "% against " << baselineFile << endl;
+            status = (regressions > 0) ? 1 : 0;
+        }
+        delete[] baseline;
+    }
+    
+    delete[] records;
+    return status;
+}
@@ -0,0 +1,408 @@
+#include "../core/simulation_state.h"
+#include "../core/simulation.h"
+#include "../core/io.h"
+#include "../core/grid.h"
+#include "../core/snapshot.h"
+#include "../core/journal.h"
+#include "../core/state_hash.h"
+#include "../core/level_cache.h"
+#include "../core/tick_profiler.h"
+#include "../core/distance_kernels.h"
+#include "../core/parallel_tick.h"
+#include "../core/time_skip.h"
+#include "../core/track_graph.h"
+#include "../core/switches.h"
+#include "../core/trains.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/MAIN.CPP - Batch runner (no SFML, no terminal grid output)
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Print usage
+// ----------------------------------------------------------------------------
+void printHeadlessUsage(const char* program) {
+    cout << "Usage: " << program << " <level_file.lvl> [options]" << endl;
+    cout << "Options:" << endl;
+    cout << "  --ticks N       Stop after N ticks (default 500)" << endl;
+    cout << "  --log LEVEL     none | metrics | full (default full)" << endl;
+    cout << "  --out DIR       Output directory (default out)" << endl;
+    cout << "  --trace FORMAT  csv | bin (default csv)" << endl;
+    cout << "  --compress      zlib-compress binary trace blocks" << endl;
+    cout << "  --delta         Log switch/signal changes only (CSV)" << endl;
+    cout << "  --keyframe N    Full switch/signal rows every N ticks (default 100)" << endl;
+    cout << "  --checkpoint N  Save <out>/checkpoint.bin every N ticks" << endl;
+    cout << "  --resume FILE   Continue from a checkpoint of the same level, appending to" << endl;
+    cout << "                  the CSV logs in <out> (rows after the checkpoint are cut)" << endl;
+    cout << "  --replay FILE   Replay a viewer input journal and check its tick hashes" << endl;
+    cout << "  --hashes        Write the state hash of every tick to <out>/hashes.csv" << endl;
+    cout << "  --dump-tick T   Save the state after tick T to <out>/state_T.bin" << endl;
+    cout << "  --verify-hash   Check the incremental state hash against a full recompute" << endl;
+    cout << "  --verify-tables Check the routing tables and the track graph against the tiles" << endl;
+    cout << "  --verify-kernels Check the SIMD distance kernels and the signals after the run" << endl;
+    cout << "  --kernels NAME  scalar | sse4 | avx2 (default: best the CPU supports)" << endl;
+    cout << "  --threads N     Run routes, counters and moves on N threads (0 = all cores)" << endl;
+    cout << "  --skip-quiet    Jump over ticks where no train can interact" << endl;
+    cout << "  --cell-by-cell  Route every train through the collision engine every tick" << endl;
+    cout << "  --no-regions    Keep the active trains in activation order" << endl;
+    cout << "  --no-level-cache Parse the .lvl even when its .lvlb is current" << endl;
+    cout << "  --quiet         Only print the timing line" << endl;
+}
+
+// ----------------------------------------------------------------------------
+// Parse --log argument
+// ----------------------------------------------------------------------------
+int parseLogLevel(const char* text) {
+    if(strcmp(text, "none") == 0 || strcmp(text, "0") == 0) return LOG_NONE;
+    if(strcmp(text, "metrics") == 0 || strcmp(text, "1") == 0) return LOG_METRICS;
+    if(strcmp(text, "full") == 0 || strcmp(text, "2") == 0) return LOG_FULL;
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    
+    if(argc < 2) {
+        printHeadlessUsage(argv[0]);
+        return 1;
+    }
+    
+    const char* levelFile = argv[1];
+    int maxTicks = 500;
+    int logLevel = LOG_FULL;
+    const char* outputDir = "out";
+    int traceFormat = TRACE_FORMAT_CSV;
+    bool compress = false;
+    int switchLogMode = SWITCH_LOG_DENSE;
+    int keyframeInterval = 100;
+    int checkpointInterval = 0;
+    const char* resumeFile = nullptr;
+    const char* replayFile = nullptr;
+    bool writeHashes = false;
+    int dumpTick = -1;
+    bool verifyHash = false;
+    bool ticksGiven = false;
+    bool verifyTables = false;
+    bool verifyKernels = false;
+    int tickThreads = 1;
+    bool skipQuiet = false;
+    bool quiet = false;
+    
+    for(int a = 2; a < argc; a++) {
+        if(strcmp(argv[a], "--ticks") == 0 && a + 1 < argc) {
+            maxTicks = atoi(argv[++a]);
+            ticksGiven = true;
+        }
+        else if(strcmp(argv[a], "--log") == 0 && a + 1 < argc) {
+            logLevel = parseLogLevel(argv[++a]);
+            if(logLevel < 0) {
+                cout << "ERROR: Unknown log level: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            outputDir = argv[++a];
+        }
+        else if(strcmp(argv[a], "--trace") == 0 && a + 1 < argc) {
+            a++;
+            if(strcmp(argv[a], "csv") == 0) {
+                traceFormat = TRACE_FORMAT_CSV;
+            } else if(strcmp(argv[a], "bin") == 0) {
+                traceFormat = TRACE_FORMAT_BINARY;
+            } else {
+                cout << "ERROR: Unknown trace format: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--compress") == 0) {
+            compress = true;
+        }
+        else if(strcmp(argv[a], "--delta") == 0) {
+            switchLogMode = SWITCH_LOG_DELTA;
+        }
+        else if(strcmp(argv[a], "--keyframe") == 0 && a + 1 < argc) {
+            keyframeInterval = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--checkpoint") == 0 && a + 1 < argc) {
+            checkpointInterval = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--resume") == 0 && a + 1 < argc) {
+            resumeFile = argv[++a];
+        }
+        else if(strcmp(argv[a], "--replay") == 0 && a + 1 < argc) {
+            replayFile = argv[++a];
+        }
+        else if(strcmp(argv[a], "--hashes") == 0) {
+            writeHashes = true;
+        }
+        else if(strcmp(argv[a], "--dump-tick") == 0 && a + 1 < argc) {
+            dumpTick = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--verify-hash") == 0) {
+            verifyHash = true;
+        }
+        else if(strcmp(argv[a], "--verify-tables") == 0) {
+            verifyTables = true;
+        }
+        else if(strcmp(argv[a], "--verify-kernels") == 0) {
+            verifyKernels = true;
+        }
+        else if(strcmp(argv[a], "--kernels") == 0 && a + 1 < argc) {
+            a++;
+            int level = findDistanceKernelLevel(argv[a]);
+            if(level < 0 || !setDistanceKernelLevel(level)) {
+                cout << "ERROR: Kernels not available on this CPU: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            tickThreads = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--skip-quiet") == 0) {
+            skipQuiet = true;
+        }
+        else if(strcmp(argv[a], "--cell-by-cell") == 0) {
+            setSegmentAdvanceEnabled(false);
+        }
+        else if(strcmp(argv[a], "--no-regions") == 0) {
+            setRegionGroupingEnabled(false);
+        }
+        else if(strcmp(argv[a], "--no-level-cache") == 0) {
+            setLevelCacheEnabled(false);
+        }
+        else if(strcmp(argv[a], "--quiet") == 0) {
+            quiet = true;
+        }
+        else {
+            printHeadlessUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if(replayFile != nullptr && (resumeFile != nullptr || checkpointInterval > 0 || dumpTick >= 0)) {
+        cout << "ERROR: --replay starts from tick 0 and cannot be combined with "
+             << "--resume, --checkpoint or --dump-tick" << endl;
+        return 1;
+    }
+    if(resumeFile != nullptr && logLevel == LOG_FULL && traceFormat == TRACE_FORMAT_BINARY) {
+        cout << "ERROR: --resume continues the CSV logs in <out>; a binary trace cannot be continued" << endl;
+        return 1;
+    }
+    
+    World* world = createWorld();
+    
+    bool loaded = loadLevelFile(levelFile, *world);
+    
+    if(!loaded) {
+        cout << "ERROR: Failed to load level file: " << levelFile << endl;
+        destroyWorld(world);
+        return 1;
+    }
+    
+    if(resumeFile != nullptr) {
+        if(!loadSnapshotFile(*world, resumeFile)) {
+            cout << "ERROR: " << resumeFile << " is not a checkpoint of " << levelFile << endl;
+            destroyWorld(world);
+            return 1;
+        }
+        if(!quiet) {
+            cout << "Resuming at tick " << world->currentTick << endl;
+        }
+    }
+    
+    // After --resume this checks the level's tables against the restored grid
+    if(verifyTables) {
+        int mismatches = validateTransitionTable(*world);
+        cout << "Transition table: " << mismatches << " mismatching entries" << endl;
+        
+        TrackGraphStats graph;
+        getTrackGraphStats(*world, graph);
+        int graphMismatches = validateTrackGraph(*world);
+        cout << "Track graph: " << graph.nodes << " nodes, " << graph.edges << " edges (mean length "
+             << graph.meanEdgeLength << "), " << graphMismatches << " mismatching entries" << endl;
+        
+        if(mismatches > 0 || graphMismatches > 0) {
+            destroyWorld(world);
+            return 1;
+        }
+    }
+    
+    Journal journal;
+    initializeJournal(journal);
+    if(replayFile != nullptr) {
+        if(!loadJournal(journal, *world, replayFile)) {
+            cout << "ERROR: " << replayFile << " is not a journal of " << levelFile << endl;
+            destroyWorld(world);
+            return 1;
+        }
+        if(!ticksGiven) {
+            maxTicks = getJournalLastTick(journal);
+        }
+    }
+    
+    LogContext log;
+    initializeLogContext(log);
+    setLogLevel(log, logLevel);
+    if(!setOutputDirectory(log, outputDir)) {
+        cout << "ERROR: Output directory path is empty or too long: " << outputDir << endl;
+        destroyWorld(world);
+        return 1;
+    }
+    setTraceFormat(log, traceFormat, compress);
+    setSwitchLogMode(log, switchLogMode, keyframeInterval);
+    setStateHashLog(log, writeHashes);
+    setTickThreads(log, tickThreads);
+    setTimeSkipEnabled(log, skipQuiet);
+    if(resumeFile != nullptr) {
+        setLogResumeTick(log, world->currentTick);
+    }
+    
+    if(logLevel > LOG_NONE || checkpointInterval > 0 || writeHashes || dumpTick >= 0) {
+        mkdir(outputDir, 0755);
+    }
+    
+    char checkpointPath[512];
+    buildOutputPath(log, checkpointPath, "checkpoint.bin");
+    
+    char dumpName[64];
+    char dumpPath[512];
+    snprintf(dumpName, sizeof(dumpName), "state_%d.bin", dumpTick);
+    buildOutputPath(log, dumpPath, dumpName);
+    
+    if(!initializeSimulation(*world, log)) {
+        cout << "ERROR: Cannot create log files in " << outputDir << endl;
+        shutdownSimulation(log);
+        freeJournal(journal);
+        destroyWorld(world);
+        return 1;
+    }
+    
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    
+    int firstMismatch = -1;
+    if(replayFile != nullptr) {
+        firstMismatch = replayJournal(*world, log, journal, maxTicks);
+    }
+    
+    // Run in pieces ending at every checkpoint and at the dump tick, saving
+    // the state after each one
+    while(replayFile == nullptr && world->currentTick < maxTicks) {
+        int stopTick = maxTicks;
+        if(checkpointInterval > 0) {
+            int nextCheckpoint = (world->currentTick / checkpointInterval + 1) * checkpointInterval;
+            if(nextCheckpoint < stopTick) stopTick = nextCheckpoint;
+        }
+        if(dumpTick > world->currentTick && dumpTick < stopTick) {
+            stopTick = dumpTick;
+        }
+        runSimulation(*world, log, stopTick);
+        
+        if(world->currentTick == dumpTick && !saveSnapshotFile(*world, dumpPath)) {
+            cout << "WARNING: Cannot write " << dumpPath << endl;
+        }
+        if(isSimulationComplete(*world)) {
+            break;
+        }
+        if(checkpointInterval > 0 && world->currentTick % checkpointInterval == 0 &&
+           !saveSnapshotFile(*world, checkpointPath)) {
+            cout << "WARNING: Cannot write " << checkpointPath << endl;
+        }
+    }
+    
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+    double wallSeconds = chrono::duration<double>(endTime - startTime).count();
+    
+    writeMetrics(log, world->currentTick, world->trainsDelivered, world->trainsCrashed,
+                 getTotalWaitTicks(*world), world->totalSwitchFlips);
+
+#ifdef SWITCHBACK_PROFILE
+    // Read before shutdownSimulation() frees the profile
+    if(!quiet) {
+        cout << "Tick profile:" << endl;
+        for(int series = 0; series < PROFILE_SERIES_COUNT; series++) {
+            TickPhaseStats stats;
+            getTickPhaseStats(getTickProfile(log), series, stats);
+            cout << "  " << getProfileSeriesName(series) << ": mean " << (long long)stats.meanNs
+                 << " ns, p99 < " << (long long)stats.p99Ns << " ns" << endl;
+        }
+    }
+#endif
+    
+    shutdownSimulation(log);
+    
+    if(!quiet) {
+        cout << "Level: " << world->levelName << endl;
+        cout << "Total Ticks: " << world->currentTick << endl;
+        cout << "Trains Delivered: " << world->trainsDelivered << endl;
+        cout << "Trains Crashed: " << world->trainsCrashed << endl;
+        cout << "Switch Flips: " << world->totalSwitchFlips << endl;
+        if(isTimeSkipEnabled(log)) {
+            cout << "Quiet Ticks Skipped: " << log.skippedTicks << endl;
+        }
+    }
+    
+    double ticksPerSecond = 0.0;
+    if(wallSeconds > 0.0) {
+        ticksPerSecond = world->currentTick / wallSeconds;
+    }
+    
+    cout << "Wall time: " << wallSeconds * 1000.0 << " ms, "
+         << ticksPerSecond << " ticks/sec" << endl;
+    
+    if(replayFile != nullptr) {
+        if(firstMismatch >= 0) {
+            cout << "Replay diverges from " << replayFile << " at tick " << firstMismatch << endl;
+        } else {
+            cout << "Replay matches " << replayFile << " (" << journal.hashCount
+                 << " tick hashes, " << journal.entryCount << " inputs)" << endl;
+        }
+    }
+    
+    bool hashMismatch = false;
+    if(verifyHash) {
+        unsigned long long parts[HASH_PART_COUNT];
+        computeStateHash(*world, parts);
+        for(int part = 0; part < HASH_PART_COUNT; part++) {
+            if(parts[part] != world->stateHash[part]) {
+                cout << "State hash: " << getStateHashPartName(part)
+                     << " differs from a full recompute" << endl;
+                hashMismatch = true;
+            }
+        }
+        if(!hashMismatch) {
+            cout << "State hash: matches a full recompute" << endl;
+        }
+    }
+    
+    bool kernelMismatch = false;
+    if(verifyKernels) {
+        for(int level = KERNEL_SCALAR; level <= getBestDistanceKernelLevel(); level++) {
+            int mismatches = verifyDistanceKernels(*world, level);
+            cout << "Distance kernels (" << getDistanceKernelName(level) << "): ";
+            if(mismatches == 0) {
+                cout << "match the scalar code" << endl;
+            } else {
+                cout << mismatches << " mismatching results" << endl;
+                kernelMismatch = true;
+            }
+        }
+        
+        int signalMismatches = verifySignalLights(*world);
+        if(signalMismatches == 0) {
+            cout << "Signals: match a full recompute" << endl;
+        } else {
+            cout << "Signals: " << signalMismatches << " switches differ from a full recompute" << endl;
+            kernelMismatch = true;
+        }
+    }
+    
+    freeJournal(journal);
+    destroyWorld(world);
+    return (firstMismatch >= 0 || hashMismatch || kernelMismatch) ? 1 : 0;
+}
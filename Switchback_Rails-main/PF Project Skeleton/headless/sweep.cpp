@@ -0,0 +1,162 @@
+#include "../core/sweep.h"
+#include "../core/io.h"
+#include "../core/job_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// ============================================================================
+// HEADLESS/SWEEP.CPP - Run a list of scenarios in parallel
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Print usage
+// ----------------------------------------------------------------------------
+void printSweepUsage(const char* program) {
+    cout << "Usage: " << program << " <jobs.txt> [options]" << endl;
+    cout << "Each line of jobs.txt: <level.lvl> <seed> [overrides]" << endl;
+    cout << "  overrides: ticks=N  skip=0|1  A.k=K  A.k=K0,K1,K2,K3" << endl;
+    cout << "             A.mode=PER_DIR|GLOBAL  A.state=0|1  trainN.spawn=T" << endl;
+    cout << "Options:" << endl;
+    cout << "  --workers N     Worker threads (default: one per hardware thread)" << endl;
+    cout << "  --ticks N       Default tick limit per run (default 500)" << endl;
+    cout << "  --log LEVEL     none | metrics | full (default metrics)" << endl;
+    cout << "  --trace FORMAT  csv | bin, with --log full (default csv)" << endl;
+    cout << "  --out DIR       Output directory (default sweep_out)" << endl;
+    cout << "  --skip-quiet    Time skipping for jobs without skip=0|1" << endl;
+    cout << "  --quiet         Only print the timing line" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    
+    if(argc < 2) {
+        printSweepUsage(argv[0]);
+        return 1;
+    }
+    
+    const char* jobFile = argv[1];
+    SweepSettings settings;
+    settings.workerCount = 0;
+    settings.maxTicks = 500;
+    settings.timeSkip = false;
+    settings.logLevel = LOG_METRICS;
+    settings.traceFormat = TRACE_FORMAT_CSV;
+    strcpy(settings.outputDir, "sweep_out");
+    bool quiet = false;
+    
+    for(int a = 2; a < argc; a++) {
+        if(strcmp(argv[a], "--workers") == 0 && a + 1 < argc) {
+            settings.workerCount = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--ticks") == 0 && a + 1 < argc) {
+            settings.maxTicks = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--log") == 0 && a + 1 < argc) {
+            a++;
+            if(strcmp(argv[a], "none") == 0) {
+                settings.logLevel = LOG_NONE;
+            } else if(strcmp(argv[a], "metrics") == 0) {
+                settings.logLevel = LOG_METRICS;
+            } else if(strcmp(argv[a], "full") == 0) {
+                settings.logLevel = LOG_FULL;
+            } else {
+                cout << "ERROR: Unknown log level: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--trace") == 0 && a + 1 < argc) {
+            a++;
+            if(strcmp(argv[a], "csv") == 0) {
+                settings.traceFormat = TRACE_FORMAT_CSV;
+            } else if(strcmp(argv[a], "bin") == 0) {
+                settings.traceFormat = TRACE_FORMAT_BINARY;
+            } else {
+                cout << "ERROR: Unknown trace format: " << argv[a] << endl;
+                return 1;
+            }
+        }
+        else if(strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            a++;
+            if(strlen(argv[a]) >= 180) {
+                cout << "ERROR: Output directory name too long" << endl;
+                return 1;
+            }
+            strcpy(settings.outputDir, argv[a]);
+        }
+        else if(strcmp(argv[a], "--skip-quiet") == 0) {
+            settings.timeSkip = true;
+        }
+        else if(strcmp(argv[a], "--quiet") == 0) {
+            quiet = true;
+        }
+        else {
+            printSweepUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    SweepJob* jobs;
+    int jobCount = readSweepJobs(jobFile, jobs);
+    if(jobCount < 0) {
+        cout << "ERROR: Failed to read job file: " << jobFile << endl;
+        return 1;
+    }
+    if(jobCount == 0) {
+        cout << "ERROR: No jobs in " << jobFile << endl;
+        delete[] jobs;
+        return 1;
+    }
+    
+    int workers = settings.workerCount;
+    if(workers <= 0) {
+        workers = getHardwareWorkerCount();
+    }
+    if(workers > jobCount) {
+        workers = jobCount;
+    }
+    
+    SweepResult* results = new SweepResult[jobCount];
+    
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    runSweep(settings, jobs, jobCount, results);
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+    double wallSeconds = chrono::duration<double>(endTime - startTime).count();
+    
+    int failed = 0;
+    for(int j = 0; j < jobCount; j++) {
+        if(!results[j].ok) {
+            failed++;
+        }
+    }
+    
+    if(settings.logLevel > LOG_NONE) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/sweep_results.csv", settings.outputDir);
+        ofstream table(path);
+        if(table.is_open()) {
+            writeSweepTable(table, jobs, results, jobCount);
+            table.close();
+        }
+    }
+    
+    if(!quiet) {
+        writeSweepTable(cout, jobs, results, jobCount);
+    }
+    
+    double runsPerSecond = 0.0;
+    if(wallSeconds > 0.0) {
+        runsPerSecond = jobCount / wallSeconds;
+    }
+    
+    cout << "Jobs: " << jobCount << " (" << failed << " failed), workers: " << workers
+         << ", wall time: " << wallSeconds * 1000.0 << " ms, "
+         << runsPerSecond << " runs/sec" << endl;
+    
+    delete[] results;
+    delete[] jobs;
+    return (failed > 0) ? 1 : 0;
+}
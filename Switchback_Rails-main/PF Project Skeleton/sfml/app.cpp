@@ -5,6 +5,8 @@
 #include "../core/switches.h"
 #include "../core/io.h"
 #include "../core/trains.h"
+#include "../core/history.h"
+#include "../core/journal.h"
 #include <SFML/Graphics.hpp>
 #include <cmath>
 #include <cstdio>
@@ -27,8 +29,17 @@ static int g_lastMouseY = 0;
 static float g_cellSize = 40.0f;
 static float g_gridOffsetX = 50.0f;
 static float g_gridOffsetY = 50.0f;
+static History* g_history = nullptr;
+static int g_viewTick = 0;
+static int g_seekTarget = -1;
+static Journal g_journal;
+static bool g_hasClick = false;
+static sf::Mouse::Button g_clickButton = sf::Mouse::Left;
+static int g_clickX = 0;
+static int g_clickY = 0;
 
 const int TILE_SIZE = 48;
+const int HISTORY_JUMP_TICKS = 50;
 
 sf::Color trainColors[] = {
     sf::Color::Red, sf::Color::Blue, sf::Color::Green,
@@ -59,7 +70,7 @@ void drawTile(char tile, int x, int y, int switchState) {
     else if (tile == 'D') {
         shape.setFillColor(sf::Color(255, 100, 0));
     }
-    else if (tile >= 'A' && tile <= 'Z') {
+    else if (isSwitchTile(tile)) {
         shape.setFillColor(switchState == 0 ? sf::Color(50, 150, 200) : sf::Color(200, 150, 50));
     }
     else {
@@ -116,30 +127,26 @@ void drawTrain(int x, int y, int dir, int colorIndex) {
 // ----------------------------------------------------------------------------
 // Draw grid
 // ----------------------------------------------------------------------------
-void drawGrid(char grid[][100], int gridRows, int gridCols,
-             int trainCount, int trainX[], int trainY[], int trainDir[],
-             int trainColor[], bool trainActive[], bool trainCrashed[],
-             bool switchExists[], int switchState[]) {
-    
-    for (int y = 0; y < gridRows; y++) {
-        for (int x = 0; x < gridCols; x++) {
-            char tile = grid[y][x];
+void drawGrid(const World& world) {
+    
+    for (int y = 0; y < world.gridRows; y++) {
+        for (int x = 0; x < world.gridCols; x++) {
+            char tile = getTile(world, x, y);
             int swState = 0;
             
-            if (tile >= 'A' && tile <= 'Z') {
-                int idx = tile - 'A';
-                if (switchExists[idx]) {
-                    swState = switchState[idx];
-                }
+            int id = world.switchAtCell[y * world.gridCols + x];
+            if (id >= 0) {
+                swState = world.switchState[id];
             }
             
             drawTile(tile, x, y, swState);
         }
     }
     
-    for (int i = 0; i < trainCount; i++) {
-        if (trainActive[i] && !trainCrashed[i]) {
-            drawTrain(trainX[i], trainY[i], trainDir[i], trainColor[i]);
+    for (int a = 0; a < world.activeCount; a++) {
+        int i = world.activeList[a];
+        if (!world.trainCrashed[i]) {
+            drawTrain(world.trainX[i], world.trainY[i], world.trainDir[i], world.trainColor[i]);
         }
     }
 }
@@ -157,6 +164,27 @@ void drawUI(int currentTick, int trainsDelivered, int trainsCrashed) {
     statusLight.setPosition(20, 25);
     statusLight.setFillColor(g_isPaused ? sf::Color::Red : sf::Color::Green);
     g_window->draw(statusLight);
+    
+    // Timeline of the recorded ticks; the marker turns blue when rewound
+    int firstTick = getHistoryFirstTick(g_history);
+    int lastTick = getHistoryLastTick(g_history);
+    if (firstTick < 0) return;
+    
+    float barLeft = 50.0f;
+    float barWidth = g_window->getSize().x - 70.0f;
+    sf::RectangleShape bar(sf::Vector2f(barWidth, 4));
+    bar.setPosition(barLeft, 33);
+    bar.setFillColor(sf::Color(90, 90, 90));
+    g_window->draw(bar);
+    
+    float position = 1.0f;
+    if (lastTick > firstTick) {
+        position = (float)(currentTick - firstTick) / (lastTick - firstTick);
+    }
+    sf::RectangleShape marker(sf::Vector2f(4, 16));
+    marker.setPosition(barLeft + position * (barWidth - 4), 27);
+    marker.setFillColor(currentTick < lastTick ? sf::Color(80, 160, 255) : sf::Color::White);
+    g_window->draw(marker);
 }
 
 // ----------------------------------------------------------------------------
@@ -170,6 +198,37 @@ void handleInput(sf::Event& event) {
         else if (event.key.code == sf::Keyboard::Escape) {
             if (g_window) g_window->close();
         }
+        else if (event.key.code == sf::Keyboard::Left) {
+            g_isPaused = true;
+            g_seekTarget = g_viewTick - 1;
+        }
+        else if (event.key.code == sf::Keyboard::Right) {
+            g_isPaused = true;
+            g_seekTarget = g_viewTick + 1;
+        }
+        else if (event.key.code == sf::Keyboard::PageUp) {
+            g_isPaused = true;
+            g_seekTarget = (g_viewTick > HISTORY_JUMP_TICKS) ? g_viewTick - HISTORY_JUMP_TICKS : 0;
+        }
+        else if (event.key.code == sf::Keyboard::PageDown) {
+            g_isPaused = true;
+            g_seekTarget = g_viewTick + HISTORY_JUMP_TICKS;
+        }
+        else if (event.key.code == sf::Keyboard::Home) {
+            g_isPaused = true;
+            g_seekTarget = getHistoryFirstTick(g_history);
+        }
+        else if (event.key.code == sf::Keyboard::End) {
+            g_isPaused = true;
+            g_seekTarget = getHistoryLastTick(g_history);
+        }
+    }
+    
+    if (event.type == sf::Event::MouseButtonPressed) {
+        g_hasClick = true;
+        g_clickButton = event.mouseButton.button;
+        g_clickX = event.mouseButton.x;
+        g_clickY = event.mouseButton.y;
     }
     
     if (event.type == sf::Event::MouseWheelScrolled) {
@@ -202,28 +261,87 @@ bool initializeApp() {
     }
 }
 
+// ----------------------------------------------------------------------------
+// Live and replayed ticks
+// ----------------------------------------------------------------------------
+// Only the newest recorded tick is simulated; any tick before it is replayed
+// from the history, so logs are written once per tick.
+static bool isRunFinished(const World& world, int maxTicks) {
+    return isSimulationComplete(world) || world.currentTick >= maxTicks;
+}
+
+static void simulateLiveTick(World& world, LogContext& log, int maxTicks) {
+    simulateOneTick(world, log);
+    recordJournalHash(g_journal, world);
+    recordHistoryTick(g_history, world);
+    
+    printGridToTerminal(world);
+    
+    if (isRunFinished(world, maxTicks)) {
+        cout << "\nSimulation complete at tick " << world.currentTick << endl;
+    }
+}
+
+static void showTick(World& world, LogContext& log, int tick, int maxTicks) {
+    int lastTick = getHistoryLastTick(g_history);
+    
+    if (tick > lastTick) {
+        if (world.currentTick != lastTick) {
+            seekHistory(g_history, world, lastTick);
+        }
+        if (!isRunFinished(world, maxTicks)) {
+            simulateLiveTick(world, log, maxTicks);
+        }
+        return;
+    }
+    
+    int firstTick = getHistoryFirstTick(g_history);
+    if (tick < firstTick) {
+        tick = firstTick;
+    }
+    seekHistory(g_history, world, tick);
+}
+
+// ----------------------------------------------------------------------------
+// Clicks on the grid
+// ----------------------------------------------------------------------------
+// Left toggles a safety tile, right flips the switch under the cursor. Both
+// go through the journal and only apply to the newest tick, since changing
+// a rewound tick would fork a run whose later ticks are already logged.
+static void handleClick(World& world) {
+    if (world.currentTick != getHistoryLastTick(g_history)) {
+        cout << "Viewing tick " << world.currentTick
+             << ": press End to return to the newest tick before changing the track" << endl;
+        return;
+    }
+    
+    sf::Vector2f point = g_window->mapPixelToCoords(sf::Vector2i(g_clickX, g_clickY));
+    int x = (int)floor(point.x / TILE_SIZE);
+    int y = (int)floor(point.y / TILE_SIZE);
+    if (!isInBounds(x, y, world.gridCols, world.gridRows)) return;
+    
+    bool changed = false;
+    if (g_clickButton == sf::Mouse::Left) {
+        changed = journalSafetyTile(g_journal, world, x, y);
+    } else if (g_clickButton == sf::Mouse::Right) {
+        changed = journalSwitchToggle(g_journal, world, world.switchAtCell[y * world.gridCols + x]);
+    }
+    
+    // Keep the stored tick in step with what is on screen
+    if (changed) {
+        recordHistoryTick(g_history, world);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // Run application loop
 // ----------------------------------------------------------------------------
-void runApp(int& gridRows, int& gridCols, char grid[][100],
-           int& trainCount, int trainX[], int trainY[], int trainDir[],
-           int trainNextX[], int trainNextY[], int trainNextDir[],
-           int trainPrevX[], int trainPrevY[],
-           int trainDestX[], int trainDestY[],
-           int trainSpawnTick[], int trainColor[],
-           bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-           int trainWaitTicks[], int trainTotalWaitTicks[],
-           bool switchExists[], int switchState[], bool switchMode[],
-           int switchCounters[][4], int switchKValues[][4],
-           bool switchFlipQueued[], int switchSignal[],
-           char switchStateNames[][2][32],
-           int& currentTick, int& trainsDelivered, int& trainsCrashed,
-           int& totalSwitchFlips) {
+void runApp(World& world, LogContext& log, long long historyBudgetBytes, int keyframeInterval) {
     
     if (!g_window) return;
     
-    float gridPixelWidth = gridCols * TILE_SIZE;
-    float gridPixelHeight = gridRows * TILE_SIZE;
+    float gridPixelWidth = world.gridCols * TILE_SIZE;
+    float gridPixelHeight = world.gridRows * TILE_SIZE;
     float paddingPixels = 50.0f;
     float desiredViewWidth = gridPixelWidth + (paddingPixels * 2);
     float desiredViewHeight = gridPixelHeight + (paddingPixels * 2);
@@ -237,9 +355,17 @@ void runApp(int& gridRows, int& gridCols, char grid[][100],
     const float TICK_DELAY = 0.5f;
     const int MAX_TICKS = 500;
     
-    spawnTrainsForTick(0, trainCount, trainSpawnTick, trainX, trainY, trainActive, grid);
+    spawnTrainsForTick(world, 0);
+    
+    g_history = createHistory(world, keyframeInterval, historyBudgetBytes);
+    recordHistoryTick(g_history, world);
+    initializeJournal(g_journal);
+    recordJournalHash(g_journal, world);
     
-    while (g_window->isOpen() && currentTick < MAX_TICKS) {
+    // The window stays open once the run is over so it can still be scrubbed
+    while (g_window->isOpen()) {
+        g_viewTick = world.currentTick;
+        
         sf::Event event;
         while (g_window->pollEvent(event)) {
             if (event.type == sf::Event::Closed) {
@@ -248,38 +374,25 @@ void runApp(int& gridRows, int& gridCols, char grid[][100],
             handleInput(event);
         }
         
+        if (g_hasClick) {
+            handleClick(world);
+            g_hasClick = false;
+        }
+        
+        if (g_seekTarget >= 0) {
+            showTick(world, log, g_seekTarget, MAX_TICKS);
+            g_seekTarget = -1;
+        }
+        
         if (!g_isPaused) {
             tickTimer += clock.restart().asSeconds();
             
             if (tickTimer >= TICK_DELAY) {
                 tickTimer = 0;
                 
-                simulateOneTick(currentTick,
-                               trainCount, trainX, trainY, trainDir,
-                               trainNextX, trainNextY, trainNextDir,
-                               trainPrevX, trainPrevY,
-                               trainDestX, trainDestY,
-                               trainSpawnTick, trainColor,
-                               trainActive, trainCrashed, trainDelivered,
-                               trainWaitTicks, trainTotalWaitTicks,
-                               grid, gridRows, gridCols,
-                               switchExists, switchState, switchMode,
-                               switchCounters, switchKValues,
-                               switchFlipQueued, switchSignal,
-                               switchStateNames,
-                               trainsDelivered, trainsCrashed, totalSwitchFlips);
-                
-                bool allSpawned = true;
-                for (int i = 0; i < trainCount; i++) {
-                    if (trainSpawnTick[i] > currentTick) {
-                        allSpawned = false;
-                        break;
-                    }
-                }
-                
-                if (allSpawned && isSimulationComplete(trainCount, trainActive, trainDelivered, trainCrashed)) {
-                    cout << "\nSimulation complete at tick " << currentTick << endl;
-                    break;
+                if (world.currentTick < getHistoryLastTick(g_history) ||
+                    !isRunFinished(world, MAX_TICKS)) {
+                    showTick(world, log, world.currentTick + 1, MAX_TICKS);
                 }
             }
         } else {
@@ -288,15 +401,28 @@ void runApp(int& gridRows, int& gridCols, char grid[][100],
         
         g_window->clear(sf::Color(20, 20, 20));
         
-        drawGrid(grid, gridRows, gridCols,
-                trainCount, trainX, trainY, trainDir,
-                trainColor, trainActive, trainCrashed,
-                switchExists, switchState);
+        drawGrid(world);
         
-        drawUI(currentTick, trainsDelivered, trainsCrashed);
+        drawUI(world.currentTick, world.trainsDelivered, world.trainsCrashed);
         
         g_window->display();
     }
+    
+    // Metrics are written from the newest tick, not the one on screen
+    seekHistory(g_history, world, getHistoryLastTick(g_history));
+    
+    destroyHistory(g_history);
+    g_history = nullptr;
+    
+    // Replay with: switchback_headless <level> --replay <out>/journal.csv
+    char journalPath[512];
+    buildOutputPath(log, journalPath, "journal.csv");
+    if (saveJournal(g_journal, world, journalPath)) {
+        cout << "Input journal saved to " << journalPath << endl;
+    } else {
+        cout << "WARNING: Cannot write " << journalPath << endl;
+    }
+    freeJournal(g_journal);
 }
 
 // ----------------------------------------------------------------------------
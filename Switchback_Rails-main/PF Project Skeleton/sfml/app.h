@@ -5,22 +5,14 @@
 // APP.H - SFML Application
 // ============================================================================
 
+#include "../core/world.h"
+#include "../core/io.h"
+
 bool initializeApp();
 
-void runApp(int& gridRows, int& gridCols, char grid[][100],
-           int& trainCount, int trainX[], int trainY[], int trainDir[],
-           int trainNextX[], int trainNextY[], int trainNextDir[],
-           int trainPrevX[], int trainPrevY[],
-           int trainDestX[], int trainDestY[],
-           int trainSpawnTick[], int trainColor[],
-           bool trainActive[], bool trainCrashed[], bool trainDelivered[],
-           int trainWaitTicks[], int trainTotalWaitTicks[],
-           bool switchExists[], int switchState[], bool switchMode[],
-           int switchCounters[][4], int switchKValues[][4],
-           bool switchFlipQueued[], int switchSignal[],
-           char switchStateNames[][2][32],
-           int& currentTick, int& trainsDelivered, int& trainsCrashed,
-           int& totalSwitchFlips);
+// Every tick shown is kept in a keyframe + delta history of at most
+// historyBudgetBytes, which the arrow keys scrub through
+void runApp(World& world, LogContext& log, long long historyBudgetBytes, int keyframeInterval);
 
 void cleanupApp();
 
@@ -3,6 +3,8 @@
 #include "../core/simulation.h"
 #include "../core/io.h"
 #include "../core/trains.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -13,128 +15,68 @@ using namespace std;
 
 int main(int argc, char* argv[]) {
     
-    int gridRows;
-    int gridCols;
-    char grid[50][100];
-    char levelName[256];
-    
-    int trainCount;
-    int trainX[100];
-    int trainY[100];
-    int trainDir[100];
-    int trainNextX[100];
-    int trainNextY[100];
-    int trainNextDir[100];
-    int trainPrevX[100];
-    int trainPrevY[100];
-    int trainDestX[100];
-    int trainDestY[100];
-    int trainSpawnTick[100];
-    int trainColor[100];
-    bool trainActive[100];
-    bool trainCrashed[100];
-    bool trainDelivered[100];
-    int trainWaitTicks[100];
-    int trainTotalWaitTicks[100];
-    
-    bool switchExists[26];
-    int switchState[26];
-    bool switchMode[26];
-    int switchCounters[26][4];
-    int switchKValues[26][4];
-    bool switchFlipQueued[26];
-    int switchSignal[26];
-    char switchStateNames[26][2][32];
-    
-    int spawnCount;
-    int spawnX[50];
-    int spawnY[50];
-    
-    int destCount;
-    int destX[50];
-    int destY[50];
-    
-    int currentTick;
-    int seed;
-    int weatherMode;
-    
-    int trainsDelivered;
-    int trainsCrashed;
-    int totalSwitchFlips;
-    int signalViolations;
-    
     cout << "========================================" << endl;
     cout << "   SWITCHBACK RAILS - Railway Simulator" << endl;
     cout << "========================================" << endl;
     cout << endl;
     
     if(argc < 2) {
-        cout << "Usage: " << argv[0] << " <level_file.lvl>" << endl;
+        cout << "Usage: " << argv[0] << " <level_file.lvl> [--history-mb N] [--keyframe N]" << endl;
         cout << "Example: " << argv[0] << " data/levels/easy_level.lvl" << endl;
         return 1;
     }
     
     const char* levelFile = argv[1];
+    long long historyBudgetMB = 64;
+    int keyframeInterval = 50;
     
-    initializeSimulationState(gridRows, gridCols, grid, levelName,
-                              trainCount, trainX, trainY, trainDir,
-                              trainNextX, trainNextY, trainNextDir,
-                              trainPrevX, trainPrevY,
-                              trainDestX, trainDestY, trainSpawnTick, trainColor,
-                              trainActive, trainCrashed, trainDelivered,
-                              trainWaitTicks, trainTotalWaitTicks,
-                              switchExists, switchState, switchMode,
-                              switchCounters, switchKValues, switchFlipQueued,
-                              switchSignal, switchStateNames,
-                              spawnCount, spawnX, spawnY,
-                              destCount, destX, destY,
-                              currentTick, seed, weatherMode,
-                              trainsDelivered, trainsCrashed, totalSwitchFlips, signalViolations);
+    for(int a = 2; a < argc; a++) {
+        if(strcmp(argv[a], "--history-mb") == 0 && a + 1 < argc) {
+            historyBudgetMB = atoll(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--keyframe") == 0 && a + 1 < argc) {
+            keyframeInterval = atoi(argv[++a]);
+        }
+        else {
+            cout << "Unknown option: " << argv[a] << endl;
+            return 1;
+        }
+    }
+    
+    World* world = createWorld();
     
     cout << "Loading level: " << levelFile << endl;
     
-    bool loaded = loadLevelFile(levelFile, levelName,
-                                gridRows, gridCols, grid,
-                                seed, weatherMode,
-                                switchExists, switchState, switchMode,
-                                switchKValues, switchStateNames,
-                                trainCount, trainX, trainY, trainDir,
-                                trainDestX, trainDestY, trainSpawnTick, trainColor,
-                                spawnCount, spawnX, spawnY,
-                                destCount, destX, destY);
+    bool loaded = loadLevelFile(levelFile, *world);
     
     if(!loaded) {
         cout << "ERROR: Failed to load level file!" << endl;
+        destroyWorld(world);
         return 1;
     }
     
-    cout << "Level loaded: " << levelName << endl;
-    cout << "Grid size: " << gridRows << " x " << gridCols << endl;
-    cout << "Trains: " << trainCount << endl;
-    cout << "Seed: " << seed << endl;
+    cout << "Level loaded: " << world->levelName << endl;
+    cout << "Grid size: " << world->gridRows << " x " << world->gridCols << endl;
+    cout << "Trains: " << world->trainCount << endl;
+    cout << "Seed: " << world->seed << endl;
     cout << endl;
     
-    initializeSimulation();
+    LogContext log;
+    initializeLogContext(log);
+    
+    if(!initializeSimulation(*world, log)) {
+        cout << "ERROR: Cannot create log files in " << log.outputDir << endl;
+        shutdownSimulation(log);
+        destroyWorld(world);
+        return 1;
+    }
     
     bool useSFML = initializeApp();
     
     if(useSFML) {
         cout << "Starting SFML visualization..." << endl;
         
-        runApp(gridRows, gridCols, grid,
-              trainCount, trainX, trainY, trainDir,
-              trainNextX, trainNextY, trainNextDir,
-              trainPrevX, trainPrevY,
-              trainDestX, trainDestY,
-              trainSpawnTick, trainColor,
-              trainActive, trainCrashed, trainDelivered,
-              trainWaitTicks, trainTotalWaitTicks,
-              switchExists, switchState, switchMode,
-              switchCounters, switchKValues,
-              switchFlipQueued, switchSignal,
-              switchStateNames,
-              currentTick, trainsDelivered, trainsCrashed,
-              totalSwitchFlips);
+        runApp(*world, log, historyBudgetMB * 1024 * 1024, keyframeInterval);
         
         cleanupApp();
         
@@ -144,59 +86,37 @@ int main(int argc, char* argv[]) {
         
         const int MAX_TICKS = 500;
         
-        spawnTrainsForTick(0, trainCount, trainSpawnTick, trainX, trainY, trainActive, grid);
+        spawnTrainsForTick(*world, 0);
         
-        while(currentTick < MAX_TICKS) {
-            simulateOneTick(currentTick,
-                           trainCount, trainX, trainY, trainDir,
-                           trainNextX, trainNextY, trainNextDir,
-                           trainPrevX, trainPrevY,
-                           trainDestX, trainDestY,
-                           trainSpawnTick, trainColor,
-                           trainActive, trainCrashed, trainDelivered,
-                           trainWaitTicks, trainTotalWaitTicks,
-                           grid, gridRows, gridCols,
-                           switchExists, switchState, switchMode,
-                           switchCounters, switchKValues,
-                           switchFlipQueued, switchSignal,
-                           switchStateNames,
-                           trainsDelivered, trainsCrashed, totalSwitchFlips);
+        while(world->currentTick < MAX_TICKS) {
+            simulateOneTick(*world, log);
             
-            bool allSpawned = true;
-            for(int i = 0; i < trainCount; i++) {
-                if(trainSpawnTick[i] > currentTick) {
-                    allSpawned = false;
-                    break;
-                }
-            }
+            printGridToTerminal(*world);
             
-            if(allSpawned && isSimulationComplete(trainCount, trainActive, trainDelivered, trainCrashed)) {
-                cout << "\nSimulation complete at tick " << currentTick << endl;
+            if(isSimulationComplete(*world)) {
+                cout << "\nSimulation complete at tick " << world->currentTick << endl;
                 break;
             }
         }
     }
-
-    int totalWait = 0;
-    for(int i = 0; i < trainCount; i++) {
-        totalWait += trainTotalWaitTicks[i];
-    }
     
-    writeMetrics(currentTick, trainsDelivered, trainsCrashed,
-                totalWait, totalSwitchFlips);
+    writeMetrics(log, world->currentTick, world->trainsDelivered, world->trainsCrashed,
+                 getTotalWaitTicks(*world), world->totalSwitchFlips);
+    
+    shutdownSimulation(log);
     
     cout << endl;
     cout << "========================================" << endl;
     cout << "         SIMULATION COMPLETE" << endl;
     cout << "========================================" << endl;
-    cout << "Total Ticks: " << currentTick << endl;
-    cout << "Trains Delivered: " << trainsDelivered << endl;
-    cout << "Trains Crashed: " << trainsCrashed << endl;
-    cout << "Switch Flips: " << totalSwitchFlips << endl;
+    cout << "Total Ticks: " << world->currentTick << endl;
+    cout << "Trains Delivered: " << world->trainsDelivered << endl;
+    cout << "Trains Crashed: " << world->trainsCrashed << endl;
+    cout << "Switch Flips: " << world->totalSwitchFlips << endl;
     cout << endl;
     cout << "Logs saved " << endl;
     
-    
+    destroyWorld(world);
     return 0;
 }
 
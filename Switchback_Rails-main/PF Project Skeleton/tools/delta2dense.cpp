@@ -0,0 +1,286 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+// ============================================================================
+// DELTA2DENSE.CPP - Expand delta switch/signal logs to the dense CSV layout
+// ============================================================================
+// Input rows are "Tick,Id,<payload...>,Kind" where Kind is K (keyframe),
+// C (change) or E (end of run). The dense output is "Tick,Id,<payload...>"
+// for every known id on every tick, in the order the ids first appeared.
+// ============================================================================
+
+const int MAX_ID_LEN = 16;
+const int MAX_PAYLOAD_LEN = 96;
+const int MAX_LINE_LEN = 256;
+
+// Ids in first-seen order, grown as new ids appear, plus an open-addressing
+// table (kept at most half full) mapping an id to its index
+static char (*g_ids)[MAX_ID_LEN] = nullptr;
+static char (*g_payloads)[MAX_PAYLOAD_LEN] = nullptr;
+static int g_idCount = 0;
+static int g_idCapacity = 0;
+static int* g_idSlots = nullptr;
+static int g_idSlotCount = 0;
+
+// ----------------------------------------------------------------------------
+// Split "Tick,Id,payload...,Kind" in place; returns false for malformed rows
+// ----------------------------------------------------------------------------
+bool splitDeltaRow(char line[], int& tick, char*& id, char*& payload, char& kind) {
+    int len = strlen(line);
+    while(len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n')) {
+        line[--len] = '\0';
+    }
+    
+    char* firstComma = strchr(line, ',');
+    if(firstComma == nullptr) return false;
+    char* secondComma = strchr(firstComma + 1, ',');
+    char* lastComma = strrchr(line, ',');
+    if(secondComma == nullptr || lastComma == secondComma) return false;
+    
+    *firstComma = '\0';
+    *secondComma = '\0';
+    *lastComma = '\0';
+    
+    tick = atoi(line);
+    id = firstComma + 1;
+    payload = secondComma + 1;
+    kind = lastComma[1];
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Hash of an id (FNV-1a)
+// ----------------------------------------------------------------------------
+static unsigned hashDeltaId(const char* id) {
+    unsigned hash = 2166136261u;
+    for(int i = 0; id[i] != '\0'; i++) {
+        hash = (hash ^ (unsigned char)id[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+// Slot holding id, or the empty slot where it belongs
+// ----------------------------------------------------------------------------
+static int findDeltaSlot(const char* id) {
+    int mask = g_idSlotCount - 1;
+    int slot = hashDeltaId(id) & mask;
+    while(g_idSlots[slot] >= 0 && strcmp(g_ids[g_idSlots[slot]], id) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// ----------------------------------------------------------------------------
+// Double the id arrays and the slot table
+// ----------------------------------------------------------------------------
+static void growDeltaIds() {
+    int capacity = (g_idCapacity > 0) ? g_idCapacity * 2 : 256;
+    
+    char (*ids)[MAX_ID_LEN] = new char[capacity][MAX_ID_LEN];
+    char (*payloads)[MAX_PAYLOAD_LEN] = new char[capacity][MAX_PAYLOAD_LEN];
+    if(g_idCount > 0) {
+        memcpy(ids, g_ids, (size_t)g_idCount * MAX_ID_LEN);
+        memcpy(payloads, g_payloads, (size_t)g_idCount * MAX_PAYLOAD_LEN);
+    }
+    delete[] g_ids;
+    delete[] g_payloads;
+    g_ids = ids;
+    g_payloads = payloads;
+    g_idCapacity = capacity;
+    
+    delete[] g_idSlots;
+    g_idSlotCount = capacity * 2;
+    g_idSlots = new int[g_idSlotCount];
+    for(int slot = 0; slot < g_idSlotCount; slot++) {
+        g_idSlots[slot] = -1;
+    }
+    for(int i = 0; i < g_idCount; i++) {
+        g_idSlots[findDeltaSlot(g_ids[i])] = i;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Find or add an id
+// ----------------------------------------------------------------------------
+int findDeltaId(const char* id) {
+    char key[MAX_ID_LEN];
+    strncpy(key, id, MAX_ID_LEN - 1);
+    key[MAX_ID_LEN - 1] = '\0';
+    
+    if(g_idCount >= g_idCapacity) {
+        growDeltaIds();
+    }
+    
+    int slot = findDeltaSlot(key);
+    if(g_idSlots[slot] >= 0) {
+        return g_idSlots[slot];
+    }
+    
+    memcpy(g_ids[g_idCount], key, MAX_ID_LEN);
+    g_payloads[g_idCount][0] = '\0';
+    g_idSlots[slot] = g_idCount;
+    return g_idCount++;
+}
+
+// ----------------------------------------------------------------------------
+// Forget every id (before the next file)
+// ----------------------------------------------------------------------------
+void clearDeltaIds() {
+    g_idCount = 0;
+    for(int slot = 0; slot < g_idSlotCount; slot++) {
+        g_idSlots[slot] = -1;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Write the full state for one tick
+// ----------------------------------------------------------------------------
+void emitDenseTick(ostream& out, int tick) {
+    for(int i = 0; i < g_idCount; i++) {
+        out << tick << "," << g_ids[i] << "," << g_payloads[i] << "\n";
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Expand one delta file. onlyTick < 0 writes every tick, otherwise just that one
+// ----------------------------------------------------------------------------
+bool expandDeltaFile(const char* inPath, ostream& out, int onlyTick) {
+    ifstream in(inPath);
+    if(!in.is_open()) {
+        cout << "ERROR: Cannot open " << inPath << endl;
+        return false;
+    }
+    
+    char line[MAX_LINE_LEN];
+    if(!in.getline(line, MAX_LINE_LEN)) {
+        return false;
+    }
+    
+    // Header without the trailing ",Kind" column
+    char* kindColumn = strrchr(line, ',');
+    if(kindColumn != nullptr) {
+        *kindColumn = '\0';
+    }
+    if(onlyTick < 0) {
+        out << line << "\n";
+    }
+    
+    clearDeltaIds();
+    int currentTick = -1;
+    
+    while(in.getline(line, MAX_LINE_LEN)) {
+        int tick;
+        char* id;
+        char* payload;
+        char kind;
+        if(!splitDeltaRow(line, tick, id, payload, kind)) {
+            continue;
+        }
+        
+        if(currentTick < 0) {
+            currentTick = tick;
+        }
+        
+        // Every tick before this row is complete
+        while(currentTick < tick) {
+            if(onlyTick < 0 || onlyTick == currentTick) {
+                emitDenseTick(out, currentTick);
+            }
+            currentTick++;
+        }
+        
+        if(kind == 'E') {
+            if(onlyTick < 0 || onlyTick == currentTick) {
+                emitDenseTick(out, currentTick);
+            }
+            return true;
+        }
+        
+        int idx = findDeltaId(id);
+        strncpy(g_payloads[idx], payload, MAX_PAYLOAD_LEN - 1);
+        g_payloads[idx][MAX_PAYLOAD_LEN - 1] = '\0';
+    }
+    
+    // Log without an end marker (run was cut short): stop at the last tick seen
+    if(currentTick >= 0 && (onlyTick < 0 || onlyTick == currentTick)) {
+        emitDenseTick(out, currentTick);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    
+    const char* dir = "out";
+    const char* outDir = nullptr;
+    int onlyTick = -1;
+    
+    for(int a = 1; a < argc; a++) {
+        if(strcmp(argv[a], "--tick") == 0 && a + 1 < argc) {
+            onlyTick = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--out") == 0 && a + 1 < argc) {
+            outDir = argv[++a];
+        }
+        else if(argv[a][0] == '-') {
+            cout << "Usage: " << argv[0] << " [input_dir] [--out DIR] [--tick N]" << endl;
+            cout << "Reads switches_delta.csv and signals_delta.csv from input_dir (default out)" << endl;
+            cout << "and writes switches.csv and signals.csv to --out DIR (default input_dir)," << endl;
+            cout << "or prints tick N with --tick." << endl;
+            return 1;
+        }
+        else {
+            dir = argv[a];
+        }
+    }
+    
+    // A missing input directory is reported; --out is created if needed
+    struct stat info;
+    if(stat(dir, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        cout << "ERROR: Directory " << dir << " does not exist" << endl;
+        return 1;
+    }
+    if(outDir == nullptr) {
+        outDir = dir;
+    }
+    else if(onlyTick < 0) {
+        mkdir(outDir, 0755);
+    }
+    
+    const char* inNames[] = {"switches_delta.csv", "signals_delta.csv"};
+    const char* outNames[] = {"switches.csv", "signals.csv"};
+    
+    for(int f = 0; f < 2; f++) {
+        char inPath[512];
+        snprintf(inPath, sizeof(inPath), "%s/%s", dir, inNames[f]);
+        
+        if(onlyTick >= 0) {
+            if(!expandDeltaFile(inPath, cout, onlyTick)) {
+                return 1;
+            }
+            continue;
+        }
+        
+        char outPath[512];
+        snprintf(outPath, sizeof(outPath), "%s/%s", outDir, outNames[f]);
+        ofstream out(outPath);
+        if(!out.is_open()) {
+            cout << "ERROR: Cannot write " << outPath << endl;
+            return 1;
+        }
+        
+        if(!expandDeltaFile(inPath, out, -1)) {
+            return 1;
+        }
+        out.close();
+        cout << "Wrote " << outPath << endl;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include "../core/world.h"
+#include "../core/io.h"
+#include "../core/snapshot.h"
+#include "../core/state_hash.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// ============================================================================
+// HASHDIFF.CPP - Find where two runs diverge
+// ============================================================================
+// Compares the hashes.csv files of two runs (switchback_headless --hashes)
+// and reports the first tick whose state hash differs, with the parts of
+// the hash that differ. When both runs also saved that tick's state
+// (--dump-tick T writes state_T.bin) and the level is given, the values of
+// every train, switch and safety tile that differ are listed.
+// ============================================================================
+
+const int HASH_LINE_LEN = 512;
+
+struct HashStream {
+    int* ticks;
+    unsigned long long* parts;      // HASH_PART_COUNT per row
+    int rowCount;
+    int rowCapacity;
+};
+
+// ----------------------------------------------------------------------------
+// Read <dir>/hashes.csv
+// ----------------------------------------------------------------------------
+bool readHashStream(const char* dir, HashStream& stream) {
+    stream.ticks = nullptr;
+    stream.parts = nullptr;
+    stream.rowCount = 0;
+    stream.rowCapacity = 0;
+    
+    char path[512];
+    snprintf(path, sizeof(path), "%s/hashes.csv", dir);
+    ifstream file(path);
+    if(!file.is_open()) {
+        return false;
+    }
+    
+    char line[HASH_LINE_LEN];
+    file.getline(line, HASH_LINE_LEN);
+    
+    while(file.getline(line, HASH_LINE_LEN)) {
+        if(line[0] == '\0') continue;
+        
+        if(stream.rowCount == stream.rowCapacity) {
+            int newCapacity = (stream.rowCapacity == 0) ? 1024 : stream.rowCapacity * 2;
+            int* ticks = new int[newCapacity];
+            unsigned long long* parts = new unsigned long long[newCapacity * HASH_PART_COUNT];
+            if(stream.rowCount > 0) {
+                memcpy(ticks, stream.ticks, stream.rowCount * sizeof(int));
+                memcpy(parts, stream.parts,
+                       stream.rowCount * HASH_PART_COUNT * sizeof(unsigned long long));
+            }
+            delete[] stream.ticks;
+            delete[] stream.parts;
+            stream.ticks = ticks;
+            stream.parts = parts;
+            stream.rowCapacity = newCapacity;
+        }
+        
+        // Tick, full hash, then the parts
+        char* field = line;
+        stream.ticks[stream.rowCount] = atoi(field);
+        for(int column = 0; column < HASH_PART_COUNT + 1; column++) {
+            field = strchr(field, ',');
+            if(field == nullptr) {
+                return false;
+            }
+            field++;
+            if(column > 0) {
+                stream.parts[stream.rowCount * HASH_PART_COUNT + column - 1] =
+                    strtoull(field, nullptr, 16);
+            }
+        }
+        stream.rowCount++;
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// List the values that differ between two states of the same level
+// ----------------------------------------------------------------------------
+int diffWorldFields(const World& a, const World& b) {
+    const char* dirStr[] = {"UP", "RIGHT", "DOWN", "LEFT"};
+    int differences = 0;
+    
+    if(a.currentTick != b.currentTick) {
+        cout << "  tick: " << a.currentTick << " vs " << b.currentTick << endl;
+        differences++;
+    }
+    
+    for(int i = 0; i < a.trainCount; i++) {
+        if(a.trainX[i] != b.trainX[i] || a.trainY[i] != b.trainY[i]) {
+            cout << "  train " << i << " position: (" << a.trainX[i] << "," << a.trainY[i]
+                 << ") vs (" << b.trainX[i] << "," << b.trainY[i] << ")" << endl;
+            differences++;
+        }
+        if(a.trainDir[i] != b.trainDir[i]) {
+            cout << "  train " << i << " direction: " << dirStr[a.trainDir[i] & 3] << " vs "
+                 << dirStr[b.trainDir[i] & 3] << endl;
+            differences++;
+        }
+        if(getTrainFlags(a, i) != getTrainFlags(b, i)) {
+            cout << "  train " << i << " active/crashed/delivered: " << a.trainActive[i]
+                 << a.trainCrashed[i] << a.trainDelivered[i] << " vs " << b.trainActive[i]
+                 << b.trainCrashed[i] << b.trainDelivered[i] << endl;
+            differences++;
+        }
+    }
+    
+    for(int id = 0; id < a.switchCount; id++) {
+        if(a.switchState[id] != b.switchState[id]) {
+            cout << "  switch " << getSwitchName(a, id) << " state: " << a.switchState[id]
+                 << " vs " << b.switchState[id] << endl;
+            differences++;
+        }
+        for(int dir = 0; dir < 4; dir++) {
+            int counterA = a.switchCounters[id * 4 + dir];
+            int counterB = b.switchCounters[id * 4 + dir];
+            if(counterA != counterB) {
+                cout << "  switch " << getSwitchName(a, id) << " counter " << dirStr[dir]
+                     << ": " << counterA << " vs " << counterB << endl;
+                differences++;
+            }
+        }
+    }
+    
+    for(int y = 0; y < a.gridRows; y++) {
+        for(int x = 0; x < a.gridCols; x++) {
+            if(getTile(a, x, y) != getTile(b, x, y)) {
+                cout << "  tile (" << x << "," << y << "): '" << getTile(a, x, y) << "' vs '"
+                     << getTile(b, x, y) << "'" << endl;
+                differences++;
+            }
+        }
+    }
+    
+    return differences;
+}
+
+// ----------------------------------------------------------------------------
+// Load both runs' state of a tick and diff them
+// ----------------------------------------------------------------------------
+void diffDumpedStates(const char* levelFile, const char* dirA, const char* dirB, int tick) {
+    char pathA[512];
+    char pathB[512];
+    snprintf(pathA, sizeof(pathA), "%s/state_%d.bin", dirA, tick);
+    snprintf(pathB, sizeof(pathB), "%s/state_%d.bin", dirB, tick);
+    
+    World* a = createWorld();
+    World* b = createWorld();
+    
+    if(!loadLevelFile(levelFile, *a) || !loadLevelFile(levelFile, *b)) {
+        cout << "ERROR: Failed to load level file: " << levelFile << endl;
+    }
+    else if(!loadSnapshotFile(*a, pathA) || !loadSnapshotFile(*b, pathB)) {
+        cout << "No state of tick " << tick << " for " << levelFile
+             << "; rerun both with --dump-tick " << tick << endl;
+    }
+    else {
+        cout << "Fields that differ at tick " << tick << ":" << endl;
+        if(diffWorldFields(*a, *b) == 0) {
+            cout << "  (none)" << endl;
+        }
+    }
+    
+    destroyWorld(a);
+    destroyWorld(b);
+}
+
+int main(int argc, char* argv[]) {
+    
+    if(argc < 3) {
+        cout << "Usage: " << argv[0] << " <run_dir_a> <run_dir_b> [level_file.lvl]" << endl;
+        return 1;
+    }
+    
+    HashStream a;
+    HashStream b;
+    if(!readHashStream(argv[1], a) || !readHashStream(argv[2], b)) {
+        cout << "ERROR: Cannot read hashes.csv of " << argv[1] << " and " << argv[2] << endl;
+        return 1;
+    }
+    
+    int rows = (a.rowCount < b.rowCount) ? a.rowCount : b.rowCount;
+    int row = 0;
+    while(row < rows && a.ticks[row] == b.ticks[row] &&
+          memcmp(&a.parts[row * HASH_PART_COUNT], &b.parts[row * HASH_PART_COUNT],
+                 HASH_PART_COUNT * sizeof(unsigned long long)) == 0) {
+        row++;
+    }
+    
+    int status = 1;
+    if(row == rows && a.rowCount == b.rowCount) {
+        cout << "Identical: " << rows << " ticks" << endl;
+        status = 0;
+    }
+    else if(row == rows) {
+        const char* shorter = (a.rowCount < b.rowCount) ? argv[1] : argv[2];
+        cout << "Identical for " << rows << " ticks, then " << shorter << " ends" << endl;
+    }
+    else if(a.ticks[row] != b.ticks[row]) {
+        cout << "Tick numbers differ at row " << row + 1 << ": " << a.ticks[row] << " vs "
+             << b.ticks[row] << endl;
+    }
+    else {
+        int tick = a.ticks[row];
+        cout << "First divergent tick: " << tick << endl;
+        cout << "Differing parts:";
+        for(int part = 0; part < HASH_PART_COUNT; part++) {
+            if(a.parts[row * HASH_PART_COUNT + part] != b.parts[row * HASH_PART_COUNT + part]) {
+                cout << " " << getStateHashPartName(part);
+            }
+        }
+        cout << endl;
+        
+        if(argc >= 4) {
+            diffDumpedStates(argv[3], argv[1], argv[2], tick);
+        }
+    }
+    
+    delete[] a.ticks;
+    delete[] a.parts;
+    delete[] b.ticks;
+    delete[] b.parts;
+    return status;
+}
@@ -0,0 +1,574 @@
+#include "../core/world.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// ============================================================================
+// LEVELGEN.CPP - Generate large lattice levels
+// ============================================================================
+// Writes a .lvl holding a lattice of horizontal lines (one every
+// --row-spacing rows) joined by vertical connectors at crossings ('+', one
+// every --col-spacing columns), the layout of complex_network.lvl scaled up.
+// Sources (S) start lines on the left and destinations (D) end them on the
+// right. The first and last columns of crossings are always connected from
+// top to bottom, so every destination can be reached from every source;
+// --density keeps that fraction of the other connectors. Switch tiles sit
+// halfway between crossings. Up to 24 switches reuse the letters A..Z
+// except S and D: every tile of a letter belongs to the same switch. With
+// more, every switch tile is a '*' with its own named switch (J0, J1, ...)
+// listed by cell in the SWITCHES section.
+//
+// The same options and seed always give the same file.
+// ============================================================================
+
+const int GEN_MARGIN = 2;           // empty border around the lattice
+// Switch letters: S and D tiles are always spawns and destinations
+const char GEN_SWITCH_LETTERS[] = "ABCEFGHIJKLMNOPQRTUVWXYZ";
+const int GEN_MAX_SWITCHES = 24;   // letter switches; named ones above that
+const int GEN_JOB_OVERRIDES = 8;    // switches changed per sweep job
+
+struct LevelGenSettings {
+    const char* outputFile;
+    const char* name;
+    const char* weather;
+    const char* jobFile;
+    int rows;
+    int cols;
+    int rowSpacing;
+    int colSpacing;
+    double density;
+    int switchCount;
+    double switchDensity;
+    double globalFraction;
+    int minK;
+    int maxK;
+    int sources;                    // -1 = one per line
+    int destinations;
+    int trainCount;
+    int spawnEvery;
+    int spawnBatch;
+    int seed;
+    int jobCount;
+};
+
+// ----------------------------------------------------------------------------
+// Random numbers (splitmix64, so the output does not depend on the C library)
+// ----------------------------------------------------------------------------
+static unsigned long long g_randomState = 0;
+
+static unsigned long long nextRandom() {
+    g_randomState += 0x9E3779B97F4A7C15ull;
+    unsigned long long z = g_randomState;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static int randomBelow(int n) {
+    return (int)(nextRandom() % (unsigned long long)n);
+}
+
+static double randomUnit() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int randomK(const LevelGenSettings& settings) {
+    return settings.minK + randomBelow(settings.maxK - settings.minK + 1);
+}
+
+// ----------------------------------------------------------------------------
+// Print usage
+// ----------------------------------------------------------------------------
+void printLevelGenUsage(const char* program) {
+    cout << "Usage: " << program << " <out.lvl> [options]" << endl;
+    cout << "Options:" << endl;
+    cout << "  --rows N            Grid rows (default 30)" << endl;
+    cout << "  --cols N            Grid columns (default 70)" << endl;
+    cout << "  --row-spacing N     Rows between horizontal lines (default 3)" << endl;
+    cout << "  --col-spacing N     Columns between crossings (default 8)" << endl;
+    cout << "  --density P         Share of vertical connectors kept, 0-1 (default 1)" << endl;
+    cout << "  --switches N        Distinct switches (default 20); above 24 each switch" << endl;
+    cout << "                      tile is its own named switch" << endl;
+    cout << "  --switch-density P  Share of track segments with a letter switch tile" << endl;
+    cout << "                      (default 0.25)" << endl;
+    cout << "  --global P          Share of switches in GLOBAL mode (default 0.1)" << endl;
+    cout << "  --k MIN MAX         Range of switch K-values (default 2 4)" << endl;
+    cout << "  --sources N         Lines starting at a source (default all)" << endl;
+    cout << "  --destinations N    Lines ending at a destination (default 4)" << endl;
+    cout << "  --trains N          Trains (default 10)" << endl;
+    cout << "  --spawn-every T     Ticks between spawn batches (default 4)" << endl;
+    cout << "  --spawn-batch N     Trains per batch (default 1)" << endl;
+    cout << "  --seed N            Generator seed, also the level's SEED (default 1)" << endl;
+    cout << "  --name TEXT         Level name" << endl;
+    cout << "  --weather W         NORMAL | RAIN | FOG (default NORMAL)" << endl;
+    cout << "  --jobs FILE         Also write a switchback_sweep job file" << endl;
+    cout << "  --job-count N       Jobs in that file (default 16)" << endl;
+}
+
+// ----------------------------------------------------------------------------
+// Parse arguments
+// ----------------------------------------------------------------------------
+bool parseLevelGenArgs(int argc, char* argv[], LevelGenSettings& settings) {
+    settings.outputFile = argv[1];
+    settings.name = nullptr;
+    settings.weather = "NORMAL";
+    settings.jobFile = nullptr;
+    settings.rows = 30;
+    settings.cols = 70;
+    settings.rowSpacing = 3;
+    settings.colSpacing = 8;
+    settings.density = 1.0;
+    settings.switchCount = 20;
+    settings.switchDensity = 0.25;
+    settings.globalFraction = 0.1;
+    settings.minK = 2;
+    settings.maxK = 4;
+    settings.sources = -1;
+    settings.destinations = 4;
+    settings.trainCount = 10;
+    settings.spawnEvery = 4;
+    settings.spawnBatch = 1;
+    settings.seed = 1;
+    settings.jobCount = 16;
+    
+    for(int a = 2; a < argc; a++) {
+        bool hasValue = a + 1 < argc;
+        if(strcmp(argv[a], "--rows") == 0 && hasValue) settings.rows = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--cols") == 0 && hasValue) settings.cols = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--row-spacing") == 0 && hasValue) settings.rowSpacing = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--col-spacing") == 0 && hasValue) settings.colSpacing = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--density") == 0 && hasValue) settings.density = atof(argv[++a]);
+        else if(strcmp(argv[a], "--switches") == 0 && hasValue) settings.switchCount = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--switch-density") == 0 && hasValue) settings.switchDensity = atof(argv[++a]);
+        else if(strcmp(argv[a], "--global") == 0 && hasValue) settings.globalFraction = atof(argv[++a]);
+        else if(strcmp(argv[a], "--k") == 0 && a + 2 < argc) {
+            settings.minK = atoi(argv[++a]);
+            settings.maxK = atoi(argv[++a]);
+        }
+        else if(strcmp(argv[a], "--sources") == 0 && hasValue) settings.sources = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--destinations") == 0 && hasValue) settings.destinations = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--trains") == 0 && hasValue) settings.trainCount = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--spawn-every") == 0 && hasValue) settings.spawnEvery = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--spawn-batch") == 0 && hasValue) settings.spawnBatch = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--seed") == 0 && hasValue) settings.seed = atoi(argv[++a]);
+        else if(strcmp(argv[a], "--name") == 0 && hasValue) settings.name = argv[++a];
+        else if(strcmp(argv[a], "--weather") == 0 && hasValue) settings.weather = argv[++a];
+        else if(strcmp(argv[a], "--jobs") == 0 && hasValue) settings.jobFile = argv[++a];
+        else if(strcmp(argv[a], "--job-count") == 0 && hasValue) settings.jobCount = atoi(argv[++a]);
+        else {
+            cout << "ERROR: Unknown option: " << argv[a] << endl;
+            return false;
+        }
+    }
+    
+    if(settings.rowSpacing < 2 || settings.colSpacing < 2) {
+        cout << "ERROR: --row-spacing and --col-spacing must be at least 2" << endl;
+        return false;
+    }
+    if(settings.switchCount < 0) {
+        cout << "ERROR: --switches must be 0 or more" << endl;
+        return false;
+    }
+    if(settings.minK < 1 || settings.maxK < settings.minK) {
+        cout << "ERROR: --k needs 1 <= MIN <= MAX" << endl;
+        return false;
+    }
+    if(settings.destinations < 1 || settings.trainCount < 0 ||
+       settings.spawnEvery < 1 || settings.spawnBatch < 1) {
+        cout << "ERROR: Need at least one destination, a spawn interval and batch of 1 or more" << endl;
+        return false;
+    }
+    if(strcmp(settings.weather, "NORMAL") != 0 && strcmp(settings.weather, "RAIN") != 0 &&
+       strcmp(settings.weather, "FOG") != 0) {
+        cout << "ERROR: Unknown weather: " << settings.weather << endl;
+        return false;
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Lattice
+// ----------------------------------------------------------------------------
+struct Lattice {
+    char* grid;                     // rows x cols
+    int rows;
+    int cols;
+    int* lineY;                     // y of each horizontal line
+    int lineCount;
+    int* crossingX;                 // x of each column of crossings
+    int crossingCount;
+    int* sourceLine;                // lines starting at S, top to bottom
+    int sourceCount;
+    int* destLine;                  // lines ending at D, top to bottom
+    int destCount;
+    bool letterUsed[GEN_MAX_SWITCHES];
+    bool namedSwitches;             // more switches than letters
+    int* namedX;                    // cell of each named switch
+    int* namedY;
+    int namedCount;
+    long long connectorCount;
+    long long switchTileCount;
+};
+
+static void freeLattice(Lattice& lattice) {
+    delete[] lattice.grid;
+    delete[] lattice.lineY;
+    delete[] lattice.crossingX;
+    delete[] lattice.sourceLine;
+    delete[] lattice.destLine;
+    delete[] lattice.namedX;
+    delete[] lattice.namedY;
+}
+
+// Line positions; false when the grid has no room for two crossing columns
+static bool placeLines(const LevelGenSettings& settings, Lattice& lattice) {
+    lattice.rows = settings.rows;
+    lattice.cols = settings.cols;
+    
+    int lastY = settings.rows - 1 - GEN_MARGIN;
+    lattice.lineCount = (lastY >= GEN_MARGIN) ? (lastY - GEN_MARGIN) / settings.rowSpacing + 1 : 0;
+    
+    // Room for the source stub on the left and the destination stub on the right
+    int firstX = GEN_MARGIN + settings.colSpacing;
+    int lastX = settings.cols - 1 - GEN_MARGIN - settings.colSpacing;
+    lattice.crossingCount = (lastX >= firstX) ? (lastX - firstX) / settings.colSpacing + 1 : 0;
+    
+    if(lattice.lineCount < 1 || lattice.crossingCount < 2) {
+        return false;
+    }
+    
+    lattice.lineY = new int[lattice.lineCount];
+    for(int i = 0; i < lattice.lineCount; i++) {
+        lattice.lineY[i] = GEN_MARGIN + i * settings.rowSpacing;
+    }
+    lattice.crossingX = new int[lattice.crossingCount];
+    for(int j = 0; j < lattice.crossingCount; j++) {
+        lattice.crossingX[j] = firstX + j * settings.colSpacing;
+    }
+    
+    // Spread evenly over the lines; destinations are offset by half a step
+    // so a few of them do not all sit at the top
+    int wantSources = (settings.sources < 0) ? lattice.lineCount : settings.sources;
+    lattice.sourceCount = (wantSources < lattice.lineCount) ? wantSources : lattice.lineCount;
+    lattice.destCount = (settings.destinations < lattice.lineCount) ? settings.destinations : lattice.lineCount;
+    
+    lattice.sourceLine = new int[lattice.sourceCount > 0 ? lattice.sourceCount : 1];
+    for(int k = 0; k < lattice.sourceCount; k++) {
+        lattice.sourceLine[k] = (int)((long long)k * lattice.lineCount / lattice.sourceCount);
+    }
+    lattice.destLine = new int[lattice.destCount];
+    for(int k = 0; k < lattice.destCount; k++) {
+        lattice.destLine[k] = (int)((2LL * k + 1) * lattice.lineCount / (2LL * lattice.destCount));
+    }
+    return true;
+}
+
+// Segments between neighbouring crossings, each holding at most one switch
+static long long countSegments(const Lattice& lattice) {
+    return (long long)lattice.lineCount * (lattice.crossingCount - 1);
+}
+
+// One '*' on exactly --switches of the segments (main() checks that there
+// are enough). Selection sampling keeps each segment equally likely, so the
+// switches spread over the whole lattice instead of filling the top lines.
+static void placeNamedSwitches(const LevelGenSettings& settings, Lattice& lattice) {
+    long long segmentsLeft = countSegments(lattice);
+    
+    lattice.namedX = new int[settings.switchCount];
+    lattice.namedY = new int[settings.switchCount];
+    for(int i = 0; i < lattice.lineCount; i++) {
+        int y = lattice.lineY[i];
+        for(int j = 0; j + 1 < lattice.crossingCount; j++) {
+            int needed = settings.switchCount - lattice.namedCount;
+            bool chosen = randomUnit() * segmentsLeft < needed;
+            segmentsLeft--;
+            if(!chosen) {
+                continue;
+            }
+            int x = lattice.crossingX[j] + settings.colSpacing / 2;
+            lattice.grid[(long long)y * lattice.cols + x] = '*';
+            lattice.namedX[lattice.namedCount] = x;
+            lattice.namedY[lattice.namedCount] = y;
+            lattice.namedCount++;
+            lattice.switchTileCount++;
+        }
+    }
+}
+
+static void buildLattice(const LevelGenSettings& settings, Lattice& lattice) {
+    int cols = lattice.cols;
+    long long cells = (long long)lattice.rows * cols;
+    lattice.grid = new char[cells];
+    memset(lattice.grid, ' ', cells);
+    lattice.connectorCount = 0;
+    lattice.switchTileCount = 0;
+    for(int i = 0; i < GEN_MAX_SWITCHES; i++) {
+        lattice.letterUsed[i] = false;
+    }
+    lattice.namedSwitches = settings.switchCount > GEN_MAX_SWITCHES;
+    lattice.namedCount = 0;
+    
+    int firstX = lattice.crossingX[0];
+    int lastX = lattice.crossingX[lattice.crossingCount - 1];
+    
+    // Horizontal lines, from their source (or the first crossing) to their
+    // destination (or the last crossing)
+    int s = 0;
+    int d = 0;
+    for(int i = 0; i < lattice.lineCount; i++) {
+        char* row = &lattice.grid[(long long)lattice.lineY[i] * cols];
+        bool source = (s < lattice.sourceCount && lattice.sourceLine[s] == i);
+        bool dest = (d < lattice.destCount && lattice.destLine[d] == i);
+        int startX = source ? GEN_MARGIN : firstX;
+        int endX = dest ? lastX + settings.colSpacing : lastX;
+        
+        memset(&row[startX], '=', endX - startX + 1);
+        if(source) {
+            row[startX] = 'S';
+            s++;
+        }
+        if(dest) {
+            row[endX] = 'D';
+            d++;
+        }
+        row[firstX] = '+';
+        row[lastX] = '+';
+    }
+    
+    // Vertical connectors; the outer columns are always complete
+    for(int j = 0; j < lattice.crossingCount; j++) {
+        int x = lattice.crossingX[j];
+        bool outer = (j == 0 || j == lattice.crossingCount - 1);
+        for(int i = 0; i + 1 < lattice.lineCount; i++) {
+            if(!outer && randomUnit() >= settings.density) {
+                continue;
+            }
+            for(int y = lattice.lineY[i] + 1; y < lattice.lineY[i + 1]; y++) {
+                lattice.grid[(long long)y * cols + x] = '|';
+            }
+            lattice.grid[(long long)lattice.lineY[i] * cols + x] = '+';
+            lattice.grid[(long long)lattice.lineY[i + 1] * cols + x] = '+';
+            lattice.connectorCount++;
+        }
+    }
+    
+    // Switch tiles halfway along the segments between crossings
+    if(settings.switchCount == 0) {
+        return;
+    }
+    if(lattice.namedSwitches) {
+        placeNamedSwitches(settings, lattice);
+        return;
+    }
+    for(int i = 0; i < lattice.lineCount; i++) {
+        char* row = &lattice.grid[(long long)lattice.lineY[i] * cols];
+        for(int j = 0; j + 1 < lattice.crossingCount; j++) {
+            if(randomUnit() >= settings.switchDensity) {
+                continue;
+            }
+            int letter = randomBelow(settings.switchCount);
+            row[lattice.crossingX[j] + settings.colSpacing / 2] = GEN_SWITCH_LETTERS[letter];
+            lattice.letterUsed[letter] = true;
+            lattice.switchTileCount++;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Write the level
+// ----------------------------------------------------------------------------
+static bool writeLevel(const LevelGenSettings& settings, const Lattice& lattice) {
+    FILE* file = fopen(settings.outputFile, "w");
+    if(file == nullptr) {
+        return false;
+    }
+    static char buffer[1 << 20];
+    setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+    
+    if(settings.name != nullptr) {
+        fprintf(file, "NAME:\n%s\n\n", settings.name);
+    } else {
+        fprintf(file, "NAME:\nGenerated %dx%d Lattice - %d Trains\n\n",
+                settings.rows, settings.cols, settings.trainCount);
+    }
+    fprintf(file, "ROWS:\n%d\n\nCOLS:\n%d\n\n", settings.rows, settings.cols);
+    fprintf(file, "SEED:\n%d\n\nWEATHER:\n%s\n\n", settings.seed, settings.weather);
+    
+    // Rows without their trailing spaces; the loader pads them
+    fprintf(file, "MAP:\n");
+    for(int y = 0; y < lattice.rows; y++) {
+        const char* row = &lattice.grid[(long long)y * lattice.cols];
+        int length = lattice.cols;
+        while(length > 0 && row[length - 1] == ' ') {
+            length--;
+        }
+        fwrite(row, 1, length, file);
+        fputc('\n', file);
+    }
+    
+    fprintf(file, "\nSWITCHES:\n");
+    int switchCount = lattice.namedSwitches ? lattice.namedCount : GEN_MAX_SWITCHES;
+    for(int s = 0; s < switchCount; s++) {
+        if(!lattice.namedSwitches && !lattice.letterUsed[s]) {
+            continue;
+        }
+        char head[64];
+        if(lattice.namedSwitches) {
+            snprintf(head, sizeof(head), "* J%d %d %d", s, lattice.namedX[s], lattice.namedY[s]);
+        } else {
+            snprintf(head, sizeof(head), "%c", GEN_SWITCH_LETTERS[s]);
+        }
+        
+        if(randomUnit() < settings.globalFraction) {
+            int k = randomK(settings);
+            fprintf(file, "%s GLOBAL 0 %d %d %d %d STRAIGHT TURN\n", head, k, k, k, k);
+        } else {
+            fprintf(file, "%s PER_DIR 0 %d %d %d %d STRAIGHT TURN\n", head,
+                    randomK(settings), randomK(settings), randomK(settings), randomK(settings));
+        }
+    }
+    
+    // Batches rotate through the sources, so a batch no larger than the
+    // source count never puts two trains on one spawn
+    fprintf(file, "\nTRAINS:\n");
+    for(int t = 0; t < settings.trainCount; t++) {
+        int tick = (t / settings.spawnBatch) * settings.spawnEvery;
+        int line = (lattice.sourceCount > 0) ? lattice.sourceLine[t % lattice.sourceCount] : 0;
+        fprintf(file, "%d %d %d 1 %d\n", tick, GEN_MARGIN, lattice.lineY[line],
+                randomBelow(lattice.destCount));
+    }
+    
+    return fclose(file) == 0;
+}
+
+// ----------------------------------------------------------------------------
+// Sweep jobs: the first runs the level as written, each other one changes
+// the K-values (and sometimes the mode) of a few switches
+// ----------------------------------------------------------------------------
+static bool writeSweepJobs(const LevelGenSettings& settings, const Lattice& lattice) {
+    ofstream jobs(settings.jobFile);
+    if(!jobs.is_open()) {
+        return false;
+    }
+    
+    // Candidates: the letters used, or every named switch
+    int candidates = lattice.namedSwitches ? lattice.namedCount : GEN_MAX_SWITCHES;
+    int* picks = new int[candidates > 0 ? candidates : 1];
+    int pickCount = 0;
+    for(int s = 0; s < candidates; s++) {
+        if(lattice.namedSwitches || lattice.letterUsed[s]) {
+            picks[pickCount++] = s;
+        }
+    }
+    
+    jobs << "# level  seed  overrides (levelgen --seed " << settings.seed << ")\n";
+    for(int job = 0; job < settings.jobCount; job++) {
+        jobs << settings.outputFile << " " << settings.seed + job;
+        int changes = (job == 0) ? 0 : pickCount;
+        if(changes > GEN_JOB_OVERRIDES) changes = GEN_JOB_OVERRIDES;
+        for(int c = 0; c < changes; c++) {
+            // Distinct switches: move the pick to the front of the list
+            int pick = c + randomBelow(pickCount - c);
+            int swap = picks[c];
+            picks[c] = picks[pick];
+            picks[pick] = swap;
+            char name[16];
+            if(lattice.namedSwitches) {
+                snprintf(name, sizeof(name), "J%d", picks[c]);
+            } else {
+                snprintf(name, sizeof(name), "%c", GEN_SWITCH_LETTERS[picks[c]]);
+            }
+            jobs << " " << name << ".k=" << randomK(settings);
+            if(randomUnit() < settings.globalFraction) {
+                jobs << " " << name << ".mode=" << (randomBelow(2) ? "GLOBAL" : "PER_DIR");
+            }
+        }
+        jobs << "\n";
+    }
+    delete[] picks;
+    return jobs.good();
+}
+
+int main(int argc, char* argv[]) {
+    
+    if(argc < 2 || argv[1][0] == '-') {
+        printLevelGenUsage(argv[0]);
+        return 1;
+    }
+    
+    LevelGenSettings settings;
+    if(!parseLevelGenArgs(argc, argv, settings)) {
+        return 1;
+    }
+    g_randomState = (unsigned long long)(unsigned int)settings.seed;
+    
+    Lattice lattice;
+    memset(&lattice, 0, sizeof(lattice));
+    if(!placeLines(settings, lattice)) {
+        cout << "ERROR: A " << settings.rows << " x " << settings.cols
+             << " grid has no room for a lattice with these spacings" << endl;
+        freeLattice(lattice);
+        return 1;
+    }
+    if(lattice.sourceCount < 1) {
+        cout << "ERROR: Need at least one source" << endl;
+        freeLattice(lattice);
+        return 1;
+    }
+    if(settings.switchCount > GEN_MAX_SWITCHES && settings.switchCount > countSegments(lattice)) {
+        cout << "ERROR: --switches " << settings.switchCount << " needs " << settings.switchCount
+             << " segments between crossings, the lattice has " << countSegments(lattice)
+             << " (use a larger grid or smaller spacings)" << endl;
+        freeLattice(lattice);
+        return 1;
+    }
+    buildLattice(settings, lattice);
+    
+    if(!writeLevel(settings, lattice)) {
+        cout << "ERROR: Cannot write " << settings.outputFile << endl;
+        freeLattice(lattice);
+        return 1;
+    }
+    if(settings.jobFile != nullptr && !writeSweepJobs(settings, lattice)) {
+        cout << "ERROR: Cannot write " << settings.jobFile << endl;
+        freeLattice(lattice);
+        return 1;
+    }
+    
+    int usedSwitches = lattice.namedCount;
+    for(int letter = 0; letter < GEN_MAX_SWITCHES; letter++) {
+        if(lattice.letterUsed[letter]) usedSwitches++;
+    }
+    long long cells = (long long)settings.rows * settings.cols;
+    long long worldBytes = measureWorld(settings.rows, settings.cols, settings.trainCount,
+                                        usedSwitches, lattice.sourceCount, lattice.destCount);
+    long long fieldBytes = cells * 4 * (long long)sizeof(unsigned short) * lattice.destCount;
+    int lastSpawn = (settings.trainCount > 0) ?
+                    ((settings.trainCount - 1) / settings.spawnBatch) * settings.spawnEvery : 0;
+    
+    cout << "Wrote " << settings.outputFile << ": " << settings.rows << " x " << settings.cols << endl;
+    cout << "  " << lattice.lineCount << " lines x " << lattice.crossingCount << " crossings, "
+         << lattice.connectorCount << " connectors" << endl;
+    cout << "  " << usedSwitches << " switches on " << lattice.switchTileCount << " tiles" << endl;
+    cout << "  " << lattice.sourceCount << " sources, " << lattice.destCount << " destinations" << endl;
+    cout << "  " << settings.trainCount << " trains, last spawn at tick " << lastSpawn << endl;
+    cout << "  World: " << worldBytes / (1024 * 1024) << " MB, of which distance fields "
+         << fieldBytes / (1024 * 1024) << " MB" << endl;
+    if(usedSwitches < settings.switchCount) {
+        cout << "WARNING: Only " << usedSwitches << " of the " << settings.switchCount
+             << " switch letters got a tile (raise --switch-density)" << endl;
+    }
+    if(lattice.sourceCount < settings.spawnBatch) {
+        cout << "WARNING: Batches larger than the source count put trains on the same spawn" << endl;
+    }
+    if(settings.jobFile != nullptr) {
+        cout << "Wrote " << settings.jobFile << ": " << settings.jobCount << " sweep jobs" << endl;
+    }
+    
+    freeLattice(lattice);
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "../core/trace_format.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+using namespace std;
+
+// ============================================================================
+// TRACE2CSV.CPP - Convert out/trace.bin back to the CSV evidence files
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Write the rows of one block to the three CSV streams
+// ----------------------------------------------------------------------------
+void writeBlockRows(int blockIndex, ostream& traceOut, ostream& switchOut, ostream& signalOut) {
+    const char* dirStr[] = {"UP", "RIGHT", "DOWN", "LEFT"};
+    
+    int tick;
+    int trainRows, switchRows, signalRows;
+    const int* trainIds;
+    const unsigned short* trainX;
+    const unsigned short* trainY;
+    const unsigned char* trainDir;
+    const unsigned char* trainState;
+    const unsigned short* switchIds;
+    const unsigned char* switchMode;
+    const unsigned char* switchState;
+    const unsigned short* signalIds;
+    const unsigned char* signalValue;
+    
+    if(!loadBinaryTraceBlock(blockIndex, tick,
+                             trainRows, trainIds, trainX, trainY, trainDir, trainState,
+                             switchRows, switchIds, switchMode, switchState,
+                             signalRows, signalIds, signalValue)) {
+        cout << "ERROR: Corrupt block " << blockIndex << endl;
+        return;
+    }
+    
+    for(int i = 0; i < trainRows; i++) {
+        traceOut << tick << "," << trainIds[i] << "," << trainX[i] << "," << trainY[i] << ","
+                 << dirStr[trainDir[i] & 3] << "," << getBinaryTraceString(trainState[i]) << "\n";
+    }
+    
+    for(int i = 0; i < switchRows; i++) {
+        switchOut << tick << "," << getBinaryTraceSwitchName(switchIds[i]) << ","
+                  << getBinaryTraceString(switchMode[i]) << ","
+                  << getBinaryTraceString(switchState[i]) << "\n";
+    }
+    
+    for(int i = 0; i < signalRows; i++) {
+        signalOut << tick << "," << getBinaryTraceSwitchName(signalIds[i]) << ","
+                  << getBinaryTraceString(signalValue[i]) << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    
+    if(argc < 2) {
+        cout << "Usage: " << argv[0] << " <trace.bin> [output_dir]" << endl;
+        cout << "       " << argv[0] << " <trace.bin> --tick N" << endl;
+        cout << "       " << argv[0] << " <trace.bin> --info" << endl;
+        return 1;
+    }
+    
+    if(!mapBinaryTrace(argv[1])) {
+        cout << "ERROR: Cannot read binary trace: " << argv[1] << endl;
+        return 1;
+    }
+    
+    if(argc >= 3 && strcmp(argv[2], "--info") == 0) {
+        const char* levelName;
+        int rows, cols, seed, weatherMode;
+        getBinaryTraceLevelInfo(levelName, rows, cols, seed, weatherMode);
+        
+        cout << "Level: " << levelName << endl;
+        cout << "Grid size: " << rows << " x " << cols << endl;
+        cout << "Seed: " << seed << endl;
+        cout << "Weather: " << weatherMode << endl;
+        cout << "Blocks: " << getBinaryTraceBlockCount() << endl;
+        cout << "Strings:";
+        for(int i = 0; i < getBinaryTraceStringCount(); i++) {
+            cout << " " << getBinaryTraceString(i);
+        }
+        cout << endl;
+        unmapBinaryTrace();
+        return 0;
+    }
+    
+    if(argc >= 4 && strcmp(argv[2], "--tick") == 0) {
+        int tick = atoi(argv[3]);
+        int block = findBinaryTraceBlock(tick);
+        if(block < 0) {
+            cout << "No rows for tick " << tick << endl;
+            unmapBinaryTrace();
+            return 1;
+        }
+        
+        while(block < getBinaryTraceBlockCount() && getBinaryTraceBlockTick(block) == tick) {
+            writeBlockRows(block, cout, cout, cout);
+            block++;
+        }
+        unmapBinaryTrace();
+        return 0;
+    }
+    
+    char dir[256] = "out";
+    if(argc >= 3) {
+        strncpy(dir, argv[2], 255);
+        dir[255] = '\0';
+    }
+    mkdir(dir, 0755);
+    
+    char path[512];
+    snprintf(path, sizeof(path), "%s/trace.csv", dir);
+    ofstream traceFile(path);
+    snprintf(path, sizeof(path), "%s/switches.csv", dir);
+    ofstream switchFile(path);
+    snprintf(path, sizeof(path), "%s/signals.csv", dir);
+    ofstream signalFile(path);
+    
+    if(!traceFile.is_open() || !switchFile.is_open() || !signalFile.is_open()) {
+        cout << "ERROR: Cannot write CSV files to " << dir << endl;
+        unmapBinaryTrace();
+        return 1;
+    }
+    
+    traceFile << "Tick,TrainID,X,Y,Direction,State\n";
+    switchFile << "Tick,Switch,Mode,State\n";
+    signalFile << "Tick,Switch,Signal\n";
+    
+    int blockCount = getBinaryTraceBlockCount();
+    for(int b = 0; b < blockCount; b++) {
+        writeBlockRows(b, traceFile, switchFile, signalFile);
+    }
+    
+    traceFile.close();
+    switchFile.close();
+    signalFile.close();
+    unmapBinaryTrace();
+    
+    cout << "Wrote " << blockCount << " tick blocks to " << dir << endl;
+    return 0;
+}